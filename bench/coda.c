@@ -0,0 +1,195 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Microbenchmark delle code del pool di thread: inserimenti ed estrazioni sulla deque di
+ *                      Chase-Lev e sulla coda globale lock-free, confrontate con la Queue protetta da una mutex del
+ *                      pool precedente. Uso: ./bench/coda [thread] [task]
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+/** Le code del pool sono statiche: il benchmark include direttamente la loro implementazione **/
+#include "../includes/threadPool/threadPool.c"
+#include <stdio.h>
+
+
+#define THREAD_PREDEFINITI 4
+#define TASK_PREDEFINITI 2000000
+#define DIM_BLOCCO 128
+
+
+/**
+ * @brief                   Struttura dati misurata
+ * @enum                    Struttura
+ */
+typedef enum { DEQUE, RING, QUEUE_MUTEX } Struttura;
+
+
+/**
+ * @brief                   Stato di una prova con piu' thread
+ * @struct                  Prova
+ * @param tipo              Struttura misurata
+ * @param deque             Deque (DEQUE)
+ * @param ring              Coda globale (RING)
+ * @param coda              Queue (QUEUE_MUTEX)
+ * @param accesso           Mutex della Queue
+ * @param totale            Task da far passare nella struttura
+ * @param estratti          Task estratti finora [accesso atomico]
+ */
+typedef struct {
+    Struttura tipo;
+    WorkDeque deque;
+    TaskRing ring;
+    Queue *coda;
+    pthread_mutex_t accesso;
+    long totale;
+    long estratti;
+} Prova;
+
+
+/** Task inseriti nelle strutture: per la Queue vengono copiati, come faceva il pool precedente **/
+static Task modello;
+
+
+/**
+ * @brief                   Istante corrente in secondi
+ * @fun                     ora
+ * @return                  Ritorna i secondi trascorsi da un istante fisso
+ */
+static double ora(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+
+/**
+ * @brief                   Inserisce un task nella struttura
+ * @fun                     inserisci
+ * @param p                 Prova
+ * @return                  (0) in caso di successo; (-1) se la struttura e' piena
+ */
+static int inserisci(Prova *p) {
+    Queue *nuova = NULL;
+
+    switch(p->tipo) {
+        case DEQUE: return pushDeque(&(p->deque), &modello);
+        case RING: return pushRing(&(p->ring), &modello);
+        default:
+            pthread_mutex_lock(&(p->accesso));
+            if((nuova = insertIntoQueue(p->coda, &modello, sizeof(Task))) != NULL) p->coda = nuova;
+            pthread_mutex_unlock(&(p->accesso));
+            return (nuova != NULL) ? 0 : -1;
+    }
+}
+
+
+/**
+ * @brief                   Estrae un task dalla struttura: il proprietario dal fondo della deque, gli altri rubando
+ * @fun                     estrai
+ * @param p                 Prova
+ * @param proprietario      Se chi estrae e' il proprietario della deque
+ * @return                  (1) se ha estratto un task; (0) altrimenti
+ */
+static int estrai(Prova *p, int proprietario) {
+    void *task = NULL;
+
+    switch(p->tipo) {
+        case DEQUE: task = (proprietario) ? popDeque(&(p->deque)) : stealDeque(&(p->deque)); break;
+        case RING: task = popRing(&(p->ring)); break;
+        default:
+            pthread_mutex_lock(&(p->accesso));
+            task = deleteFirstElement(&(p->coda));
+            pthread_mutex_unlock(&(p->accesso));
+            free(task);
+            break;
+    }
+
+    return (task != NULL);
+}
+
+
+/**
+ * @brief                   Thread che estrae finche' non sono passati tutti i task
+ * @fun                     consumatore
+ * @param argv              Prova
+ * @return                  Ritorna sempre NULL
+ */
+static void* consumatore(void *argv) {
+    Prova *p = (Prova *) argv;
+
+    while(__atomic_load_n(&(p->estratti), __ATOMIC_RELAXED) < p->totale) {
+        if(estrai(p, 0)) __atomic_add_fetch(&(p->estratti), 1, __ATOMIC_RELAXED);
+        else CPU_RELAX();
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief                   Esegue una prova: il thread principale inserisce blocchi di DIM_BLOCCO task e ne estrae a
+ *                          sua volta, gli altri numeroThread-1 thread estraggono in concorrenza
+ * @fun                     prova
+ * @param tipo              Struttura da misurare
+ * @param numeroThread      Thread coinvolti (1 per la sola coppia inserimento/estrazione)
+ * @param totale            Task da far passare nella struttura
+ * @return                  Ritorna i milioni di task al secondo
+ */
+static double prova(Struttura tipo, unsigned int numeroThread, long totale) {
+    Prova p;
+    pthread_t consumatori[numeroThread];
+    double inizio = 0, durata = 0;
+    long inseriti = 0;
+
+    /** Preparo la struttura **/
+    memset(&p, 0, sizeof(Prova));
+    p.tipo = tipo, p.totale = totale;
+    if((initDeque(&(p.deque), DIM_CODA_THREAD) == -1) || (initRing(&(p.ring), DIM_CODA_THREAD) == -1)) {
+        perror("bench");
+        exit(errno);
+    }
+    pthread_mutex_init(&(p.accesso), NULL);
+
+    /** Misuro **/
+    inizio = ora();
+    for(unsigned int i=1; i<numeroThread; i++) pthread_create(consumatori+i, NULL, consumatore, &p);
+    while(__atomic_load_n(&(p.estratti), __ATOMIC_RELAXED) < totale) {
+        for(int i=0; (i<DIM_BLOCCO) && (inseriti<totale) && (inserisci(&p) == 0); i++) inseriti++;
+        for(int i=0; (i<DIM_BLOCCO) && estrai(&p, 1); i++) __atomic_add_fetch(&(p.estratti), 1, __ATOMIC_RELAXED);
+    }
+    for(unsigned int i=1; i<numeroThread; i++) pthread_join(consumatori[i], NULL);
+    durata = ora() - inizio;
+
+    /** Libero **/
+    free(p.deque.buffer);
+    free(p.ring.slot);
+    destroyQueue(&(p.coda), free);
+    pthread_mutex_destroy(&(p.accesso));
+
+    return (double) totale / durata / 1e6;
+}
+
+
+int main(int argc, char *argv[]) {
+    /** Variabili **/
+    unsigned int numeroThread = (argc > 1) ? (unsigned int) strtoul(argv[1], NULL, 10) : THREAD_PREDEFINITI;
+    long totale = (argc > 2) ? strtol(argv[2], NULL, 10) : TASK_PREDEFINITI;
+    const char *nomi[] = { "deque di Chase-Lev", "coda globale lock-free", "Queue + mutex (precedente)" };
+
+    /** Controllo parametri **/
+    if((numeroThread == 0) || (totale <= 0)) {
+        fprintf(stderr, "Uso: %s [thread] [task]\n", argv[0]);
+        return EINVAL;
+    }
+
+    /** Prove **/
+    printf("task: %ld - blocchi da %d\n", totale, DIM_BLOCCO);
+    printf("%-28s %11s th %11u th\n", "", "1", numeroThread);
+    for(int s=DEQUE; s<=QUEUE_MUTEX; s++) {
+        printf("%-28s %10.2f M/s %10.2f M/s\n", nomi[s], prova((Struttura) s, 1, totale), prova((Struttura) s, numeroThread, totale));
+    }
+
+    return 0;
+}
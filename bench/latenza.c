@@ -0,0 +1,287 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Latenza delle richieste di un singolo client a basso carico: esegue in sequenza la stessa
+ *                      operazione e riporta mediana, 99° percentile e media dei tempi di andata e ritorno.
+ *                      Uso: ./bench/latenza [-s] socket iterazioni operazione [dimensione del file di prova]
+ *                      Con -s il client non usa gli anelli in memoria condivisa: tutto passa dal socket
+ *                      Operazioni:
+ *                          open        openFile di un file esistente (seguita da closeFile, non misurata)
+ *                          read        readFile di un file aperto (dal socket con -s, altrimenti le risposte fino a
+ *                                      ANELLO_MASSIMO_FRAME arrivano dall'anello)
+ *                          shm         readFile di un file pubblicato nel segmento condiviso
+ *                          sequenza    openFile, lockFile, readFile, unlockFile e closeFile in cinque richieste
+ *                          composta    le stesse operazioni in un'unica compoundRequest
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <Client_API.h>
+#include <time.h>
+
+
+#define RISCALDAMENTO 100
+#define FILE_BENCH "/bench/latenza"
+#define DIMENSIONE_PREDEFINITA 4096
+
+
+/** Dimensione e pathname del file di prova (distinto per ogni processo, putFile non riscrive un file esistente) **/
+static size_t dimensione = DIMENSIONE_PREDEFINITA;
+static char fileBench[MAX_PATHNAME];
+
+
+/**
+ * @brief                   Operazione misurata
+ * @struct                  Operazione
+ * @param nome              Nome da riga di comando
+ * @param prepara           Prepara il server prima delle misure (NULL se non serve)
+ * @param esegui            Esegue l'operazione una volta; il tempo misurato e' quello tra inizio e fine
+ */
+typedef struct {
+    const char *nome;
+    int (*prepara)(void);
+    int (*esegui)(double *, double *);
+} Operazione;
+
+
+/**
+ * @brief                   Istante corrente in secondi
+ * @fun                     ora
+ * @return                  Ritorna i secondi trascorsi da un istante fisso
+ */
+static double ora(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+
+/**
+ * @brief                   Crea il file usato dalle misure
+ * @fun                     preparaFile
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int preparaFile(void) {
+    /** Variabili **/
+    void *contenuto = NULL;
+    int esito = 0;
+
+    if((contenuto = calloc(1, dimensione)) == NULL) return -1;
+    esito = putFile(fileBench, contenuto, dimensione, 0, NULL);
+    free(contenuto);
+
+    return esito;
+}
+
+
+/**
+ * @brief                   Crea il file usato dalle misure e lo apre, per leggerlo dal socket
+ * @fun                     preparaLettura
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int preparaLettura(void) {
+    if(preparaFile() == -1) return -1;
+    return openFile(fileBench, 0);
+}
+
+
+/**
+ * @brief                   Crea il file usato dalle misure, lo apre e lo pubblica nel segmento condiviso
+ * @fun                     preparaPubblicazione
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int preparaPubblicazione(void) {
+    if(preparaLettura() == -1) return -1;
+    return publishFile(fileBench);
+}
+
+
+/**
+ * @brief                   openFile del file di prova; la closeFile che la segue non e' misurata
+ * @fun                     apertura
+ * @param inizio            Istante di inizio della misura
+ * @param fine              Istante di fine della misura
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int apertura(double *inizio, double *fine) {
+    int esito = 0;
+
+    *inizio = ora();
+    esito = openFile(fileBench, 0);
+    *fine = ora();
+    if(esito == -1) return -1;
+
+    return closeFile(fileBench);
+}
+
+
+/**
+ * @brief                   readFile del file di prova
+ * @fun                     lettura
+ * @param inizio            Istante di inizio della misura
+ * @param fine              Istante di fine della misura
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int lettura(double *inizio, double *fine) {
+    void *buf = NULL;
+    size_t size = 0;
+    int esito = 0;
+
+    *inizio = ora();
+    esito = readFile(fileBench, &buf, &size);
+    *fine = ora();
+    free(buf);
+    if((esito == 0) && (size != dimensione)) { errno = EIO; return -1; }
+
+    return esito;
+}
+
+
+/**
+ * @brief                   Apre, blocca, legge, sblocca e chiude il file di prova con cinque richieste
+ * @fun                     sequenza
+ * @param inizio            Istante di inizio della misura
+ * @param fine              Istante di fine della misura
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int sequenza(double *inizio, double *fine) {
+    void *buf = NULL;
+    size_t size = 0;
+    int esito = 0;
+
+    *inizio = ora();
+    if(openFile(fileBench, 0) == -1) return -1;
+    if((lockFile(fileBench) == 0) && (readFile(fileBench, &buf, &size) == 0) && (unlockFile(fileBench) == 0)) esito = closeFile(fileBench);
+    else esito = -1;
+    *fine = ora();
+    free(buf);
+
+    return esito;
+}
+
+
+/**
+ * @brief                   Apre, blocca, legge, sblocca e chiude il file di prova con un'unica richiesta composta
+ * @fun                     composta
+ * @param inizio            Istante di inizio della misura
+ * @param fine              Istante di fine della misura
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int composta(double *inizio, double *fine) {
+    Operazione_Composta ops[] = {
+        { OP_OPENFILE, 0, fileBench, 0, NULL, 0, 0 },
+        { OP_LOCKFILE, 0, fileBench, 0, NULL, 0, 0 },
+        { OP_READFILE, 0, fileBench, 0, NULL, 0, 0 },
+        { OP_UNLOCKFILE, 0, fileBench, 0, NULL, 0, 0 },
+        { OP_CLOSEFILE, 0, fileBench, 0, NULL, 0, 0 }
+    };
+    int esito = 0;
+
+    *inizio = ora();
+    esito = compoundRequest(ops, 5, NULL);
+    *fine = ora();
+    free(ops[2].buf);
+
+    return esito;
+}
+
+
+/**
+ * @brief                   Operazioni disponibili
+ */
+static const Operazione operazioni[] = {
+    { "open", preparaFile, apertura },
+    { "read", preparaLettura, lettura },
+    { "shm", preparaPubblicazione, lettura },
+    { "sequenza", preparaFile, sequenza },
+    { "composta", preparaFile, composta },
+    { NULL, NULL, NULL }
+};
+
+
+/**
+ * @brief                   Confronto tra durate per qsort
+ * @fun                     confronta
+ */
+static int confronta(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+int main(int argc, char *argv[]) {
+    /** Variabili **/
+    struct timespec attesa = { 1, 0 };
+    const Operazione *op = operazioni;
+    long iterazioni = 0;
+    int opzione = 0, soloSocket = 0;
+    double *durate = NULL, inizio = 0, fine = 0, somma = 0;
+
+    /** Controllo parametri **/
+    while((opzione = getopt(argc, argv, "s")) != -1) {
+        if(opzione != 's') {
+            fprintf(stderr, "Uso: %s [-s] socket iterazioni operazione [dimensione]\n", argv[0]);
+            return EINVAL;
+        }
+        soloSocket = 1;
+    }
+    argc -= optind - 1, argv += optind - 1;
+    if((argc != 4) && (argc != 5)) {
+        fprintf(stderr, "Uso: %s [-s] socket iterazioni operazione [dimensione]\n", argv[0]);
+        return EINVAL;
+    }
+    if((iterazioni = strtol(argv[2], NULL, 10)) <= 0) {
+        fprintf(stderr, "Numero di iterazioni non valido: %s\n", argv[2]);
+        return EINVAL;
+    }
+    if((argc == 5) && ((dimensione = strtoul(argv[4], NULL, 10)) == 0)) {
+        fprintf(stderr, "Dimensione non valida: %s\n", argv[4]);
+        return EINVAL;
+    }
+    while((op->nome != NULL) && (strcmp(op->nome, argv[3]) != 0)) op++;
+    if(op->nome == NULL) {
+        fprintf(stderr, "Operazione sconosciuta: %s\n", argv[3]);
+        return EINVAL;
+    }
+    if((durate = (double *) malloc(iterazioni * sizeof(double))) == NULL) {
+        perror("malloc");
+        return errno;
+    }
+
+    /** Connessione e preparazione **/
+    snprintf(fileBench, MAX_PATHNAME, "%s-%ld", FILE_BENCH, (long) getpid());
+    setSharedRings(!soloSocket);
+    if(openConnection(argv[1], 100, attesa) == -1) {
+        perror("openConnection");
+        free(durate);
+        return errno;
+    }
+    if((op->prepara != NULL) && (op->prepara() == -1)) {
+        perror("preparazione");
+        closeConnection(argv[1]);
+        free(durate);
+        return errno;
+    }
+
+    /** Misure, dopo RISCALDAMENTO esecuzioni non contate **/
+    for(long i=-RISCALDAMENTO; i<iterazioni; i++) {
+        if(op->esegui(&inizio, &fine) == -1) {
+            perror(op->nome);
+            closeConnection(argv[1]);
+            free(durate);
+            return errno;
+        }
+        if(i >= 0) durate[i] = (fine - inizio) * 1e6, somma += durate[i];
+    }
+    closeConnection(argv[1]);
+
+    /** Risultati **/
+    qsort(durate, iterazioni, sizeof(double), confronta);
+    printf("%s%s %s: %ld richieste - p50 %.1f us - p99 %.1f us - media %.1f us\n", argv[1], (soloSocket) ? " (solo socket)" : "", op->nome, iterazioni, durate[iterazioni/2], durate[(iterazioni*99)/100], somma / iterazioni);
+
+    free(durate);
+    return 0;
+}
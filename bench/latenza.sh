@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Benchmark di latenza: avvio il server con la configurazione indicata, misuro con un solo client e lo arresto
+
+# Controllo gli argomenti
+if [ $# -lt 4 ]; then
+  echo "Uso: $0 config [-s] socket iterazioni operazione [dimensione]"
+  exit 22;
+fi
+
+./server $1 > /dev/null &
+SERVER=$!
+
+# Attendo che il server sia in ascolto
+sleep 1
+shift
+./bench/latenza "$@"
+ESITO=$?
+
+# Mando il segnale di arresto al server
+kill -1 $SERVER
+wait $SERVER
+
+exit $ESITO
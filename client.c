@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include <utils.h>
 #include <Client_API.h>
 
@@ -274,6 +275,63 @@ static void orderRequest(int argc, char **argv) {
 }
 
 
+/**
+ * @brief               Legge dal server i file indicati con un'unica richiesta e stampa l'esito di ognuno
+ * @fun                 leggiFileDalServer
+ * @param option        Opzioni del client (per la stampa)
+ * @param files         Pathname dei file da leggere
+ * @param numero        Numero dei file
+ * @param dirname       Cartella in cui salvare i file letti (NULL se non vanno salvati)
+ */
+static void leggiFileDalServer(checkList *option, char **files, int numero, const char *dirname) {
+    /** Variabili **/
+    char errorMessage[MAX_BUFFER_LEN];
+    void **bufs = NULL;
+    size_t *sizes = NULL;
+    int *esiti = NULL;
+
+    /** Controllo parametri **/
+    if((files == NULL) || (numero <= 0)) return;
+
+    /** Lettura dei file **/
+    if(((bufs = (void **) calloc(numero, sizeof(void *))) == NULL) ||
+       ((sizes = (size_t *) calloc(numero, sizeof(size_t))) == NULL) ||
+       ((esiti = (int *) calloc(numero, sizeof(int))) == NULL)) {
+        TRACE_ON_DISPLAY("Errore di allocazione memoria per la lettura dei file\n")
+    } else if(readFiles(files, numero, bufs, sizes, esiti) == -1) {
+        if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
+            TRACE_ON_DISPLAY("Impossibile leggere i file dal server - Errore: %s\n", errorMessage)
+        }
+    } else {
+        for(int i=0; i<numero; i++) {
+            if(esiti[i] == ENOENT) {
+                TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Rimosso o espulso dal server\n", files[i])
+            } else if(esiti[i] != 0) {
+                if(strerror_r(esiti[i], errorMessage, MAX_BUFFER_LEN) == 0) {
+                    TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Errore: %s\n", files[i], errorMessage)
+                }
+            } else {
+                TRACE_ON_DISPLAY("File:%s letto dal server\n", files[i])
+                if((dirname != NULL) && (writeFileIntoDisk(files[i], dirname, bufs[i], sizes[i]) == -1)) {
+                    if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
+                        TRACE_ON_DISPLAY("Salvatagio del file dentro \"%s\" non riuscita - Errore: %s\n", dirname, errorMessage)
+                    }
+                }
+            }
+        }
+    }
+
+    /** Libero la memoria **/
+    for(int i=0; (bufs != NULL) && (i<numero); i++) {
+        if(bufs[i] != NULL) free(bufs[i]);
+    }
+    if(bufs != NULL) free(bufs);
+    if(sizes != NULL) free(sizes);
+    if(esiti != NULL) free(esiti);
+    errno = 0;
+}
+
+
 /** Main **/
 int main(int argc, const char **argv) {
     /** Variabili **/
@@ -282,8 +340,7 @@ int main(int argc, const char **argv) {
     char **files = NULL, *save = NULL, *tok = NULL, *abs_pathname = NULL;
     char **copyArgv = NULL, errorMessage[MAX_BUFFER_LEN];
     char *el = NULL;
-    void *buf = NULL;
-    size_t dimBuf = -1;
+    int sorgente = -1;
     checkList *option = NULL;
     struct stat checkFile;
     struct timespec timeout, saveT;
@@ -448,7 +505,6 @@ int main(int argc, const char **argv) {
                         break;
                     }
                     i = -1;
-                    buf = NULL;
                     while((files != NULL) && (files[++i] != NULL)) {
                         if(stat(files[i], &checkFile) == -1) {
                             TRACE_ON_DISPLAY("Impossibile identificare %s\n", files[i])
@@ -456,54 +512,22 @@ int main(int argc, const char **argv) {
                             TRACE_ON_DISPLAY("%s non è un file\n", files[i])
                         } else if((abs_pathname = abs_path(files[i])) == NULL) {
                             TRACE_ON_DISPLAY("Calcolo path assoluto fallito\n")
-                        } else if(readFileFromDisk(abs_pathname, &buf, &dimBuf) == -1) {
+                        } else if((sorgente = open(abs_pathname, O_RDONLY)) == -1) {
                             if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
                                 TRACE_ON_DISPLAY("Lettura di %s dal disco fallita\n", files[i])
                             }
-                        } else if(openFile(abs_pathname, (O_CREATE | O_LOCK)) == -1) {
+                        } else if(putFileFromFd(abs_pathname, sorgente, 0, option->dirname_D) == -1) {
                             if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - File già presente nel server\n", files[i])
+                                TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - File già presente nel server\n", files[i])
+                            } else if(errno == EFBIG) {
+                                TRACE_ON_DISPLAY("File:%s - Dimensione superiore alla capacità del server\n", files[i])
                             } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(writeFile(abs_pathname, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta non riuscita per mancanza di diritti su di esso\n", files[i])
-                            } else if(errno == EAGAIN) {
-                                TRACE_ON_DISPLAY("File:%s già presente in memoria, scrittura fallita\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile scrivere %s - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(appendToFile(abs_pathname, buf, dimBuf, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta contenuto non consentita\n", files[i])
-                            } else if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("File:%s - File in fase di lock da un altro utente - Impossibile aggiornarlo\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aggiornare il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(unlockFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la unlock su un file non locked in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la unlock sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la close su un file non aperto in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la close sul file '%s' - Errore: %s\n", files[i], errorMessage)
+                                TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - Errore: %s\n", files[i], errorMessage)
                             }
                         } else {
                             TRACE_ON_DISPLAY("File:%s scritto sul server\n", files[i])
                         }
-                        if(buf != NULL) free(buf), buf = NULL;
+                        if(sorgente != -1) close(sorgente), sorgente = -1;
                         if(abs_pathname != NULL) free(abs_pathname), abs_pathname = NULL;
                         free(files[i]);
                     }
@@ -541,53 +565,21 @@ int main(int argc, const char **argv) {
                         } else if((abs_pathname = abs_path(files[i])) == NULL) {
                             TRACE_ON_DISPLAY("Calcolo path assoluto fallito\n")
                             errno = 0;
-                        } else if(readFileFromDisk(abs_pathname, &buf, &dimBuf) == -1) {
+                        } else if((sorgente = open(abs_pathname, O_RDONLY)) == -1) {
                             TRACE_ON_DISPLAY("Lettura di %s dal disco fallita\n", files[i])
                             errno = 0;
-                        } else if(openFile(abs_pathname, (O_CREATE | O_LOCK)) == -1) {
+                        } else if(putFileFromFd(abs_pathname, sorgente, 0, option->dirname_D) == -1) {
                             if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - File già presente nel server\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(writeFile(abs_pathname, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta non riuscita per mancanza di diritti su di esso\n", files[i])
-                            } else if(errno == EAGAIN) {
-                                TRACE_ON_DISPLAY("File:%s già presente in memoria, scrittura fallità\n", files[i])
+                                TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - File già presente nel server\n", files[i])
+                            } else if(errno == EFBIG) {
+                                TRACE_ON_DISPLAY("File:%s - Dimensione superiore alla capacità del server\n", files[i])
                             } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
                                 TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - Errore: %s\n", files[i], errorMessage)
                             }
-                        } else if(appendToFile(abs_pathname, buf, dimBuf, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta contenuto non consentita\n", files[i])
-                            } else if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("File:%s - File in fase di lock da un altro utente - Impossibile aggiornarlo\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aggiornare il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(unlockFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la unlock su un file non locked in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la unlock sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la close su un file non aperto in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la close sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
                         } else {
                             TRACE_ON_DISPLAY("File:%s scritto sul server\n", files[i])
                         }
-                        if(buf != NULL) free(buf), buf = NULL;
+                        if(sorgente != -1) close(sorgente), sorgente = -1;
                         if(abs_pathname != NULL) free(abs_pathname), abs_pathname = NULL;
                         free(files[i]);
                     }
@@ -631,53 +623,21 @@ int main(int argc, const char **argv) {
                             TRACE_ON_DISPLAY("%s non è un file\n", files[i])
                         } else if((abs_pathname = abs_path(files[i])) == NULL) {
                             TRACE_ON_DISPLAY("Calcolo path assoluto fallito\n")
-                        } else if(readFileFromDisk(abs_pathname, &buf, &dimBuf) == -1) {
+                        } else if((sorgente = open(abs_pathname, O_RDONLY)) == -1) {
                             TRACE_ON_DISPLAY("Lettura del file %s fallita\n", files[i])
-                        } else if(openFile(abs_pathname, (O_CREATE | O_LOCK)) == -1) {
+                        } else if(putFileFromFd(abs_pathname, sorgente, 0, option->dirname_D) == -1) {
                             if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - File già presente nel server\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(writeFile(abs_pathname, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta non riuscita per mancanza di diritti su di esso\n", files[i])
-                            } else if(errno == EAGAIN) {
-                                TRACE_ON_DISPLAY("File:%s già presente in memoria, scrittura fallità\n", files[i])
+                                TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - File già presente nel server\n", files[i])
+                            } else if(errno == EFBIG) {
+                                TRACE_ON_DISPLAY("File:%s - Dimensione superiore alla capacità del server\n", files[i])
                             } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
                                 TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - Errore: %s\n", files[i], errorMessage)
                             }
-                        } else if(appendToFile(abs_pathname, buf, dimBuf, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta contenuto non consentita\n", files[i])
-                            } else if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("File:%s - File in fase di lock da un altro utente - Impossibile aggiornarlo\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aggiornare il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(unlockFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la unlock su un file non locked in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la unlock sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la close su un file non aperto in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la close sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
                         } else {
                             TRACE_ON_DISPLAY("File:%s scritto sul server\n", files[i])
                         }
 
-                        if(buf != NULL) free(buf), buf = NULL;
+                        if(sorgente != -1) close(sorgente), sorgente = -1;
                         if(abs_pathname != NULL) free(abs_pathname), abs_pathname = NULL;
                         free(files[i]);
                     }
@@ -705,55 +665,23 @@ int main(int argc, const char **argv) {
                             TRACE_ON_DISPLAY("%s non è un file\n", files[i])
                         } else if((abs_pathname = abs_path(files[i])) == NULL) {
                             TRACE_ON_DISPLAY("Calcolo path assoluto fallito\n")
-                        } else if(readFileFromDisk(abs_pathname, &buf, &dimBuf) == -1) {
+                        } else if((sorgente = open(abs_pathname, O_RDONLY)) == -1) {
                             if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
                                 TRACE_ON_DISPLAY("Lettura del file %s fallita\n", files[i])
                             }
-                        } else if(openFile(abs_pathname, (O_CREATE | O_LOCK)) == -1) {
+                        } else if(putFileFromFd(abs_pathname, sorgente, 0, option->dirname_D) == -1) {
                             if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - File già presente nel server\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(writeFile(abs_pathname, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta non riuscita per mancanza di diritti su di esso\n", files[i])
-                            } else if(errno == EAGAIN) {
-                                TRACE_ON_DISPLAY("File:%s già presente in memoria, scrittura fallità\n", files[i])
+                                TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - File già presente nel server\n", files[i])
+                            } else if(errno == EFBIG) {
+                                TRACE_ON_DISPLAY("File:%s - Dimensione superiore alla capacità del server\n", files[i])
                             } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
                                 TRACE_ON_DISPLAY("Impossibile scrivere il file '%s' - Errore: %s\n", files[i], errorMessage)
                             }
-                        } else if(appendToFile(abs_pathname, buf, dimBuf, option->dirname_D) == -1) {
-                            if(errno == EACCES) {
-                                TRACE_ON_DISPLAY("File:%s - Aggiunta contenuto non consentita\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(errno == EPERM) {
-                                TRACE_ON_DISPLAY("File:%s - File in fase di lock da un altro utente - Impossibile aggiornarlo\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aggiornare il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(unlockFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la unlock su un file non locked in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la unlock sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(abs_pathname) == -1) {
-                            if(errno == EBADF) {
-                                TRACE_ON_DISPLAY("File:%s - Impossibile eseguire la close su un file non aperto in precedenza\n", files[i])
-                            } else if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("File:%s non presente in memoria/espulso in precedenza\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile eseguire la close sul file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
                         } else {
                             TRACE_ON_DISPLAY("File:%s scritto sul server\n", files[i])
                         }
 
-                        if(buf != NULL) free(buf), buf = NULL;
+                        if(sorgente != -1) close(sorgente), sorgente = -1;
                         if(abs_pathname != NULL) free(abs_pathname), abs_pathname = NULL;
                         free(files[i]);
                     }
@@ -781,30 +709,9 @@ int main(int argc, const char **argv) {
                 if((optind >= argc) || (strncmp(copyArgv[optind], "-d", 2) != 0)) {
                     DELAY
                     TRACE_ON_DISPLAY("Richiesta di lettura dei file passati senza opzione di salvataggio dei file\n")
+                    leggiFileDalServer(option, files, (int) option->numr, NULL);
                     i = -1;
                     while((files != NULL) && (files[++i] != NULL)) {
-                        if(openFile(files[i], 0) == -1) {
-                            if(errno == EMLINK) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Troppi utenti hanno richiesto di aprire il file\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(readFile(files[i], &buf, &dimBuf) == -1) {
-                            if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Rimosso o espulso dal server\n", files[i])
-                            } if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(files[i]) == -1) {
-                            if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile chiudere il file \"%s\" - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else {
-                            TRACE_ON_DISPLAY("File:%s letto dal server\n", files[i])
-                        }
-
-                        if(buf != NULL) free(buf);
-                        buf = NULL;
                         free(files[i]);
                     }
                     if(files != NULL) free(files), files = NULL;
@@ -872,35 +779,9 @@ int main(int argc, const char **argv) {
                 if(option->r) {
                     DELAY
                     TRACE_ON_DISPLAY("Richiesta di lettura dei file passati con opzione di salvataggio dei file dentro \"%s\"\n", option->dirname_d)
+                    leggiFileDalServer(option, files, (int) option->numr, option->dirname_d);
                     i = -1;
                     while((files != NULL) && (files[++i] != NULL)) {
-                        if(openFile(files[i], 0) == -1) {
-                            if(errno == EMLINK) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Troppi utenti hanno richiesto di aprire il file\n", files[i])
-                            } else if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile aprire il file '%s' - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(readFile(files[i], &buf, &dimBuf) == -1) {
-                            if(errno == ENOENT) {
-                                TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Rimosso o espulso dal server\n", files[i])
-                            } if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile leggere il file \"%s\" - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else if(closeFile(files[i]) == -1) {
-                            if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                TRACE_ON_DISPLAY("Impossibile chiudere il file \"%s\" - Errore: %s\n", files[i], errorMessage)
-                            }
-                        } else {
-                            TRACE_ON_DISPLAY("File:%s letto dal server\n", files[i])
-                            if(writeFileIntoDisk(files[i], option->dirname_d, buf, dimBuf) == -1) {
-                                if(strerror_r(errno, errorMessage, MAX_BUFFER_LEN) == 0) {
-                                    TRACE_ON_DISPLAY("Salvatagio del file dentro \"%s\" non riuscita - Errore: %s\n", option->dirname_d, errorMessage)
-                                }
-                            }
-                        }
-
-                        if(buf != NULL) free(buf);
-                        buf = NULL;
                         free(files[i]);
                     }
                     if(files != NULL) free(files), files = NULL;
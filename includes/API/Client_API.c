@@ -7,14 +7,79 @@
  */
 
 
+#define _DEFAULT_SOURCE
 #include "Client_API.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <anello.h>
+#include <segmento.h>
 
 
 /** Variabili Globali **/
 static int fd_server = -1;
+static int protocollo = PROTOCOLLO_V1;
+static uint32_t prossimoId = 0;
+static Lettore lettore;
+static Messaggi richiestaV1 = { NULL, 0, 0 };
+static char cartellaRegistrata[MAX_PATHNAME];
+static int cartellaNonSupportata = 0;
+static Anelli *anelli = NULL;
+static int campanello = -1;
+static int anelliRichiesti = 1;
+static const Segmento_Condiviso *segmento = NULL;
+static size_t dimSegmento = 0;
+static int remoto = 0;
 char socketname[MAX_PATHNAME];
 
 
+/** Stato di una richiesta v2 nella tabella delle richieste in volo **/
+#define RICHIESTA_LIBERA 0
+#define RICHIESTA_IN_VOLO 1
+#define RICHIESTA_COMPLETATA 2
+
+
+/**
+ * @brief           Richiesta v2 inviata al server di cui si attende (o si deve ancora ritirare) la risposta
+ * @struct          Richiesta_In_Volo
+ * @param id        Identificativo della richiesta
+ * @param opcode    Operazione richiesta
+ * @param stato     RICHIESTA_LIBERA, RICHIESTA_IN_VOLO o RICHIESTA_COMPLETATA
+ * @param risposta  Intestazione della risposta (se completata)
+ * @param corpo     Corpo della risposta (se completata)
+ */
+typedef struct {
+    uint32_t id;
+    uint16_t opcode;
+    int stato;
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+} Richiesta_In_Volo;
+
+
+static Richiesta_In_Volo inVolo[FINESTRA_MASSIMA];
+static unsigned int numeroInVolo = 0;
+static unsigned int finestra = FINESTRA_PREDEFINITA;
+
+
+/**
+ * @brief           Notifica di file espulsi arrivata dal server (OP_ESPULSIONI), in attesa di essere prelevata
+ * @struct          Notifica_Espulsi
+ * @param nodo      Nodo della coda delle notifiche
+ * @param flags     Flag della notifica (con FLAG_SALVATI o FLAG_NOMI il corpo contiene solo i pathname)
+ * @param restanti  File della notifica non ancora prelevati
+ * @param corpo     Corpo della notifica
+ */
+typedef struct {
+    QueueNode nodo;
+    uint16_t flags;
+    uint32_t restanti;
+    Corpo corpo;
+} Notifica_Espulsi;
+
+
+static IntrusiveQueue notifiche = { NULL, NULL, 0 };
+
+
 /**
  * @brief           Struttura per la gestione del timer
  * @struct          argTimer
@@ -478,283 +543,1356 @@ char** readNFileFromDir(const char *dirname, size_t n) {
 
 
 /**
- * @brief                   Tenta la connessione al server tramite la socket specificata
- * @fun                     openConnection
- * @param sockname          Nome della socket su cui connettersi
- * @param msec              Intervallo tra un tentativo e un altro di connessione
- * @param abstime           Tempo massimo oltre il quale scade il tentativo di connessione
- * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ * @brief                   Spedisce un comando v1 seguito dai suoi argomenti con un'unica writev
+ * @fun                     inviaComando
+ * @param comando           Comando da spedire
+ * @param numeroArgomenti   Numero di argomenti che seguono, ognuno come coppia (const void *, size_t)
+ * @return                  Ritorna il numero di byte scritti o -1 in caso di errore [setta errno]
  */
-int openConnection(const char *sockname, int msec, const struct timespec abstime) {
+static ssize_t inviaComando(const char *comando, int numeroArgomenti, ...) {
     /** Variabili **/
-    int error = 0, stop = 0, connectRes = -1, *status = NULL;
-    pthread_t *timer = NULL;
-    struct sockaddr_un sock_addr;
-    struct timespec repeat;
-    argTimer arg;
-
-    /** Controllo parametri **/
-    errno = 0;
-    if(sockname == NULL) { errno = EINVAL; return -1; }
-    if(msec <= 0) { errno = EINVAL; return -1; }
-
-    /** Tentativo di connessione al server **/
-    if((fd_server = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
-        return -1;
-    }
-    strncpy(sock_addr.sun_path, sockname, strnlen(sockname, MAX_PATHNAME)+1);
-    sock_addr.sun_family = AF_UNIX;
-    arg.stop = &stop;
-    arg.timer = abstime;
-    arg.access = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t));
-    if(arg.access == NULL) {
-        return -1;
-    }
-    if((error = pthread_mutex_init(arg.access, NULL)) != 0) {
-        free(arg.access);
-        return -1;
-    }
-    memset(&repeat, 0, sizeof(struct timespec)), repeat.tv_nsec = msec;
-    if((timer = (pthread_t *) malloc(sizeof(pthread_t))) == NULL) {
-        pthread_mutex_destroy(arg.access);
-        free(arg.access);
-        return -1;
-    }
-    if((error = pthread_create(timer, NULL, timeout, (void *) &arg)) != 0) {
-        free(timer);
-        pthread_mutex_destroy(arg.access);
-        free(arg.access);
-        errno = error;
-        return -1;
-    }
-    if((error = pthread_mutex_lock(arg.access)) != 0) {
-        pthread_join(*timer, NULL);
-        free(timer);
-        pthread_mutex_destroy(arg.access);
-        free(arg.access);
-        errno = error;
+    va_list argomenti;
+    const void *dati = NULL;
+    size_t dimensione = 0;
+    int error = 0;
+
+    /** Accodo comando e argomenti **/
+    richiestaV1.numero = 0;
+    if(aggiungiMSG(&richiestaV1, comando, (strlen(comando)+1)*sizeof(char)) == -1) {
         return -1;
     }
-    while((!stop) && ((connectRes = connect(fd_server, (struct sockaddr *) &sock_addr, sizeof(sock_addr))) == -1)) {
-        if((error = pthread_mutex_unlock(arg.access)) != 0) {
-            pthread_join(*timer, NULL);
-            free(timer);
-            pthread_mutex_destroy(arg.access);
-            free(arg.access);
-            errno = error;
-            return -1;
-        }
-        if(nanosleep(&repeat, NULL) == -1) {
-            pthread_join(*timer, NULL);
-            free(timer);
-            pthread_mutex_destroy(arg.access);
-            free(arg.access);
-            return -1;
-        }
-        if((error = pthread_mutex_lock(arg.access)) != 0) {
-            pthread_join(*timer, NULL);
-            free(timer);
-            pthread_mutex_destroy(arg.access);
-            free(arg.access);
+    va_start(argomenti, numeroArgomenti);
+    for(int i=0; i<numeroArgomenti; i++) {
+        dati = va_arg(argomenti, const void *);
+        dimensione = va_arg(argomenti, size_t);
+        if(aggiungiMSG(&richiestaV1, dati, dimensione) == -1) {
+            error = errno;
+            va_end(argomenti);
             errno = error;
             return -1;
         }
     }
-    if((error = pthread_mutex_unlock(arg.access)) != 0) {
-        pthread_join(*timer, NULL);
-        free(timer);
-        pthread_mutex_destroy(arg.access);
-        free(arg.access);
-        errno = error;
-        return -1;
-    }
+    va_end(argomenti);
 
-    /** Termino il tentativo e riporto il risultato al client **/
-    if(((error = pthread_join(*timer, (void **) &status)) != 0) || ((status != NULL) && (*status != 0) && (*status != EINTR))) {
-        if(fd_server != -1) close(fd_server);
-        if(status == NULL) errno = error;
-        else errno = *status;
-        free(timer);
-        pthread_mutex_destroy(arg.access);
-        free(arg.access);
-        free(status);
+    /** Invio **/
+    return sendMSGv(fd_server, &richiestaV1);
+}
+
+
+/**
+ * @brief                   Propone al server il protocollo v2; se il server non lo conosce resta in v1. La proposta
+ *                          e' seguita da una sonda v1 a cui qualunque server risponde, quindi non serve un timeout
+ * @fun                     negoziaProtocollo
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int negoziaProtocollo(void) {
+    /** Variabili **/
+    int proposta[2] = { PROTOCOLLO_V2, NEGOZIAZIONE_CON_SONDA }, flags = 0, *risposta = NULL;
+    size_t dimRisposta = 0;
+
+    /** Invio proposta e sonda in un'unica scrittura **/
+    protocollo = PROTOCOLLO_V1;
+    if(inviaComando(COMANDO_PROTOCOLLO, 4, proposta, sizeof(proposta), COMANDO_SONDA, sizeof(COMANDO_SONDA), PATHNAME_SONDA, sizeof(PATHNAME_SONDA), &flags, sizeof(int)) == -1) {
         return -1;
     }
-    free(timer);
-    if((error = pthread_mutex_destroy(arg.access)) != 0) {
-        errno = error;
+
+    /** Un server v2 risponde con due int; uno che non conosce la negoziazione risponde alla sonda con un solo int **/
+    if(receiveBufferedMSG(&lettore, (void **) &risposta, &dimRisposta) <= 0) {
         return -1;
     }
-    free(arg.access);
-    if(connectRes == -1) { errno = ETIMEDOUT; return -1; }
+    if((dimRisposta == sizeof(proposta)) && (risposta[1] == NEGOZIAZIONE_CON_SONDA) && (risposta[0] == PROTOCOLLO_V2)) protocollo = PROTOCOLLO_V2;
+    free(risposta);
 
-    strncpy(socketname, sockname, strnlen(sockname, MAX_PATHNAME));
     errno = 0;
     return 0;
 }
 
 
 /**
- * @brief               Termina la connessione con il server
- * @fun                 closeConnection
- * @param sockname      Socket da chiudere
- * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ * @brief                   Accoda una notifica di file espulsi: se non c'e' memoria per tenerla viene scartata,
+ *                          come fa il server in modalita' ESPULSI_SCARTA
+ * @fun                     accodaNotifica
+ * @param risposta          Intestazione della notifica
+ * @param corpo             Corpo della notifica (passa alla coda)
  */
-int closeConnection(const char *sockname) {
-    /** Controllo parametri **/
-    errno = 0;
-    if(sockname == NULL) { errno = EINVAL; return -1; }
+static void accodaNotifica(const Intestazione_Risposta *risposta, Corpo *corpo) {
+    /** Variabili **/
+    Notifica_Espulsi *notifica = NULL;
 
-    /** Chiusura della connessione **/
-    if(strncmp(sockname, socketname, (size_t) fmax((double) MAX_PATHNAME, (double) strnlen(sockname, MAX_PATHNAME))) == 0) {
-        if(close(fd_server) == -1) { return -1; }
-        memset(socketname, 0, strnlen(sockname, MAX_PATHNAME));
-        errno = 0;
-        return 0;
+    /** Accodo **/
+    if((risposta->numero == 0) || ((notifica = (Notifica_Espulsi *) calloc(1, sizeof(Notifica_Espulsi))) == NULL)) {
+        liberaCorpo(corpo);
+        return;
     }
-
-    /** Non ho trovato la socket specificata aperta **/
-    errno = ENOENT;
-    return -1;
+    notifica->flags = risposta->flags;
+    notifica->restanti = risposta->numero;
+    notifica->corpo = *corpo;
+    enqueueNode(&notifiche, &(notifica->nodo));
 }
 
 
 /**
- * @brief                   Apre/Crea un file nel server
- * @fun                     openFile
- * @param pathname          Pathname del file da aprire/creare
- * @param flags             Flags che specificano le modalita' di apertura del file
- * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ * @brief                   Libera la prima notifica della coda
+ * @fun                     scartaNotifica
  */
-int openFile(const char *pathname, int flags) {
+static void scartaNotifica(void) {
     /** Variabili **/
-    int *result = NULL;
+    Notifica_Espulsi *notifica = (Notifica_Espulsi *) dequeueNode(&notifiche);
 
-    /** Controllo parametri **/
-    errno = 0;
-    if(pathname == NULL) { errno = EINVAL; return -1; }
-    if(flags < 0) { errno = EINVAL; return -1; }
+    /** Libero **/
+    if(notifica == NULL) return;
+    liberaCorpo(&(notifica->corpo));
+    free(notifica);
+}
 
-    /** Invio richiesta al server e dei dati che richiede **/
-    if(sendMSG(fd_server, "openFile", 9*sizeof(char)) == -1) {
-        return -1;
-    }
-    if(sendMSG(fd_server, (void *) pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) == -1) {
-        return -1;
-    }
-    if(sendMSG(fd_server, (void *) &flags, sizeof(int)) == -1) {
-        return -1;
+
+/**
+ * @brief                   Riceve una risposta v2 e la assegna alla richiesta in volo con lo stesso id
+ *                          (le risposte possono arrivare in un ordine diverso da quello delle richieste);
+ *                          le notifiche di file espulsi vengono accodate per nextEviction
+ * @fun                     riceviUnaRisposta
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int riceviUnaRisposta(void) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    ssize_t bytes = 0;
+    char prossimo = 0;
+
+    /** Con gli anelli le risposte arrivano dall'anello: un'intestazione con FLAG_SUL_SOCKET annuncia quella sul socket **/
+    memset(&corpo, 0, sizeof(Corpo));
+    if(anelli != NULL) {
+        while((bytes = leggiRispostaAnello(&(anelli->risposte), &risposta, &corpo)) == 0) {
+            if((attendiAnello(&(anelli->risposte), ATTESA_ANELLO_MS) == -1) && (recv(fd_server, &prossimo, 1, MSG_PEEK | MSG_DONTWAIT) == 0)) {
+                errno = ECOMM;
+                return -1;
+            }
+        }
+        if(bytes == -1) {
+            errno = ECOMM;
+            return -1;
+        }
     }
 
-    /** APK del server per valutare l'esito della richiesta **/
-    if(receiveMSG(fd_server, (void **) &result, NULL) == -1) {
+    /** Ricevo la risposta dal socket **/
+    if(((anelli == NULL) || (risposta.flags & FLAG_SUL_SOCKET)) && (riceviRisposta(&lettore, &risposta, &corpo) <= 0)) {
+        errno = ECOMM;
         return -1;
     }
-    if(*result == 0 || *result == 1) {
-        free(result);
+
+    /** Le notifiche non appartengono a nessuna richiesta **/
+    if((risposta.id == ID_NOTIFICA) && (risposta.opcode == OP_ESPULSIONI)) {
+        accodaNotifica(&risposta, &corpo);
         errno = 0;
         return 0;
     }
 
-    errno = *result;
-    free(result);
+    /** Cerco la richiesta a cui si riferisce **/
+    for(int i=0; i<FINESTRA_MASSIMA; i++) {
+        if((inVolo[i].stato == RICHIESTA_IN_VOLO) && (inVolo[i].id == risposta.id)) {
+            if(inVolo[i].opcode != risposta.opcode) break;
+            inVolo[i].risposta = risposta;
+            inVolo[i].corpo = corpo;
+            inVolo[i].stato = RICHIESTA_COMPLETATA;
+            numeroInVolo--;
+            errno = 0;
+            return 0;
+        }
+    }
+
+    liberaCorpo(&corpo);
+    errno = EBADMSG;
     return -1;
 }
 
 
 /**
- * @brief                   Chiede la lettura di un file dal server
- * @fun                     readFile
- * @param pathname          Pathname del file da leggere
- * @param buf               Buffer del file da leggere
- * @param size              Dimensione del file
- * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ * @brief                   Verifica senza bloccarsi se c'e' una risposta da ricevere
+ * @fun                     rispostaDisponibile
+ * @return                  (1) se ci sono dati da leggere; (0) altrimenti
  */
-int readFile(const char *pathname, void **buf, size_t *size) {
+static int rispostaDisponibile(void) {
     /** Variabili **/
-    int *existFile = NULL;
+    struct pollfd attesa = { fd_server, POLLIN, 0 };
+    int error = errno;
 
-    /** Controllo parametri **/
-    errno = 0;
-    if(pathname == NULL) { errno = EINVAL; return -1; }
-    if(size == NULL) { errno = EINVAL; return -1; }
+    /** Con gli anelli le risposte sono annunciate nell'anello; altrimenti dati gia' nel buffer del lettore o sul socket **/
+    if(anelli != NULL) return !anelloVuoto(&(anelli->risposte));
+    if(lettore.fine > lettore.inizio) return 1;
+    if(poll(&attesa, 1, 0) > 0) {
+        errno = error;
+        return 1;
+    }
 
-    /** Mando la richiesta al server **/
-    if(sendMSG(fd_server, "readFile", 9*sizeof(char)) <= 0) {
-        return -1;
+    errno = error;
+    return 0;
+}
+
+
+/**
+ * @brief                   Invia una richiesta v2 sul canale del server: nell'anello delle richieste se la connessione
+ *                          ha gli anelli e il frame ci sta, altrimenti sul socket. Con gli anelli un frame spedito sul
+ *                          socket e' preceduto nell'anello dalla sua intestazione con FLAG_SUL_SOCKET, cosi' il server riceve
+ *                          le richieste nell'ordine di invio; il campanello sveglia il server
+ * @fun                     inviaRichiestaV2
+ * @param richiesta         Intestazione della richiesta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare al server con la richiesta (-1 se nessuno): viaggia sempre sul socket
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+static ssize_t inviaRichiestaV2(Intestazione_Richiesta *richiesta, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Variabili **/
+    Intestazione_Richiesta segnaposto;
+    ssize_t bytes = -1;
+
+    /** Senza anelli passa tutto dal socket **/
+    if(anelli == NULL) {
+        return (descrittore >= 0) ? inviaRichiestaConDescrittore(fd_server, richiesta, campi, numeroCampi, descrittore) : inviaRichiesta(fd_server, richiesta, campi, numeroCampi);
     }
 
-    /** Mando il pathname e ricevo risposta **/
-    if(sendMSG(fd_server, (void *) pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
-        return -1;
+    /** Nell'anello se possibile **/
+    if((descrittore < 0) && ((bytes = scriviRichiestaAnello(&(anelli->richieste), richiesta, campi, numeroCampi)) != -1)) {
+        return (suonaCampanello(campanello) == -1) ? -1 : bytes;
     }
-    if(receiveMSG(fd_server, (void **) &existFile, NULL) <= 0) {
+    if((descrittore < 0) && (errno != EMSGSIZE)) return -1;
+
+    /** Sul socket, annunciato prima nell'anello: il server inizia a leggerlo mentre viene scritto **/
+    segnaposto = *richiesta;
+    segnaposto.flags |= FLAG_SUL_SOCKET;
+    if((scriviRichiestaAnello(&(anelli->richieste), &segnaposto, NULL, 0) == -1) || (suonaCampanello(campanello) == -1)) return -1;
+
+    return (descrittore >= 0) ? inviaRichiestaConDescrittore(fd_server, richiesta, campi, numeroCampi, descrittore) : inviaRichiesta(fd_server, richiesta, campi, numeroCampi);
+}
+
+
+/**
+ * @brief                   Invia una richiesta v2 senza attenderne la risposta. Prima dell'invio raccoglie le
+ *                          risposte gia' arrivate e, se la finestra e' piena, attende che se ne liberi un posto;
+ *                          una richiesta con un corpo grande attende tutte le risposte in volo, cosi' il server
+ *                          non resta bloccato a scrivere risposte che il client non legge
+ * @fun                     inviaAsincrona
+ * @param opcode            Operazione richiesta
+ * @param flags             Flag dell'operazione
+ * @param campi             Campi del corpo della richiesta
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare al server con la richiesta (-1 se nessuno)
+ * @return                  Ritorna l'id della richiesta; (-1) in caso di errore [setta errno]
+ */
+static int inviaAsincrona(uint16_t opcode, uint16_t flags, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Variabili **/
+    Intestazione_Richiesta richiesta;
+    size_t dimensione = 0;
+    int posto = -1;
+
+    /** Raccolgo le risposte arrivate e rispetto la finestra **/
+    for(size_t i=0; i<numeroCampi; i++) dimensione += campi[i].dimensione;
+    while((numeroInVolo > 0) && ((numeroInVolo >= finestra) || (dimensione > MAX_BUFFER_LEN) || rispostaDisponibile())) {
+        if(riceviUnaRisposta() == -1) return -1;
+    }
+    for(int i=0; (i<FINESTRA_MASSIMA) && (posto == -1); i++) {
+        if(inVolo[i].stato == RICHIESTA_LIBERA) posto = i;
+    }
+    if(posto == -1) { errno = EAGAIN; return -1; }
+
+    /** Invio la richiesta **/
+    memset(&richiesta, 0, sizeof(Intestazione_Richiesta));
+    richiesta.opcode = opcode;
+    richiesta.flags = flags;
+    richiesta.id = prossimoId = (prossimoId % INT32_MAX) + 1;
+    if(inviaRichiestaV2(&richiesta, campi, numeroCampi, descrittore) <= 0) {
         return -1;
     }
-    if((*existFile) != 0) {
-        errno = *existFile;
-        free(existFile);
-        return -1;
+    memset(inVolo + posto, 0, sizeof(Richiesta_In_Volo));
+    inVolo[posto].id = richiesta.id;
+    inVolo[posto].opcode = opcode;
+    inVolo[posto].stato = RICHIESTA_IN_VOLO;
+    numeroInVolo++;
+
+    errno = 0;
+    return (int) richiesta.id;
+}
+
+
+/**
+ * @brief                   Attende la risposta di una richiesta v2 e libera il suo posto nella tabella
+ * @fun                     attendiRispostaV2
+ * @param id                Identificativo della richiesta
+ * @param risposta          Intestazione della risposta
+ * @param corpo             Corpo della risposta (da liberare con liberaCorpo)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int attendiRispostaV2(int id, Intestazione_Risposta *risposta, Corpo *corpo) {
+    /** Variabili **/
+    int posto = -1;
+
+    /** Cerco la richiesta **/
+    for(int i=0; (i<FINESTRA_MASSIMA) && (posto == -1); i++) {
+        if((inVolo[i].stato != RICHIESTA_LIBERA) && (inVolo[i].id == (uint32_t) id)) posto = i;
     }
+    if(posto == -1) { errno = EINVAL; return -1; }
 
-    /** In caso affermativo di risposta ricevo il contenuto del file **/
-    if(receiveMSG(fd_server, buf, size) <= 0) {
-        free(existFile);
-        return -1;
+    /** Ricevo finche' non arriva la sua risposta **/
+    while(inVolo[posto].stato == RICHIESTA_IN_VOLO) {
+        if(riceviUnaRisposta() == -1) return -1;
     }
+    *risposta = inVolo[posto].risposta;
+    *corpo = inVolo[posto].corpo;
+    memset(inVolo + posto, 0, sizeof(Richiesta_In_Volo));
 
-    free(existFile);
     errno = 0;
     return 0;
 }
 
 
 /**
- * @brief               Legge N file random e li scrive nella dirname
- * @fun                 readNFiles
- * @param N             Numero di file che il client ha intenzione di leggere
- * @param dirname       Cartella in cui salvare i file
- * @return              Ritorna il numero effettivo di file letti dal server;
- *                      in caso di errore ritorna (-1) [setta errno]
+ * @brief                   Invia una richiesta v2 e riceve la risposta corrispondente
+ * @fun                     transazioneV2
+ * @param opcode            Operazione richiesta
+ * @param flags             Flag dell'operazione
+ * @param campi             Campi del corpo della richiesta
+ * @param numeroCampi       Numero dei campi
+ * @param risposta          Intestazione della risposta
+ * @param corpo             Corpo della risposta (da liberare con liberaCorpo)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
  */
-int readNFiles(int N, const char *dirname) {
+static int transazioneV2(uint16_t opcode, uint16_t flags, const Campo *campi, size_t numeroCampi, Intestazione_Risposta *risposta, Corpo *corpo) {
     /** Variabili **/
-    int *res = NULL, numReads = 0;
-    void *buf = NULL;
-    char *pathname = NULL;
-    size_t size = -1;
+    int id = -1;
 
-    /** Invio richiesta **/
-    errno = 0;
-    if(sendMSG(fd_server, "readNFiles", 11* sizeof(char)) <= 0) {
+    /** Invio la richiesta e ne attendo la risposta **/
+    if((id = inviaAsincrona(opcode, flags, campi, numeroCampi, -1)) == -1) {
         return -1;
     }
 
-    /** Mando il numero di file che voglio leggere **/
-    if(sendMSG(fd_server, (void *) &N, sizeof(int)) <= 0) {
-        return -1;
-    }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    return attendiRispostaV2(id, risposta, corpo);
+}
+
+
+/**
+ * @brief                   Invia senza attendere la risposta una richiesta v2 che ha come corpo solo il pathname
+ * @fun                     richiestaAsincronaV2
+ * @param opcode            Operazione richiesta
+ * @param flags             Flag dell'operazione
+ * @param pathname          Pathname del file
+ * @return                  Ritorna l'id della richiesta; (-1) in caso di errore [setta errno]
+ */
+static int richiestaAsincronaV2(uint16_t opcode, uint16_t flags, const char *pathname) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Invio la richiesta **/
+    Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+    return inviaAsincrona(opcode, flags, campi, 1, -1);
+}
+
+
+/**
+ * @brief                   Richiesta v2 su un pathname la cui risposta contiene solo l'esito
+ * @fun                     richiestaPathnameV2
+ * @param opcode            Operazione richiesta
+ * @param pathname          Pathname del file
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int richiestaPathnameV2(uint16_t opcode, const char *pathname) {
+    /** Variabili **/
+    Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+
+    /** Invio la richiesta e valuto l'esito **/
+    if(transazioneV2(opcode, 0, campi, 1, &risposta, &corpo) == -1) {
         return -1;
     }
-    if(*res != 0) {
-        errno = *res;
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Richiesta v2 su una maniglia la cui risposta contiene solo l'esito
+ * @fun                     richiestaManigliaV2
+ * @param opcode            Operazione richiesta
+ * @param maniglia          Maniglia del file data da openHandle
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int richiestaManigliaV2(uint16_t opcode, int maniglia) {
+    /** Variabili **/
+    uint32_t numero = (uint32_t) maniglia;
+    Campo campi[1] = { { &numero, sizeof(uint32_t) } };
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(maniglia <= 0) { errno = EBADF; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Invio la richiesta e valuto l'esito **/
+    if(transazioneV2(opcode, FLAG_MANIGLIA, campi, 1, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Passa al server gli anelli in memoria condivisa (OP_ANELLI): se li accetta risponde con il
+ *                          campanello e da qui in poi richieste e risposte piccole non passano dal socket, che resta
+ *                          per i frame grandi, i descrittori e la chiusura. Se il server non li supporta la
+ *                          connessione continua sul socket
+ * @fun                     attivaAnelli
+ */
+static void attivaAnelli(void) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    Anelli *nuovi = NULL;
+    int descrittore = -1, id = -1, error = errno;
+
+    /** Creo gli anelli e li passo al server **/
+    if((nuovi = creaAnelli(&descrittore)) == NULL) {
+        errno = error;
+        return;
+    }
+    id = inviaAsincrona(OP_ANELLI, FLAG_DESCRITTORE, NULL, 0, descrittore);
+    close(descrittore);
+
+    /** Il campanello arriva con la risposta **/
+    if((id != -1) && (attendiRispostaV2(id, &risposta, &corpo) == 0)) {
+        liberaCorpo(&corpo);
+        if((risposta.esito == 0) && (risposta.flags & FLAG_DESCRITTORE) && ((campanello = prelevaDescrittore(&lettore)) != -1)) {
+            anelli = nuovi;
+            errno = error;
+            return;
+        }
+    }
+    smappaAnelli(&nuovi);
+    errno = error;
+}
+
+
+/**
+ * @brief                   Chiede al server il segmento condiviso con i file pubblicati (OP_SEGMENTO) e lo mappa in
+ *                          sola lettura: readFile cerca li' i file prima di interrogare il server. Se il server non
+ *                          lo mette a disposizione le letture passano tutte dal socket
+ * @fun                     attivaSegmento
+ */
+static void attivaSegmento(void) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    int descrittore = -1, id = -1, error = errno;
+
+    /** Il memfd del segmento arriva con la risposta **/
+    if(((id = inviaAsincrona(OP_SEGMENTO, 0, NULL, 0, -1)) == -1) || (attendiRispostaV2(id, &risposta, &corpo) == -1)) {
+        errno = error;
+        return;
+    }
+    liberaCorpo(&corpo);
+    if((risposta.esito == 0) && (risposta.flags & FLAG_DESCRITTORE) && ((descrittore = prelevaDescrittore(&lettore)) != -1)) {
+        segmento = mappaSegmento(descrittore, &dimSegmento);
+        close(descrittore);
+    }
+    errno = error;
+}
+
+
+/**
+ * @brief                   Pubblica un file nel segmento condiviso del server: da quel momento tutti i client sulla
+ *                          stessa macchina lo leggono con readFile direttamente dalla memoria, senza chiamate di
+ *                          sistema e senza bisogno di averlo aperto, finche' resta nel server (solo protocollo v2)
+ * @fun                     publishFile
+ * @param pathname          Pathname del file da pubblicare (aperto dal client)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno: ENOTSUP se il server non ha il
+ *                          segmento, EFBIG se il file e' troppo grande per il segmento]
+ */
+int publishFile(const char *pathname) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Pubblico il file **/
+    return richiestaPathnameV2(OP_PUBLISHFILE, pathname);
+}
+
+
+/**
+ * @brief                   Sceglie come ricevere i file espulsi dalle proprie scritture: nella risposta alla scrittura
+ *                          (ESPULSI_IN_RISPOSTA, predefinita), oppure in notifiche separate che non ritardano la
+ *                          risposta, con pathname e contenuto (ESPULSI_CONTENUTO) o solo i pathname (ESPULSI_NOMI),
+ *                          oppure per niente (ESPULSI_SCARTA). Le notifiche si prelevano con nextEviction
+ *                          (solo protocollo v2)
+ * @fun                     subscribeEvictions
+ * @param modo              Modalita' di consegna (ESPULSI_*)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int subscribeEvictions(int modo) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    int id = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((modo != ESPULSI_IN_RISPOSTA) && (modo != ESPULSI_CONTENUTO) && (modo != ESPULSI_NOMI) && (modo != ESPULSI_SCARTA)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Comunico la modalita' al server **/
+    if(((id = inviaAsincrona(OP_ESPULSIONI, (uint16_t) modo, NULL, 0, -1)) == -1) || (attendiRispostaV2(id, &risposta, &corpo) == -1)) {
+        return -1;
+    }
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Preleva senza bloccarsi il prossimo file espulso notificato dal server (subscribeEvictions):
+ *                          prima raccoglie le notifiche gia' arrivate sul canale
+ * @fun                     nextEviction
+ * @param pathname          Pathname del file espulso (da liberare con free)
+ * @param contenuto         Contenuto del file (da liberare con free); NULL se la notifica ha solo i pathname
+ * @param size              Dimensione del contenuto
+ * @return                  (1) se ha prelevato un file; (0) se non ci sono notifiche; (-1) altrimenti [setta errno]
+ */
+int nextEviction(char **pathname, void **contenuto, size_t *size) {
+    /** Variabili **/
+    Notifica_Espulsi *notifica = NULL;
+    void *campo = NULL;
+    size_t dim = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((pathname == NULL) || (contenuto == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+    *pathname = NULL, *contenuto = NULL, *size = 0;
+
+    /** Raccolgo le notifiche arrivate **/
+    while((notifiche.len == 0) && rispostaDisponibile()) {
+        if(riceviUnaRisposta() == -1) return -1;
+    }
+    if((notifica = (Notifica_Espulsi *) notifiche.head) == NULL) {
+        errno = 0;
+        return 0;
+    }
+
+    /** Prelevo il prossimo file della notifica **/
+    if((leggiCampo(&(notifica->corpo), &campo, &dim) == -1) || (dim == 0) || (((char *) campo)[dim-1] != '\0')) {
+        scartaNotifica();
+        errno = EBADMSG;
+        return -1;
+    }
+    if((*pathname = (char *) malloc(dim)) == NULL) return -1;
+    memcpy(*pathname, campo, dim);
+    if(!(notifica->flags & (FLAG_SALVATI | FLAG_NOMI))) {
+        if(leggiCampo(&(notifica->corpo), &campo, &dim) == -1) {
+            free(*pathname), *pathname = NULL;
+            scartaNotifica();
+            errno = EBADMSG;
+            return -1;
+        }
+        if((dim > 0) && ((*contenuto = malloc(dim)) == NULL)) {
+            free(*pathname), *pathname = NULL;
+            return -1;
+        }
+        if(dim > 0) memcpy(*contenuto, campo, dim);
+        *size = dim;
+    }
+    if(--(notifica->restanti) == 0) scartaNotifica();
+
+    errno = 0;
+    return 1;
+}
+
+
+/**
+ * @brief                   Registra nel server la cartella in cui salvare i file espulsi dalle scritture del client:
+ *                          il descrittore della cartella viene passato al server (SCM_RIGHTS), che vi scrive i
+ *                          file e risponde solo con i loro nomi (solo protocollo v2)
+ * @fun                     registerEvictionDir
+ * @param dirname           Cartella da registrare; NULL per annullare la registrazione
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int registerEvictionDir(const char *dirname) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    int cartella = -1, id = -1, error = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((protocollo != PROTOCOLLO_V2) || remoto) { errno = ENOTSUP; return -1; }
+    if((dirname != NULL) && ((cartella = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)) return -1;
+
+    /** Passo la cartella al server (senza descrittore la registrazione viene annullata) **/
+    id = inviaAsincrona(OP_REGISTERDIR, (cartella != -1) ? FLAG_DESCRITTORE : 0, NULL, 0, cartella), error = errno;
+    if(cartella != -1) close(cartella);
+    if(id == -1) {
+        errno = error;
+        return -1;
+    }
+    if(attendiRispostaV2(id, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    liberaCorpo(&corpo);
+    if(risposta.esito != 0) {
+        errno = risposta.esito;
+        return -1;
+    }
+    memset(cartellaRegistrata, 0, MAX_PATHNAME);
+    if(dirname != NULL) strncpy(cartellaRegistrata, dirname, MAX_PATHNAME-1);
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Allinea la cartella registrata nel server con quella richiesta per i file espulsi da una
+ *                          scrittura: la registrazione viene rifatta solo quando la cartella cambia. Se non riesce
+ *                          i file espulsi arrivano comunque sul socket
+ * @fun                     allineaCartellaEspulsi
+ * @param dirname           Cartella in cui salvare i file espulsi (NULL se non vanno salvati)
+ */
+static void allineaCartellaEspulsi(const char *dirname) {
+    /** Controllo parametri **/
+    if((protocollo != PROTOCOLLO_V2) || cartellaNonSupportata) return;
+    if((dirname == NULL) && (cartellaRegistrata[0] == '\0')) return;
+    if((dirname != NULL) && (strncmp(dirname, cartellaRegistrata, MAX_PATHNAME) == 0)) return;
+
+    /** Registro la nuova cartella **/
+    if((registerEvictionDir(dirname) == -1) && (errno == ENOSYS)) cartellaNonSupportata = 1;
+    errno = 0;
+}
+
+
+/**
+ * @brief                   Salva su disco i file (coppie pathname-contenuto) contenuti in una risposta v2; con
+ *                          FLAG_SALVATI il server li ha gia' scritti nella cartella registrata e il corpo ne
+ *                          contiene solo i pathname, come con FLAG_NOMI (il server non ha potuto spedirne i contenuti)
+ * @fun                     salvaFileRicevuti
+ * @param corpo             Corpo della risposta
+ * @param flags             Flag della risposta
+ * @param numero            Numero di file nel corpo
+ * @param dirname           Cartella in cui salvarli (NULL se non vanno salvati)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int salvaFileRicevuti(Corpo *corpo, uint16_t flags, uint32_t numero, const char *dirname) {
+    /** Variabili **/
+    char *pathname = NULL;
+    void *contenuto = NULL;
+    size_t dimPathname = 0, dimContenuto = 0;
+
+    /** Salvo i file **/
+    for(uint32_t i=0; i<numero; i++) {
+        if(leggiCampo(corpo, (void **) &pathname, &dimPathname) == -1) return -1;
+        if(flags & (FLAG_SALVATI | FLAG_NOMI)) continue;
+        if(leggiCampo(corpo, &contenuto, &dimContenuto) == -1) return -1;
+        if((dimPathname == 0) || (pathname[dimPathname-1] != '\0')) { errno = EBADMSG; return -1; }
+        if((dirname != NULL) && (dimContenuto != 0) && (writeFileIntoDisk(pathname, dirname, contenuto, dimContenuto) == -1)) {
+            return -1;
+        }
+    }
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Converte l'indirizzo "indirizzo:porta" del listener TCP del server
+ * @fun                     indirizzoTcp
+ * @param testo             Indirizzo IPv4 e porta separati da ':'
+ * @param indirizzo         Indirizzo da riempire
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int indirizzoTcp(const char *testo, struct sockaddr_in *indirizzo) {
+    /** Variabili **/
+    char host[INET_ADDRSTRLEN];
+    const char *porta = NULL;
+    long valore = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((porta = strrchr(testo, ':')) == NULL) { errno = EINVAL; return -1; }
+    if((size_t) (porta - testo) >= INET_ADDRSTRLEN) { errno = EINVAL; return -1; }
+    if(((valore = isNumber(porta+1)) <= 0) || (valore > 65535)) { errno = EINVAL; return -1; }
+
+    /** Converto **/
+    memset(host, 0, INET_ADDRSTRLEN), memcpy(host, testo, (size_t) (porta - testo));
+    memset(indirizzo, 0, sizeof(struct sockaddr_in));
+    indirizzo->sin_family = AF_INET;
+    indirizzo->sin_port = htons((unsigned short) valore);
+    if(inet_pton(AF_INET, host, &(indirizzo->sin_addr)) != 1) { errno = EINVAL; return -1; }
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Tenta la connessione al server tramite la socket specificata; se e' un socket
+ *                          SOCK_SEQPACKET lo riconosce da solo e ci parla direttamente il protocollo v2. Con
+ *                          "tcp:indirizzo:porta" si connette al listener TCP del server: senza descrittori ne'
+ *                          memoria condivisa, che richiedono un socket AF_UNIX
+ * @fun                     openConnection
+ * @param sockname          Nome della socket su cui connettersi (o "tcp:indirizzo:porta")
+ * @param msec              Intervallo tra un tentativo e un altro di connessione
+ * @param abstime           Tempo massimo oltre il quale scade il tentativo di connessione
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int openConnection(const char *sockname, int msec, const struct timespec abstime) {
+    /** Variabili **/
+    int error = 0, stop = 0, connectRes = -1, *status = NULL, tipoSocket = SOCK_STREAM, remota = 0, attivo = 1;
+    pthread_t *timer = NULL;
+    struct sockaddr_un sock_addr;
+    struct sockaddr_in indirizzo;
+    struct sockaddr *destinazione = (struct sockaddr *) &sock_addr;
+    socklen_t dimDestinazione = sizeof(sock_addr);
+    struct timespec repeat;
+    argTimer arg;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(sockname == NULL) { errno = EINVAL; return -1; }
+    if(msec <= 0) { errno = EINVAL; return -1; }
+
+    /** Listener TCP del server **/
+    if(strncmp(sockname, PREFISSO_TCP, strlen(PREFISSO_TCP)) == 0) {
+        if(indirizzoTcp(sockname + strlen(PREFISSO_TCP), &indirizzo) == -1) return -1;
+        destinazione = (struct sockaddr *) &indirizzo, dimDestinazione = sizeof(indirizzo), remota = 1;
+    }
+
+    /** Tentativo di connessione al server **/
+    if((fd_server = socket((remota) ? AF_INET : AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        return -1;
+    }
+    strncpy(sock_addr.sun_path, sockname, strnlen(sockname, MAX_PATHNAME)+1);
+    sock_addr.sun_family = AF_UNIX;
+    arg.stop = &stop;
+    arg.timer = abstime;
+    arg.access = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t));
+    if(arg.access == NULL) {
+        return -1;
+    }
+    if((error = pthread_mutex_init(arg.access, NULL)) != 0) {
+        free(arg.access);
+        return -1;
+    }
+    memset(&repeat, 0, sizeof(struct timespec)), repeat.tv_nsec = msec;
+    if((timer = (pthread_t *) malloc(sizeof(pthread_t))) == NULL) {
+        pthread_mutex_destroy(arg.access);
+        free(arg.access);
+        return -1;
+    }
+    if((error = pthread_create(timer, NULL, timeout, (void *) &arg)) != 0) {
+        free(timer);
+        pthread_mutex_destroy(arg.access);
+        free(arg.access);
+        errno = error;
+        return -1;
+    }
+    if((error = pthread_mutex_lock(arg.access)) != 0) {
+        pthread_join(*timer, NULL);
+        free(timer);
+        pthread_mutex_destroy(arg.access);
+        free(arg.access);
+        errno = error;
+        return -1;
+    }
+    while((!stop) && ((connectRes = connect(fd_server, destinazione, dimDestinazione)) == -1)) {
+        /** Il server ascolta su un socket SOCK_SEQPACKET: riprovo subito con un socket dello stesso tipo **/
+        if((errno == EPROTOTYPE) && (tipoSocket == SOCK_STREAM)) {
+            close(fd_server);
+            if((fd_server = socket(AF_UNIX, SOCK_SEQPACKET, 0)) != -1) {
+                tipoSocket = SOCK_SEQPACKET;
+                continue;
+            }
+            stop = 1;
+            break;
+        }
+        if((error = pthread_mutex_unlock(arg.access)) != 0) {
+            pthread_join(*timer, NULL);
+            free(timer);
+            pthread_mutex_destroy(arg.access);
+            free(arg.access);
+            errno = error;
+            return -1;
+        }
+        if(nanosleep(&repeat, NULL) == -1) {
+            pthread_join(*timer, NULL);
+            free(timer);
+            pthread_mutex_destroy(arg.access);
+            free(arg.access);
+            return -1;
+        }
+        if((error = pthread_mutex_lock(arg.access)) != 0) {
+            pthread_join(*timer, NULL);
+            free(timer);
+            pthread_mutex_destroy(arg.access);
+            free(arg.access);
+            errno = error;
+            return -1;
+        }
+    }
+    if((error = pthread_mutex_unlock(arg.access)) != 0) {
+        pthread_join(*timer, NULL);
+        free(timer);
+        pthread_mutex_destroy(arg.access);
+        free(arg.access);
+        errno = error;
+        return -1;
+    }
+
+    /** Termino il tentativo e riporto il risultato al client **/
+    if(((error = pthread_join(*timer, (void **) &status)) != 0) || ((status != NULL) && (*status != 0) && (*status != EINTR))) {
+        if(fd_server != -1) close(fd_server);
+        if(status == NULL) errno = error;
+        else errno = *status;
+        free(timer);
+        pthread_mutex_destroy(arg.access);
+        free(arg.access);
+        free(status);
+        return -1;
+    }
+    free(timer);
+    if((error = pthread_mutex_destroy(arg.access)) != 0) {
+        errno = error;
+        return -1;
+    }
+    free(arg.access);
+    if(connectRes == -1) { errno = ETIMEDOUT; return -1; }
+    inizializzaLettore(&lettore, fd_server);
+    if(impostaPacchetti(fd_server, (tipoSocket == SOCK_SEQPACKET)) == -1) {
+        error = errno;
+        close(fd_server);
+        errno = error;
+        return -1;
+    }
+    if(remota && (setsockopt(fd_server, IPPROTO_TCP, TCP_NODELAY, &attivo, sizeof(int)) == -1)) {
+        error = errno;
+        close(fd_server);
+        errno = error;
+        return -1;
+    }
+    if(tipoSocket == SOCK_SEQPACKET) protocollo = PROTOCOLLO_V2;  //Sul socket a pacchetti il server parla solo v2
+    else if(negoziaProtocollo() == -1) {
+        error = errno;
+        close(fd_server);
+        errno = error;
+        return -1;
+    }
+    remoto = remota, cartellaNonSupportata = remota;              //Via TCP i descrittori non passano
+    if((protocollo == PROTOCOLLO_V2) && !remoto) {
+        if(anelliRichiesti && (tipoSocket != SOCK_SEQPACKET)) attivaAnelli();      //Sul socket a pacchetti i frame restano pacchetti
+        attivaSegmento();
+    }
+
+    strncpy(socketname, sockname, strnlen(sockname, MAX_PATHNAME));
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief               Termina la connessione con il server
+ * @fun                 closeConnection
+ * @param sockname      Socket da chiudere
+ * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int closeConnection(const char *sockname) {
+    /** Variabili **/
+    int descrittore = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(sockname == NULL) { errno = EINVAL; return -1; }
+
+    /** Chiusura della connessione **/
+    if(strncmp(sockname, socketname, (size_t) fmax((double) MAX_PATHNAME, (double) strnlen(sockname, MAX_PATHNAME))) == 0) {
+        impostaPacchetti(fd_server, 0);
+        if(close(fd_server) == -1) { return -1; }
+        memset(socketname, 0, strnlen(sockname, MAX_PATHNAME));
+        protocollo = PROTOCOLLO_V1;
+        memset(cartellaRegistrata, 0, MAX_PATHNAME), cartellaNonSupportata = 0, remoto = 0;
+        smappaAnelli(&anelli);
+        smappaSegmento(&segmento, dimSegmento), dimSegmento = 0;
+        if(campanello != -1) close(campanello), campanello = -1;
+        while((descrittore = prelevaDescrittore(&lettore)) != -1) close(descrittore);
+        inizializzaLettore(&lettore, -1);
+        liberaMessaggi(&richiestaV1);
+        for(int i=0; i<FINESTRA_MASSIMA; i++) {
+            if(inVolo[i].stato == RICHIESTA_COMPLETATA) liberaCorpo(&(inVolo[i].corpo));
+            memset(inVolo + i, 0, sizeof(Richiesta_In_Volo));
+        }
+        numeroInVolo = 0;
+        while(notifiche.len > 0) scartaNotifica();
+        errno = 0;
+        return 0;
+    }
+
+    /** Non ho trovato la socket specificata aperta **/
+    errno = ENOENT;
+    return -1;
+}
+
+
+/**
+ * @brief                   Apre/Crea un file nel server
+ * @fun                     openFile
+ * @param pathname          Pathname del file da aprire/creare
+ * @param flags             Flags che specificano le modalita' di apertura del file
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int openFile(const char *pathname, int flags) {
+    /** Variabili **/
+    int *result = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(flags < 0) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: pathname nel corpo, flag nell'intestazione **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        if(transazioneV2(OP_OPENFILE, (uint16_t) flags, campi, 1, &risposta, &corpo) == -1) {
+            return -1;
+        }
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return (risposta.esito == 0) ? 0 : -1;
+    }
+
+    /** Invio richiesta al server e dei dati che richiede **/
+    if(inviaComando("openFile", 2, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char), &flags, sizeof(int)) == -1) {
+        return -1;
+    }
+
+    /** APK del server per valutare l'esito della richiesta **/
+    if(receiveBufferedMSG(&lettore, (void **) &result, NULL) == -1) {
+        return -1;
+    }
+    if(*result == 0 || *result == 1) {
+        free(result);
+        errno = 0;
+        return 0;
+    }
+
+    errno = *result;
+    free(result);
+    return -1;
+}
+
+
+/**
+ * @brief                   Richiesta v2 di readFile che accetta il contenuto come memfd sigillato: il server lo usa
+ *                          per i file oltre la sua soglia, gli altri arrivano nel corpo della risposta
+ * @fun                     richiestaLetturaV2
+ * @param file              Campo con il pathname (o la maniglia) del file da leggere
+ * @param flags             FLAG_MANIGLIA se il campo contiene la maniglia
+ * @param corpo             Corpo della risposta (da liberare con liberaCorpo)
+ * @param contenuto         Contenuto del file nel corpo (NULL se e' arrivato il memfd)
+ * @param descrittore       Memfd con il contenuto del file (-1 se il contenuto e' nel corpo)
+ * @param size              Dimensione del file
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int richiestaLetturaV2(const Campo *file, uint16_t flags, Corpo *corpo, void **contenuto, int *descrittore, size_t *size) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    uint64_t dimensione = 0;
+    void *campo = NULL;
+    size_t dim = 0;
+
+    /** Richiesta **/
+    *contenuto = NULL, *descrittore = -1;
+    if(transazioneV2(OP_READFILE, (remoto) ? flags : (flags | FLAG_DESCRITTORE), file, 1, &risposta, corpo) == -1) {
+        return -1;
+    }
+    if(risposta.esito != 0) {
+        liberaCorpo(corpo);
+        errno = risposta.esito;
+        return -1;
+    }
+
+    /** Contenuto nel corpo **/
+    if(!(risposta.flags & FLAG_DESCRITTORE)) {
+        if(leggiCampo(corpo, contenuto, size) == -1) {
+            liberaCorpo(corpo);
+            return -1;
+        }
+        return 0;
+    }
+
+    /** Contenuto nel memfd arrivato con l'intestazione **/
+    if((leggiCampo(corpo, &campo, &dim) == -1) || (dim != sizeof(uint64_t))) {
+        liberaCorpo(corpo);
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&dimensione, campo, sizeof(uint64_t));
+    liberaCorpo(corpo);
+    if((*descrittore = prelevaDescrittore(&lettore)) == -1) {
+        errno = EBADMSG;
+        return -1;
+    }
+    *size = (size_t) dimensione;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Legge un file con il protocollo v2 e ne copia il contenuto (arrivato nel corpo o nel memfd)
+ * @fun                     copiaLetturaV2
+ * @param file              Campo con il pathname (o la maniglia) del file da leggere
+ * @param flags             FLAG_MANIGLIA se il campo contiene la maniglia
+ * @param buf               Buffer del file letto
+ * @param size              Dimensione del file
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int copiaLetturaV2(const Campo *file, uint16_t flags, void **buf, size_t *size) {
+    /** Variabili **/
+    Corpo corpo;
+    void *contenuto = NULL, *mappa = MAP_FAILED;
+    int descrittore = -1;
+
+    /** Leggo il file e lo copio **/
+    if(richiestaLetturaV2(file, flags, &corpo, &contenuto, &descrittore, size) == -1) {
+        return -1;
+    }
+    if((descrittore != -1) && (*size > 0) && ((mappa = mmap(NULL, *size, PROT_READ, MAP_SHARED, descrittore, 0)) == MAP_FAILED)) {
+        close(descrittore);
+        return -1;
+    }
+    if(descrittore != -1) close(descrittore), contenuto = mappa;
+    if(*buf != NULL) free(*buf);
+    if((*buf = malloc(*size)) == NULL) {
+        if(mappa != MAP_FAILED) munmap(mappa, *size);
+        liberaCorpo(&corpo);
+        return -1;
+    }
+    if(*size > 0) memcpy(*buf, contenuto, *size);
+    if(mappa != MAP_FAILED) munmap(mappa, *size);
+    liberaCorpo(&corpo);
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Chiede la lettura di un file dal server
+ * @fun                     readFile
+ * @param pathname          Pathname del file da leggere
+ * @param buf               Buffer del file da leggere
+ * @param size              Dimensione del file
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int readFile(const char *pathname, void **buf, size_t *size) {
+    /** Variabili **/
+    int *existFile = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(size == NULL) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: i file pubblicati si leggono dal segmento condiviso, gli altri (o quelli che il server sta
+        aggiornando) dalla risposta, che contiene il file o il memfd che lo contiene **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo file = { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) };
+        void *contenuto = NULL;
+
+        if((segmento != NULL) && (leggiSegmento(segmento, pathname, &contenuto, size) == 0)) {
+            if(*buf != NULL) free(*buf);
+            *buf = contenuto;
+            errno = 0;
+            return 0;
+        }
+        return copiaLetturaV2(&file, 0, buf, size);
+    }
+
+    /** Mando la richiesta al server con il pathname e ricevo risposta **/
+    if(inviaComando("readFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
+        return -1;
+    }
+    if(receiveBufferedMSG(&lettore, (void **) &existFile, NULL) <= 0) {
+        return -1;
+    }
+    if((*existFile) != 0) {
+        errno = *existFile;
+        free(existFile);
+        return -1;
+    }
+
+    /** In caso affermativo di risposta ricevo il contenuto del file **/
+    if(receiveBufferedMSG(&lettore, buf, size) <= 0) {
+        free(existFile);
+        return -1;
+    }
+
+    free(existFile);
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Legge un file dal server restituendone una mappatura in sola lettura: i file oltre la
+ *                          soglia del server arrivano come memfd sigillato e vengono mappati senza copiarli
+ * @fun                     mapFile
+ * @param pathname          Pathname del file da leggere
+ * @param buf               Mappatura del contenuto (NULL se il file e' vuoto), da rilasciare con unmapFile
+ * @param size              Dimensione del file
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int mapFile(const char *pathname, void **buf, size_t *size) {
+    /** Variabili **/
+    void *contenuto = NULL, *mappa = MAP_FAILED;
+    int descrittore = -1, error = 0;
+    Corpo corpo;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if((buf == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+
+    /** Leggo il file: con il protocollo v1 (o se arriva nel corpo) lo copio in una mappatura anonima **/
+    *buf = NULL, *size = 0;
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo file = { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) };
+
+        if(richiestaLetturaV2(&file, 0, &corpo, &contenuto, &descrittore, size) == -1) {
+            return -1;
+        }
+    } else {
+        memset(&corpo, 0, sizeof(Corpo));
+        if(readFile(pathname, &contenuto, size) == -1) {
+            return -1;
+        }
+        corpo.buffer = (char *) contenuto;   // Il contenuto letto con v1 viene liberato insieme al corpo
+    }
+    if(*size == 0) {
+        if(descrittore != -1) close(descrittore);
+        liberaCorpo(&corpo);
+        errno = 0;
+        return 0;
+    }
+    if(descrittore != -1) {
+        mappa = mmap(NULL, *size, PROT_READ, MAP_SHARED, descrittore, 0), error = errno;
+        close(descrittore);
+    } else if((mappa = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED) {
+        memcpy(mappa, contenuto, *size);
+        mprotect(mappa, *size, PROT_READ);
+    } else error = errno;
+    liberaCorpo(&corpo);
+    if(mappa == MAP_FAILED) {
+        *size = 0;
+        errno = error;
+        return -1;
+    }
+
+    *buf = mappa;
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Rilascia la mappatura restituita da mapFile
+ * @fun                     unmapFile
+ * @param buf               Mappatura del contenuto
+ * @param size              Dimensione del file
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int unmapFile(void *buf, size_t size) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((buf == NULL) || (size == 0)) return 0;
+
+    return munmap(buf, size);
+}
+
+
+/**
+ * @brief                   Richiesta v2 di readFileRange: la risposta contiene la dimensione del file e la porzione letta
+ * @fun                     letturaPorzioneV2
+ * @param file              Campo con il pathname (o la maniglia) del file da leggere
+ * @param flags             FLAG_MANIGLIA se il campo contiene la maniglia
+ * @param offset            Posizione da cui leggere
+ * @param length            Bytes da leggere (0 per arrivare alla fine)
+ * @param buf               Porzione letta
+ * @param size              Dimensione della porzione letta
+ * @param totalSize         Dimensione attuale del file (puo' essere NULL)
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int letturaPorzioneV2(const Campo *file, uint16_t flags, size_t offset, size_t length, void **buf, size_t *size, size_t *totalSize) {
+    /** Variabili **/
+    void *contenuto = NULL, *campo = NULL;
+    size_t dimContenuto = 0, dim = 0;
+    uint64_t totale = 0, inizio = (uint64_t) offset, lunghezza = (uint64_t) length;
+    Campo campi[3] = { *file, { &inizio, sizeof(uint64_t) }, { &lunghezza, sizeof(uint64_t) } };
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+
+    /** Richiesta **/
+    if(transazioneV2(OP_READFILERANGE, flags, campi, 3, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    if(risposta.esito != 0) {
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return -1;
+    }
+
+    /** Copio la porzione letta **/
+    if((leggiCampo(&corpo, &campo, &dim) == -1) || (dim != sizeof(uint64_t)) || (leggiCampo(&corpo, &contenuto, &dimContenuto) == -1)) {
+        liberaCorpo(&corpo);
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&totale, campo, sizeof(uint64_t));
+    if(*buf != NULL) free(*buf), *buf = NULL;
+    if((dimContenuto > 0) && ((*buf = malloc(dimContenuto)) == NULL)) {
+        liberaCorpo(&corpo);
+        return -1;
+    }
+    if(dimContenuto > 0) memcpy(*buf, contenuto, dimContenuto);
+    *size = dimContenuto;
+    if(totalSize != NULL) *totalSize = (size_t) totale;
+    liberaCorpo(&corpo);
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Legge dal server solo una porzione del file, insieme alla sua dimensione attuale
+ *                          (con il protocollo v1 il file viene letto per intero e poi ritagliato)
+ * @fun                     readFileRange
+ * @param pathname          Pathname del file da leggere
+ * @param offset            Posizione da cui iniziare la lettura
+ * @param length            Numero massimo di bytes da leggere; (0) per leggere fino alla fine del file
+ * @param buf               Bytes letti (NULL se la porzione e' vuota)
+ * @param size              Numero di bytes letti
+ * @param totalSize         Dimensione attuale dell'intero file (puo' essere NULL)
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int readFileRange(const char *pathname, size_t offset, size_t length, void **buf, size_t *size, size_t *totalSize) {
+    /** Variabili **/
+    void *contenuto = NULL;
+    size_t dimContenuto = 0, dim = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if((buf == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: la risposta contiene solo la porzione richiesta **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo file = { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) };
+
+        return letturaPorzioneV2(&file, 0, offset, length, buf, size, totalSize);
+    }
+
+    /** Protocollo v1: leggo l'intero file e tengo la porzione richiesta **/
+    if(readFile(pathname, &contenuto, &dimContenuto) == -1) {
+        if(contenuto != NULL) free(contenuto);
+        return -1;
+    }
+    dim = (offset < dimContenuto) ? (dimContenuto - offset) : 0;
+    if((length != 0) && (length < dim)) dim = length;
+    if(*buf != NULL) free(*buf), *buf = NULL;
+    if((dim > 0) && ((*buf = malloc(dim)) == NULL)) {
+        free(contenuto);
+        return -1;
+    }
+    if(dim > 0) memcpy(*buf, (char *) contenuto + offset, dim);
+    *size = dim;
+    if(totalSize != NULL) *totalSize = dimContenuto;
+    if(contenuto != NULL) free(contenuto);
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief               Legge N file random e li scrive nella dirname
+ * @fun                 readNFiles
+ * @param N             Numero di file che il client ha intenzione di leggere
+ * @param dirname       Cartella in cui salvare i file
+ * @return              Ritorna il numero effettivo di file letti dal server;
+ *                      in caso di errore ritorna (-1) [setta errno]
+ */
+int readNFiles(int N, const char *dirname) {
+    /** Variabili **/
+    int *res = NULL, numReads = 0;
+    void *buf = NULL;
+    char *pathname = NULL;
+    size_t size = -1;
+
+    /** Protocollo v2: tutti i file arrivano in un'unica risposta **/
+    errno = 0;
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo campi[1] = { { &N, sizeof(int) } };
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        if(transazioneV2(OP_READNFILES, 0, campi, 1, &risposta, &corpo) == -1) {
+            return -1;
+        }
+        if(risposta.esito != 0) {
+            liberaCorpo(&corpo);
+            errno = risposta.esito;
+            return -1;
+        }
+        if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+            liberaCorpo(&corpo);
+            return -1;
+        }
+        liberaCorpo(&corpo);
+        errno = 0;
+        return (int) risposta.numero;
+    }
+
+    /** Invio richiesta con il numero di file che voglio leggere **/
+    if(inviaComando("readNFiles", 1, &N, sizeof(int)) <= 0) {
+        return -1;
+    }
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
+        return -1;
+    }
+    if(*res != 0) {
+        errno = *res;
         free(res);
         return -1;
     }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
         free(res);
         return -1;
     }
     while(*res != 0) {
         numReads++;
-        if(receiveMSG(fd_server, (void **) &pathname, NULL) <= 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &pathname, NULL) <= 0) {
             if(buf != NULL) free(buf);
             if(pathname != NULL) free(pathname);
             if(res != NULL) free(res);
             return -1;
         }
-        if(receiveMSG(fd_server, (void **) &buf, &size) <= 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &buf, &size) <= 0) {
             if(buf != NULL) free(buf);
             if(pathname != NULL) free(pathname);
             if(res != NULL) free(res);
@@ -766,7 +1904,7 @@ int readNFiles(int N, const char *dirname) {
             if(res != NULL) free(res);
             return -1;
         }
-        if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
             if(buf != NULL) free(buf);
             if(pathname != NULL) free(pathname);
             if(res != NULL) free(res);
@@ -782,6 +1920,100 @@ int readNFiles(int N, const char *dirname) {
 }
 
 
+/**
+ * @brief               Legge dal server una lista di file indicati per nome con un'unica richiesta (protocollo v2);
+ *                      con il protocollo v1 ogni file viene aperto, letto e chiuso
+ * @fun                 readFiles
+ * @param pathnames     Pathname dei file da leggere
+ * @param numero        Numero dei file
+ * @param bufs          Contenuto di ogni file (NULL se la lettura non e' riuscita)
+ * @param sizes         Dimensione di ogni file
+ * @param esiti         Esito della lettura di ogni file: 0 in caso di successo; altrimenti il codice di errore
+ * @return              Ritorna il numero di file letti; in caso di errore ritorna (-1) [setta errno]
+ */
+int readFiles(char **pathnames, int numero, void **bufs, size_t *sizes, int *esiti) {
+    /** Variabili **/
+    int numReads = 0;
+    void *contenuto = NULL, *esito = NULL;
+    size_t dim = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((pathnames == NULL) || (bufs == NULL) || (sizes == NULL) || (esiti == NULL)) { errno = EINVAL; return -1; }
+    if(numero <= 0) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: tutti i pathname nella richiesta, esito e contenuto di ogni file nella risposta **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo *campi = NULL;
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        if((campi = (Campo *) malloc(numero*sizeof(Campo))) == NULL) {
+            return -1;
+        }
+        for(int i=0; i<numero; i++) {
+            campi[i].dati = pathnames[i];
+            campi[i].dimensione = (strnlen(pathnames[i], MAX_PATHNAME)+1)*sizeof(char);
+        }
+        if(transazioneV2(OP_READFILES, 0, campi, (size_t) numero, &risposta, &corpo) == -1) {
+            free(campi);
+            return -1;
+        }
+        free(campi);
+        if(risposta.esito != 0) {
+            liberaCorpo(&corpo);
+            errno = risposta.esito;
+            return -1;
+        }
+        if(risposta.numero != (uint32_t) numero) {
+            liberaCorpo(&corpo);
+            errno = EBADMSG;
+            return -1;
+        }
+        for(int i=0; i<numero; i++) {
+            if((leggiCampo(&corpo, &esito, &dim) == -1) || (dim != sizeof(int)) || (leggiCampo(&corpo, &contenuto, sizes+i) == -1)) {
+                liberaCorpo(&corpo);
+                errno = EBADMSG;
+                return -1;
+            }
+            memcpy(esiti+i, esito, sizeof(int));
+            if(bufs[i] != NULL) free(bufs[i]), bufs[i] = NULL;
+            if(esiti[i] != 0) continue;
+            if((sizes[i] > 0) && ((bufs[i] = malloc(sizes[i])) == NULL)) {
+                liberaCorpo(&corpo);
+                return -1;
+            }
+            if(sizes[i] > 0) memcpy(bufs[i], contenuto, sizes[i]);
+            numReads++;
+        }
+        liberaCorpo(&corpo);
+        errno = 0;
+        return numReads;
+    }
+
+    /** Protocollo v1: apertura, lettura e chiusura di ogni file **/
+    for(int i=0; i<numero; i++) {
+        if(bufs[i] != NULL) free(bufs[i]), bufs[i] = NULL;
+        sizes[i] = 0;
+        if(openFile(pathnames[i], 0) == -1) {
+            esiti[i] = errno;
+            continue;
+        }
+        if(readFile(pathnames[i], bufs+i, sizes+i) == -1) {
+            esiti[i] = errno;
+            if(bufs[i] != NULL) free(bufs[i]), bufs[i] = NULL;
+        } else {
+            esiti[i] = 0;
+            numReads++;
+        }
+        closeFile(pathnames[i]);
+    }
+
+    errno = 0;
+    return numReads;
+}
+
+
 /**
  * brief                Scrive tutto il file puntato da pathname nel server
  * @fun                 writeFile
@@ -800,26 +2032,40 @@ int writeFile(const char *pathname, const char *dirname) {
     errno = 0;
     if(pathname == NULL) { errno = EINVAL; return -1; }
 
-    /** Invio la richiesta al server **/
-    if(sendMSG(fd_server, "writeFile", 10*sizeof(char)) <= 0) {
-        return -1;
+    /** Protocollo v2: la risposta contiene l'esito e i file espulsi **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        allineaCartellaEspulsi(dirname);
+        if(transazioneV2(OP_WRITEFILE, 0, campi, 1, &risposta, &corpo) == -1) {
+            return -1;
+        }
+        if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+            liberaCorpo(&corpo);
+            return -1;
+        }
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return (risposta.esito == 0) ? 0 : -1;
     }
 
-    /** Mando il pathname del file da aggiungere **/
-    if(sendMSG(fd_server, (void *) pathname, sizeof(char)*(strnlen(pathname, MAX_PATHNAME)+1)) <= 0) {
+    /** Invio la richiesta al server con il pathname del file da aggiungere **/
+    if(inviaComando("writeFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
         return -1;
     }
-    if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
         return -1;
     }
     while(*result != 0) {
-        if(receiveMSG(fd_server, (void **) &fileToWrite, NULL) <= 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &fileToWrite, NULL) <= 0) {
             if(buf != NULL) free(buf);
             if(fileToWrite != NULL) free(fileToWrite);
             if(result != NULL) free(result);
             return -1;
         }
-        if(receiveMSG(fd_server, &buf, &dimBuf) <= 0) {
+        if(receiveBufferedMSG(&lettore, &buf, &dimBuf) <= 0) {
             if(buf != NULL) free(buf);
             if(fileToWrite != NULL) free(fileToWrite);
             if(result != NULL) free(result);
@@ -834,14 +2080,14 @@ int writeFile(const char *pathname, const char *dirname) {
         if(buf != NULL) free(buf);
         if(fileToWrite != NULL) free(fileToWrite);
         if(result != NULL) free(result);
-        if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
             if(buf != NULL) free(buf);
             if(fileToWrite != NULL) free(fileToWrite);
             if(result != NULL) free(result);
             return -1;
         }
     }
-    if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
         free(buf);
         free(fileToWrite);
         free(result);
@@ -863,6 +2109,37 @@ int writeFile(const char *pathname, const char *dirname) {
 }
 
 
+/**
+ * @brief               Richiesta v2 di appendToFile: file e dati in un'unica richiesta, i file espulsi nella risposta
+ * @fun                 aggiuntaV2
+ * @param file          Campo con il pathname (o la maniglia) del file da aggiornare
+ * @param flags         FLAG_MANIGLIA se il campo contiene la maniglia
+ * @param buf           Buffer da aggiungere
+ * @param size          Dimensione del buffer
+ * @param dirname       Cartella dove salvo i file espulsi
+ * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int aggiuntaV2(const Campo *file, uint16_t flags, void *buf, size_t size, const char *dirname) {
+    /** Variabili **/
+    Campo campi[2] = { *file, { buf, size } };
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+
+    /** Invio la richiesta e salvo i file espulsi **/
+    allineaCartellaEspulsi(dirname);
+    if(transazioneV2(OP_APPENDTOFILE, flags, campi, 2, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+        liberaCorpo(&corpo);
+        return -1;
+    }
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
+
+
 /**
  * @brief               Aggiungo il contenuto di buf, di dimensione size nel server
  * @fun                 appendToFile
@@ -872,76 +2149,260 @@ int writeFile(const char *pathname, const char *dirname) {
  * @param dirname       Cartella dove salvo i file espulsi
  * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
  */
-int appendToFile(const char *pathname, void *buf, size_t size, const char *dirname) {
+int appendToFile(const char *pathname, void *buf, size_t size, const char *dirname) {
+    /** Variabili **/
+    char *fileToWrite = NULL;
+    void *bufKick = NULL;
+    int *result = NULL, res = 0;
+    size_t dimBuf;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(buf == NULL) { errno = EINVAL; return -1; }
+    if(size <= 0) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: pathname e dati in un'unica richiesta **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo file = { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) };
+
+        return aggiuntaV2(&file, 0, buf, size, dirname);
+    }
+
+    /** Invio richiesta al server con il pathname del file e il contenuto da aggiungere **/
+    if(inviaComando("appendToFile", 2, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char), buf, size) <= 0) {
+        return -1;
+    }
+
+    /** Controllo la presenza di eventuali memorymiss **/
+    if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
+        return -1;
+    }
+    while(*result != 0) {
+        if(receiveBufferedMSG(&lettore, (void **) &fileToWrite, NULL) <= 0) {
+            if(bufKick != NULL) free(bufKick);
+            if(fileToWrite != NULL) free(fileToWrite);
+            if(result != NULL) free(result);
+            return -1;
+        }
+        if(receiveBufferedMSG(&lettore, &bufKick, &dimBuf) <= 0) {
+            if(bufKick != NULL) free(bufKick);
+            if(fileToWrite != NULL) free(fileToWrite);
+            if(result != NULL) free(result);
+            return -1;
+        }
+        if((dirname != NULL) && (dimBuf != 0) && (writeFileIntoDisk(fileToWrite, dirname, bufKick, dimBuf) == -1)) {
+            if(bufKick != NULL) free(bufKick);
+            if(fileToWrite != NULL) free(fileToWrite);
+            if(result != NULL) free(result);
+            return -1;
+        }
+        if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
+            if(bufKick != NULL) free(bufKick), bufKick = NULL;
+            if(fileToWrite != NULL) free(fileToWrite);
+            if(result != NULL) free(result);
+            return -1;
+        }
+    }
+
+    /** Ricevo la risposta e valuto l'esito **/
+    if(receiveBufferedMSG(&lettore, (void **) &result, NULL) <= 0) {
+        if(bufKick != NULL) free(bufKick);
+        if(fileToWrite != NULL) free(fileToWrite);
+        if(result != NULL) free(result);
+        return -1;
+    }
+
+    res = *result;
+    if(bufKick != NULL) free(bufKick), bufKick = NULL;
+    if(fileToWrite != NULL) free(fileToWrite);
+    if(result != NULL) free(result);
+    errno = 0;
+    return res;
+}
+
+
+/**
+ * @brief               Richiesta v2 di writeAt: file, offset e dati in un'unica richiesta, i file espulsi nella risposta
+ * @fun                 scritturaPosizioneV2
+ * @param file          Campo con il pathname (o la maniglia) del file da aggiornare
+ * @param flags         FLAG_MANIGLIA se il campo contiene la maniglia
+ * @param offset        Posizione da cui scrivere
+ * @param buf           Buffer da scrivere
+ * @param size          Dimensione del buffer
+ * @param dirname       Cartella dove salvo i file espulsi
+ * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int scritturaPosizioneV2(const Campo *file, uint16_t flags, size_t offset, void *buf, size_t size, const char *dirname) {
+    /** Variabili **/
+    uint64_t posizione = (uint64_t) offset;
+    Campo campi[3] = { *file, { &posizione, sizeof(uint64_t) }, { buf, size } };
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+
+    /** Invio la richiesta e salvo i file espulsi **/
+    allineaCartellaEspulsi(dirname);
+    if(transazioneV2(OP_WRITEAT, flags, campi, 3, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+        liberaCorpo(&corpo);
+        return -1;
+    }
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Sovrascrive il contenuto di un file del server a partire da offset, estendendolo se
+ *                          necessario; il file deve essere aperto e in lock dal client (solo protocollo v2)
+ * @fun                     writeAt
+ * @param pathname          Pathname del file da aggiornare
+ * @param offset            Posizione da cui scrivere
+ * @param buf               Dati da scrivere
+ * @param size              Dimensione dei dati
+ * @param dirname           Cartella in cui salvare i file espulsi (puo' essere NULL)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int writeAt(const char *pathname, size_t offset, void *buf, size_t size, const char *dirname) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if((buf == NULL) || (size == 0)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Pathname, offset e dati in un'unica richiesta **/
+    Campo file = { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) };
+    return scritturaPosizioneV2(&file, 0, offset, buf, size, dirname);
+}
+
+
+/**
+ * @brief                   Crea nel server un file gia' completo del suo contenuto. Con il protocollo v2 e' un'unica
+ *                          richiesta atomica; con il v1 equivale a openFile(O_CREATE | O_LOCK), writeFile,
+ *                          appendToFile e, senza O_LOCK, unlockFile e closeFile
+ * @fun                     putFile
+ * @param pathname          Pathname del file da creare
+ * @param buf               Contenuto del file
+ * @param size              Dimensione del contenuto
+ * @param flags             O_LOCK se il file deve restare aperto e in lock dal client; 0 altrimenti
+ * @param dirname           Cartella in cui salvare i file espulsi (puo' essere NULL)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int putFile(const char *pathname, void *buf, size_t size, int flags, const char *dirname) {
+    /** Variabili **/
+    int res = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if((buf == NULL) && (size > 0)) { errno = EINVAL; return -1; }
+    if((flags != 0) && (flags != O_LOCK)) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2: pathname e contenuto in un'unica richiesta **/
+    if(protocollo == PROTOCOLLO_V2) {
+        Campo campi[2] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) }, { buf, size } };
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        allineaCartellaEspulsi(dirname);
+        if(transazioneV2(OP_PUTFILE, (uint16_t) flags, campi, 2, &risposta, &corpo) == -1) {
+            return -1;
+        }
+        if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+            liberaCorpo(&corpo);
+            return -1;
+        }
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return (risposta.esito == 0) ? 0 : -1;
+    }
+
+    /** Protocollo v1: sequenza di richieste equivalente (appendToFile v1 riporta l'esito come valore di ritorno) **/
+    if(openFile(pathname, (O_CREATE | O_LOCK)) == -1) return -1;
+    if(writeFile(pathname, dirname) == -1) return -1;
+    if((size > 0) && ((res = appendToFile(pathname, buf, size, dirname)) != 0)) {
+        if(res > 0) errno = res;
+        return -1;
+    }
+    if(flags == O_LOCK) return 0;
+    if(unlockFile(pathname) == -1) return -1;
+
+    return closeFile(pathname);
+}
+
+
+/**
+ * @brief                   Crea nel server un file gia' completo del contenuto del file regolare aperto su 'descrittore'.
+ *                          Con il protocollo v2 il descrittore viene passato al server (SCM_RIGHTS), che legge
+ *                          il contenuto direttamente: i bytes non passano ne' dalla memoria del client ne' dal
+ *                          socket. Con il v1 (o via TCP) il contenuto viene letto e spedito con putFile
+ * @fun                     putFileFromFd
+ * @param pathname          Pathname del file da creare
+ * @param descrittore       Descrittore del file regolare con il contenuto (aperto in lettura)
+ * @param flags             O_LOCK se il file deve restare aperto e in lock dal client; 0 altrimenti
+ * @param dirname           Cartella in cui salvare i file espulsi (puo' essere NULL)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int putFileFromFd(const char *pathname, int descrittore, int flags, const char *dirname) {
     /** Variabili **/
-    char *fileToWrite = NULL;
-    void *bufKick = NULL;
-    int *result = NULL, res = 0;
-    size_t dimBuf;
+    struct stat info;
+    void *contenuto = NULL;
+    size_t letti = 0;
+    ssize_t n = 0;
+    int id = -1, res = 0, error = 0;
 
     /** Controllo parametri **/
     errno = 0;
     if(pathname == NULL) { errno = EINVAL; return -1; }
-    if(buf == NULL) { errno = EINVAL; return -1; }
-    if(size <= 0) { errno = EINVAL; return -1; }
-
-    /** Invio richiesta al server **/
-    if(sendMSG(fd_server, "appendToFile", 13) <= 0) {
-        return -1;
-    }
-
-    /** Invio il pathname del file e il contenuto da aggiungere **/
-    if(sendMSG(fd_server, (void *) pathname, strnlen(pathname, MAX_PATHNAME)+1) <= 0) {
-        return -1;
-    }
-    if(sendMSG(fd_server, (void *) buf, size) <= 0) {
-        return -1;
-    }
-
-    /** Controllo la presenza di eventuali memorymiss **/
-    if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
-        return -1;
-    }
-    while(*result != 0) {
-        if(receiveMSG(fd_server, (void **) &fileToWrite, NULL) <= 0) {
-            if(bufKick != NULL) free(bufKick);
-            if(fileToWrite != NULL) free(fileToWrite);
-            if(result != NULL) free(result);
+    if(descrittore < 0) { errno = EBADF; return -1; }
+    if((flags != 0) && (flags != O_LOCK)) { errno = EINVAL; return -1; }
+    if(fstat(descrittore, &info) == -1) return -1;
+    if(!S_ISREG(info.st_mode)) { errno = EINVAL; return -1; }
+
+    /** Protocollo v2 su AF_UNIX: il corpo contiene solo il pathname, il contenuto lo legge il server **/
+    if((protocollo == PROTOCOLLO_V2) && !remoto) {
+        Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+        Intestazione_Risposta risposta;
+        Corpo corpo;
+
+        allineaCartellaEspulsi(dirname);
+        if((id = inviaAsincrona(OP_PUTFILE, (uint16_t) (flags | FLAG_DESCRITTORE), campi, 1, descrittore)) == -1) {
             return -1;
         }
-        if(receiveMSG(fd_server, &bufKick, &dimBuf) <= 0) {
-            if(bufKick != NULL) free(bufKick);
-            if(fileToWrite != NULL) free(fileToWrite);
-            if(result != NULL) free(result);
-            return -1;
-        }
-        if((dirname != NULL) && (dimBuf != 0) && (writeFileIntoDisk(fileToWrite, dirname, bufKick, dimBuf) == -1)) {
-            if(bufKick != NULL) free(bufKick);
-            if(fileToWrite != NULL) free(fileToWrite);
-            if(result != NULL) free(result);
+        if(attendiRispostaV2(id, &risposta, &corpo) == -1) {
             return -1;
         }
-        if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
-            if(bufKick != NULL) free(bufKick), bufKick = NULL;
-            if(fileToWrite != NULL) free(fileToWrite);
-            if(result != NULL) free(result);
+        if(salvaFileRicevuti(&corpo, risposta.flags, risposta.numero, dirname) == -1) {
+            liberaCorpo(&corpo);
             return -1;
         }
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return (risposta.esito == 0) ? 0 : -1;
     }
 
-    /** Ricevo la risposta e valuto l'esito **/
-    if(receiveMSG(fd_server, (void **) &result, NULL) <= 0) {
-        if(bufKick != NULL) free(bufKick);
-        if(fileToWrite != NULL) free(fileToWrite);
-        if(result != NULL) free(result);
+    /** Protocollo v1: leggo il contenuto e lo spedisco **/
+    if((info.st_size > 0) && ((contenuto = malloc((size_t) info.st_size)) == NULL)) {
         return -1;
     }
+    while(letti < (size_t) info.st_size) {
+        if((n = pread(descrittore, (char *) contenuto + letti, (size_t) info.st_size - letti, (off_t) letti)) == -1) {
+            if(errno == EINTR) continue;
+            error = errno;
+            free(contenuto);
+            errno = error;
+            return -1;
+        }
+        if(n == 0) break;
+        letti += n;
+    }
+    res = putFile(pathname, contenuto, letti, flags, dirname), error = errno;
+    if(contenuto != NULL) free(contenuto);
 
-    res = *result;
-    if(bufKick != NULL) free(bufKick), bufKick = NULL;
-    if(fileToWrite != NULL) free(fileToWrite);
-    if(result != NULL) free(result);
-    errno = 0;
+    errno = error;
     return res;
 }
 
@@ -961,16 +2422,14 @@ int lockFile(const char *pathname) {
     errno = 0;
     if(pathname == NULL) { errno = EINVAL; return -1; }
 
-    /** Invio richiesta al server **/
-    if(sendMSG(fd_server, "lockFile", sizeof(char)*9) <= 0) {
-        return -1;
-    }
+    /** Protocollo v2 **/
+    if(protocollo == PROTOCOLLO_V2) return richiestaPathnameV2(OP_LOCKFILE, pathname);
 
-    /** Mando la candidatura di lock al server per quel file **/
-    if(sendMSG(fd_server, (void *) pathname, sizeof(char)*(strnlen(pathname, MAX_PATHNAME)+1)) <= 0) {
+    /** Invio richiesta al server con la candidatura di lock per quel file **/
+    if(inviaComando("lockFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
         return -1;
     }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
         return -1;
     }
     if(*res == 0) {
@@ -1000,16 +2459,14 @@ int unlockFile(const char *pathname) {
     errno = 0;
     if(pathname == NULL) { errno = EINVAL; return -1; }
 
-    /** Invio richiesta al server **/
-    if(sendMSG(fd_server, (void *) "unlockFile", sizeof(char)*11) <= 0) {
-        return -1;
-    }
+    /** Protocollo v2 **/
+    if(protocollo == PROTOCOLLO_V2) return richiestaPathnameV2(OP_UNLOCKFILE, pathname);
 
-    /** Effettuo unlock **/
-    if(sendMSG(fd_server, (void *) pathname, sizeof(char)*(strnlen(pathname, MAX_PATHNAME)+1)) <= 0) {
+    /** Invio richiesta di unlock al server **/
+    if(inviaComando("unlockFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
         return -1;
     }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
         return -1;
     }
     if(*res == 0) {
@@ -1038,14 +2495,14 @@ int closeFile(const char *pathname) {
     /** Controllo parametri **/
     if(pathname == NULL) { errno = EINVAL; return -1; }
 
+    /** Protocollo v2 **/
+    if(protocollo == PROTOCOLLO_V2) return richiestaPathnameV2(OP_CLOSEFILE, pathname);
+
     /** Invio richiesta al server **/
-    if(sendMSG(fd_server, "closeFile", sizeof(char)*10) <= 0) {
+    if(inviaComando("closeFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
         return -1;
     }
-    if(sendMSG(fd_server, (void *) pathname, sizeof(char)*(strnlen(pathname, MAX_PATHNAME)+1)) <= 0) {
-        return -1;
-    }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
         return -1;
     }
 
@@ -1076,16 +2533,14 @@ int removeFile(const char *pathname) {
     errno = 0;
     if(pathname == NULL) { errno = EINVAL; return -1; }
 
-    /** Invio richiesta al server **/
-    if(sendMSG(fd_server, "removeFile", sizeof(char)*11) <= 0) {
-        return -1;
-    }
+    /** Protocollo v2 **/
+    if(protocollo == PROTOCOLLO_V2) return richiestaPathnameV2(OP_REMOVEFILE, pathname);
 
-    /** Invio pathname e attesa della risposta del server **/
-    if(sendMSG(fd_server, (void *) pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
+    /** Invio richiesta e pathname al server e attesa della risposta **/
+    if(inviaComando("removeFile", 1, pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char)) <= 0) {
         return -1;
     }
-    if(receiveMSG(fd_server, (void **) &res, NULL) <= 0) {
+    if(receiveBufferedMSG(&lettore, (void **) &res, NULL) <= 0) {
         return -1;
     }
     if(*res == 0) {
@@ -1097,4 +2552,477 @@ int removeFile(const char *pathname) {
     free(res);
     errno = *res;
     return -1;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief                   Imposta il numero massimo di richieste v2 in volo sulla connessione
+ * @fun                     setInFlightWindow
+ * @param richieste         Dimensione della finestra (da 1 a FINESTRA_MASSIMA)
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int setInFlightWindow(int richieste) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((richieste < 1) || (richieste > FINESTRA_MASSIMA)) { errno = EINVAL; return -1; }
+
+    finestra = (unsigned int) richieste;
+    return 0;
+}
+
+
+/**
+ * @brief                   Abilita o disabilita gli anelli in memoria condivisa per le connessioni aperte in seguito:
+ *                          senza anelli tutte le richieste e le risposte passano dal socket
+ * @fun                     setSharedRings
+ * @param attivi            (0) per disabilitarli; altro per abilitarli (predefinito)
+ * @return                  Ritorna sempre (0)
+ */
+int setSharedRings(int attivi) {
+    errno = 0;
+    anelliRichiesti = (attivi != 0);
+    return 0;
+}
+
+
+/**
+ * @brief                   Invia una openFile senza attenderne la risposta (solo protocollo v2)
+ * @fun                     openFileAsync
+ * @param pathname          Pathname del file da aprire/creare
+ * @param flags             Flags che specificano le modalita' di apertura del file
+ * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+ */
+int openFileAsync(const char *pathname, int flags) {
+    /** Controllo parametri **/
+    if(flags < 0) { errno = EINVAL; return -1; }
+
+    return richiestaAsincronaV2(OP_OPENFILE, (uint16_t) flags, pathname);
+}
+
+
+/**
+ * @brief                   Invia una readFile senza attenderne la risposta (solo protocollo v2)
+ * @fun                     readFileAsync
+ * @param pathname          Pathname del file da leggere
+ * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+ */
+int readFileAsync(const char *pathname) {
+    return richiestaAsincronaV2(OP_READFILE, 0, pathname);
+}
+
+
+/**
+ * @brief                   Invia una lockFile senza attenderne la risposta (solo protocollo v2):
+ *                          se il file e' occupato la risposta arriva quando la lock viene concessa
+ * @fun                     lockFileAsync
+ * @param pathname          Pathname del file da lockare
+ * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+ */
+int lockFileAsync(const char *pathname) {
+    return richiestaAsincronaV2(OP_LOCKFILE, 0, pathname);
+}
+
+
+/**
+ * @brief                   Invia una unlockFile senza attenderne la risposta (solo protocollo v2)
+ * @fun                     unlockFileAsync
+ * @param pathname          Pathname del file da unlockare
+ * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+ */
+int unlockFileAsync(const char *pathname) {
+    return richiestaAsincronaV2(OP_UNLOCKFILE, 0, pathname);
+}
+
+
+/**
+ * @brief                   Invia una closeFile senza attenderne la risposta (solo protocollo v2)
+ * @fun                     closeFileAsync
+ * @param pathname          Pathname del file da chiudere
+ * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+ */
+int closeFileAsync(const char *pathname) {
+    return richiestaAsincronaV2(OP_CLOSEFILE, 0, pathname);
+}
+
+
+/**
+ * @brief                   Attende la risposta di una richiesta asincrona
+ * @fun                     waitResponse
+ * @param id                Identificativo ritornato dalla richiesta
+ * @param buf               Contenuto del file per readFileAsync (puo' essere NULL)
+ * @param size              Dimensione del contenuto (puo' essere NULL)
+ * @return                  Ritorna (0) se l'operazione ha avuto successo; (-1) altrimenti [setta errno]
+ */
+int waitResponse(int id, void **buf, size_t *size) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    void *contenuto = NULL;
+    size_t dimensione = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(id <= 0) { errno = EINVAL; return -1; }
+
+    /** Attendo la risposta e ne valuto l'esito **/
+    if(attendiRispostaV2(id, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    if(risposta.esito != 0) {
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return -1;
+    }
+
+    /** Copio l'eventuale contenuto **/
+    if(corpo.dimensione > 0) {
+        if(leggiCampo(&corpo, &contenuto, &dimensione) == -1) {
+            liberaCorpo(&corpo);
+            return -1;
+        }
+        if(buf != NULL) {
+            if(*buf != NULL) free(*buf);
+            if((*buf = malloc(dimensione)) == NULL) {
+                liberaCorpo(&corpo);
+                return -1;
+            }
+            memcpy(*buf, contenuto, dimensione);
+        }
+    }
+    if(size != NULL) *size = dimensione;
+    liberaCorpo(&corpo);
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Apre un file gia' presente nel server e ne riceve la maniglia: le richieste che la usano
+ *                          indicano il file con un intero invece del pathname e il server lo trova senza cercarlo
+ *                          nella sua tabella. La maniglia vale per la connessione finche' il file non viene chiuso;
+ *                          se il file lascia il server le richieste falliscono con ESTALE (solo protocollo v2)
+ * @fun                     openHandle
+ * @param pathname          Pathname del file da aprire
+ * @return                  Ritorna la maniglia (maggiore di 0); (-1) in caso di errore [setta errno]
+ */
+int openHandle(const char *pathname) {
+    /** Variabili **/
+    Intestazione_Risposta risposta;
+    Corpo corpo;
+    void *campo = NULL;
+    size_t dim = 0;
+    uint32_t numero = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Apro il file e leggo la maniglia **/
+    Campo campi[1] = { { pathname, (strnlen(pathname, MAX_PATHNAME)+1)*sizeof(char) } };
+    if(transazioneV2(OP_OPENFILE, FLAG_MANIGLIA, campi, 1, &risposta, &corpo) == -1) {
+        return -1;
+    }
+    if(risposta.esito != 0) {
+        liberaCorpo(&corpo);
+        errno = risposta.esito;
+        return -1;
+    }
+    if((leggiCampo(&corpo, &campo, &dim) == -1) || (dim != sizeof(uint32_t))) {
+        liberaCorpo(&corpo);
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&numero, campo, sizeof(uint32_t));
+    liberaCorpo(&corpo);
+    if((numero == 0) || (numero > INT_MAX)) { errno = EBADMSG; return -1; }
+
+    errno = 0;
+    return (int) numero;
+}
+
+
+/**
+ * @brief                   Legge un file indicato dalla sua maniglia
+ * @fun                     readHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @param buf               Buffer del file da leggere
+ * @param size              Dimensione del file
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int readHandle(int maniglia, void **buf, size_t *size) {
+    /** Variabili **/
+    uint32_t numero = (uint32_t) maniglia;
+    Campo file = { &numero, sizeof(uint32_t) };
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(maniglia <= 0) { errno = EBADF; return -1; }
+    if((buf == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    return copiaLetturaV2(&file, FLAG_MANIGLIA, buf, size);
+}
+
+
+/**
+ * @brief                   Aggiunge il contenuto di buf al file indicato dalla sua maniglia
+ * @fun                     appendToHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @param buf               Buffer da aggiungere
+ * @param size              Dimensione del buffer
+ * @param dirname           Cartella dove salvo i file espulsi
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int appendToHandle(int maniglia, void *buf, size_t size, const char *dirname) {
+    /** Variabili **/
+    uint32_t numero = (uint32_t) maniglia;
+    Campo file = { &numero, sizeof(uint32_t) };
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(maniglia <= 0) { errno = EBADF; return -1; }
+    if((buf == NULL) || (size == 0)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    return aggiuntaV2(&file, FLAG_MANIGLIA, buf, size, dirname);
+}
+
+
+/**
+ * @brief                   Effettua la lock del file indicato dalla sua maniglia
+ * @fun                     lockHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int lockHandle(int maniglia) {
+    return richiestaManigliaV2(OP_LOCKFILE, maniglia);
+}
+
+
+/**
+ * @brief                   Effettua la unlock del file indicato dalla sua maniglia
+ * @fun                     unlockHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int unlockHandle(int maniglia) {
+    return richiestaManigliaV2(OP_UNLOCKFILE, maniglia);
+}
+
+
+/**
+ * @brief                   Chiude il file indicato dalla sua maniglia, che da qui in poi non e' piu' valida
+ * @fun                     closeHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int closeHandle(int maniglia) {
+    return richiestaManigliaV2(OP_CLOSEFILE, maniglia);
+}
+
+
+/**
+ * @brief                   Legge una porzione del file indicato dalla sua maniglia
+ * @fun                     readHandleRange
+ * @param maniglia          Maniglia data da openHandle
+ * @param offset            Posizione da cui leggere
+ * @param length            Bytes da leggere (0 per arrivare alla fine)
+ * @param buf               Porzione letta
+ * @param size              Dimensione della porzione letta
+ * @param totalSize         Dimensione attuale del file (puo' essere NULL)
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int readHandleRange(int maniglia, size_t offset, size_t length, void **buf, size_t *size, size_t *totalSize) {
+    /** Variabili **/
+    uint32_t numero = (uint32_t) maniglia;
+    Campo file = { &numero, sizeof(uint32_t) };
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(maniglia <= 0) { errno = EBADF; return -1; }
+    if((buf == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    return letturaPorzioneV2(&file, FLAG_MANIGLIA, offset, length, buf, size, totalSize);
+}
+
+
+/**
+ * @brief                   Sovrascrive il file indicato dalla sua maniglia a partire da un offset
+ * @fun                     writeAtHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @param offset            Posizione da cui scrivere
+ * @param buf               Buffer da scrivere
+ * @param size              Dimensione del buffer
+ * @param dirname           Cartella dove salvo i file espulsi
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int writeAtHandle(int maniglia, size_t offset, void *buf, size_t size, const char *dirname) {
+    /** Variabili **/
+    uint32_t numero = (uint32_t) maniglia;
+    Campo file = { &numero, sizeof(uint32_t) };
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(maniglia <= 0) { errno = EBADF; return -1; }
+    if((buf == NULL) || (size == 0)) { errno = EINVAL; return -1; }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    return scritturaPosizioneV2(&file, FLAG_MANIGLIA, offset, buf, size, dirname);
+}
+
+
+/**
+ * @brief                   Rimuove dal server il file indicato dalla sua maniglia, che da qui in poi non e' piu' valida
+ * @fun                     removeHandle
+ * @param maniglia          Maniglia data da openHandle
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int removeHandle(int maniglia) {
+    return richiestaManigliaV2(OP_REMOVEFILE, maniglia);
+}
+
+
+/**
+ * @brief                   Esegue piu' operazioni in un'unica richiesta (OP_COMPOSTA): il server le esegue in ordine
+ *                          nello stesso task e si ferma alla prima che fallisce, quindi ad esempio lock, lettura,
+ *                          aggiunta e unlock costano un solo giro. Una lock su un file di un altro client fallisce
+ *                          con EBUSY invece di attendere (solo protocollo v2)
+ * @fun                     compoundRequest
+ * @param operazioni        Operazioni da eseguire, di cui viene riportato l'esito
+ * @param numero            Numero delle operazioni (al massimo OPERAZIONI_COMPOSTE_MASSIME)
+ * @param dirname           Cartella dove salvo i file espulsi dalle aggiunte
+ * @return                  Ritorna (0) se tutte hanno avuto successo; (-1) altrimenti [setta errno]
+ */
+int compoundRequest(Operazione_Composta *operazioni, int numero, const char *dirname) {
+    /** Variabili **/
+    Campo *richieste = NULL, file[2];
+    uint32_t *maniglie = NULL, valore = 0;
+    char *buffer = NULL, *campo = NULL;
+    size_t dim = 0, dimContenuto = 0, numeroCampi = 0;
+    uint64_t totale = 0;
+    void *contenuto = NULL, *copia = NULL;
+    Intestazione_Richiesta intestazione;
+    Intestazione_Risposta risposta, esito;
+    Corpo corpo, sotto, operazione;
+    int i = 0, errore = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((operazioni == NULL) || (numero <= 0) || (numero > OPERAZIONI_COMPOSTE_MASSIME)) { errno = EINVAL; return -1; }
+    for(i=0; i<numero; i++) {
+        operazioni[i].esito = ECANCELED;
+        switch(operazioni[i].operazione) {
+            case OP_OPENFILE:
+                if(operazioni[i].maniglia > 0) { errno = EINVAL; return -1; }
+                break;
+            case OP_REMOVEFILE:
+            case OP_READFILE:
+            case OP_LOCKFILE:
+            case OP_UNLOCKFILE:
+            case OP_CLOSEFILE:
+                break;
+            case OP_APPENDTOFILE:
+                if((operazioni[i].buf == NULL) || (operazioni[i].size == 0)) { errno = EINVAL; return -1; }
+                break;
+            default:
+                errno = EINVAL;
+                return -1;
+        }
+        if((operazioni[i].maniglia <= 0) && (operazioni[i].pathname == NULL)) { errno = EINVAL; return -1; }
+    }
+    if(protocollo != PROTOCOLLO_V2) { errno = ENOTSUP; return -1; }
+
+    /** Preparo le operazioni: ognuna e' un campo con l'intestazione e il corpo della sua richiesta **/
+    if(((richieste = (Campo *) malloc(numero*sizeof(Campo))) == NULL) || ((maniglie = (uint32_t *) malloc(numero*sizeof(uint32_t))) == NULL)) {
+        free(richieste);
+        return -1;
+    }
+    for(int passo=0; passo<2; passo++) {
+        for(i=0; i<numero; i++) {
+            maniglie[i] = (uint32_t) operazioni[i].maniglia;
+            if(operazioni[i].maniglia > 0) file[0].dati = maniglie + i, file[0].dimensione = sizeof(uint32_t);
+            else file[0].dati = operazioni[i].pathname, file[0].dimensione = (strnlen(operazioni[i].pathname, MAX_PATHNAME)+1)*sizeof(char);
+            file[1].dati = operazioni[i].buf, file[1].dimensione = operazioni[i].size;
+            numeroCampi = (operazioni[i].operazione == OP_APPENDTOFILE) ? 2 : 1;
+            if(passo == 0) {
+                totale += sizeof(Intestazione_Richiesta) + dimensioneCorpo(file, numeroCampi);
+                continue;
+            }
+            memset(&intestazione, 0, sizeof(Intestazione_Richiesta));
+            intestazione.opcode = (uint16_t) operazioni[i].operazione;
+            intestazione.flags = (uint16_t) ((operazioni[i].operazione == OP_OPENFILE) ? operazioni[i].flags : 0);
+            if(operazioni[i].maniglia > 0) intestazione.flags |= FLAG_MANIGLIA;
+            intestazione.lunghezza = dimensioneCorpo(file, numeroCampi);
+            richieste[i].dati = buffer + dim, richieste[i].dimensione = sizeof(Intestazione_Richiesta) + intestazione.lunghezza;
+            memcpy(buffer + dim, &intestazione, sizeof(Intestazione_Richiesta));
+            scriviCampi(buffer + dim + sizeof(Intestazione_Richiesta), file, numeroCampi);
+            dim += richieste[i].dimensione;
+        }
+        if((passo == 0) && ((buffer = (char *) malloc((size_t) totale)) == NULL)) {
+            free(richieste);
+            free(maniglie);
+            return -1;
+        }
+    }
+
+    /** Invio la richiesta **/
+    allineaCartellaEspulsi(dirname);
+    errore = transazioneV2(OP_COMPOSTA, 0, richieste, (size_t) numero, &risposta, &corpo);
+    free(richieste);
+    free(maniglie);
+    free(buffer);
+    if(errore == -1) return -1;
+    if((risposta.numero > (uint32_t) numero) || ((risposta.numero > 0) && (leggiCampo(&corpo, (void **) &campo, &dim) == -1))) {
+        liberaCorpo(&corpo);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    /** Leggo le risposte delle operazioni eseguite **/
+    corpoAnnidato(&sotto, campo, (risposta.numero > 0) ? dim : 0);
+    for(i=0; i<(int) risposta.numero; i++) {
+        if((leggiCampo(&sotto, (void **) &campo, &dim) == -1) || (dim < sizeof(Intestazione_Risposta))) {
+            liberaCorpo(&corpo);
+            errno = EBADMSG;
+            return -1;
+        }
+        memcpy(&esito, campo, sizeof(Intestazione_Risposta));
+        corpoAnnidato(&operazione, campo + sizeof(Intestazione_Risposta), dim - sizeof(Intestazione_Risposta));
+        operazioni[i].esito = esito.esito;
+        if(esito.esito != 0) continue;
+
+        /** Riporto il contenuto letto, la maniglia ricevuta o salvo i file espulsi **/
+        switch(operazioni[i].operazione) {
+            case OP_READFILE:
+                if((leggiCampo(&operazione, &contenuto, &dimContenuto) == -1) || ((copia = malloc((dimContenuto > 0) ? dimContenuto : 1)) == NULL)) errore = 1;
+                else {
+                    if(dimContenuto > 0) memcpy(copia, contenuto, dimContenuto);
+                    if(operazioni[i].buf != NULL) free(operazioni[i].buf);
+                    operazioni[i].buf = copia, operazioni[i].size = dimContenuto;
+                }
+                break;
+            case OP_OPENFILE:
+                if(!(operazioni[i].flags & FLAG_MANIGLIA)) break;
+                if((leggiCampo(&operazione, &contenuto, &dimContenuto) == -1) || (dimContenuto != sizeof(uint32_t))) errore = 1;
+                else memcpy(&valore, contenuto, sizeof(uint32_t)), operazioni[i].maniglia = (int) valore;
+                break;
+            case OP_APPENDTOFILE:
+                if(salvaFileRicevuti(&operazione, esito.flags, esito.numero, dirname) == -1) errore = 1;
+                break;
+            default:
+                break;
+        }
+        if(errore) {
+            liberaCorpo(&corpo);
+            if(errno == 0) errno = EBADMSG;
+            return -1;
+        }
+    }
+
+    liberaCorpo(&corpo);
+    errno = risposta.esito;
+    return (risposta.esito == 0) ? 0 : -1;
+}
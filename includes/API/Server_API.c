@@ -10,34 +10,1978 @@
 #include "Server_API.h"
 
 
+/** Sticky bit delle cartelle (definito da sys/stat.h solo con le estensioni XSI) **/
+#ifndef S_ISVTX
+#define S_ISVTX 01000
+#endif
+
+
+/**
+ * @brief       Chiusura connessione con il client
+ * @macro       CLIENT_GOODBYE
+ */
+#define CLIENT_GOODBYE                                              \
+    do {                                                            \
+        salutaClient(cache, tp->sessioni, *fd);                     \
+    } while(0)
+
+
+/**
+ * @brief       Macro di supporto output sul file di log
+ * @macro       LOG_PRINT_FLAGS
+ */
+#define LOG_PRINT_FLAGS \
+    (*flags == 0) ? "0" : ((*flags == (O_CREATE | O_LOCK)) ? "O_CREATE | O_LOCK" : "O_CREATE")
+
+
+/**
+ * @brief       Stampa sul log per le richieste v2; in caso di errore termina il gestore con (-1)
+ * @macro       LOG_V2
+ */
+#define LOG_V2(R, TXT, ...)                                                 \
+    if(traceOnLog(((R)->tp)->log, TXT, ##__VA_ARGS__) == -1) {              \
+        return -1;                                                          \
+    }
+
+
+/**
+ * @brief                   Client in attesa di una lock da risvegliare dopo la risposta a una richiesta composta
+ * @struct                  Risveglio
+ * @param fd                FD del client da risvegliare
+ * @param pathname          File di cui il client riceve la lock (copia)
+ * @param esito             Esito da comunicare
+ */
+typedef struct {
+    int fd;
+    char *pathname;
+    int esito;
+} Risveglio;
+
+
+/**
+ * @brief                   Risposte raccolte per le operazioni di una richiesta composta (OP_COMPOSTA). Quello che
+ *                          le operazioni spedirebbero fuori dalla propria risposta (notifiche di file espulsi,
+ *                          risvegli dei client in attesa di una lock) viene rinviato a dopo la risposta composta
+ * @struct                  Raccolta_Risposte
+ * @param buffer            Un campo per ogni risposta: Intestazione_Risposta seguita dal suo corpo
+ * @param dimensione        Bytes usati nel buffer
+ * @param capacita          Bytes allocati nel buffer
+ * @param esito             Esito dell'ultima risposta raccolta
+ * @param espulsi           File espulsi da notificare (lista terminata da NULL)
+ * @param numeroEspulsi     Numero dei file espulsi da notificare
+ * @param modoEspulsi       Modo della notifica (ESPULSI_CONTENUTO o ESPULSI_NOMI)
+ * @param risvegli          Client da risvegliare
+ * @param numeroRisvegli    Numero dei client da risvegliare
+ */
+typedef struct {
+    char *buffer;
+    size_t dimensione;
+    size_t capacita;
+    int esito;
+    myFile **espulsi;
+    size_t numeroEspulsi;
+    int modoEspulsi;
+    Risveglio *risvegli;
+    size_t numeroRisvegli;
+} Raccolta_Risposte;
+
+
+/**
+ * @brief                   Richiesta v2 in corso di esecuzione
+ * @struct                  Richiesta_V2
+ * @param thread            Numero del thread che la esegue
+ * @param fd                FD del client
+ * @param tp                Argomenti del task
+ * @param intestazione      Intestazione della richiesta
+ * @param corpo             Corpo della richiesta
+ * @param descrittore       Descrittore passato dal client con la richiesta (-1 se nessuno), chiuso dopo il gestore
+ * @param bytesLetti        Bytes ricevuti dal client
+ * @param bytesScritti      Bytes spediti al client
+ * @param raccolta          Risposte della richiesta composta di cui fa parte (NULL se la risposta va spedita)
+ */
+typedef struct {
+    unsigned int thread;
+    int fd;
+    Task_Package *tp;
+    Intestazione_Richiesta intestazione;
+    Corpo corpo;
+    int descrittore;
+    size_t bytesLetti;
+    size_t bytesScritti;
+    Raccolta_Risposte *raccolta;
+} Richiesta_V2;
+
+
+/**
+ * @brief                   Registra una richiesta v2 che potrebbe restare in attesa della lock sul file.
+ *                          Va fatto prima di tentare la lock: il client puo' essere risvegliato da un altro
+ *                          thread appena la richiesta entra nella coda del file
+ * @fun                     registraAttesa
+ * @param sessione          Sessione del client
+ * @param intestazione      Intestazione della richiesta
+ * @param pathname          File di cui si chiede la lock
+ * @return                  Ritorna (0) in caso di successo; (-1) se le attese sono gia' FINESTRA_MASSIMA [setta errno]
+ */
+static int registraAttesa(Sessione *sessione, const Intestazione_Richiesta *intestazione, const char *pathname) {
+    /** Variabili **/
+    int error = 0, esito = 0;
+    char *copia = NULL;
+
+    /** Copio il pathname e registro l'attesa **/
+    if((copia = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
+        return -1;
+    }
+    strncpy(copia, pathname, strnlen(pathname, MAX_PATHNAME)+1);
+    if((error = pthread_mutex_lock(sessione->accesso)) != 0) {
+        free(copia);
+        errno = error;
+        return -1;
+    }
+    if(sessione->numeroAttese < FINESTRA_MASSIMA) {
+        (sessione->attese)[sessione->numeroAttese].id = intestazione->id;
+        (sessione->attese)[sessione->numeroAttese].opcode = intestazione->opcode;
+        (sessione->attese)[sessione->numeroAttese].pathname = copia;
+        sessione->numeroAttese++;
+    } else {
+        free(copia);
+        esito = EAGAIN;
+    }
+    pthread_mutex_unlock(sessione->accesso);
+
+    errno = esito;
+    return (esito == 0) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Toglie dalle attese della sessione la richiesta sul file indicato
+ *                          (la piu' recente; con pathname NULL la piu' vecchia). Va chiamata con accesso acquisito
+ * @fun                     estraiAttesa
+ * @param sessione          Sessione del client
+ * @param pathname          File su cui si attendeva la lock
+ * @param attesa            Attesa estratta (il pathname viene liberato)
+ * @return                  Ritorna (0) se l'attesa e' stata trovata; (-1) altrimenti
+ */
+static int estraiAttesa(Sessione *sessione, const char *pathname, Attesa_Lock *attesa) {
+    /** Variabili **/
+    int trovata = -1;
+
+    /** Cerco l'attesa **/
+    if(sessione->numeroAttese == 0) return -1;
+    if(pathname == NULL) {
+        trovata = 0;
+    } else {
+        for(int i=(int) sessione->numeroAttese-1; (i >= 0) && (trovata == -1); i--) {
+            if(strncmp((sessione->attese)[i].pathname, pathname, MAX_PATHNAME) == 0) trovata = i;
+        }
+        if(trovata == -1) return -1;
+    }
+
+    /** La estraggo mantenendo l'ordine delle altre **/
+    *attesa = (sessione->attese)[trovata];
+    free(attesa->pathname), attesa->pathname = NULL;
+    memmove(sessione->attese + trovata, sessione->attese + trovata + 1, (sessione->numeroAttese - trovata - 1)*sizeof(Attesa_Lock));
+    sessione->numeroAttese--;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Annulla la registrazione di una richiesta che non e' rimasta in attesa
+ * @fun                     annullaAttesa
+ * @param sessione          Sessione del client
+ * @param pathname          File di cui si chiedeva la lock
+ */
+static void annullaAttesa(Sessione *sessione, const char *pathname) {
+    /** Variabili **/
+    Attesa_Lock attesa;
+
+    /** Tolgo l'attesa **/
+    if(pthread_mutex_lock(sessione->accesso) != 0) return;
+    estraiAttesa(sessione, pathname, &attesa);
+    pthread_mutex_unlock(sessione->accesso);
+}
+
+
+/**
+ * @brief                   Invia una risposta v2 sul canale del client: nell'anello delle risposte se la sessione
+ *                          ha gli anelli e il frame ci sta, altrimenti sul socket. Con gli anelli un frame spedito
+ *                          sul socket e' preceduto nell'anello dalla sua intestazione con FLAG_SUL_SOCKET, cosi' il client
+ *                          legge tutte le risposte da un unico canale e nell'ordine di invio. L'anello ha posto per
+ *                          ANELLO_FRAME_RISERVATI frame, compresa una notifica per ogni richiesta in volo, quindi non
+ *                          si riempie (ENOBUFS) finche' il client rispetta la finestra.
+ *                          Va chiamata con accesso acquisito
+ * @fun                     inviaRispostaSessione
+ * @param sessione          Sessione del client
+ * @param fd                FD del client
+ * @param risposta          Intestazione della risposta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare con la risposta (-1 se nessuno): viaggia sempre sul socket
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+static ssize_t inviaRispostaSessione(Sessione *sessione, int fd, Intestazione_Risposta *risposta, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Variabili **/
+    Intestazione_Risposta segnaposto;
+    ssize_t bytes = -1;
+
+    /** Nell'anello se possibile **/
+    if((sessione->anelli != NULL) && (descrittore < 0)) {
+        if((bytes = scriviRispostaAnello(&((sessione->anelli)->risposte), risposta, campi, numeroCampi)) != -1) return bytes;
+        if(errno != EMSGSIZE) return -1;
+    }
+
+    /** Sul socket, annunciato prima nell'anello: il client inizia a leggerlo mentre viene scritto **/
+    if(sessione->anelli != NULL) {
+        segnaposto = *risposta;
+        segnaposto.flags |= FLAG_SUL_SOCKET;
+        if(scriviRispostaAnello(&((sessione->anelli)->risposte), &segnaposto, NULL, 0) == -1) return -1;
+    }
+
+    return (descrittore >= 0) ? inviaRispostaConDescrittore(fd, risposta, campi, numeroCampi, descrittore) : inviaRisposta(fd, risposta, campi, numeroCampi);
+}
+
+
+/**
+ * @brief                   Risponde a un client sospeso in attesa di una lock, rispettando il suo protocollo
+ * @fun                     rispondiAttesa
+ * @param sessioni          Tabella delle sessioni
+ * @param fd                FD del client da risvegliare
+ * @param pathname          File di cui il client riceve la lock (NULL se non noto)
+ * @param esito             Esito da comunicare
+ * @return                  Ritorna il numero di bytes scritti; 0 se il client non aveva richieste in attesa;
+ *                          -1 in caso di errore [setta errno]
+ */
+static ssize_t rispondiAttesa(Sessione *sessioni, int fd, const char *pathname, int esito) {
+    /** Variabili **/
+    int error = 0;
+    ssize_t bytes = 0;
+    Intestazione_Risposta risposta;
+    Attesa_Lock attesa;
+    Sessione *sessione = sessioni + fd;
+
+    /** Il client potrebbe ricevere in contemporanea le risposte alle sue richieste **/
+    if((error = pthread_mutex_lock(sessione->accesso)) != 0) {
+        errno = error;
+        return -1;
+    }
+    if(sessione->protocollo != PROTOCOLLO_V2) {
+        /** Protocollo v1: solo l'esito **/
+        bytes = sendMSG(fd, (void *) &esito, sizeof(int));
+    } else if(estraiAttesa(sessione, pathname, &attesa) == 0) {
+        /** Protocollo v2: risposta alla richiesta sospesa **/
+        memset(&risposta, 0, sizeof(Intestazione_Risposta));
+        risposta.opcode = attesa.opcode;
+        risposta.id = attesa.id;
+        risposta.esito = esito;
+        bytes = inviaRispostaSessione(sessione, fd, &risposta, NULL, 0, -1);
+    }
+    error = errno;
+    pthread_mutex_unlock(sessione->accesso);
+
+    errno = error;
+    return bytes;
+}
+
+
+/**
+ * @brief                   Elimina ogni pendenza di un client che si disconnette e risveglia
+ *                          i client in attesa delle sue lock
+ * @fun                     salutaClient
+ * @param cache             Memoria cache
+ * @param sessioni          Tabella delle sessioni
+ * @param fd                FD del client che si disconnette
+ */
+static void salutaClient(LRU_Memory *cache, Sessione *sessioni, int fd) {
+    /** Variabili **/
+    int *locks = NULL, i = -1;
+    char **pathnames = NULL;
+
+    /** Logout e risveglio dei client in attesa **/
+    errno = 0;
+    chiudiSessione(sessioni + fd);
+    logoutClient(cache);
+    locks = deleteClientFromCache(cache, fd, &pathnames);
+    if((errno == 0) && (locks != NULL)) {
+        while(locks[++i] != -1) {
+            rispondiAttesa(sessioni, locks[i], (pathnames != NULL) ? pathnames[i] : NULL, 0);
+        }
+    }
+    i = -1;
+    while((locks != NULL) && (locks[++i] != -1)) {
+        if((pathnames != NULL) && (pathnames[i] != NULL)) free(pathnames[i]);
+    }
+    if(pathnames != NULL) free(pathnames);
+    if(locks != NULL) free(locks);
+}
+
+
+/**
+ * @brief                   Codice di errore da riportare al client per un'operazione fallita
+ * @fun                     codiceErrore
+ * @return                  Ritorna errno; EIO se l'operazione e' fallita senza impostarlo
+ */
+static int codiceErrore(void) {
+    return (errno != 0) ? errno : EIO;
+}
+
+
+/**
+ * @brief                   Converte i flag di openFile in stringa per il log
+ * @fun                     stringaFlags
+ * @param flags             Flag di apertura
+ * @return                  Ritorna la stringa dei flag
+ */
+static const char* stringaFlags(int flags) {
+    return (flags == 0) ? "0" : ((flags == (O_CREATE | O_LOCK)) ? "O_CREATE | O_LOCK" : "O_CREATE");
+}
+
+
+/**
+ * @brief                   Corsia di una richiesta v2: le operazioni sui metadati passano avanti ai trasferimenti
+ * @fun                     corsiaOpcode
+ * @param opcode            Opcode della richiesta
+ * @return                  CORSIA_PRIORITARIA o CORSIA_NORMALE
+ */
+static int corsiaOpcode(uint16_t opcode) {
+    switch(opcode) {
+        case OP_OPENFILE:
+        case OP_LOCKFILE:
+        case OP_UNLOCKFILE:
+        case OP_CLOSEFILE:
+        case OP_REMOVEFILE:
+        case OP_PUBLISHFILE:
+        case OP_SEGMENTO:
+        case OP_ESPULSIONI:
+            return CORSIA_PRIORITARIA;
+
+        default:
+            return CORSIA_NORMALE;
+    }
+}
+
+
+/**
+ * @brief                   Corsia di un comando v1
+ * @fun                     corsiaComando
+ * @param comando           Comando ricevuto
+ * @param dimensione        Dimensione del comando
+ * @return                  CORSIA_PRIORITARIA o CORSIA_NORMALE
+ */
+static int corsiaComando(const char *comando, size_t dimensione) {
+    /** Variabili **/
+    const char *metadati[] = { "openFile", "lockFile", "unlockFile", "closeFile", "removeFile", NULL };
+    int i = -1;
+
+    /** Confronto il comando **/
+    if((dimensione == 0) || (comando[dimensione-1] != '\0')) return CORSIA_NORMALE;
+    while(metadati[++i] != NULL) {
+        if(strncmp(comando, metadati[i], dimensione) == 0) return CORSIA_PRIORITARIA;
+    }
+
+    return CORSIA_NORMALE;
+}
+
+
+/**
+ * @brief                   Aggiunge la risposta di un'operazione a quelle della richiesta composta
+ * @fun                     raccogliRisposta
+ * @param raccolta          Risposte raccolte
+ * @param risposta          Intestazione della risposta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int raccogliRisposta(Raccolta_Risposte *raccolta, Intestazione_Risposta *risposta, const Campo *campi, size_t numeroCampi) {
+    /** Variabili **/
+    uint64_t dimCampo = 0;
+    size_t richiesta = 0, capacita = 0;
+    char *nuovo = NULL;
+
+    /** Faccio spazio al campo **/
+    risposta->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    dimCampo = sizeof(Intestazione_Risposta) + risposta->lunghezza;
+    richiesta = raccolta->dimensione + sizeof(uint64_t) + (size_t) dimCampo;
+    if(richiesta > raccolta->capacita) {
+        capacita = (raccolta->capacita == 0) ? 256 : raccolta->capacita;
+        while(capacita < richiesta) capacita *= 2;
+        if((nuovo = (char *) realloc(raccolta->buffer, capacita)) == NULL) return -1;
+        raccolta->buffer = nuovo, raccolta->capacita = capacita;
+    }
+
+    /** Scrivo il campo: intestazione e corpo della risposta **/
+    memcpy(raccolta->buffer + raccolta->dimensione, &dimCampo, sizeof(uint64_t));
+    memcpy(raccolta->buffer + raccolta->dimensione + sizeof(uint64_t), risposta, sizeof(Intestazione_Risposta));
+    scriviCampi(raccolta->buffer + raccolta->dimensione + sizeof(uint64_t) + sizeof(Intestazione_Risposta), campi, numeroCampi);
+    raccolta->dimensione = richiesta;
+    raccolta->esito = risposta->esito;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Invia la risposta a una richiesta v2, passando al client anche un descrittore se indicato
+ * @fun                     rispondiV2ConDescrittore
+ * @param r                 Richiesta a cui rispondere
+ * @param flags             Flag della risposta (FLAG_DESCRITTORE viene aggiunto se c'e' un descrittore)
+ * @param esito             Esito dell'operazione
+ * @param numero            Numero di file nel corpo
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare con la risposta (-1 se nessuno)
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int rispondiV2ConDescrittore(Richiesta_V2 *r, uint16_t flags, int esito, uint32_t numero, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Variabili **/
+    ssize_t bytes = -1;
+    Intestazione_Risposta risposta;
+
+    /** Preparo la risposta **/
+    memset(&risposta, 0, sizeof(Intestazione_Risposta));
+    risposta.opcode = (r->intestazione).opcode;
+    risposta.flags = (descrittore >= 0) ? (flags | FLAG_DESCRITTORE) : flags;
+    risposta.id = (r->intestazione).id;
+    risposta.esito = esito;
+    risposta.numero = numero;
+
+    /** Operazione di una richiesta composta: la risposta viene raccolta (i descrittori non sono ammessi) **/
+    if(r->raccolta != NULL) {
+        if(descrittore >= 0) risposta.flags = flags, risposta.esito = ENOTSUP, campi = NULL, numeroCampi = 0;
+        return raccogliRisposta(r->raccolta, &risposta, campi, numeroCampi);
+    }
+
+    /** Invio la risposta **/
+    if(pthread_mutex_lock(((r->tp)->sessioni)[r->fd].accesso) != 0) {
+        errno = ECOMM;
+        return -1;
+    }
+    bytes = inviaRispostaSessione(((r->tp)->sessioni) + r->fd, r->fd, &risposta, campi, numeroCampi, descrittore);
+    pthread_mutex_unlock(((r->tp)->sessioni)[r->fd].accesso);
+    if(bytes <= 0) {
+        errno = ECOMM;
+        return -1;
+    }
+    r->bytesScritti += bytes;
+    LOG_V2(r, "[THREAD %d]: Spedisco dati al client\n", r->thread)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Invia la risposta a una richiesta v2
+ * @fun                     rispondiV2
+ * @param r                 Richiesta a cui rispondere
+ * @param esito             Esito dell'operazione
+ * @param numero            Numero di file nel corpo
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int rispondiV2(Richiesta_V2 *r, int esito, uint32_t numero, const Campo *campi, size_t numeroCampi) {
+    return rispondiV2ConDescrittore(r, 0, esito, numero, campi, numeroCampi, -1);
+}
+
+
+/**
+ * @brief                   Legge il pathname dal corpo della richiesta
+ * @fun                     leggiPathname
+ * @param r                 Richiesta
+ * @param pathname          Pathname letto (interno al corpo)
+ * @return                  Ritorna (0) in caso di successo; (-1) se il campo e' assente o non terminato [setta errno]
+ */
+static int leggiPathname(Richiesta_V2 *r, char **pathname) {
+    /** Variabili **/
+    size_t dim = 0;
+
+    /** Lettura **/
+    if(leggiCampo(&(r->corpo), (void **) pathname, &dim) == -1) return -1;
+    if((dim == 0) || (dim > MAX_PATHNAME) || ((*pathname)[dim-1] != '\0')) { errno = EBADMSG; return -1; }
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Legge dal corpo della richiesta il file su cui operare: il pathname o, con FLAG_MANIGLIA,
+ *                          la maniglia data dal server, che viene tradotta con la tabella della sessione
+ * @fun                     leggiFileRichiesto
+ * @param r                 Richiesta
+ * @param pathname          Pathname del file (interno al corpo o alla tabella delle maniglie)
+ * @param maniglia          Maniglia del file nella cache (NULL se la richiesta porta il pathname)
+ * @return                  Ritorna (0) in caso di successo; (-1) se il campo e' assente o malformato (EBADMSG)
+ *                          o la maniglia non e' della sessione (EBADF) [setta errno]
+ */
+static int leggiFileRichiesto(Richiesta_V2 *r, char **pathname, const Maniglia_File **maniglia) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    void *campo = NULL;
+    size_t dim = 0;
+    uint32_t numero = 0;
+
+    /** Senza FLAG_MANIGLIA il corpo contiene il pathname **/
+    *maniglia = NULL;
+    if(!((r->intestazione).flags & FLAG_MANIGLIA)) return leggiPathname(r, pathname);
+
+    /** Traduco la maniglia **/
+    if((leggiCampo(&(r->corpo), &campo, &dim) == -1) || (dim != sizeof(uint32_t))) { errno = EBADMSG; return -1; }
+    memcpy(&numero, campo, sizeof(uint32_t));
+    if((numero == 0) || (numero > sessione->numeroManiglie) || ((sessione->maniglie)[numero-1].pathname == NULL)) { errno = EBADF; return -1; }
+    *pathname = (sessione->maniglie)[numero-1].pathname;
+    *maniglia = &((sessione->maniglie)[numero-1].file);
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Da' al client una maniglia per il file: se ne aveva gia' una per lo stesso pathname
+ *                          viene aggiornata, altrimenti prende la prima posizione libera della tabella
+ * @fun                     assegnaManiglia
+ * @param sessione          Sessione del client
+ * @param pathname          Pathname del file
+ * @param file              Maniglia del file nella cache
+ * @return                  Ritorna il numero della maniglia; (0) in caso di errore [setta errno]
+ */
+static uint32_t assegnaManiglia(Sessione *sessione, const char *pathname, const Maniglia_File *file) {
+    /** Variabili **/
+    unsigned int i = 0, libera = sessione->numeroManiglie;
+    Maniglia_Sessione *nuove = NULL;
+
+    /** Cerco il pathname o una posizione libera **/
+    for(i = 0; i < sessione->numeroManiglie; i++) {
+        if((sessione->maniglie)[i].pathname == NULL) {
+            if(libera == sessione->numeroManiglie) libera = i;
+        } else if(strncmp((sessione->maniglie)[i].pathname, pathname, MAX_PATHNAME) == 0) {
+            (sessione->maniglie)[i].file = *file;
+            return i+1;
+        }
+    }
+
+    /** Tabella piena: la raddoppio **/
+    if(libera == sessione->numeroManiglie) {
+        if((nuove = (Maniglia_Sessione *) realloc(sessione->maniglie, ((sessione->numeroManiglie == 0) ? 8 : 2*sessione->numeroManiglie)*sizeof(Maniglia_Sessione))) == NULL) {
+            return 0;
+        }
+        sessione->maniglie = nuove;
+        sessione->numeroManiglie = (sessione->numeroManiglie == 0) ? 8 : 2*sessione->numeroManiglie;
+        memset(sessione->maniglie + libera, 0, (sessione->numeroManiglie - libera)*sizeof(Maniglia_Sessione));
+    }
+    if(((sessione->maniglie)[libera].pathname = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
+        return 0;
+    }
+    strncpy((sessione->maniglie)[libera].pathname, pathname, strnlen(pathname, MAX_PATHNAME)+1);
+    (sessione->maniglie)[libera].file = *file;
+
+    return libera+1;
+}
+
+
+/**
+ * @brief                   Ritira la maniglia del client per un file che ha chiuso o rimosso
+ * @fun                     ritiraManiglia
+ * @param sessione          Sessione del client
+ * @param pathname          Pathname del file
+ */
+static void ritiraManiglia(Sessione *sessione, const char *pathname) {
+    /** Al piu' una maniglia per pathname **/
+    for(unsigned int i = 0; i < sessione->numeroManiglie; i++) {
+        if(((sessione->maniglie)[i].pathname != NULL) && (strncmp((sessione->maniglie)[i].pathname, pathname, MAX_PATHNAME) == 0)) {
+            free((sessione->maniglie)[i].pathname), (sessione->maniglie)[i].pathname = NULL;
+            return;
+        }
+    }
+}
+
+
+/**
+ * @brief                   Prepara i campi (pathname e contenuto) per spedire una lista di file
+ * @fun                     campiFile
+ * @param files             Lista di file terminata da NULL
+ * @param numero            Numero di file nella lista
+ * @return                  Ritorna i campi da spedire; NULL in caso di errore [setta errno]
+ */
+static Campo* campiFile(myFile **files, size_t *numero) {
+    /** Variabili **/
+    Campo *campi = NULL;
+    size_t n = 0;
+
+    /** Conto i file e preparo i campi **/
+    while((files != NULL) && (files[n] != NULL)) n++;
+    *numero = n;
+    if((campi = (Campo *) malloc((2*n+1)*sizeof(Campo))) == NULL) return NULL;
+    for(size_t i=0; i<n; i++) {
+        campi[2*i].dati = files[i]->pathname;
+        campi[2*i].dimensione = strnlen(files[i]->pathname, MAX_PATHNAME)+1;
+        campi[2*i+1].dati = files[i]->buffer;
+        campi[2*i+1].dimensione = files[i]->size;
+    }
+
+    return campi;
+}
+
+
+/**
+ * @brief                   Libera una lista di file terminata da NULL
+ * @fun                     liberaFile
+ * @param files             Lista di file
+ * @return                  Ritorna la somma delle dimensioni dei file liberati
+ */
+static size_t liberaFile(myFile **files) {
+    /** Variabili **/
+    size_t totale = 0;
+    int index = -1;
+
+    /** Libero **/
+    if(files == NULL) return 0;
+    while(files[++index] != NULL) {
+        totale += files[index]->size;
+        destroyFile(&(files[index]));
+    }
+    free(files);
+
+    return totale;
+}
+
+
+/**
+ * @brief                   Rinvia la notifica dei file espulsi da un'operazione di una richiesta composta a dopo
+ *                          la risposta composta, prendendo possesso dei file
+ * @fun                     rinviaEspulsi
+ * @param raccolta          Risposte della richiesta composta
+ * @param files             File espulsi (lista terminata da NULL; la lista viene liberata)
+ * @param modo              ESPULSI_CONTENUTO o ESPULSI_NOMI
+ * @return                  Ritorna la somma delle dimensioni dei file; senza memoria i file vengono liberati
+ *                          e la loro notifica persa
+ */
+static size_t rinviaEspulsi(Raccolta_Risposte *raccolta, myFile **files, int modo) {
+    /** Variabili **/
+    size_t totale = 0, numero = 0;
+    myFile **nuovo = NULL;
+
+    /** Accodo i file a quelli gia' rinviati **/
+    if(files == NULL) return 0;
+    while(files[numero] != NULL) totale += files[numero++]->size;
+    if(numero == 0) {
+        free(files);
+        return 0;
+    }
+    if((nuovo = (myFile **) realloc(raccolta->espulsi, (raccolta->numeroEspulsi + numero + 1)*sizeof(myFile *))) == NULL) return liberaFile(files);
+    memcpy(nuovo + raccolta->numeroEspulsi, files, (numero + 1)*sizeof(myFile *));
+    raccolta->espulsi = nuovo, raccolta->numeroEspulsi += numero, raccolta->modoEspulsi = modo;
+    free(files);
+
+    return totale;
+}
+
+
+/**
+ * @brief                   Risveglia un client in attesa di una lock: in una richiesta composta il risveglio
+ *                          viene rinviato a dopo la risposta composta (senza memoria per rinviarlo parte subito)
+ * @fun                     risvegliaAttesa
+ * @param r                 Richiesta che libera la lock
+ * @param fd                FD del client da risvegliare
+ * @param pathname          File di cui il client riceve la lock
+ * @param esito             Esito da comunicare
+ * @return                  Ritorna il numero di bytes scritti (0 se rinviato); -1 in caso di errore [setta errno]
+ */
+static ssize_t risvegliaAttesa(Richiesta_V2 *r, int fd, const char *pathname, int esito) {
+    /** Variabili **/
+    Raccolta_Risposte *raccolta = r->raccolta;
+    Risveglio *nuovo = NULL;
+    char *copia = NULL;
+
+    /** Rinvio il risveglio **/
+    if((raccolta != NULL) && ((copia = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) != NULL)) {
+        if((nuovo = (Risveglio *) realloc(raccolta->risvegli, (raccolta->numeroRisvegli + 1)*sizeof(Risveglio))) != NULL) {
+            strncpy(copia, pathname, strnlen(pathname, MAX_PATHNAME)+1);
+            nuovo[raccolta->numeroRisvegli].fd = fd;
+            nuovo[raccolta->numeroRisvegli].pathname = copia;
+            nuovo[raccolta->numeroRisvegli].esito = esito;
+            raccolta->risvegli = nuovo, raccolta->numeroRisvegli++;
+            return 0;
+        }
+        free(copia);
+    }
+
+    return rispondiAttesa((r->tp)->sessioni, fd, pathname, esito);
+}
+
+
+/**
+ * @brief                   Gestore v2 di openFile: il corpo contiene il pathname, i flag sono nell'intestazione.
+ *                          Con FLAG_MANIGLIA (solo per i file gia' nella cache) la risposta contiene la maniglia
+ *                          (uint32_t) con cui il client puo' indicare il file nelle richieste successive
+ * @fun                     gestisciOpenFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciOpenFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int flags = (r->intestazione).flags & ~FLAG_MANIGLIA, res = -1, esito = 0;
+    LRU_Memory *cache = (r->tp)->cache;
+    Maniglia_File file;
+    uint32_t numero = 0;
+    Campo maniglia;
+
+    /** Eseguo l'apertura **/
+    if(leggiPathname(r, &pathname) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    switch(flags) {
+        case 0:
+            if((res = openFileOnCache(cache, pathname, r->fd)) == -1) esito = codiceErrore();
+        break;
+
+        case O_CREATE:
+        case O_CREATE | O_LOCK:
+            if((res = createFileToInsert(cache, pathname, cache->maxUtentiPerFile, r->fd, (flags == (O_CREATE | O_LOCK)))) == -1) esito = codiceErrore();
+        break;
+
+        default:
+            esito = EINVAL;
+    }
+
+    /** Maniglia del file **/
+    if((esito == 0) && ((r->intestazione).flags & FLAG_MANIGLIA)) {
+        if(flags != 0) {
+            esito = EINVAL;
+        } else if((handleOnCache(cache, pathname, r->fd, &file) == -1) || ((numero = assegnaManiglia(((r->tp)->sessioni) + r->fd, pathname, &file)) == 0)) {
+            esito = codiceErrore();
+        }
+    }
+
+    /** Log e risposta **/
+    if(esito == 0) {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: %s\n", r->thread, r->fd, pathname, stringaFlags(flags), (res == 1) ? "già eseguita" : "eseguita correttamente")
+    } else {
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, stringaFlags(flags), errorMsg)
+    }
+    if(numero != 0) {
+        maniglia.dati = &numero, maniglia.dimensione = sizeof(uint32_t);
+        return rispondiV2(r, esito, 0, &maniglia, 1);
+    }
+
+    return rispondiV2(r, esito, 0, NULL, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di readFile: il corpo contiene il pathname (o la maniglia), la risposta il
+ *                          contenuto del file; con FLAG_DESCRITTORE i file oltre la soglia vengono consegnati come
+ *                          memfd sigillato
+ * @fun                     gestisciReadFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciReadFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    void *bufferFile = NULL;
+    size_t dimBuffer = 0;
+    uint64_t dimCopia = 0;
+    int esito = 0, copia = -1;
+    const Maniglia_File *maniglia = NULL;
+    Campo contenuto;
+
+    /** Leggo il file **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s\n", r->thread, r->fd, pathname)
+
+    /** I file oltre la soglia vengono consegnati come memfd sigillato, senza copiarli sul socket **/
+    if(((r->intestazione).flags & FLAG_DESCRITTORE) && !(((r->tp)->sessioni)[r->fd].remota) && ((copia = shareFileOnCache((r->tp)->cache, pathname, r->fd, &dimBuffer, maniglia)) != -1)) {
+        dimCopia = (uint64_t) dimBuffer;
+        contenuto.dati = &dimCopia, contenuto.dimensione = sizeof(uint64_t);
+        if(rispondiV2ConDescrittore(r, 0, 0, 0, &contenuto, 1, copia) == -1) {
+            close(copia);
+            return -1;
+        }
+        close(copia);
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s - ESITO: eseguita correttamente (memfd)\n", r->thread, r->fd, pathname)
+        LOG_V2(r, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", r->thread, r->fd, (long) dimBuffer)
+        return 0;
+    }
+    errno = 0;
+    if((dimBuffer = readRangeOnCache((r->tp)->cache, pathname, r->fd, 0, 0, &bufferFile, NULL, maniglia)) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+
+    /** Spedisco il contenuto **/
+    contenuto.dati = bufferFile, contenuto.dimensione = dimBuffer;
+    if(rispondiV2(r, 0, 0, &contenuto, 1) == -1) {
+        free(bufferFile);
+        return -1;
+    }
+    free(bufferFile);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", r->thread, r->fd, (long) dimBuffer)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Gestore v2 di readFileRange: il corpo contiene pathname (o maniglia), offset e lunghezza (uint64_t);
+ *                          la risposta la dimensione attuale del file (uint64_t) e i bytes letti
+ * @fun                     gestisciReadFileRange
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciReadFileRange(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    void *bufferFile = NULL, *campo = NULL;
+    size_t dimBuffer = 0, dimTotale = 0, dim = 0;
+    uint64_t offset = 0, lunghezza = 0, totale = 0;
+    int esito = 0;
+    Campo campi[2];
+    const Maniglia_File *maniglia = NULL;
+
+    /** Leggo la porzione del file **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    if((leggiCampo(&(r->corpo), &campo, &dim) == -1) || (dim != sizeof(uint64_t))) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    memcpy(&offset, campo, sizeof(uint64_t));
+    if((leggiCampo(&(r->corpo), &campo, &dim) == -1) || (dim != sizeof(uint64_t))) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    memcpy(&lunghezza, campo, sizeof(uint64_t));
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFileRange - FILE: %s - OFFSET: %lu - LUNGHEZZA: %lu\n", r->thread, r->fd, pathname, (unsigned long) offset, (unsigned long) lunghezza)
+    errno = 0;
+    if((dimBuffer = readRangeOnCache((r->tp)->cache, pathname, r->fd, (size_t) offset, (size_t) lunghezza, &bufferFile, &dimTotale, maniglia)) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFileRange - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+
+    /** Spedisco dimensione del file e bytes letti **/
+    totale = (uint64_t) dimTotale;
+    campi[0].dati = &totale, campi[0].dimensione = sizeof(uint64_t);
+    campi[1].dati = bufferFile, campi[1].dimensione = dimBuffer;
+    if(rispondiV2(r, 0, 0, campi, 2) == -1) {
+        if(bufferFile != NULL) free(bufferFile);
+        return -1;
+    }
+    if(bufferFile != NULL) free(bufferFile);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFileRange - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", r->thread, r->fd, (long) dimBuffer)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Gestore v2 di readNFiles: il corpo contiene N, la risposta le coppie pathname-contenuto
+ * @fun                     gestisciReadNFiles
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciReadNFiles(Richiesta_V2 *r) {
+    /** Variabili **/
+    int *campoN = NULL, N = 0, esito = 0;
+    char errorMsg[MAX_BUFFER_LEN];
+    size_t dim = 0, numero = 0, letti = 0;
+    myFile **readFiles = NULL;
+    Campo *campi = NULL;
+
+    /** Leggo N e i file **/
+    if((leggiCampo(&(r->corpo), (void **) &campoN, &dim) == -1) || (dim != sizeof(int))) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    memcpy(&N, campoN, sizeof(int));
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles\n", r->thread, r->fd)
+    errno = 0;
+    readFiles = readsRandFiles((r->tp)->cache, r->fd, &N);
+    if(errno != 0) {
+        esito = errno;
+        liberaFile(readFiles);
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+
+    /** Spedisco tutti i file in un'unica risposta **/
+    if((campi = campiFile(readFiles, &numero)) == NULL) {
+        liberaFile(readFiles);
+        return rispondiV2(r, ENOMEM, 0, NULL, 0);
+    }
+    if(rispondiV2(r, 0, (uint32_t) numero, campi, 2*numero) == -1) {
+        free(campi);
+        liberaFile(readFiles);
+        return -1;
+    }
+    free(campi);
+    letti = liberaFile(readFiles);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: eseguita correttamente\n", r->thread, r->fd)
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", r->thread, r->fd, (long) letti)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Gestore v2 di readFiles: il corpo contiene i pathname dei file, la risposta per ogni file
+ *                          (nell'ordine della richiesta) l'esito della lettura e il contenuto
+ * @fun                     gestisciReadFiles
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciReadFiles(Richiesta_V2 *r) {
+    /** Variabili **/
+    char **pathnames = NULL, errorMsg[MAX_BUFFER_LEN];
+    int *esiti = NULL, esito = 0;
+    size_t numero = 0, letti = 0, dim = 0;
+    void *dati = NULL;
+    myFile **readFiles = NULL;
+    Campo *campi = NULL;
+    Corpo conteggio = r->corpo;
+    Arena *arena = &(((r->tp)->sessioni)[r->fd].ricezione);
+
+    /** Conto i pathname e li leggo (gli array stanno nell'arena della richiesta) **/
+    while(conteggio.letti < conteggio.dimensione) {
+        if(leggiCampo(&conteggio, &dati, &dim) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+        numero++;
+    }
+    if(numero == 0) return rispondiV2(r, EINVAL, 0, NULL, 0);
+    if(((pathnames = (char **) allocaArena(arena, numero*sizeof(char *))) == NULL) ||
+       ((esiti = (int *) allocaArena(arena, numero*sizeof(int))) == NULL) ||
+       ((campi = (Campo *) allocaArena(arena, 2*numero*sizeof(Campo))) == NULL)) {
+        return rispondiV2(r, ENOMEM, 0, NULL, 0);
+    }
+    for(size_t i=0; i<numero; i++) {
+        if(leggiPathname(r, pathnames+i) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    }
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFiles - FILE RICHIESTI: %ld\n", r->thread, r->fd, (long) numero)
+
+    /** Leggo i file **/
+    errno = 0;
+    if((readFiles = readListOnCache((r->tp)->cache, r->fd, pathnames, numero, esiti)) == NULL) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFiles - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+
+    /** Spedisco esito e contenuto di ogni file in un'unica risposta **/
+    for(size_t i=0; i<numero; i++) {
+        campi[2*i].dati = esiti+i;
+        campi[2*i].dimensione = sizeof(int);
+        campi[2*i+1].dati = (readFiles[i] != NULL) ? readFiles[i]->buffer : NULL;
+        campi[2*i+1].dimensione = (readFiles[i] != NULL) ? readFiles[i]->size : 0;
+    }
+    esito = rispondiV2(r, 0, (uint32_t) numero, campi, 2*numero);
+    for(size_t i=0; i<numero; i++) {
+        if(readFiles[i] == NULL) continue;
+        letti += readFiles[i]->size;
+        destroyFile(readFiles+i);
+        if((esito == 0) && (traceOnLog((r->tp)->log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFiles - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathnames[i]) == -1)) {
+            esito = -1;
+        }
+    }
+    free(readFiles);
+    if(esito == -1) return -1;
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", r->thread, r->fd, (long) letti)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Salva i file espulsi nella cartella registrata dal client, ognuno con il nome finale
+ *                          del suo pathname (i file vuoti non vengono salvati, come fa il client)
+ * @fun                     salvaEspulsi
+ * @param r                 Richiesta
+ * @param kickedFiles       File espulsi (lista terminata da NULL)
+ * @return                  Ritorna (1) se tutti i file sono stati salvati; (0) se il client non ha registrato
+ *                          una cartella o un salvataggio e' fallito (i file vanno spediti)
+ */
+static int salvaEspulsi(Richiesta_V2 *r, myFile **kickedFiles) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    int cartella = -1, file = -1, salvati = 1;
+    const char *nome = NULL;
+
+    /** Duplico la cartella: il client puo' sostituirla mentre scrivo **/
+    if((kickedFiles == NULL) || (kickedFiles[0] == NULL)) return 0;
+    if(pthread_mutex_lock(sessione->accesso) != 0) return 0;
+    if(sessione->cartellaEspulsi >= 0) cartella = dup(sessione->cartellaEspulsi);
+    pthread_mutex_unlock(sessione->accesso);
+    if(cartella == -1) return 0;
+
+    /** Scrivo ogni file direttamente nella cartella **/
+    for(int i=0; salvati && (kickedFiles[i] != NULL); i++) {
+        if(kickedFiles[i]->size == 0) continue;
+        nome = ((nome = strrchr(kickedFiles[i]->pathname, '/')) == NULL) ? kickedFiles[i]->pathname : nome+1;
+        if((*nome == '\0') || (strcmp(nome, ".") == 0) || (strcmp(nome, "..") == 0)) { salvati = 0; break; }
+        if((file = openat(cartella, nome, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0666)) == -1) { salvati = 0; break; }
+        if(writen(file, kickedFiles[i]->buffer, kickedFiles[i]->size) != kickedFiles[i]->size) salvati = 0;
+        if(close(file) == -1) salvati = 0;
+    }
+    close(cartella);
+
+    return salvati;
+}
+
+
+/**
+ * @brief                   Prepara i campi con i soli pathname di una lista di file
+ * @fun                     campiNomi
+ * @param files             Lista di file terminata da NULL
+ * @param numero            Numero di file nella lista
+ * @return                  Ritorna i campi da spedire; NULL in caso di errore [setta errno]
+ */
+static Campo* campiNomi(myFile **files, size_t *numero) {
+    /** Variabili **/
+    Campo *campi = NULL;
+    size_t n = 0;
+
+    /** Conto i file e preparo i campi **/
+    while((files != NULL) && (files[n] != NULL)) n++;
+    *numero = n;
+    if((campi = (Campo *) malloc((n+1)*sizeof(Campo))) == NULL) return NULL;
+    for(size_t i=0; i<n; i++) {
+        campi[i].dati = files[i]->pathname;
+        campi[i].dimensione = strnlen(files[i]->pathname, MAX_PATHNAME)+1;
+    }
+
+    return campi;
+}
+
+
+/**
+ * @brief                   Spedisce i file espulsi da una scrittura in una notifica separata, dopo la risposta: il
+ *                          corpo contiene pathname e contenuto (ESPULSI_CONTENUTO) oppure solo i pathname
+ *                          (ESPULSI_NOMI, o file gia' salvati nella cartella registrata)
+ * @fun                     notificaEspulsi
+ * @param r                 Richiesta che ha causato le espulsioni
+ * @param kickedFiles       File espulsi (lista terminata da NULL)
+ * @param modo              ESPULSI_CONTENUTO o ESPULSI_NOMI
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int notificaEspulsi(Richiesta_V2 *r, myFile **kickedFiles, int modo) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    Intestazione_Risposta notifica;
+    Campo *campi = NULL;
+    size_t numero = 0;
+    ssize_t bytes = -1;
+    int salvati = 0;
+
+    /** Preparo la notifica: senza memoria per i contenuti il client riceve almeno i nomi **/
+    if((kickedFiles == NULL) || (kickedFiles[0] == NULL)) return 0;
+    salvati = (modo == ESPULSI_CONTENUTO) && salvaEspulsi(r, kickedFiles);
+    if(!salvati && (modo == ESPULSI_CONTENUTO) && ((campi = campiFile(kickedFiles, &numero)) == NULL)) modo = ESPULSI_NOMI;
+    if((campi == NULL) && ((campi = campiNomi(kickedFiles, &numero)) == NULL)) {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - Memoria esaurita: notifica dei file espulsi non spedita\n", r->thread, r->fd)
+        return 0;
+    }
+    memset(&notifica, 0, sizeof(Intestazione_Risposta));
+    notifica.opcode = OP_ESPULSIONI;
+    notifica.flags = (salvati) ? FLAG_SALVATI : ((modo == ESPULSI_NOMI) ? FLAG_NOMI : 0);
+    notifica.id = ID_NOTIFICA;
+    notifica.numero = (uint32_t) numero;
+
+    /** La spedisco **/
+    if(pthread_mutex_lock(sessione->accesso) != 0) {
+        free(campi);
+        errno = ECOMM;
+        return -1;
+    }
+    bytes = inviaRispostaSessione(sessione, r->fd, &notifica, campi, (notifica.flags) ? numero : 2*numero, -1);
+    pthread_mutex_unlock(sessione->accesso);
+    free(campi);
+    if(bytes <= 0) {
+        errno = ECOMM;
+        return -1;
+    }
+    r->bytesScritti += bytes;
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - Notifica di %ld file espulsi\n", r->thread, r->fd, (long) numero)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Spedisce l'esito di una scrittura insieme ai file espulsi dalla cache; se il client si e'
+ *                          iscritto alle espulsioni (OP_ESPULSIONI) l'esito parte subito e i file dopo, o mai
+ * @fun                     rispondiScrittura
+ * @param r                 Richiesta
+ * @param nomeOperazione    Nome dell'operazione per il log
+ * @param pathname          File scritto
+ * @param kickedFiles       File espulsi (lista terminata da NULL; viene liberata)
+ * @param esito             Esito della scrittura
+ * @param scritti           Bytes scritti nella cache
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int rispondiScrittura(Richiesta_V2 *r, const char *nomeOperazione, const char *pathname, myFile **kickedFiles, int esito, size_t scritti) {
+    /** Variabili **/
+    char errorMsg[MAX_BUFFER_LEN];
+    size_t numero = 0, rimossi = 0;
+    int index = -1, salvati = 0, rinvia = 0, modo = ESPULSI_IN_RISPOSTA;
+    uint16_t flags = 0;
+    Campo *campi = NULL;
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+
+    /** Iscrizione alle espulsioni: l'esito non aspetta i file espulsi. In una richiesta composta la notifica
+        parte dopo la risposta composta **/
+    if(pthread_mutex_lock(sessione->accesso) == 0) {
+        modo = sessione->espulsioni;
+        pthread_mutex_unlock(sessione->accesso);
+    }
+    if(modo != ESPULSI_IN_RISPOSTA) {
+        rinvia = (modo != ESPULSI_SCARTA) && (r->raccolta != NULL);
+        if((rispondiV2(r, esito, 0, NULL, 0) == -1) || ((modo != ESPULSI_SCARTA) && !rinvia && (notificaEspulsi(r, kickedFiles, modo) == -1))) {
+            liberaFile(kickedFiles);
+            return -1;
+        }
+    } else {
+        /** Spedisco esito e file espulsi in un'unica risposta: se il client ha registrato una cartella li salvo io
+            e spedisco solo i loro nomi. La scrittura e' gia' avvenuta, quindi senza memoria per i contenuti parte
+            l'esito vero con i soli nomi (FLAG_NOMI), o al limite senza i file **/
+        salvati = salvaEspulsi(r, kickedFiles);
+        flags = (salvati) ? FLAG_SALVATI : 0;
+        campi = (salvati) ? campiNomi(kickedFiles, &numero) : campiFile(kickedFiles, &numero);
+        if((campi == NULL) && !salvati && ((campi = campiNomi(kickedFiles, &numero)) != NULL)) flags = FLAG_NOMI;
+        if(campi == NULL) {
+            numero = 0;
+            LOG_V2(r, "[THREAD %d]: CLIENT: %d - Memoria esaurita: file espulsi non spediti\n", r->thread, r->fd)
+        }
+        if(rispondiV2ConDescrittore(r, flags, esito, (uint32_t) numero, campi, (flags) ? numero : 2*numero, -1) == -1) {
+            free(campi);
+            liberaFile(kickedFiles);
+            return -1;
+        }
+        free(campi);
+    }
+    while((kickedFiles != NULL) && (kickedFiles[++index] != NULL)) {
+        if(traceOnLog((r->tp)->log, "[THREAD %d]: CLIENT: %d - RICHIESTA: %s - FILE: %s - ESITO: espulsione file - KICK-FILE: %s\n", r->thread, r->fd, nomeOperazione, pathname, kickedFiles[index]->pathname) == -1) {
+            liberaFile(kickedFiles);
+            return -1;
+        }
+    }
+    rimossi = (rinvia) ? rinviaEspulsi(r->raccolta, kickedFiles, modo) : liberaFile(kickedFiles);
+
+    /** Log dell'esito **/
+    if(esito == 0) {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: %s - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, nomeOperazione, pathname)
+    } else {
+        scritti = 0;
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: %s - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, nomeOperazione, pathname, errorMsg)
+    }
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - RIMOSSI: %ldB - SCRITTI: %ldB\n", r->thread, r->fd, (long) rimossi, (long) scritti)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Gestore v2 di writeFile: il corpo contiene il pathname, la risposta i file espulsi
+ * @fun                     gestisciWriteFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciWriteFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL;
+    myFile **kickedFiles = NULL;
+    int esito = 0;
+
+    /** Aggiungo il file alla cache **/
+    if(leggiPathname(r, &pathname) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: writeFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    kickedFiles = addFileOnCache((r->tp)->cache, pathname, r->fd, 1), esito = errno;
+
+    return rispondiScrittura(r, "writeFile", pathname, kickedFiles, esito, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di appendToFile: il corpo contiene pathname (o maniglia) e dati, la risposta
+ *                          i file espulsi
+ * @fun                     gestisciAppendToFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciAppendToFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL;
+    void *dati = NULL;
+    size_t dimDati = 0;
+    myFile **kickedFiles = NULL;
+    int esito = 0;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Aggiorno il file nella cache **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    if(leggiCampo(&(r->corpo), &dati, &dimDati) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: appendToFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    kickedFiles = appendFile((r->tp)->cache, pathname, r->fd, dati, dimDati, maniglia), esito = errno;
+
+    return rispondiScrittura(r, "appendToFile", pathname, kickedFiles, esito, dimDati);
+}
+
+
+/**
+ * @brief                   Gestore v2 di writeAt: il corpo contiene pathname (o maniglia), offset (uint64_t) e dati;
+ *                          la risposta i file espulsi
+ * @fun                     gestisciWriteAt
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciWriteAt(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL;
+    void *dati = NULL, *campo = NULL;
+    size_t dimDati = 0, dim = 0;
+    uint64_t offset = 0;
+    myFile **kickedFiles = NULL;
+    int esito = 0;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Scrivo nel file **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    if((leggiCampo(&(r->corpo), &campo, &dim) == -1) || (dim != sizeof(uint64_t))) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    memcpy(&offset, campo, sizeof(uint64_t));
+    if(leggiCampo(&(r->corpo), &dati, &dimDati) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: writeAt - FILE: %s - OFFSET: %lu\n", r->thread, r->fd, pathname, (unsigned long) offset)
+    errno = 0;
+    kickedFiles = writeAtOnCache((r->tp)->cache, pathname, r->fd, (size_t) offset, dati, dimDati, maniglia), esito = errno;
+
+    return rispondiScrittura(r, "writeAt", pathname, kickedFiles, esito, dimDati);
+}
+
+
+/**
+ * @brief                   Controlla che il client connesso su 'fd' possa scrivere nella cartella: il server vi crea e
+ *                          tronca file con i propri permessi, quindi la cartella deve essere del client (o il client
+ *                          deve essere root) oppure scrivibile dal suo gruppo o da tutti, senza sticky bit
+ * @fun                     cartellaDelClient
+ * @param fd                FD del client (socket AF_UNIX)
+ * @param info              Stato della cartella
+ * @return                  Ritorna (1) se il client puo' scriverci; (0) altrimenti o se le sue credenziali non sono note
+ */
+static int cartellaDelClient(int fd, const struct stat *info) {
+    /** Variabili **/
+    uid_t uid = 0;
+    gid_t gid = 0;
+
+    /** Credenziali del client **/
+    if(credenzialiPeer(fd, &uid, &gid) == -1) return 0;
+    if((uid == 0) || (uid == info->st_uid)) return 1;
+    if(info->st_mode & S_ISVTX) return 0;
+
+    return ((gid == info->st_gid) && (info->st_mode & S_IWGRP)) || (info->st_mode & S_IWOTH);
+}
+
+
+/**
+ * @brief                   Gestore v2 di registerDir: con FLAG_DESCRITTORE la cartella passata dal client diventa
+ *                          quella in cui il server salva i file espulsi dalle sue scritture (EACCES se il client non
+ *                          potrebbe scriverci da se'); senza la registrazione viene annullata
+ * @fun                     gestisciRegisterDir
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciRegisterDir(Richiesta_V2 *r) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    struct stat info;
+    int precedente = -1;
+
+    /** Controllo la cartella **/
+    if(((r->intestazione).flags & FLAG_DESCRITTORE) && (r->descrittore < 0)) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    if((r->descrittore >= 0) && (fstat(r->descrittore, &info) == -1)) return rispondiV2(r, codiceErrore(), 0, NULL, 0);
+    if((r->descrittore >= 0) && !S_ISDIR(info.st_mode)) return rispondiV2(r, ENOTDIR, 0, NULL, 0);
+    if((r->descrittore >= 0) && !cartellaDelClient(r->fd, &info)) return rispondiV2(r, EACCES, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: registerDir - %s\n", r->thread, r->fd, (r->descrittore >= 0) ? "registrata" : "annullata")
+
+    /** Sostituisco la cartella della sessione (il descrittore passa alla sessione) **/
+    if(pthread_mutex_lock(sessione->accesso) != 0) return rispondiV2(r, ECOMM, 0, NULL, 0);
+    precedente = sessione->cartellaEspulsi;
+    sessione->cartellaEspulsi = r->descrittore, r->descrittore = -1;
+    pthread_mutex_unlock(sessione->accesso);
+    if(precedente >= 0) close(precedente);
+
+    return rispondiV2(r, 0, 0, NULL, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di OP_ANELLI: mappa gli anelli nel memfd passato dal client e risponde con il
+ *                          campanello (eventfd) che il client suona dopo ogni richiesta scritta nell'anello. Da questa
+ *                          risposta in poi richieste e risposte passano dagli anelli; il socket resta per i frame
+ *                          grandi, per i descrittori e per la chiusura. I client TCP e quelli del socket
+ *                          SOCK_SEQPACKET ricevono ENOTSUP
+ * @fun                     gestisciAnelli
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciAnelli(Richiesta_V2 *r) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    Intestazione_Risposta risposta;
+    Anelli *anelli = NULL;
+    int campanello = -1, esito = 0;
+    ssize_t bytes = -1;
+
+    /** Controllo e mappo il memfd **/
+    if(sessione->remota || sessione->pacchetti) return rispondiV2(r, ENOTSUP, 0, NULL, 0);
+    if(r->descrittore < 0) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    if(sessione->anelli != NULL) return rispondiV2(r, EALREADY, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: anelli in memoria condivisa\n", r->thread, r->fd)
+    if((anelli = mappaAnelli(r->descrittore)) == NULL) return rispondiV2(r, codiceErrore(), 0, NULL, 0);
+    if((campanello = creaCampanello()) == -1) {
+        esito = codiceErrore();
+        smappaAnelli(&anelli);
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+
+    /** Rispondo sul socket e attivo gli anelli senza rilasciare accesso: le risposte successive passano dagli anelli **/
+    memset(&risposta, 0, sizeof(Intestazione_Risposta));
+    risposta.opcode = (r->intestazione).opcode;
+    risposta.flags = FLAG_DESCRITTORE;
+    risposta.id = (r->intestazione).id;
+    if(pthread_mutex_lock(sessione->accesso) != 0) {
+        smappaAnelli(&anelli), close(campanello);
+        errno = ECOMM;
+        return -1;
+    }
+    if((bytes = inviaRispostaConDescrittore(r->fd, &risposta, NULL, 0, campanello)) > 0) {
+        sessione->anelli = anelli, sessione->campanello = campanello;
+    }
+    pthread_mutex_unlock(sessione->accesso);
+    if(bytes <= 0) {
+        smappaAnelli(&anelli), close(campanello);
+        errno = ECOMM;
+        return -1;
+    }
+    r->bytesScritti += bytes;
+    LOG_V2(r, "[THREAD %d]: Spedisco dati al client\n", r->thread)
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Gestore v2 di publishFile: pubblica il file nel segmento condiviso
+ * @fun                     gestisciPublishFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciPublishFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int esito = 0;
+
+    /** Pubblico il file **/
+    if(leggiPathname(r, &pathname) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: publishFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    if(publishFileOnCache((r->tp)->cache, pathname, r->fd) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: publishFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: publishFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+
+    return rispondiV2(r, 0, 0, NULL, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di OP_ESPULSIONI: imposta come consegnare al client i file espulsi dalle sue
+ *                          scritture (modalita' ESPULSI_* nei flag della richiesta)
+ * @fun                     gestisciEspulsioni
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciEspulsioni(Richiesta_V2 *r) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    int modo = (int) (r->intestazione).flags;
+
+    /** Imposto la modalita' **/
+    if((modo != ESPULSI_IN_RISPOSTA) && (modo != ESPULSI_CONTENUTO) && (modo != ESPULSI_NOMI) && (modo != ESPULSI_SCARTA)) return rispondiV2(r, EINVAL, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: iscrizione alle espulsioni - MODALITA': %d\n", r->thread, r->fd, modo)
+    if(pthread_mutex_lock(sessione->accesso) != 0) return rispondiV2(r, ECOMM, 0, NULL, 0);
+    sessione->espulsioni = modo;
+    pthread_mutex_unlock(sessione->accesso);
+
+    return rispondiV2(r, 0, 0, NULL, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di OP_SEGMENTO: risponde con il memfd del segmento condiviso, che il client
+ *                          puo' mappare solo in lettura (ENOTSUP se il segmento e' disattivato o il client e' via TCP)
+ * @fun                     gestisciSegmento
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciSegmento(Richiesta_V2 *r) {
+    /** Variabili **/
+    Segmento *segmento = ((r->tp)->cache)->segmento;
+
+    /** Consegno il segmento **/
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: segmento condiviso - %s\n", r->thread, r->fd, (segmento != NULL) ? "consegnato" : "disattivato")
+    if((segmento == NULL) || ((r->tp)->sessioni)[r->fd].remota) return rispondiV2(r, ENOTSUP, 0, NULL, 0);
+
+    return rispondiV2ConDescrittore(r, 0, 0, 0, NULL, 0, segmento->descrittore);
+}
+
+
+/**
+ * @brief                   Gestore v2 di putFile: crea il file gia' completo del contenuto in un'unica richiesta
+ *                          (con O_LOCK nei flag resta aperto e in lock dal client); la risposta contiene i file espulsi
+ * @fun                     gestisciPutFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciPutFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL;
+    void *dati = NULL;
+    size_t dimDati = 0;
+    myFile **kickedFiles = NULL;
+    int esito = 0;
+
+    /** Il contenuto arriva nel corpo oppure e' il file il cui descrittore accompagna la richiesta **/
+    if(leggiPathname(r, &pathname) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    if((r->intestazione).flags & FLAG_DESCRITTORE) {
+        if(r->descrittore < 0) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: putFile (descrittore) - FILE: %s\n", r->thread, r->fd, pathname)
+        errno = 0;
+        kickedFiles = putFileFromFdOnCache((r->tp)->cache, pathname, r->fd, r->descrittore, (((r->intestazione).flags & O_LOCK) == O_LOCK), &dimDati), esito = errno;
+        return rispondiScrittura(r, "putFile", pathname, kickedFiles, esito, dimDati);
+    }
+    if(leggiCampo(&(r->corpo), &dati, &dimDati) == -1) return rispondiV2(r, EBADMSG, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: putFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    kickedFiles = putFileOnCache((r->tp)->cache, pathname, r->fd, dati, dimDati, (((r->intestazione).flags & O_LOCK) == O_LOCK)), esito = errno;
+
+    return rispondiScrittura(r, "putFile", pathname, kickedFiles, esito, dimDati);
+}
+
+
+/**
+ * @brief                   Gestore v2 di lockFile: se il file e' occupato la risposta arriva quando viene liberato
+ *                          (in una richiesta composta la lock fallisce invece con EBUSY)
+ * @fun                     gestisciLockFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciLockFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int res = -1, esito = 0, attendi = (r->raccolta == NULL);
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Tento la lock; la richiesta resta in attesa se il file e' di un altro client **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s\n", r->thread, r->fd, pathname)
+    if(attendi && (registraAttesa(sessione, &(r->intestazione), pathname) == -1)) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+    errno = 0;
+    if((res = lockFileOnCache((r->tp)->cache, pathname, r->fd, attendi, maniglia)) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+    } else if(res == r->fd) {
+        esito = EALREADY;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: Già eseguita\n", r->thread, r->fd, pathname)
+    } else if(res == 0) {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+    } else {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: file occupato\n", r->thread, r->fd, pathname)
+        return 0;
+    }
+    if(attendi) annullaAttesa(sessione, pathname);
+
+    return rispondiV2(r, esito, 0, NULL, 0);
+}
+
+
 /**
- * @brief       Chiusura connessione con il client
- * @macro       CLIENT_GOODBYE
+ * @brief                   Gestore v2 di unlockFile: risveglia l'eventuale client in attesa della lock
+ * @fun                     gestisciUnlockFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
  */
-#define CLIENT_GOODBYE                                              \
-    do {                                                            \
-        size_t b, tot = 0;                                          \
-        errno=0;                                                    \
-        logoutClient(cache);                                        \
-        locks = deleteClientFromCache(cache, *fd);                  \
-                                                                    \
-        if(errno == 0 && locks != NULL) {                           \
-           int i = -1;                                              \
-           while(locks[++i] != -1) {                                \
-               b = sendMSG(locks[i], (void *) &errno, sizeof(int)); \
-               if(b != -1) tot += b;                                \
-           }                                                        \
-           free(locks);                                             \
-        }                                                           \
-    } while(0)
+static int gestisciUnlockFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int res = -1, esito = 0;
+    ssize_t bytes = -1;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Effettuo la unlock **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    if((res = unlockFileOnCache((r->tp)->cache, pathname, r->fd, maniglia)) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        return rispondiV2(r, esito, 0, NULL, 0);
+    }
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+    if(rispondiV2(r, 0, 0, NULL, 0) == -1) return -1;
+
+    /** Passo la lock al client in attesa **/
+    if(res > 0) {
+        if((bytes = risvegliaAttesa(r, res, pathname, 0)) > 0) {
+            r->bytesScritti += bytes;
+            LOG_V2(r, "[THREAD %d]: Spedisco dati al client\n", r->thread)
+        }
+    }
+
+    return 0;
+}
 
 
 /**
- * @brief       Macro di supporto output sul file di log
- * @macro       LOG_PRINT_FLAGS
+ * @brief                   Gestore v2 di closeFile: risveglia l'eventuale client in attesa della lock e ritira
+ *                          la maniglia del file
+ * @fun                     gestisciCloseFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
  */
-#define LOG_PRINT_FLAGS \
-    (*flags == 0) ? "0" : ((*flags == (O_CREATE | O_LOCK)) ? "O_CREATE | O_LOCK" : "O_CREATE")
+static int gestisciCloseFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int res = -1, esito = 0;
+    ssize_t bytes = -1;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Chiudo il file **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    if((res = closeFileOnCache((r->tp)->cache, pathname, r->fd, maniglia)) == -1) {
+        esito = codiceErrore();
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+    } else {
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+        if((res > 0) && ((bytes = risvegliaAttesa(r, res, pathname, 0)) > 0)) {
+            r->bytesScritti += bytes;
+            LOG_V2(r, "[THREAD %d]: Spedisco dati al client\n", r->thread)
+        }
+    }
+    if((esito == 0) || (esito == ESTALE)) ritiraManiglia(((r->tp)->sessioni) + r->fd, pathname);
+
+    return rispondiV2(r, esito, 0, NULL, 0);
+}
+
+
+/**
+ * @brief                   Gestore v2 di removeFile: i client in attesa della lock ricevono ENOENT
+ * @fun                     gestisciRemoveFile
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciRemoveFile(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
+    int esito = 0, *fdAttesa = NULL;
+    size_t rimossi = 0;
+    ssize_t bytes = -1;
+    myFile *resCancellazione = NULL;
+    const Maniglia_File *maniglia = NULL;
+
+    /** Rimuovo il file **/
+    if(leggiFileRichiesto(r, &pathname, &maniglia) == -1) return rispondiV2(r, errno, 0, NULL, 0);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: removeFile - FILE: %s\n", r->thread, r->fd, pathname)
+    errno = 0;
+    resCancellazione = removeFileOnCache((r->tp)->cache, pathname, r->fd, maniglia), esito = errno;
+    if(rispondiV2(r, esito, 0, NULL, 0) == -1) {
+        destroyFile(&resCancellazione);
+        return -1;
+    }
+    if(esito != 0) {
+        destroyFile(&resCancellazione);
+        if(strerror_r(esito, errorMsg, MAX_BUFFER_LEN) != 0) return -1;
+        LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: removeFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", r->thread, r->fd, pathname, errorMsg)
+        if(esito == ESTALE) ritiraManiglia(((r->tp)->sessioni) + r->fd, pathname);
+        return 0;
+    }
+
+    /** Risveglio i client in attesa della lock sul file rimosso **/
+    if(resCancellazione != NULL) rimossi = resCancellazione->size;
+    while((resCancellazione != NULL) && (resCancellazione->utentiLocked != NULL)) {
+        if((fdAttesa = deleteFirstElement(&(resCancellazione->utentiLocked))) != NULL) {
+            if((bytes = risvegliaAttesa(r, *fdAttesa, pathname, ENOENT)) > 0) {
+                r->bytesScritti += bytes;
+                traceOnLog((r->tp)->log, "[THREAD %d]: Spedisco dati al client\n", r->thread);
+            }
+            free(fdAttesa);
+        }
+    }
+    destroyFile(&resCancellazione);
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: removeFile - FILE: %s - ESITO: eseguita correttamente\n", r->thread, r->fd, pathname)
+    LOG_V2(r, "[THREAD %d]: CLIENT %d - RIMOSSI: %ldB\n", r->thread, r->fd, (long) rimossi)
+    ritiraManiglia(((r->tp)->sessioni) + r->fd, pathname);
+
+    return 0;
+}
+
+
+static int gestisciComposta(Richiesta_V2 *);
+
+
+/**
+ * @brief               Tabella dei gestori v2, indicizzata per opcode
+ */
+static int (* const gestoriV2[NUMERO_OPCODE])(Richiesta_V2 *) = {
+    [OP_OPENFILE] = gestisciOpenFile,
+    [OP_READFILE] = gestisciReadFile,
+    [OP_READNFILES] = gestisciReadNFiles,
+    [OP_WRITEFILE] = gestisciWriteFile,
+    [OP_APPENDTOFILE] = gestisciAppendToFile,
+    [OP_LOCKFILE] = gestisciLockFile,
+    [OP_UNLOCKFILE] = gestisciUnlockFile,
+    [OP_CLOSEFILE] = gestisciCloseFile,
+    [OP_REMOVEFILE] = gestisciRemoveFile,
+    [OP_PUTFILE] = gestisciPutFile,
+    [OP_READFILES] = gestisciReadFiles,
+    [OP_READFILERANGE] = gestisciReadFileRange,
+    [OP_WRITEAT] = gestisciWriteAt,
+    [OP_REGISTERDIR] = gestisciRegisterDir,
+    [OP_ANELLI] = gestisciAnelli,
+    [OP_PUBLISHFILE] = gestisciPublishFile,
+    [OP_SEGMENTO] = gestisciSegmento,
+    [OP_ESPULSIONI] = gestisciEspulsioni,
+    [OP_COMPOSTA] = gestisciComposta
+};
+
+
+/**
+ * @brief               Operazioni ammesse in una richiesta composta: quelle sui file che non passano descrittori
+ */
+static const char operazioniComposte[NUMERO_OPCODE] = {
+    [OP_OPENFILE] = 1,
+    [OP_READFILE] = 1,
+    [OP_READNFILES] = 1,
+    [OP_WRITEFILE] = 1,
+    [OP_APPENDTOFILE] = 1,
+    [OP_LOCKFILE] = 1,
+    [OP_UNLOCKFILE] = 1,
+    [OP_CLOSEFILE] = 1,
+    [OP_REMOVEFILE] = 1,
+    [OP_PUTFILE] = 1,
+    [OP_READFILES] = 1,
+    [OP_READFILERANGE] = 1,
+    [OP_WRITEAT] = 1
+};
+
+
+/**
+ * @brief                   Conclude una richiesta composta dopo la sua risposta: spedisce in un'unica notifica i file
+ *                          espulsi dalle operazioni e risveglia, nell'ordine delle operazioni, i client a cui sono
+ *                          passate le lock. I risvegli partono anche se il client della richiesta non e' raggiungibile
+ * @fun                     concludiComposta
+ * @param r                 Richiesta composta
+ * @param raccolta          Risposte raccolte (viene svuotata)
+ * @param notifica          Se spedire la notifica dei file espulsi
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int concludiComposta(Richiesta_V2 *r, Raccolta_Risposte *raccolta, int notifica) {
+    /** Variabili **/
+    int esito = 0;
+    ssize_t bytes = -1;
+
+    /** Notifica dei file espulsi **/
+    if(notifica && (raccolta->espulsi != NULL)) esito = notificaEspulsi(r, raccolta->espulsi, raccolta->modoEspulsi);
+    liberaFile(raccolta->espulsi);
+    raccolta->espulsi = NULL, raccolta->numeroEspulsi = 0;
+
+    /** Risvegli **/
+    for(size_t i=0; i<raccolta->numeroRisvegli; i++) {
+        if((bytes = rispondiAttesa((r->tp)->sessioni, (raccolta->risvegli)[i].fd, (raccolta->risvegli)[i].pathname, (raccolta->risvegli)[i].esito)) > 0) {
+            r->bytesScritti += bytes;
+            traceOnLog((r->tp)->log, "[THREAD %d]: Spedisco dati al client\n", r->thread);
+        }
+        free((raccolta->risvegli)[i].pathname);
+    }
+    free(raccolta->risvegli);
+    raccolta->risvegli = NULL, raccolta->numeroRisvegli = 0;
+
+    return esito;
+}
+
+
+/**
+ * @brief                   Gestore v2 di una richiesta composta: esegue in ordine le operazioni del corpo nello
+ *                          stesso task, fermandosi alla prima che fallisce, e spedisce le loro risposte insieme.
+ *                          Il client riceve prima la risposta composta, poi l'eventuale notifica dei file espulsi;
+ *                          i client in attesa delle lock liberate vengono risvegliati per ultimi
+ * @fun                     gestisciComposta
+ * @param r                 Richiesta
+ * @return                  Ritorna (0) in caso di successo; (-1) se la comunicazione col client e' fallita
+ */
+static int gestisciComposta(Richiesta_V2 *r) {
+    /** Variabili **/
+    char *operazione = NULL;
+    size_t dim = 0;
+    uint32_t eseguite = 0;
+    int esito = 0;
+    Richiesta_V2 sotto;
+    Raccolta_Risposte raccolta;
+    Campo campo;
+
+    /** Controllo parametri **/
+    if(r->raccolta != NULL) return rispondiV2(r, EINVAL, 0, NULL, 0);
+    memset(&raccolta, 0, sizeof(Raccolta_Risposte));
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: composta\n", r->thread, r->fd)
+
+    /** Eseguo le operazioni **/
+    while((raccolta.esito == 0) && (leggiCampo(&(r->corpo), (void **) &operazione, &dim) != -1)) {
+        memcpy(&sotto, r, sizeof(Richiesta_V2));
+        sotto.descrittore = -1, sotto.raccolta = &raccolta, sotto.bytesLetti = 0, sotto.bytesScritti = 0;
+        if(dim < sizeof(Intestazione_Richiesta)) {
+            memset(&(sotto.corpo), 0, sizeof(Corpo));
+            esito = rispondiV2(&sotto, EINVAL, 0, NULL, 0);
+        } else {
+            memcpy(&(sotto.intestazione), operazione, sizeof(Intestazione_Richiesta));
+            (sotto.intestazione).id = (r->intestazione).id;
+            corpoAnnidato(&(sotto.corpo), operazione + sizeof(Intestazione_Richiesta), dim - sizeof(Intestazione_Richiesta));
+            if(eseguite >= OPERAZIONI_COMPOSTE_MASSIME) esito = rispondiV2(&sotto, E2BIG, 0, NULL, 0);
+            else if(((sotto.intestazione).opcode >= NUMERO_OPCODE) || !operazioniComposte[(sotto.intestazione).opcode] || ((sotto.intestazione).flags & FLAG_DESCRITTORE)) esito = rispondiV2(&sotto, EINVAL, 0, NULL, 0);
+            else esito = gestoriV2[(sotto.intestazione).opcode](&sotto);
+        }
+        if(esito == -1) {
+            free(raccolta.buffer);
+            concludiComposta(r, &raccolta, 0);
+            return -1;
+        }
+        eseguite++;
+    }
+
+    /** Spedisco le risposte raccolte, poi quello che le operazioni hanno rinviato **/
+    campo.dati = raccolta.buffer, campo.dimensione = raccolta.dimensione;
+    esito = rispondiV2(r, raccolta.esito, eseguite, &campo, 1);
+    free(raccolta.buffer);
+    if(concludiComposta(r, &raccolta, (esito == 0)) == -1) esito = -1;
+    LOG_V2(r, "[THREAD %d]: CLIENT: %d - RICHIESTA: composta - OPERAZIONI: %u - ESITO: %d\n", r->thread, r->fd, eseguite, raccolta.esito)
+
+    return esito;
+}
+
+
+/**
+ * @brief                       Riceve la prossima richiesta v2 del client: dal socket oppure, se la sessione ha gli
+ *                              anelli, dall'anello delle richieste (un'intestazione con FLAG_SUL_SOCKET annuncia una
+ *                              richiesta spedita sul socket)
+ * @fun                         riceviRichiestaV2
+ * @param r                     Richiesta da riempire
+ * @return                      Ritorna il numero di bytes letti; 0 se il client ha chiuso la connessione;
+ *                              -1 in caso di errore [setta errno]
+ */
+static ssize_t riceviRichiestaV2(Richiesta_V2 *r) {
+    /** Variabili **/
+    Sessione *sessione = ((r->tp)->sessioni) + r->fd;
+    ssize_t bytes = -1;
+
+    /** Dall'anello **/
+    if(sessione->anelli != NULL) {
+        if((bytes = leggiRichiestaAnello(&((sessione->anelli)->richieste), &(r->intestazione), &(r->corpo), &(sessione->ricezione))) <= 0) {
+            if(bytes == 0) errno = ECOMM;
+            return -1;
+        }
+        if(!((r->intestazione).flags & FLAG_SUL_SOCKET)) return bytes;
+    }
+
+    /** Dal socket **/
+    return riceviRichiesta(r->fd, &(r->intestazione), &(r->corpo), &(sessione->ricezione), &(r->descrittore));
+}
+
+
+/**
+ * @brief                       Raccoglie le risposte di un client TCP in segmenti pieni (TCP_CORK), oppure spedisce
+ *                              quelle raccolte
+ * @fun                         raccogliRisposte
+ * @param fd                    Client TCP
+ * @param attivo                (1) per iniziare a raccogliere; (0) per spedire
+ */
+static void raccogliRisposte(int fd, int attivo) {
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &attivo, sizeof(int));
+}
+
+
+/**
+ * @brief                       Sbircia se il client v2 ha un'altra richiesta nel socket e, se ne e' gia' arrivata
+ *                              l'intestazione, ne sceglie la corsia per quando il client tornera' al thread manager
+ * @fun                         prossimaRichiestaV2
+ * @param fd                    Client
+ * @param sessione              Sessione del client
+ * @return                      Ritorna il numero di bytes in attesa (al piu' un'intestazione); 0 se il client ha chiuso
+ *                              la connessione; -1 se non c'e' niente da leggere [setta errno]
+ */
+static ssize_t prossimaRichiestaV2(int fd, Sessione *sessione) {
+    /** Variabili **/
+    Intestazione_Richiesta intestazione;
+    ssize_t letti = recv(fd, &intestazione, sizeof(Intestazione_Richiesta), MSG_PEEK | MSG_DONTWAIT);
+
+    /** Corsia della prossima richiesta **/
+    if(letti == (ssize_t) sizeof(Intestazione_Richiesta)) sessione->corsia = corsiaOpcode(intestazione.opcode);
+    return letti;
+}
+
+
+/**
+ * @brief                       Serve una richiesta di un client che ha negoziato il protocollo v2
+ * @fun                         serviRichiestaV2
+ * @param numeroDelThread       Numero del thread che esegue la task
+ * @param tp                    Argomenti del task
+ * @return                      (NULL) in caso di successo; altrimenti riporto un messaggio di errore
+ */
+static void* serviRichiestaV2(unsigned int numeroDelThread, Task_Package *tp) {
+    /** Variabili **/
+    int esito = 0, servite = 0, anelli = 0, raccolte = 0;
+    char prossimo = 0;
+    ssize_t bytes = -1;
+    Richiesta_V2 r;
+    Sessione *sessione = (tp->sessioni) + tp->fd;
+
+    /** Con gli anelli il campanello va azzerato prima di guardarli: una richiesta scritta dopo lo risuona **/
+    if((anelli = (sessione->anelli != NULL))) azzeraCampanello(sessione->campanello);
+
+    /** Servo le richieste gia' in coda: il client puo' inviarne diverse senza attendere le risposte **/
+    do {
+        /** Con gli anelli il socket porta solo le richieste annunciate nell'anello e la chiusura della connessione **/
+        if(anelli && anelloVuoto(&((sessione->anelli)->richieste))) {
+            if(recv(tp->fd, &prossimo, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+                salutaClient(tp->cache, tp->sessioni, tp->fd);
+                close(tp->fd);
+                errno = ECOMM;
+                return (void *) &errno;
+            }
+            break;
+        }
+
+        /** Un client TCP ha altre richieste in coda: le risposte partono insieme alla fine del task **/
+        if(sessione->remota && (servite == 1)) raccogliRisposte(tp->fd, 1), raccolte = 1;
+
+        /** Ricevo la richiesta **/
+        memset(&r, 0, sizeof(Richiesta_V2));
+        r.thread = numeroDelThread, r.fd = tp->fd, r.tp = tp, r.descrittore = -1;
+        azzeraArena(&(sessione->ricezione));
+        if((bytes = riceviRichiestaV2(&r)) <= 0) {
+            salutaClient(tp->cache, tp->sessioni, r.fd);
+            close(r.fd);
+            errno = ECOMM;
+            return (void *) &errno;
+        }
+        r.bytesLetti += bytes;
+        if(traceOnLog(tp->log, "[THREAD %d]: Ricevuto dati dal client\n", numeroDelThread) == -1) {
+            if(r.descrittore >= 0) close(r.descrittore);
+            liberaCorpo(&(r.corpo));
+            salutaClient(tp->cache, tp->sessioni, r.fd);
+            close(r.fd);
+            return (void *) &errno;
+        }
+
+        /** Eseguo il gestore dell'opcode; senza altre richieste il client torna nella corsia di questa **/
+        sessione->corsia = corsiaOpcode((r.intestazione).opcode);
+        if(((r.intestazione).opcode >= NUMERO_OPCODE) || (gestoriV2[(r.intestazione).opcode] == NULL)) esito = rispondiV2(&r, ENOSYS, 0, NULL, 0);
+        else esito = gestoriV2[(r.intestazione).opcode](&r);
+        if(r.descrittore >= 0) close(r.descrittore);
+        liberaCorpo(&(r.corpo));
+        if(esito == -1) {
+            salutaClient(tp->cache, tp->sessioni, r.fd);
+            close(r.fd);
+            errno = ECOMM;
+            return (void *) &errno;
+        }
+        if(traceOnLog(tp->log, "[THREAD %d]: CLIENT %d - INVIATI: %ldB - RICEVUTI: %ldB\n", numeroDelThread, r.fd, (long) r.bytesLetti, (long) r.bytesScritti) == -1) {
+            salutaClient(tp->cache, tp->sessioni, r.fd);
+            close(r.fd);
+            return (void *) &errno;
+        }
+    } while((++servite < RICHIESTE_PER_TASK) && ((anelli) ? !anelloVuoto(&((sessione->anelli)->richieste)) : (prossimaRichiestaV2(r.fd, sessione) > 0)));
+
+    /** Le richieste rimaste nell'anello devono risvegliare il server: il campanello e' stato azzerato **/
+    if(anelli && !anelloVuoto(&((sessione->anelli)->richieste))) suonaCampanello(sessione->campanello);
+    if(raccolte) raccogliRisposte(tp->fd, 0);
+
+    /** Riabilito fd in lettura nel server **/
+    if(write(tp->pfd, (void *) &(tp->fd), sizeof(int)) <= 0) {
+        salutaClient(tp->cache, tp->sessioni, tp->fd);
+        close(tp->fd);
+        return (void *) &errno;
+    }
+
+    errno = 0;
+    return (void *) 0;
+}
+
+
+/**
+ * @brief                   Risposta v1 di writeFile e appendToFile: per ogni file espulso spedisce
+ *                          (1, pathname, contenuto), poi il terminatore (0) e l'esito, tutto con
+ *                          un'unica scrittura. I file espulsi vengono sempre distrutti
+ * @fun                     rispondiEspulsioniV1
+ * @param fd                Client a cui rispondere
+ * @param log               File di log
+ * @param numeroDelThread   Thread che serve la richiesta
+ * @param nomeOperazione    Operazione servita (per il log)
+ * @param pathname          File scritto
+ * @param kickedFiles       File espulsi (NULL se nessuno)
+ * @param esito             Esito dell'operazione
+ * @param fromMem           Bytes spediti dalla memoria (aggiornato)
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+static ssize_t rispondiEspulsioniV1(int fd, serverLogFile *log, unsigned int numeroDelThread, const char *nomeOperazione, const char *pathname, myFile **kickedFiles, int esito, unsigned int *fromMem) {
+    /** Variabili **/
+    Messaggi risposta = { NULL, 0, 0 };
+    ssize_t bytes = -1;
+    int index = -1, error = 0;
+
+    /** Accodo file espulsi, terminatore ed esito **/
+    while((kickedFiles != NULL) && (kickedFiles[++index] != NULL)) {
+        if((aggiungiIntMSG(&risposta, 1) == -1) ||
+           (aggiungiMSG(&risposta, kickedFiles[index]->pathname, (strnlen(kickedFiles[index]->pathname, MAX_PATHNAME)+1)*sizeof(char)) == -1) ||
+           (aggiungiMSG(&risposta, kickedFiles[index]->buffer, kickedFiles[index]->size) == -1)) {
+            break;
+        }
+    }
+    if((kickedFiles == NULL) || (kickedFiles[index] == NULL)) {
+        if((aggiungiIntMSG(&risposta, 0) == 0) && (aggiungiIntMSG(&risposta, esito) == 0)) {
+            bytes = sendMSGv(fd, &risposta);
+        }
+    }
+    error = errno;
+    liberaMessaggi(&risposta);
+
+    /** Log e distruzione dei file espulsi **/
+    if((bytes > 0) && (traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1)) {
+        error = errno, bytes = -1;
+    }
+    index = -1;
+    while((kickedFiles != NULL) && (kickedFiles[++index] != NULL)) {
+        if((bytes > 0) && (traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: %s - FILE: %s - ESITO: espulsione file - KICK-FILE: %s\n", numeroDelThread, fd, nomeOperazione, pathname, kickedFiles[index]->pathname) == -1)) {
+            error = errno, bytes = -1;
+        }
+        *fromMem += (unsigned int) (kickedFiles[index]->size);
+        destroyFile(&(kickedFiles[index]));
+    }
+    if(kickedFiles != NULL) free(kickedFiles);
+
+    errno = (bytes > 0) ? 0 : error;
+    return bytes;
+}
 
 
 /**
@@ -49,7 +1993,6 @@
  */
 void* ServerTasks(unsigned int numeroDelThread, void *argv) {
     /** Variabili **/
-    int *locks = NULL;
     int isSetErrno = 0, pipe = -1, *fd = NULL, *flags = NULL, *N = NULL;
     char *request = NULL, *pathname = NULL, errorMsg[MAX_BUFFER_LEN];
     void *bufferFile = NULL;
@@ -62,11 +2005,17 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
     Task_Package *tp = NULL;
     serverLogFile *log = NULL;
     LRU_Memory *cache = NULL;
+    Messaggi risposta = { NULL, 0, 0 };
+    Arena *arena = NULL;
 
     /** Controllo parametri **/
     errno = 0;
     if(argv == NULL) { errno = EINVAL; return (void *) &errno; }
 
+    /** I client che hanno negoziato il protocollo v2 vengono serviti dalla tabella dei gestori **/
+    tp = (Task_Package *) argv;
+    if((tp->sessioni)[tp->fd].protocollo == PROTOCOLLO_V2) return serviRichiestaV2(numeroDelThread, tp);
+
     /** Conversione argomenti **/
     if((fd = (int *) malloc(sizeof(int))) == NULL) {
         return (void *) &errno;
@@ -77,9 +2026,11 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
     log = tp->log;
     cache = tp->cache;
 
-    /** Ascolto richiesta dal client **/
+    /** Ascolto richiesta dal client: i messaggi vengono ricevuti nell'arena della connessione **/
+    arena = &((tp->sessioni)[*fd].ricezione);
+    azzeraArena(arena);
     errno = 0;
-    if((bytes += receiveMSG(*fd, (void *) &request, &requestSize)) <= 0) {
+    if((bytes += receiveMSGArena(*fd, arena, (void **) &request, &requestSize)) <= 0) {
         CLIENT_GOODBYE;
         errno = ECOMM;
         close(*fd);
@@ -93,6 +2044,54 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         free(fd);
         return (void *) &errno;
     }
+    (tp->sessioni)[*fd].corsia = corsiaComando(request, requestSize);
+
+    /** Negoziazione del protocollo **/
+    if(strncmp(request, COMANDO_PROTOCOLLO, (size_t) fmax(11, (double) requestSize)) == 0) {
+        /** Variabili blocco **/
+        int *versione = NULL, accettata = PROTOCOLLO_V1, sonda = 0, risposta[2];
+        size_t dimVersione = 0;
+        void *ignorato = NULL;
+
+        /** Ricevo la versione proposta e l'eventuale sonda (comando, pathname e flags di un openFile v1, a cui
+            risponderebbe un server senza negoziazione): la consumo e rispondo con la versione accettata **/
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &versione, &dimVersione)) <= 0) {
+            CLIENT_GOODBYE;
+            close(*fd);
+            free(fd);
+            errno = ECOMM;
+            return (void *) &errno;
+        }
+        bytesRead += bytes;
+        if((dimVersione >= sizeof(int)) && (versione[0] >= PROTOCOLLO_V2)) accettata = PROTOCOLLO_V2;
+        sonda = (dimVersione == 2*sizeof(int)) && (versione[1] == NEGOZIAZIONE_CON_SONDA);
+        for(int i=0; sonda && (i<3); i++) {
+            if((bytes = receiveMSGArena(*fd, arena, &ignorato, NULL)) <= 0) {
+                CLIENT_GOODBYE;
+                close(*fd);
+                free(fd);
+                errno = ECOMM;
+                return (void *) &errno;
+            }
+            bytesRead += bytes;
+        }
+        risposta[0] = accettata, risposta[1] = NEGOZIAZIONE_CON_SONDA;
+        if((bytes = sendMSG(*fd, (void *) risposta, (sonda) ? sizeof(risposta) : sizeof(int))) <= 0) {
+            CLIENT_GOODBYE;
+            close(*fd);
+            free(fd);
+            errno = ECOMM;
+            return (void *) &errno;
+        }
+        bytesWrite += bytes;
+        (tp->sessioni)[*fd].protocollo = accettata;
+        if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - Protocollo negoziato: v%d\n", numeroDelThread, *fd, accettata) == -1) {
+            CLIENT_GOODBYE;
+            close(*fd);
+            free(fd);
+            return (void *) &errno;
+        }
+    }
 
     /** openFile **/
     if(strncmp(request, "openFile", (size_t) fmax(9, (double) requestSize)) == 0) {
@@ -100,11 +2099,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         int res = -1;
 
         /** Tentativo di openFile **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, &path_len)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, &path_len)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -112,17 +2110,14 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         bytesRead += bytes;
-        if((bytes = receiveMSG(*fd, (void **) &flags, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &flags, NULL)) <= 0) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -130,7 +2125,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -139,9 +2133,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
         switch (*flags) {
@@ -150,18 +2141,12 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 if((res == 0) && (traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname, LOG_PRINT_FLAGS) == -1)) {
                     CLIENT_GOODBYE;
                     close(*fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
                 if((res == 1) && (traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: già eseguita\n", numeroDelThread, *fd, pathname, LOG_PRINT_FLAGS) == -1)) {
                     CLIENT_GOODBYE;
                     close(*fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
@@ -170,26 +2155,17 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(pathname);
-                        free(flags);
-                        free(request);
                         return (void *) &errno;
                     }
                     if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(pathname);
-                        free(flags);
-                        free(request);
                         return (void *) &errno;
                     }
                     if((bytes = sendMSG(*fd, (void *) &errno, sizeof(int))) <= 0) {
                         CLIENT_GOODBYE;
                         close(*fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -198,9 +2174,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
                         CLIENT_GOODBYE;
                         close(*fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -209,9 +2182,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                     CLIENT_GOODBYE;
                     close(*fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
@@ -228,18 +2198,12 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(pathname);
-                    free(flags);
-                    free(request);
                     return (void *) &errno;
                 }
                 if((res == -1) && (traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - MODALITA': %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1)) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
@@ -247,9 +2211,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
@@ -258,9 +2219,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -269,9 +2227,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -280,9 +2235,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -291,9 +2243,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                         CLIENT_GOODBYE;
                         close(*fd);
                         free(fd);
-                        free(flags);
-                        free(request);
-                        free(pathname);
                         errno = ECOMM;
                         return (void *) &errno;
                     }
@@ -305,9 +2254,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(pathname);
-                    free(flags);
-                    free(request);
                     return (void *) &errno;
                 }
                 errno = EINVAL;
@@ -315,9 +2261,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
@@ -326,16 +2269,11 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                     CLIENT_GOODBYE;
                     close(*fd);
                     free(fd);
-                    free(flags);
-                    free(request);
-                    free(pathname);
                     errno = ECOMM;
                     return (void *) &errno;
                 }
         }
 
-        free(pathname);
-        free(flags);
     }
 
     /** readFile **/
@@ -343,9 +2281,8 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         /** Variabili blocco **/
         size_t dimBuffer = -1;
 
-        if((bytes = receiveMSG(*fd, (void **) &pathname, &path_len)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, &path_len)) <= 0) {
             CLIENT_GOODBYE;
-            free(request);
             close(*fd);
             free(fd);
             errno = ECOMM;
@@ -354,7 +2291,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         bytesRead += bytes;
         if(traceOnLog(log, "[THREAD %d]: Ricevuto dati dal client\n") == -1) {
             CLIENT_GOODBYE;
-            free(request);
             close(*fd);
             free(fd);
             errno = ECOMM;
@@ -362,8 +2298,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
-            free(request);
-            free(pathname);
             close(*fd);
             free(fd);
             return (void *) &errno;
@@ -371,24 +2305,18 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         if((dimBuffer = readFileOnCache(cache, pathname, *fd, &bufferFile)) == -1) {
             if(strerror_r(errno, errorMsg, MAX_BUFFER_LEN) != 0) {
                 CLIENT_GOODBYE;
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: openFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                 CLIENT_GOODBYE;
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 return (void *) &errno;
             }
             if((bytes = sendMSG(*fd, &errno, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -397,8 +2325,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -409,8 +2335,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             if((bytes = sendMSG(*fd, &errno, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
                 free(bufferFile);
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -420,8 +2344,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
                 free(bufferFile);
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -430,8 +2352,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             if((bytesWrite += sendMSG(*fd, bufferFile, dimBuffer)) <= 0) {
                 CLIENT_GOODBYE;
                 free(bufferFile);
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -441,8 +2361,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
                 free(bufferFile);
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 errno = ECOMM;
@@ -451,8 +2369,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
                 free(bufferFile);
-                free(request);
-                free(pathname);
                 close(*fd);
                 free(fd);
                 return (void *) &errno;
@@ -462,14 +2378,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
 
         free(bufferFile);
-        free(pathname);
     }
 
     /** readNFiles **/
@@ -480,16 +2392,14 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         /** Ricevo il numero di file che il client vuole leggere **/
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles\n", numeroDelThread, *fd) == -1) {
             CLIENT_GOODBYE;
-            free(request);
             close(*fd);
             free(fd);
             return (void *) &errno;
         }
-        if((bytes = receiveMSG(*fd, (void *) &N, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &N, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return &errno;
         }
@@ -498,7 +2408,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return &errno;
         }
@@ -510,10 +2419,8 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             while(readFiles[++index] != NULL) {
                 destroyFile(&(readFiles[index]));
             }
-            free(N);
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -524,10 +2431,8 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             while(readFiles[++index] != NULL) {
                 destroyFile(&(readFiles[index]));
             }
-            free(N);
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -538,10 +2443,8 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 while(readFiles[++index] != NULL) {
                     destroyFile(&(readFiles[index]));
                 }
-                free(N);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, errorMsg) == -1) {
@@ -550,150 +2453,60 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 while(readFiles[++index] != NULL) {
                     destroyFile(&(readFiles[index]));
                 }
-                free(N);
-                close(*fd);
-                free(fd);
-                free(request);
-                return (void *) &errno;
-            }
-        } else {
-            if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: file letti, invio al client\n", numeroDelThread, *fd) == -1) {
-                CLIENT_GOODBYE;
-                free(N);
-                close(*fd);
-                free(fd);
-                free(request);
-                while(readFiles[++index] != NULL) {
-                    destroyFile(&(readFiles[index]));
-                }
-                free(readFiles);
-                return (void *) &errno;
-            }
-            while(++index < *N) {
-                res = 1;
-                if((bytes = sendMSG(*fd, &res, sizeof(int))) <= 0) {
-                   CLIENT_GOODBYE;
-                   free(N);
-                   close(*fd);
-                   free(fd);
-                   free(request);
-                   while(index >= 0) {
-                       destroyFile(&(readFiles[index]));
-                       index--;
-                   }
-                   free(readFiles);
-                   errno = ECOMM;
-                   return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    free(N);
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    while(index >= 0) {
-                        destroyFile(&(readFiles[index]));
-                        index--;
-                    }
-                    free(readFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if((bytes = sendMSG(*fd, readFiles[index]->pathname, (strnlen(readFiles[index]->pathname, MAX_PATHNAME)+1)*sizeof(char))) <= 0) {
-                    CLIENT_GOODBYE;
-                    free(N);
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    while(index >= 0) {
-                       destroyFile(&(readFiles[index]));
-                       index--;
-                    }
-                    free(readFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    free(N);
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    while(index >= 0) {
-                        destroyFile(&(readFiles[index]));
-                        index--;
-                    }
-                    free(readFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if((bytes = sendMSG(*fd, readFiles[index]->buffer, readFiles[index]->size)) <= 0) {
-                   CLIENT_GOODBYE;
-                   free(N);
-                   close(*fd);
-                   free(fd);
-                   free(request);
-                   while(index >= 0) {
-                       destroyFile(&(readFiles[index]));
-                       index--;
-                   }
-                   free(readFiles);
-                   errno = ECOMM;
-                   return (void *) &errno;
-               }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    free(N);
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    while(index >= 0) {
-                        destroyFile(&(readFiles[index]));
-                        index--;
-                    }
-                    free(readFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: file inviato - FILE-READ: %s\n", numeroDelThread, *fd, readFiles[index]->pathname) == -1) {
+                close(*fd);
+                free(fd);
+                return (void *) &errno;
+            }
+        } else {
+            if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: file letti, invio al client\n", numeroDelThread, *fd) == -1) {
+                CLIENT_GOODBYE;
+                close(*fd);
+                free(fd);
+                while(readFiles[++index] != NULL) {
+                    destroyFile(&(readFiles[index]));
+                }
+                free(readFiles);
+                return (void *) &errno;
+            }
+            while(++index < *N) {
+                if((aggiungiIntMSG(&risposta, 1) == -1) ||
+                   (aggiungiMSG(&risposta, readFiles[index]->pathname, (strnlen(readFiles[index]->pathname, MAX_PATHNAME)+1)*sizeof(char)) == -1) ||
+                   (aggiungiMSG(&risposta, readFiles[index]->buffer, readFiles[index]->size) == -1)) {
                     CLIENT_GOODBYE;
-                    free(N);
                     close(*fd);
                     free(fd);
-                    free(request);
+                    index = -1;
                     while(readFiles[++index] != NULL) {
                         destroyFile(&(readFiles[index]));
                     }
                     free(readFiles);
+                    liberaMessaggi(&risposta);
                     return (void *) &errno;
                 }
                 fromMem += readFiles[index]->size;
             }
+
+            /** File e terminatore vengono spediti con un'unica scrittura **/
             res = 0;
-            if((bytes = sendMSG(*fd, &res, sizeof(int))) <= 0) {
+            if((aggiungiIntMSG(&risposta, res) == -1) || ((bytes = sendMSGv(*fd, &risposta)) <= 0)) {
                 CLIENT_GOODBYE;
-                free(N);
                 close(*fd);
                 free(fd);
-                free(request);
                 index = -1;
                 while(readFiles[++index] != NULL) {
                     destroyFile(&(readFiles[index]));
                 }
                 free(readFiles);
+                liberaMessaggi(&risposta);
                 errno = ECOMM;
                 return (void *) &errno;
             }
+            liberaMessaggi(&risposta);
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(N);
                 close(*fd);
                 free(fd);
-                free(request);
                 index = -1;
                 while(readFiles[++index] != NULL) {
                     destroyFile(&(readFiles[index]));
@@ -703,6 +2516,20 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 return (void *) &errno;
             }
             index = -1;
+            while(++index < *N) {
+                if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: file inviato - FILE-READ: %s\n", numeroDelThread, *fd, readFiles[index]->pathname) == -1) {
+                    CLIENT_GOODBYE;
+                    close(*fd);
+                    free(fd);
+                    index = -1;
+                    while(readFiles[++index] != NULL) {
+                        destroyFile(&(readFiles[index]));
+                    }
+                    free(readFiles);
+                    return (void *) &errno;
+                }
+            }
+            index = -1;
             while(++index < *N) {
                 destroyFile(&(readFiles[index]));
             }
@@ -710,39 +2537,26 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: readNFiles - ESITO: eseguita correttamente\n", numeroDelThread, *fd) == -1) {
             CLIENT_GOODBYE;
-            free(N);
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT %d - LETTI: %ldB\n", numeroDelThread, *fd, fromMem) == -1) {
             CLIENT_GOODBYE;
-            free(N);
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
 
-        free(N);
     }
 
     /** writeFile **/
     if(strncmp(request, "writeFile", (size_t) fmax(10, (double) requestSize)) == 0) {
-        /** Variabili blocco **/
-        int index = -1, res = 0;
-
         /** Ricevo il pathname e scrivo tutto il file fisico nella memoria cache **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -751,7 +2565,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -759,166 +2572,21 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
-            free(pathname);
             return (void *) &errno;
         }
         kickedFiles = addFileOnCache(cache, pathname, *fd, 1), isSetErrno = errno;
-        if(kickedFiles != NULL) {
-            res = 1;
-            while(kickedFiles[++index] != NULL) {
-                if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if((bytesWrite = sendMSG(*fd, (void *) kickedFiles[index]->pathname, (strnlen(kickedFiles[index]->pathname, MAX_PATHNAME)+1)*sizeof(char))) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if((bytesWrite = sendMSG(*fd, (void *) kickedFiles[index]->buffer, kickedFiles[index]->size)) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: writeFile - FILE: %s - ESITO: espulsione file - KICK-FILE: %s\n", numeroDelThread, *fd, pathname, kickedFiles[index]->pathname) == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(kickedFiles[++index] != NULL) {
-                        destroyFile(&(kickedFiles[index]));
-                    }
-                    free(kickedFiles);
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                fromMem += kickedFiles[index]->size;
-            }
-            index = -1;
-            while(kickedFiles[++index] != NULL) {
-                destroyFile(&(kickedFiles[index]));
-            }
-            free(kickedFiles);
-            res = 0;
-        }
-        if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
-            return (void *) &errno;
-        }
-        bytesWrite += bytes;
-        if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
-            return (void *) &errno;
-        }
-        if((bytes = sendMSG(*fd, (void *) &isSetErrno, sizeof(int))) <= 0) {
+        if((bytes = rispondiEspulsioniV1(*fd, log, numeroDelThread, "writeFile", pathname, kickedFiles, isSetErrno, &fromMem)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
-            free(pathname);
             errno = ECOMM;
             return (void *) &errno;
         }
         bytesWrite += bytes;
-        if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
-            return (void *) &errno;
-        }
         if(isSetErrno == 0) {
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: writeFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
-                free(request);
                 free(fd);
                 return (void *) &errno;
             }
@@ -926,17 +2594,13 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         else {
             if(strerror_r(errno, errorMsg, MAX_BUFFER_LEN) != 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
-                free(request);
                 free(fd);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: writeFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
-                free(request);
                 free(fd);
                 return (void *) &errno;
             }
@@ -945,27 +2609,21 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
 
-        free(pathname);
     }
 
     /** appendToFile **/
     if(strncmp(request, "appendToFile", (size_t) fmax(13, (double) requestSize)) == 0) {
         /** Variabili blocco **/
         size_t dimFile = -1;
-        int index = -1, res = 0;
 
         /** Leggo pathname e buffer del file da aggiornare **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
         bytesRead += bytes;
@@ -973,23 +2631,18 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: appendToFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(request);
             return (void *) &errno;
         }
         if((bytes = receiveMSG(*fd, (void **) &bufferFile, &dimFile)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(request);
             return (void *) &errno;
         }
         bytesRead += bytes;
@@ -997,170 +2650,18 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
-            return (void *) &errno;
-        }
-        kickedFiles = appendFile(cache, pathname, *fd, bufferFile, dimFile), isSetErrno = errno;
-        if(kickedFiles != NULL) {
-            res = 1, index = -1;
-            while(kickedFiles[++index] != NULL) {
-                if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if((bytes = sendMSG(*fd, (void *) kickedFiles[index]->pathname, (strnlen(kickedFiles[index]->pathname, MAX_PATHNAME)+1)*sizeof(char))) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                bytesWrite += bytes;
-                if((bytes = sendMSG(*fd, (void *) kickedFiles[index]->buffer, kickedFiles[index]->size)) <= 0) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(index >= 0) {
-                        destroyFile(&(kickedFiles[index]));
-                        index--;
-                    }
-                    free(kickedFiles);
-                    errno = ECOMM;
-                    return (void *) &errno;
-                }
-                if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: appendToFile - FILE: %s - ESITO: espulsione file - KICK-FILE: %s\n", numeroDelThread, *fd, pathname, kickedFiles[index]->pathname) == -1) {
-                    CLIENT_GOODBYE;
-                    close(*fd);
-                    free(fd);
-                    free(request);
-                    free(bufferFile);
-                    free(pathname);
-                    while(kickedFiles[++index] != NULL) {
-                        destroyFile(&(kickedFiles[index]));
-                    }
-                    free(kickedFiles);
-                    return (void *) &errno;
-                }
-                fromMem += (unsigned int) (kickedFiles[index]->size);
-                bytesWrite += bytes;
-            }
-            index = -1;
-            while(kickedFiles[++index] != NULL) {
-                destroyFile(&(kickedFiles[index]));
-            }
-            free(kickedFiles);
-            res = 0;
-        }
-        if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(bufferFile);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
-            return (void *) &errno;
-        }
-        bytesWrite += bytes;
-        if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(bufferFile);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
             return (void *) &errno;
         }
-        if((bytesWrite = sendMSG(*fd, (void *) &isSetErrno, sizeof(int))) <= 0) {
+        kickedFiles = appendFile(cache, pathname, *fd, bufferFile, dimFile, NULL), isSetErrno = errno;
+        if((bytes = rispondiEspulsioniV1(*fd, log, numeroDelThread, "appendToFile", pathname, kickedFiles, isSetErrno, &fromMem)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
             free(bufferFile);
-            free(request);
-            free(pathname);
             errno = ECOMM;
             return (void *) &errno;
         }
         bytesWrite += bytes;
-        if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
-            CLIENT_GOODBYE;
-            close(*fd);
-            free(fd);
-            free(bufferFile);
-            free(request);
-            free(pathname);
-            errno = ECOMM;
-            return (void *) &errno;
-        }
         if(isSetErrno != 0) {
             errno = isSetErrno;
             if(strerror_r(errno, errorMsg, MAX_BUFFER_LEN) != 0) {
@@ -1168,9 +2669,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 close(*fd);
                 free(bufferFile);
                 free(fd);
-                free(pathname);
-                free(flags);
-                free(request);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: appendToFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
@@ -1178,9 +2676,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 close(*fd);
                 free(bufferFile);
                 free(fd);
-                free(pathname);
-                free(flags);
-                free(request);
                 return (void *) &errno;
             }
             dimFile=0;
@@ -1190,9 +2685,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 close(*fd);
                 free(bufferFile);
                 free(fd);
-                free(pathname);
-                free(flags);
-                free(request);
                 return (void *) &errno;
             }
         }
@@ -1201,14 +2693,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             close(*fd);
             free(bufferFile);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
 
         kickedFiles = NULL;
-        free(pathname);
         free(bufferFile), bufferFile = NULL;
     }
 
@@ -1218,11 +2706,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         int res = -1;
 
         /** Ricevo il pathname del file e provo ad effettuare la lock **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -1231,35 +2718,28 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
-        if(((res = lockFileOnCache(cache, pathname, *fd)) == -1) || (res == 0) || (res == *fd)) {
+        if(((res = lockFileOnCache(cache, pathname, *fd, 1, NULL)) == -1) || (res == 0) || (res == *fd)) {
             isSetErrno = errno;
             if(res == -1) {
                 if(strerror_r(isSetErrno, errorMsg, MAX_BUFFER_LEN) != 0) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
                 if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
                 res = errno;
@@ -1267,53 +2747,42 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
                 res = EALREADY;
                 if(traceOnLog(log,  "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: Già eseguita\n", numeroDelThread, *fd, pathname) == -1) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
             } else {
                 if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
             }
             if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
         } else {
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: lockFile - FILE: %s - ESITO: file occupato\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
         }
 
-        free(pathname);
     }
 
     /** unlockFile **/
@@ -1322,11 +2791,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         int res = -1, wakeUp = -1;
 
         /** Effettuo la unlock **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -1335,81 +2803,64 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
-        res = unlockFileOnCache(cache, pathname, *fd), isSetErrno = errno;
+        res = unlockFileOnCache(cache, pathname, *fd, NULL), isSetErrno = errno;
         if(res == -1) {
             if(strerror_r(isSetErrno, errorMsg, MAX_BUFFER_LEN) != 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             res = errno;
             if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
         } else if(res == 0) {
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
@@ -1418,53 +2869,42 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             res = 0;
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: unlockFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if((bytes = sendMSG(*fd, (void *) &res, sizeof(int))) <= 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
-            if((bytes = sendMSG(wakeUp, (void *) &res, sizeof(int))) <= 0) {
+            if((bytes = rispondiAttesa(tp->sessioni, wakeUp, pathname, res)) <= 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
             bytesWrite += bytes;
             if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 errno = ECOMM;
                 return (void *) &errno;
             }
         }
 
-        free(pathname);
     }
 
     /** closeFile **/
@@ -1473,11 +2913,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         int res = -1, wakeUp = 0;
 
         /** Effettuo la unlock **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -1486,85 +2925,67 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
-        res = closeFileOnCache(cache, pathname, *fd), isSetErrno = errno;
+        res = closeFileOnCache(cache, pathname, *fd, NULL), isSetErrno = errno;
         if(res == -1) {
             if(strerror_r(isSetErrno, errorMsg, MAX_BUFFER_LEN) != 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
         } else {
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if(res > 0) {
                 wakeUp = res, res = 0;
-                if((bytes = sendMSG(wakeUp, (void *) &res, sizeof(int))) <= 0) {
+                if((bytes = rispondiAttesa(tp->sessioni, wakeUp, pathname, res)) <= 0) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
                 bytesWrite += bytes;
                 if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
                     CLIENT_GOODBYE;
-                    free(pathname);
                     close(*fd);
                     free(fd);
-                    free(request);
                     return (void *) &errno;
                 }
             }
         }
         if((bytes = sendMSG(*fd, (void *) &isSetErrno, sizeof(int))) <= 0) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
         bytesWrite += bytes;
         if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
 
-        free(pathname);
     }
 
     /** removeFile **/
@@ -1573,11 +2994,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         size_t removed = 0;
 
         /** Ricevo il pathname dal client **/
-        if((bytes = receiveMSG(*fd, (void **) &pathname, NULL)) <= 0) {
+        if((bytes = receiveMSGArena(*fd, arena, (void **) &pathname, NULL)) <= 0) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -1586,35 +3006,28 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: removeFile - FILE: %s\n", numeroDelThread, *fd, pathname) == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             return (void *) &errno;
         }
-        resCancellazione = removeFileOnCache(cache, pathname, *fd), isSetErrno = errno;
+        resCancellazione = removeFileOnCache(cache, pathname, *fd, NULL), isSetErrno = errno;
         if((bytes = sendMSG(*fd, (void *) &errno, sizeof(int))) <= 0) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
         bytesWrite += bytes;
         if(traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n") == -1) {
             CLIENT_GOODBYE;
-            free(pathname);
             close(*fd);
             free(fd);
-            free(request);
             errno = ECOMM;
             return (void *) &errno;
         }
@@ -1623,10 +3036,8 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             else removed = 0;
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: eseguita correttamente\n", numeroDelThread, *fd, pathname) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             int *fdUn = NULL;
@@ -1634,7 +3045,7 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             while(resCancellazione != NULL && resCancellazione->utentiLocked != NULL) {
                 fdUn = deleteFirstElement(&(resCancellazione->utentiLocked));
                 if(fdUn != NULL) {
-                    bytes = sendMSG(*fdUn, &result, sizeof(int));
+                    bytes = rispondiAttesa(tp->sessioni, *fdUn, pathname, result);
                     if(bytes != -1) {
                         bytesWrite += bytes;
                         traceOnLog(log, "[THREAD %d]: Spedisco dati al client\n");
@@ -1645,18 +3056,14 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         } else {
             if(strerror_r(isSetErrno, errorMsg, MAX_BUFFER_LEN) != 0) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
             if(traceOnLog(log, "[THREAD %d]: CLIENT: %d - RICHIESTA: closeFile - FILE: %s - ESITO: fallita - ERRORE: %s\n", numeroDelThread, *fd, pathname, errorMsg) == -1) {
                 CLIENT_GOODBYE;
-                free(pathname);
                 close(*fd);
                 free(fd);
-                free(request);
                 return (void *) &errno;
             }
         }
@@ -1664,14 +3071,10 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
             CLIENT_GOODBYE;
             close(*fd);
             free(fd);
-            free(pathname);
-            free(flags);
-            free(request);
             return (void *) &errno;
         }
 
         destroyFile(&resCancellazione);
-        free(pathname);
     }
 
     /** Riabilito fd in lettura nel server **/
@@ -1679,7 +3082,6 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         CLIENT_GOODBYE;
         close(*fd);
         free(fd);
-        free(request);
         return (void *) &errno;
     }
     bytesWrite += bytes;
@@ -1687,12 +3089,165 @@ void* ServerTasks(unsigned int numeroDelThread, void *argv) {
         CLIENT_GOODBYE;
         close(*fd);
         free(fd);
-        free(request);
         return (void *) &errno;
     }
     free(fd);
-    free(request);
 
     errno = 0;
     return (void *) 0;
 }
+
+
+/**
+ * @brief                       Classifica la prossima richiesta del client senza chiamate di sistema: con gli anelli
+ *                              ne guarda l'intestazione in memoria condivisa, altrimenti usa la corsia scelta dal
+ *                              task che ha servito il client (il thread manager non sbircia il socket)
+ * @fun                         classificaRichiesta
+ * @param sessione              Sessione del client
+ * @return                      CORSIA_PRIORITARIA per le operazioni sui metadati; CORSIA_NORMALE per i trasferimenti
+ *                              di dati
+ */
+int classificaRichiesta(const Sessione *sessione) {
+    /** Variabili **/
+    Intestazione_Richiesta intestazione;
+
+    /** Anelli: l'intestazione e' gia' in memoria **/
+    if((sessione->protocollo == PROTOCOLLO_V2) && (sessione->anelli != NULL)) {
+        if(sbirciaAnello(&((sessione->anelli)->richieste), &intestazione, sizeof(Intestazione_Richiesta)) == -1) return sessione->corsia;
+        if(intestazione.flags & FLAG_SUL_SOCKET) return sessione->corsia;
+        return corsiaOpcode(intestazione.opcode);
+    }
+
+    return sessione->corsia;
+}
+
+
+/**
+ * @brief                       Crea la tabella delle sessioni, indicizzata per FD
+ * @fun                         creaSessioni
+ * @param numero                Numero di sessioni
+ * @return                      Ritorna la tabella; NULL in caso di errore [setta errno]
+ */
+Sessione* creaSessioni(size_t numero) {
+    /** Variabili **/
+    Sessione *sessioni = NULL;
+    int error = 0;
+    size_t i = 0;
+
+    /** Controllo parametri **/
+    if(numero == 0) { errno = EINVAL; return NULL; }
+
+    /** Creo la tabella **/
+    if((sessioni = (Sessione *) calloc(numero, sizeof(Sessione))) == NULL) {
+        return NULL;
+    }
+    for(i = 0; i < numero; i++) sessioni[i].cartellaEspulsi = -1, sessioni[i].campanello = -1;
+    for(i = 0; i < numero; i++) {
+        sessioni[i].protocollo = PROTOCOLLO_V1;
+        if((sessioni[i].accesso = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t))) == NULL) {
+            break;
+        }
+        if((error = pthread_mutex_init(sessioni[i].accesso, NULL)) != 0) {
+            free(sessioni[i].accesso), sessioni[i].accesso = NULL;
+            errno = error;
+            break;
+        }
+        if((sessioni[i].attese = (Attesa_Lock *) calloc(FINESTRA_MASSIMA, sizeof(Attesa_Lock))) == NULL) {
+            break;
+        }
+    }
+    if(i < numero) {
+        error = errno;
+        distruggiSessioni(&sessioni, numero);
+        errno = error;
+        return NULL;
+    }
+
+    return sessioni;
+}
+
+
+/**
+ * @brief                       Distrugge la tabella delle sessioni
+ * @fun                         distruggiSessioni
+ * @param sessioni              Tabella da distruggere (viene messa a NULL)
+ * @param numero                Numero di sessioni
+ */
+void distruggiSessioni(Sessione **sessioni, size_t numero) {
+    /** Controllo parametri **/
+    if((sessioni == NULL) || (*sessioni == NULL)) return;
+
+    /** Distruggo ogni sessione **/
+    for(size_t i = 0; i < numero; i++) {
+        chiudiSessione((*sessioni) + i);
+        if(((*sessioni)[i]).accesso != NULL) {
+            pthread_mutex_destroy(((*sessioni)[i]).accesso);
+            free(((*sessioni)[i]).accesso);
+        }
+        if(((*sessioni)[i]).attese != NULL) free(((*sessioni)[i]).attese);
+    }
+    free(*sessioni);
+    *sessioni = NULL;
+}
+
+
+/**
+ * @brief                       Inizializza la sessione di un client appena connesso: ogni client parte dal protocollo
+ *                              v1 finche' non ne negozia un altro, tranne quelli del socket SOCK_SEQPACKET che parlano
+ *                              solo il v2 (i loro frame viaggiano a pacchetti). Ai client TCP viene disattivato
+ *                              l'algoritmo di Nagle: le risposte partono subito, e quelle di piu' richieste servite
+ *                              di fila vengono raccolte con TCP_CORK
+ * @fun                         apriSessione
+ * @param sessioni              Tabella delle sessioni
+ * @param fd                    Client appena connesso
+ * @param trasporto             TRASPORTO_STREAM, TRASPORTO_PACCHETTI o TRASPORTO_TCP
+ * @return                      Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int apriSessione(Sessione *sessioni, int fd, int trasporto) {
+    /** Variabili **/
+    int attivo = 1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((sessioni == NULL) || (fd < 0)) { errno = EINVAL; return -1; }
+    if((trasporto != TRASPORTO_STREAM) && (trasporto != TRASPORTO_PACCHETTI) && (trasporto != TRASPORTO_TCP)) { errno = EINVAL; return -1; }
+
+    /** Inizializzo **/
+    chiudiSessione(sessioni + fd);
+    if(impostaPacchetti(fd, (trasporto == TRASPORTO_PACCHETTI)) == -1) return -1;
+    if(trasporto == TRASPORTO_PACCHETTI) sessioni[fd].protocollo = PROTOCOLLO_V2;
+    if((trasporto == TRASPORTO_TCP) && (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &attivo, sizeof(int)) == -1)) return -1;
+    sessioni[fd].remota = (trasporto == TRASPORTO_TCP);
+    sessioni[fd].pacchetti = (trasporto == TRASPORTO_PACCHETTI);
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                       Rilascia le risorse della sessione di un client (arena, attese, cartella registrata,
+ *                              anelli e maniglie)
+ * @fun                         chiudiSessione
+ * @param sessione              Sessione da chiudere
+ */
+void chiudiSessione(Sessione *sessione) {
+    /** Controllo parametri **/
+    if(sessione == NULL) return;
+
+    /** Libero l'arena e le richieste ancora in attesa **/
+    if((sessione->accesso != NULL) && (pthread_mutex_lock(sessione->accesso) != 0)) return;
+    liberaArena(&(sessione->ricezione));
+    for(unsigned int i = 0; (sessione->attese != NULL) && (i < sessione->numeroAttese); i++) {
+        free((sessione->attese)[i].pathname), (sessione->attese)[i].pathname = NULL;
+    }
+    sessione->numeroAttese = 0;
+    sessione->protocollo = PROTOCOLLO_V1;
+    if(sessione->cartellaEspulsi >= 0) close(sessione->cartellaEspulsi), sessione->cartellaEspulsi = -1;
+    smappaAnelli(&(sessione->anelli));
+    if(sessione->campanello >= 0) close(sessione->campanello), sessione->campanello = -1;
+    sessione->remota = 0, sessione->pacchetti = 0, sessione->espulsioni = ESPULSI_IN_RISPOSTA, sessione->corsia = CORSIA_NORMALE;
+    for(unsigned int i = 0; i < sessione->numeroManiglie; i++) free((sessione->maniglie)[i].pathname);
+    free(sessione->maniglie), sessione->maniglie = NULL, sessione->numeroManiglie = 0;
+    if(sessione->accesso != NULL) pthread_mutex_unlock(sessione->accesso);
+}
@@ -0,0 +1,448 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Anelli in memoria condivisa tra client e server sulla stessa macchina
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#define _GNU_SOURCE
+#include "anello.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+/**
+ * @brief                   Copia dei bytes nell'anello a partire da una posizione, riavvolgendosi alla fine
+ * @fun                     copiaNellAnello
+ * @param anello            Anello in cui copiare
+ * @param posizione         Contatore dei bytes scritti da cui partire
+ * @param dati              Bytes da copiare
+ * @param n                 Numero di bytes
+ */
+static void copiaNellAnello(Anello *anello, uint32_t posizione, const void *dati, size_t n) {
+    /** Variabili **/
+    size_t inizio = posizione & (ANELLO_CAPACITA - 1), primi = ANELLO_CAPACITA - inizio;
+
+    /** Copia **/
+    if(n <= primi) {
+        memcpy(anello->dati + inizio, dati, n);
+        return;
+    }
+    memcpy(anello->dati + inizio, dati, primi);
+    memcpy(anello->dati, (const char *) dati + primi, n - primi);
+}
+
+
+/**
+ * @brief                   Copia dei bytes dall'anello a partire da una posizione, riavvolgendosi alla fine
+ * @fun                     copiaDallAnello
+ * @param anello            Anello da cui copiare
+ * @param posizione         Contatore dei bytes letti da cui partire
+ * @param dati              Destinazione
+ * @param n                 Numero di bytes
+ */
+static void copiaDallAnello(const Anello *anello, uint32_t posizione, void *dati, size_t n) {
+    /** Variabili **/
+    size_t inizio = posizione & (ANELLO_CAPACITA - 1), primi = ANELLO_CAPACITA - inizio;
+
+    /** Copia **/
+    if(n <= primi) {
+        memcpy(dati, anello->dati + inizio, n);
+        return;
+    }
+    memcpy(dati, anello->dati + inizio, primi);
+    memcpy((char *) dati + primi, anello->dati, n - primi);
+}
+
+
+/**
+ * @brief                   Bytes pronti da consumare: il contatore del produttore sta in memoria condivisa,
+ *                          quindi un valore incoerente viene rifiutato
+ * @fun                     occupati
+ * @param anello            Anello da controllare
+ * @return                  Ritorna i bytes pronti; -1 se i contatori sono incoerenti [setta errno]
+ */
+static int64_t occupati(const Anello *anello) {
+    /** Variabili **/
+    uint32_t scritti = __atomic_load_n(&(anello->scritti), __ATOMIC_ACQUIRE);
+    uint32_t letti = __atomic_load_n(&(anello->letti), __ATOMIC_ACQUIRE);
+
+    /** Controllo **/
+    if((uint32_t) (scritti - letti) > ANELLO_CAPACITA) { errno = EBADMSG; return -1; }
+
+    return (int64_t) (uint32_t) (scritti - letti);
+}
+
+
+/**
+ * @brief                   Scrive un frame nell'anello: i bytes diventano visibili al consumatore tutti insieme
+ * @fun                     scriviFrame
+ * @param anello            Anello in cui scrivere
+ * @param intestazione      Intestazione del frame (gia' completa della lunghezza del corpo)
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param lunghezza         Dimensione del corpo
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+static ssize_t scriviFrame(Anello *anello, const void *intestazione, size_t dimIntestazione, const Campo *campi, size_t numeroCampi, uint64_t lunghezza) {
+    /** Variabili **/
+    uint64_t totale = dimIntestazione + lunghezza, dimCampo = 0;
+    uint32_t posizione = 0;
+    int64_t pronti = -1;
+
+    /** Controllo spazio **/
+    errno = 0;
+    if(totale > ANELLO_MASSIMO_FRAME) { errno = EMSGSIZE; return -1; }
+    if((pronti = occupati(anello)) == -1) return -1;
+    if(totale > ANELLO_CAPACITA - pronti) { errno = ENOBUFS; return -1; }
+
+    /** Copio intestazione e campi **/
+    posizione = __atomic_load_n(&(anello->scritti), __ATOMIC_RELAXED);
+    copiaNellAnello(anello, posizione, intestazione, dimIntestazione);
+    posizione += dimIntestazione;
+    for(size_t i=0; i<numeroCampi; i++) {
+        dimCampo = campi[i].dimensione;
+        copiaNellAnello(anello, posizione, &dimCampo, sizeof(uint64_t));
+        posizione += sizeof(uint64_t);
+        if(dimCampo == 0) continue;
+        copiaNellAnello(anello, posizione, campi[i].dati, dimCampo);
+        posizione += dimCampo;
+    }
+
+    /** Pubblico il frame e sveglio il consumatore se dorme **/
+    __atomic_store_n(&(anello->scritti), posizione, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&(anello->inAttesa), __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, &(anello->scritti), FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+
+    errno = 0;
+    return (ssize_t) totale;
+}
+
+
+/**
+ * @brief                   Preleva un frame dall'anello: intestazione e corpo
+ * @fun                     leggiFrame
+ * @param anello            Anello da cui leggere
+ * @param arena             Arena in cui ricevere il corpo (NULL per allocarlo con malloc)
+ * @param intestazione      Intestazione da riempire
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @param lunghezza         Campo dell'intestazione con la dimensione del corpo
+ * @param corpo             Corpo da riempire (il contenuto precedente viene liberato)
+ * @return                  Ritorna il numero di bytes letti; 0 se l'anello e' vuoto; -1 in caso di errore [setta errno]
+ */
+static ssize_t leggiFrame(Anello *anello, Arena *arena, void *intestazione, size_t dimIntestazione, const uint64_t *lunghezza, Corpo *corpo) {
+    /** Variabili **/
+    uint32_t posizione = 0;
+    int64_t pronti = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(corpo == NULL) { errno = EINVAL; return -1; }
+
+    /** Il produttore pubblica solo frame completi **/
+    liberaCorpo(corpo);
+    if((pronti = occupati(anello)) <= 0) return (pronti == 0) ? 0 : -1;
+    if(pronti < (int64_t) dimIntestazione) { errno = EBADMSG; return -1; }
+    posizione = __atomic_load_n(&(anello->letti), __ATOMIC_RELAXED);
+    copiaDallAnello(anello, posizione, intestazione, dimIntestazione);
+    posizione += dimIntestazione;
+    if(*lunghezza > (uint64_t) (pronti - dimIntestazione)) { errno = EBADMSG; return -1; }
+
+    /** Copio il corpo nella sua destinazione **/
+    if(*lunghezza != 0) {
+        corpo->buffer = (arena != NULL) ? (char *) allocaArena(arena, *lunghezza) : (char *) malloc(*lunghezza);
+        if(corpo->buffer == NULL) return -1;
+        corpo->arena = arena;
+        copiaDallAnello(anello, posizione, corpo->buffer, *lunghezza);
+        posizione += *lunghezza;
+        corpo->dimensione = *lunghezza;
+    }
+    __atomic_store_n(&(anello->letti), posizione, __ATOMIC_RELEASE);
+
+    errno = 0;
+    return (ssize_t) (dimIntestazione + *lunghezza);
+}
+
+
+/**
+ * @brief                   Crea gli anelli in un memfd sigillato contro ridimensionamenti e li mappa
+ * @fun                     creaAnelli
+ * @param descrittore       Memfd degli anelli, da passare al server e poi chiudere
+ * @return                  Ritorna gli anelli; NULL in caso di errore [setta errno]
+ */
+Anelli* creaAnelli(int *descrittore) {
+    /** Variabili **/
+    Anelli *anelli = NULL;
+    int error = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(descrittore == NULL) { errno = EINVAL; return NULL; }
+
+    /** Creo, sigillo e mappo il memfd: il server non deve poterlo vedere accorciato mentre lo usa **/
+    if((*descrittore = memfd_create("anelli", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) {
+        return NULL;
+    }
+    if((ftruncate(*descrittore, sizeof(Anelli)) == -1) ||
+       (fcntl(*descrittore, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) ||
+       ((anelli = (Anelli *) mmap(NULL, sizeof(Anelli), PROT_READ | PROT_WRITE, MAP_SHARED, *descrittore, 0)) == MAP_FAILED)) {
+        error = errno;
+        close(*descrittore), *descrittore = -1;
+        errno = error;
+        return NULL;
+    }
+
+    errno = 0;
+    return anelli;
+}
+
+
+/**
+ * @brief                   Mappa gli anelli ricevuti dal client, verificando dimensione e sigilli del memfd
+ * @fun                     mappaAnelli
+ * @param descrittore       Memfd degli anelli (resta aperto)
+ * @return                  Ritorna gli anelli; NULL in caso di errore [setta errno]
+ */
+Anelli* mappaAnelli(int descrittore) {
+    /** Variabili **/
+    Anelli *anelli = NULL;
+    struct stat info;
+    int sigilli = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(descrittore < 0) { errno = EINVAL; return NULL; }
+
+    /** Il memfd deve avere la dimensione degli anelli e non poter cambiare **/
+    if(fstat(descrittore, &info) == -1) return NULL;
+    if((sigilli = fcntl(descrittore, F_GET_SEALS)) == -1) return NULL;
+    if((!S_ISREG(info.st_mode)) || (info.st_size != (off_t) sizeof(Anelli)) || ((sigilli & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if((anelli = (Anelli *) mmap(NULL, sizeof(Anelli), PROT_READ | PROT_WRITE, MAP_SHARED, descrittore, 0)) == MAP_FAILED) {
+        return NULL;
+    }
+
+    errno = 0;
+    return anelli;
+}
+
+
+/**
+ * @brief                   Rilascia la mappatura degli anelli
+ * @fun                     smappaAnelli
+ * @param anelli            Anelli da rilasciare (viene messo a NULL)
+ */
+void smappaAnelli(Anelli **anelli) {
+    /** Controllo parametri **/
+    if((anelli == NULL) || (*anelli == NULL)) return;
+
+    /** Rilascio **/
+    munmap(*anelli, sizeof(Anelli));
+    *anelli = NULL;
+}
+
+
+/**
+ * @brief                   Scrive una richiesta v2 nell'anello
+ * @fun                     scriviRichiestaAnello
+ * @param anello            Anello delle richieste
+ * @param intestazione      Intestazione della richiesta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno: EMSGSIZE se
+ *                          il frame supera ANELLO_MASSIMO_FRAME, ENOBUFS se l'anello e' pieno]
+ */
+ssize_t scriviRichiestaAnello(Anello *anello, Intestazione_Richiesta *intestazione, const Campo *campi, size_t numeroCampi) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((anello == NULL) || (intestazione == NULL)) { errno = EINVAL; return -1; }
+    if((numeroCampi > 0) && (campi == NULL)) { errno = EINVAL; return -1; }
+
+    /** Scrittura **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return scriviFrame(anello, intestazione, sizeof(Intestazione_Richiesta), campi, numeroCampi, intestazione->lunghezza);
+}
+
+
+/**
+ * @brief                   Scrive una risposta v2 nell'anello e sveglia il client se dorme
+ * @fun                     scriviRispostaAnello
+ * @param anello            Anello delle risposte
+ * @param intestazione      Intestazione della risposta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno: EMSGSIZE se
+ *                          il frame supera ANELLO_MASSIMO_FRAME, ENOBUFS se l'anello e' pieno]
+ */
+ssize_t scriviRispostaAnello(Anello *anello, Intestazione_Risposta *intestazione, const Campo *campi, size_t numeroCampi) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((anello == NULL) || (intestazione == NULL)) { errno = EINVAL; return -1; }
+    if((numeroCampi > 0) && (campi == NULL)) { errno = EINVAL; return -1; }
+
+    /** Scrittura **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return scriviFrame(anello, intestazione, sizeof(Intestazione_Risposta), campi, numeroCampi, intestazione->lunghezza);
+}
+
+
+/**
+ * @brief                   Preleva una richiesta v2 dall'anello
+ * @fun                     leggiRichiestaAnello
+ * @param anello            Anello delle richieste
+ * @param intestazione      Intestazione della richiesta
+ * @param corpo             Corpo della richiesta
+ * @param arena             Arena della connessione in cui ricevere il corpo (NULL per allocarlo con malloc)
+ * @return                  Ritorna il numero di bytes letti; 0 se l'anello e' vuoto; -1 in caso di errore [setta errno]
+ */
+ssize_t leggiRichiestaAnello(Anello *anello, Intestazione_Richiesta *intestazione, Corpo *corpo, Arena *arena) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((anello == NULL) || (intestazione == NULL)) { errno = EINVAL; return -1; }
+
+    /** Lettura **/
+    return leggiFrame(anello, arena, intestazione, sizeof(Intestazione_Richiesta), &(intestazione->lunghezza), corpo);
+}
+
+
+/**
+ * @brief                   Preleva una risposta v2 dall'anello (il corpo viene allocato con malloc)
+ * @fun                     leggiRispostaAnello
+ * @param anello            Anello delle risposte
+ * @param intestazione      Intestazione della risposta
+ * @param corpo             Corpo della risposta
+ * @return                  Ritorna il numero di bytes letti; 0 se l'anello e' vuoto; -1 in caso di errore [setta errno]
+ */
+ssize_t leggiRispostaAnello(Anello *anello, Intestazione_Risposta *intestazione, Corpo *corpo) {
+    /** Controllo parametri **/
+    errno = 0;
+    if((anello == NULL) || (intestazione == NULL)) { errno = EINVAL; return -1; }
+
+    /** Lettura **/
+    return leggiFrame(anello, NULL, intestazione, sizeof(Intestazione_Risposta), &(intestazione->lunghezza), corpo);
+}
+
+
+/**
+ * @brief                   Copia l'intestazione del prossimo frame senza consumarlo
+ * @fun                     sbirciaAnello
+ * @param anello            Anello da controllare
+ * @param intestazione      Intestazione da riempire
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @return                  Ritorna (0) se c'e' un frame; (-1) altrimenti
+ */
+int sbirciaAnello(const Anello *anello, void *intestazione, size_t dimIntestazione) {
+    /** Variabili **/
+    int64_t pronti = -1;
+    int error = errno;
+
+    /** Copio l'intestazione **/
+    pronti = occupati(anello);
+    errno = error;
+    if(pronti < (int64_t) dimIntestazione) return -1;
+    copiaDallAnello(anello, __atomic_load_n(&(anello->letti), __ATOMIC_RELAXED), intestazione, dimIntestazione);
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Verifica se l'anello e' vuoto
+ * @fun                     anelloVuoto
+ * @param anello            Anello da controllare
+ * @return                  Ritorna (1) se non ci sono frame da prelevare; (0) altrimenti
+ */
+int anelloVuoto(const Anello *anello) {
+    return __atomic_load_n(&(anello->scritti), __ATOMIC_ACQUIRE) == __atomic_load_n(&(anello->letti), __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief                   Attende sul futex dell'anello che arrivi un frame. Il consumatore annuncia l'attesa
+ *                          prima di ricontrollare il contatore: il produttore lo sveglia solo se l'ha annunciata
+ * @fun                     attendiAnello
+ * @param anello            Anello da attendere
+ * @param msec              Attesa massima in millisecondi
+ * @return                  Ritorna (0) se l'anello non e' vuoto; (-1) allo scadere dell'attesa [setta errno]
+ */
+int attendiAnello(Anello *anello, int msec) {
+    /** Variabili **/
+    struct timespec attesa = { msec / 1000, (msec % 1000) * 1000000L };
+    uint32_t visto = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(anello == NULL) { errno = EINVAL; return -1; }
+
+    /** Attesa **/
+    if(!anelloVuoto(anello)) return 0;
+    __atomic_store_n(&(anello->inAttesa), 1, __ATOMIC_SEQ_CST);
+    visto = __atomic_load_n(&(anello->scritti), __ATOMIC_SEQ_CST);
+    if(visto == __atomic_load_n(&(anello->letti), __ATOMIC_RELAXED)) {
+        syscall(SYS_futex, &(anello->scritti), FUTEX_WAIT, visto, &attesa, NULL, 0);
+    }
+    __atomic_store_n(&(anello->inAttesa), 0, __ATOMIC_RELAXED);
+    if(!anelloVuoto(anello)) {
+        errno = 0;
+        return 0;
+    }
+
+    errno = ETIMEDOUT;
+    return -1;
+}
+
+
+/**
+ * @brief                   Crea il campanello (eventfd non bloccante) con cui il client segnala al server nuove richieste
+ * @fun                     creaCampanello
+ * @return                  Ritorna il campanello; -1 in caso di errore [setta errno]
+ */
+int creaCampanello(void) {
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+
+/**
+ * @brief                   Suona il campanello
+ * @fun                     suonaCampanello
+ * @param campanello        Campanello da suonare
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int suonaCampanello(int campanello) {
+    /** Variabili **/
+    uint64_t uno = 1;
+    ssize_t scritti = -1;
+
+    /** Suono: con il contatore al massimo il server deve ancora svegliarsi, quindi va bene lo stesso **/
+    while(((scritti = write(campanello, &uno, sizeof(uint64_t))) == -1) && (errno == EINTR));
+    if((scritti == -1) && (errno != EAGAIN)) return -1;
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Azzera il campanello senza bloccarsi
+ * @fun                     azzeraCampanello
+ * @param campanello        Campanello da azzerare
+ */
+void azzeraCampanello(int campanello) {
+    /** Variabili **/
+    uint64_t contatore = 0;
+    int error = errno;
+
+    /** Azzero **/
+    if(read(campanello, &contatore, sizeof(uint64_t)) == -1) errno = error;
+}
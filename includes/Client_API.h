@@ -19,6 +19,9 @@
     #define O_CREATE 127
     #define O_LOCK 128
 
+    /** Prefisso del sockname che indica il listener TCP del server ("tcp:indirizzo:porta") **/
+    #define PREFISSO_TCP "tcp:"
+
 
     #include <stdlib.h>
     #include <stdio.h>
@@ -33,9 +36,15 @@
     #include <signal.h>
     #include <sys/un.h>
     #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
     #include <dirent.h>
     #include <limits.h>
     #include <queue.h>
+    #include <poll.h>
+    #include <stdarg.h>
+    #include <protocol.h>
 
 
     /**
@@ -105,6 +114,32 @@
     int readFile(const char *, void **, size_t *);
 
 
+    /**
+     * @brief                   Legge un file dal server restituendone una mappatura in sola lettura (i file grandi
+     *                          arrivano come memfd e non vengono copiati)
+     * @fun                     mapFile
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int mapFile(const char *, void **, size_t *);
+
+
+    /**
+     * @brief                   Rilascia la mappatura restituita da mapFile
+     * @fun                     unmapFile
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int unmapFile(void *, size_t);
+
+
+    /**
+     * @brief               Legge dal server solo una porzione del file (offset e lunghezza, 0 per arrivare alla fine)
+     *                      insieme alla sua dimensione attuale
+     * @fun                 readFileRange
+     * @return              Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int readFileRange(const char *, size_t, size_t, void **, size_t *, size_t *);
+
+
     /**
      * @brief               Legge N file random e li scrive nella dirname
      * @fun                 readNFiles
@@ -114,6 +149,14 @@
     int readNFiles(int, const char *);
 
 
+    /**
+     * @brief               Legge dal server una lista di file indicati per nome, con l'esito di ogni lettura
+     * @fun                 readFiles
+     * @return              Ritorna il numero di file letti; in caso di errore ritorna (-1) [setta errno]
+     */
+    int readFiles(char **, int, void **, size_t *, int *);
+
+
     /**
      * brief                Scrive tutto il file puntato da pathname nel server
      * @fun                 writeFile
@@ -130,6 +173,68 @@
     int appendToFile(const char *, void *, size_t, const char *);
 
 
+    /**
+     * @brief               Sovrascrive il contenuto di un file del server a partire da un offset, estendendolo se
+     *                      necessario (file aperto e in lock dal client, solo protocollo v2)
+     * @fun                 writeAt
+     * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int writeAt(const char *, size_t, void *, size_t, const char *);
+
+
+    /**
+     * @brief               Crea nel server un file gia' completo del suo contenuto (con O_LOCK resta aperto e in lock)
+     * @fun                 putFile
+     * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int putFile(const char *, void *, size_t, int, const char *);
+
+
+    /**
+     * @brief                   Crea nel server un file gia' completo del contenuto del file regolare aperto sul
+     *                          descrittore indicato (con il protocollo v2 il descrittore viene passato al server)
+     * @fun                     putFileFromFd
+     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int putFileFromFd(const char *, int, int, const char *);
+
+
+    /**
+     * @brief                   Registra nel server la cartella in cui salvare direttamente i file espulsi dalle
+     *                          scritture del client (NULL annulla la registrazione; solo protocollo v2 su AF_UNIX)
+     * @fun                     registerEvictionDir
+     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int registerEvictionDir(const char *);
+
+
+    /**
+     * @brief                   Sceglie come ricevere i file espulsi dalle proprie scritture: nella risposta
+     *                          (ESPULSI_IN_RISPOSTA) o in notifiche separate (ESPULSI_CONTENUTO, ESPULSI_NOMI),
+     *                          oppure per niente (ESPULSI_SCARTA); solo protocollo v2
+     * @fun                     subscribeEvictions
+     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int subscribeEvictions(int);
+
+
+    /**
+     * @brief                   Preleva senza bloccarsi il prossimo file espulso notificato dal server
+     * @fun                     nextEviction
+     * @return                  (1) se ha prelevato un file; (0) se non ci sono notifiche; (-1) altrimenti [setta errno]
+     */
+    int nextEviction(char **, void **, size_t *);
+
+
+    /**
+     * @brief                   Pubblica un file nel segmento condiviso del server, da cui readFile lo legge senza
+     *                          chiamate di sistema e senza bisogno di averlo aperto (solo protocollo v2)
+     * @fun                     publishFile
+     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int publishFile(const char *);
+
+
     /**
      * @brief               Effettua la lock di 'pathname' nel server
      * @fun                 lockFile
@@ -165,4 +270,176 @@
     int removeFile(const char *);
 
 
+    /**
+     * @brief                   Imposta il numero massimo di richieste v2 in volo sulla connessione
+     * @fun                     setInFlightWindow
+     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int setInFlightWindow(int);
+
+
+    /**
+     * @brief                   Abilita o disabilita gli anelli in memoria condivisa per le connessioni aperte in seguito
+     * @fun                     setSharedRings
+     * @return                  Ritorna sempre (0)
+     */
+    int setSharedRings(int);
+
+
+    /**
+     * @brief                   Invia una openFile senza attenderne la risposta (solo protocollo v2)
+     * @fun                     openFileAsync
+     * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+     */
+    int openFileAsync(const char *, int);
+
+
+    /**
+     * @brief                   Invia una readFile senza attenderne la risposta (solo protocollo v2)
+     * @fun                     readFileAsync
+     * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+     */
+    int readFileAsync(const char *);
+
+
+    /**
+     * @brief                   Invia una lockFile senza attenderne la risposta (solo protocollo v2)
+     * @fun                     lockFileAsync
+     * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+     */
+    int lockFileAsync(const char *);
+
+
+    /**
+     * @brief                   Invia una unlockFile senza attenderne la risposta (solo protocollo v2)
+     * @fun                     unlockFileAsync
+     * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+     */
+    int unlockFileAsync(const char *);
+
+
+    /**
+     * @brief                   Invia una closeFile senza attenderne la risposta (solo protocollo v2)
+     * @fun                     closeFileAsync
+     * @return                  Ritorna l'id da passare a waitResponse; (-1) in caso di errore [setta errno]
+     */
+    int closeFileAsync(const char *);
+
+
+    /**
+     * @brief                   Attende la risposta di una richiesta asincrona (per readFileAsync riporta il file)
+     * @fun                     waitResponse
+     * @return                  Ritorna (0) se l'operazione ha avuto successo; (-1) altrimenti [setta errno]
+     */
+    int waitResponse(int, void **, size_t *);
+
+
+    /**
+     * @brief                   Apre un file gia' presente nel server e ne riceve la maniglia, con cui le richieste
+     *                          successive lo indicano al posto del pathname (solo protocollo v2)
+     * @fun                     openHandle
+     * @return                  Ritorna la maniglia (maggiore di 0); (-1) in caso di errore [setta errno: ESTALE nelle
+     *                          richieste sulla maniglia se il file ha lasciato il server]
+     */
+    int openHandle(const char *);
+
+
+    /**
+     * @brief                   Legge un file indicato dalla sua maniglia
+     * @fun                     readHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int readHandle(int, void **, size_t *);
+
+
+    /**
+     * @brief                   Aggiunge dati al file indicato dalla sua maniglia
+     * @fun                     appendToHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int appendToHandle(int, void *, size_t, const char *);
+
+
+    /**
+     * @brief                   Effettua la lock del file indicato dalla sua maniglia
+     * @fun                     lockHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int lockHandle(int);
+
+
+    /**
+     * @brief                   Effettua la unlock del file indicato dalla sua maniglia
+     * @fun                     unlockHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int unlockHandle(int);
+
+
+    /**
+     * @brief                   Chiude il file indicato dalla sua maniglia
+     * @fun                     closeHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int closeHandle(int);
+
+
+    /**
+     * @brief                   Legge una porzione del file indicato dalla sua maniglia
+     * @fun                     readHandleRange
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int readHandleRange(int, size_t, size_t, void **, size_t *, size_t *);
+
+
+    /**
+     * @brief                   Sovrascrive il file indicato dalla sua maniglia a partire da un offset
+     * @fun                     writeAtHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int writeAtHandle(int, size_t, void *, size_t, const char *);
+
+
+    /**
+     * @brief                   Rimuove dal server il file indicato dalla sua maniglia
+     * @fun                     removeHandle
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int removeHandle(int);
+
+
+    /**
+     * @brief                   Operazione di una richiesta composta
+     * @struct                  Operazione_Composta
+     * @param operazione        OP_OPENFILE, OP_READFILE, OP_APPENDTOFILE, OP_LOCKFILE, OP_UNLOCKFILE, OP_CLOSEFILE
+     *                          o OP_REMOVEFILE
+     * @param flags             Flag di OP_OPENFILE (con FLAG_MANIGLIA riceve la maniglia del file in maniglia)
+     * @param pathname          Pathname del file (ignorato se maniglia e' maggiore di 0)
+     * @param maniglia          Maniglia del file data da openHandle (0 per indicarlo col pathname)
+     * @param buf               Dati da aggiungere (OP_APPENDTOFILE) o contenuto letto (OP_READFILE, NULL o allocato
+     *                          con malloc)
+     * @param size              Dimensione di buf
+     * @param esito             Esito dell'operazione: 0 in caso di successo; ECANCELED se non e' stata eseguita
+     */
+    typedef struct {
+        int operazione;
+        int flags;
+        const char *pathname;
+        int maniglia;
+        void *buf;
+        size_t size;
+        int esito;
+    } Operazione_Composta;
+
+
+    /**
+     * @brief                   Esegue piu' operazioni in un'unica richiesta: il server le esegue in ordine e si ferma
+     *                          alla prima che fallisce (solo protocollo v2)
+     * @fun                     compoundRequest
+     * @return                  Ritorna (0) se tutte hanno avuto successo; (-1) altrimenti [setta errno: l'esito
+     *                          dell'operazione fallita]
+     */
+    int compoundRequest(Operazione_Composta *, int, const char *);
+
+
 #endif //FILE_STORAGE_SERVER_LRU_CLIENT_API_H
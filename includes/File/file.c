@@ -7,7 +7,11 @@
  */
 
 
+#define _GNU_SOURCE
 #include "file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 
 /**
@@ -89,6 +93,9 @@ myFile* createFile(const char *pathname, unsigned int maxUtentiConnessiAlFile, p
     memset(file->utentiConnessi, -1, maxUtentiConnessiAlFile*sizeof(unsigned int));
     file->maxUtentiConnessiAlFile = maxUtentiConnessiAlFile;
     file->utenteLock = -1;
+    file->copiaSigillata = -1;
+    file->voceCondivisa = -1;
+    file->posto = -1;
 
 
     /** File creato correttamente **/
@@ -118,15 +125,15 @@ size_t addContentToFile(myFile *file, void *toAdd, size_t sizeToAdd) {
     if(toAdd == NULL) { errno = EINVAL; return -1; }
     if(sizeToAdd <= 0) { errno = EINVAL; return -1; }
 
-    /** Aggiungo il contenuto al file **/
-    if((copyBuffer = malloc(sizeToAdd+file->size)) == NULL) {
+    /** Aggiungo il contenuto al file (realloc evita di ricopiare il contenuto gia' presente se puo' estendere il buffer) **/
+    if((copyBuffer = realloc(file->buffer, sizeToAdd+file->size)) == NULL) {
         return -1;
     }
-    memcpy(copyBuffer, file->buffer, file->size);
-    memcpy(copyBuffer+file->size, toAdd, sizeToAdd);
-    free(file->buffer);
+    memcpy((char *) copyBuffer+file->size, toAdd, sizeToAdd);
     file->size += sizeToAdd;
     file->buffer = copyBuffer;
+    dropSealedCopy(file);
+    refreshPublishedFile(file);
 
     /** Contento aggiornato **/
     updateTime(file);
@@ -135,6 +142,214 @@ size_t addContentToFile(myFile *file, void *toAdd, size_t sizeToAdd) {
 }
 
 
+/**
+ * @brief                       Aggiorna il contenuto di 'file' aggiungendo in append 'sizeToAdd' bytes letti
+ *                              da 'source', ricevuti direttamente nel buffer del file
+ * @fun                         addContentFromFd
+ * @param file                  File da aggiornare
+ * @param source                Descrittore (file regolare) da cui leggere, a partire dal suo inizio
+ * @param sizeToAdd             Numero di bytes da leggere
+ * @return                      Ritorna la dimensione finale del file; in caso di errore ritorna (-1) e setta errno
+ *                              (EIO se 'source' e' piu' corto di 'sizeToAdd')
+ */
+size_t addContentFromFd(myFile *file, int source, size_t sizeToAdd) {
+    /** Variabili **/
+    void *copyBuffer = NULL;
+    size_t letti = 0;
+    ssize_t n = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(file == NULL) { errno = EINVAL; return -1; }
+    if(source < 0) { errno = EINVAL; return -1; }
+    if(sizeToAdd <= 0) { errno = EINVAL; return -1; }
+
+    /** Estendo il buffer e ci leggo il contenuto senza copie intermedie **/
+    if((copyBuffer = realloc(file->buffer, sizeToAdd+file->size)) == NULL) {
+        return -1;
+    }
+    file->buffer = copyBuffer;
+    while(letti < sizeToAdd) {
+        if((n = pread(source, (char *) copyBuffer + file->size + letti, sizeToAdd - letti, (off_t) letti)) == -1) {
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        if(n == 0) { errno = EIO; return -1; }
+        letti += n;
+    }
+    file->size += sizeToAdd;
+    dropSealedCopy(file);
+    refreshPublishedFile(file);
+
+    /** Contento aggiornato **/
+    updateTime(file);
+    errno = 0;
+    return file->size;
+}
+
+
+/**
+ * @brief                       Sovrascrive il contenuto di 'file' a partire da 'offset', estendendolo se necessario
+ *                              (l'eventuale spazio tra la fine del file e 'offset' viene riempito di zeri)
+ * @fun                         writeContentAt
+ * @param file                  File da aggiornare
+ * @param offset                Posizione da cui scrivere
+ * @param toWrite               Buffer da scrivere
+ * @param sizeToWrite           Dimensione del buffer
+ * @return                      Ritorna la dimensione finale del file; in caso di errore ritorna (-1) e setta errno
+ */
+size_t writeContentAt(myFile *file, size_t offset, void *toWrite, size_t sizeToWrite) {
+    /** Variabili **/
+    void *copyBuffer = NULL;
+    size_t finalSize = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(file == NULL) { errno = EINVAL; return -1; }
+    if(toWrite == NULL) { errno = EINVAL; return -1; }
+    if(sizeToWrite <= 0) { errno = EINVAL; return -1; }
+    if(offset > ((size_t) -1) - sizeToWrite - 1) { errno = EFBIG; return -1; }
+
+    /** Estendo il buffer solo se la scrittura supera la fine del file **/
+    finalSize = ((offset + sizeToWrite) > file->size) ? (offset + sizeToWrite) : file->size;
+    if(finalSize > file->size) {
+        if((copyBuffer = realloc(file->buffer, finalSize)) == NULL) {
+            return -1;
+        }
+        if(offset > file->size) memset((char *) copyBuffer + file->size, 0, offset - file->size);
+        file->buffer = copyBuffer;
+    }
+    memcpy((char *) file->buffer + offset, toWrite, sizeToWrite);
+    file->size = finalSize;
+    dropSealedCopy(file);
+    refreshPublishedFile(file);
+
+    /** Contento aggiornato **/
+    updateTime(file);
+    errno = 0;
+    return file->size;
+}
+
+
+/**
+ * @brief                       Restituisce la copia sigillata (memfd in sola lettura) del contenuto di 'file',
+ *                              creandola alla prima richiesta: resta valida finche' il contenuto non cambia
+ * @fun                         sealedCopyOfFile
+ * @param file                  File di cui ottenere la copia
+ * @return                      Ritorna il descrittore della copia (appartiene al file: va duplicato per
+ *                              consegnarlo); in caso di errore ritorna (-1) e setta errno
+ */
+int sealedCopyOfFile(myFile *file) {
+    /** Variabili **/
+    int copia = -1, error = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(file == NULL) { errno = EINVAL; return -1; }
+    if(file->copiaSigillata >= 0) return file->copiaSigillata;
+
+    /** Copio il contenuto nel memfd e lo sigillo: chi lo riceve non puo' modificarlo **/
+    if((copia = memfd_create(file->pathname, MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) {
+        return -1;
+    }
+    if((file->size > 0) && (writen(copia, file->buffer, file->size) != file->size)) {
+        error = (errno != 0) ? errno : EIO;
+        close(copia);
+        errno = error;
+        return -1;
+    }
+    if(fcntl(copia, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+        error = errno;
+        close(copia);
+        errno = error;
+        return -1;
+    }
+    file->copiaSigillata = copia;
+
+    errno = 0;
+    return copia;
+}
+
+
+/**
+ * @brief                       Chiude la copia sigillata di 'file' (chi l'ha gia' ricevuta continua a vederla)
+ * @fun                         dropSealedCopy
+ * @param file                  File di cui eliminare la copia
+ */
+void dropSealedCopy(myFile *file) {
+    /** Controllo parametri **/
+    if((file == NULL) || (file->copiaSigillata < 0)) return;
+
+    /** Chiudo la copia **/
+    close(file->copiaSigillata);
+    file->copiaSigillata = -1;
+}
+
+
+/**
+ * @brief                       Pubblica il contenuto di 'file' nel segmento condiviso: i client lo leggono da
+ *                              li' senza passare dal server finche' il file non viene modificato o rimosso
+ * @fun                         publishFileContent
+ * @param file                  File da pubblicare
+ * @param segmento              Segmento condiviso
+ * @return                      Ritorna (0) in caso di successo; in caso di errore ritorna (-1) e setta errno
+ *                              (EFBIG se il contenuto non sta in una voce, ENOSPC se il segmento e' pieno)
+ */
+int publishFileContent(myFile *file, Segmento *segmento) {
+    /** Variabili **/
+    int voce = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((file == NULL) || (segmento == NULL)) { errno = EINVAL; return -1; }
+
+    /** Pubblico **/
+    if((voce = pubblicaVoce(segmento, file, file->pathname, file->buffer, file->size)) == -1) {
+        return -1;
+    }
+    file->segmento = segmento;
+    file->voceCondivisa = voce;
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                       Aggiorna la voce di 'file' nel segmento condiviso dopo una modifica: se il nuovo
+ *                              contenuto non ci sta piu' il file viene ritirato e i client lo leggono dal server
+ * @fun                         refreshPublishedFile
+ * @param file                  File modificato
+ */
+void refreshPublishedFile(myFile *file) {
+    /** Variabili **/
+    int errnoSalvato = errno;
+
+    /** Controllo parametri **/
+    if((file == NULL) || (file->segmento == NULL)) return;
+
+    /** Ripubblico **/
+    if(publishFileContent(file, file->segmento) == -1) withdrawPublishedFile(file);
+    errno = errnoSalvato;
+}
+
+
+/**
+ * @brief                       Ritira 'file' dal segmento condiviso
+ * @fun                         withdrawPublishedFile
+ * @param file                  File da ritirare
+ */
+void withdrawPublishedFile(myFile *file) {
+    /** Controllo parametri **/
+    if((file == NULL) || (file->segmento == NULL)) return;
+
+    /** Ritiro la voce **/
+    ritiraVoce(file->segmento, file->voceCondivisa, file);
+    file->segmento = NULL;
+    file->voceCondivisa = -1;
+}
+
+
 /**
  * @brief                   Controlla che 'fd' abbia aperto 'file'
  * @fun                     fileIsOpenedFrom
@@ -386,6 +601,8 @@ void destroyFile(myFile **file) {
     if((*file)->pathname != NULL) free((*file)->pathname);
     if((*file)->buffer != NULL) free((*file)->buffer);
     if((*file)->utentiConnessi != NULL) free((*file)->utentiConnessi);
+    dropSealedCopy(*file);
+    withdrawPublishedFile(*file);
     destroyQueue(&((*file)->utentiLocked), free);
     free(*file);
 
@@ -21,11 +21,13 @@
     #include <errno.h>
     #include <pthread.h>
     #include <math.h>
+    #include <sys/stat.h>
     #include <icl_hash.h>
     #include <file.h>
     #include <logFile.h>
     #include <utils.h>
     #include <queue.h>
+    #include <corsie.h>
 
 
     #define DEFAULT_NUMERO_THREAD_WORKER 10
@@ -33,26 +35,57 @@
     #define DEFAULT_SOCKET "./socket.sk"
     #define DEFUALT_MAX_NUMERO_FILE 20
     #define DEFUALT_MAX_NUMERO_UTENTI 15
+    #define DEFAULT_DIM_CODA_TASK 64
+    #define MASSIMA_CODA_TASK (1 << 20)
+    #define MASSIMO_SEGMENTO_KB (1L << 22)
+    #define DEFAULT_SPIN_WORKER 512
+    #define DEFAULT_SOGLIA_MEMFD_KB 1024
+    #define DEFAULT_SEGMENTO_CONDIVISO_KB 0
 
 
     /**
      * @brief                           Struttura che contiene le informazioni di base del server lette nel config file
      * @struct                          Settings
      * @param socket                    Socket usato per la comunicazione client-server
+     * @param socketPacchetti           Socket SOCK_SEQPACKET aggiuntivo, solo protocollo v2 (NULL se non richiesto)
+     * @param indirizzoTcp              Indirizzo IPv4 del listener TCP aggiuntivo (NULL se non richiesto)
+     * @param portaTcp                  Porta del listener TCP
      * @param maxMB                     Numero massimo di MB che posso caricare
-     * @param numeroThreadWorker        Numero di thread da avviare nel pool
+     * @param numeroThreadWorker        Numero di thread da avviare nel pool (numero minimo di thread)
+     * @param maxThreadWorker           Numero massimo di thread del pool, compresi gli aiutanti creati sotto carico
      * @param maxNumeroFileCaricaribili Numero massimo di file da caricare nel server
      * @param maxUtentuConnessi         Numero massimo di utenti che posso far connettere al server
      * @param maxUtentiPerFile          Numero massimo di utenti che puo' aprire il file contemporaneamente
+     * @param dimCodaTask               Capacita' della coda globale dei task del pool di thread
+     * @param affinitaConnessioni       Se le richieste di una connessione vanno sempre allo stesso thread worker
+     * @param cpuWorker                 Lista delle CPU su cui fissare i thread worker (NULL se non richiesto)
+     * @param numeroCpuWorker           Lunghezza della lista delle CPU
+     * @param spinWorker                Giri massimi di attesa attiva dei thread worker prima di sospendersi (0 la disattiva)
+     * @param busyPoll                  Se i thread worker fissi interrogano le code senza mai sospendersi
+     * @param sogliaMemfdKB             Dimensione in KB oltre la quale un file letto viene consegnato come memfd
+     *                                  sigillato invece che copiato sul socket (0 la disattiva)
+     * @param segmentoCondivisoKB       Dimensione in KB del segmento condiviso con i file pubblicati (0 lo disattiva)
      */
     typedef struct {
         /** Capacita' del server **/
         char *socket;
+        char *socketPacchetti;
+        char *indirizzoTcp;
+        unsigned short portaTcp;
         ssize_t maxMB;
         unsigned int numeroThreadWorker;
+        unsigned int maxThreadWorker;
         unsigned int maxNumeroFileCaricabili;
         unsigned int maxUtentiConnessi;
         unsigned int maxUtentiPerFile;
+        unsigned int dimCodaTask;
+        int affinitaConnessioni;
+        int *cpuWorker;
+        unsigned int numeroCpuWorker;
+        unsigned int spinWorker;
+        int busyPoll;
+        size_t sogliaMemfdKB;
+        size_t segmentoCondivisoKB;
     } Settings;
 
 
@@ -81,6 +114,31 @@
     } userLink;
 
 
+    /**
+     * @brief                   Maniglia di un file della cache: lo trova senza cercarne il pathname nella tabella
+     * @struct                  Maniglia_File
+     * @param posto             Posto del file nella tabella delle maniglie
+     * @param generazione       Generazione del posto quando la maniglia e' stata data: cambia quando il file
+     *                          lascia la cache, cosi' una maniglia vecchia non trova il file che ne ha preso il posto
+     */
+    typedef struct {
+        unsigned int posto;
+        unsigned int generazione;
+    } Maniglia_File;
+
+
+    /**
+     * @brief                   Posto della tabella delle maniglie
+     * @struct                  Posto_File
+     * @param file              File che occupa il posto (NULL se libero)
+     * @param generazione       Generazione attuale del posto (parte da 1)
+     */
+    typedef struct {
+        myFile *file;
+        unsigned int generazione;
+    } Posto_File;
+
+
     /**
      * @brief                               Struttura dati per rappresentare la cache con politica LRU
      * @struct                              LRU_Memory
@@ -94,10 +152,16 @@
      * @param log                           File di log per il tracciamento delle operazioni della cache
      * @param LRU_Access                    Mutex per l'accesso concorrente nella tabella
      * @param Files_Access                  Mutex che vengono assegnate ai file per l'accesso agli stessi in modo concorrente
+     * @param posti                         Tabella delle maniglie, un posto per ogni file che la cache puo' contenere
+     * @param postiLiberi                   Pila dei posti liberi
+     * @param numeroPostiLiberi             Numero dei posti liberi
      * @param maxBytesOnline                Numero massimo di bytes che posso memorizzare nella cache
      * @param maxUsersLoggedOnline          Numero massimo di connessioni nel server
      * @param maxFileOnline                 Numero massimo di file che posso caricare in memoria cache
      * @param maxUtentiPerFile              Numero massimo di utenti che posso aprire un singolo file contemporaneamente
+     * @param sogliaMemfd                   Dimensione in bytes oltre la quale i file letti vengono consegnati come
+     *                                      memfd sigillati (0 se disattivato)
+     * @param segmento                      Segmento condiviso con i file pubblicati (NULL se disattivato)
      * @param bytesOnline                   Numero di bytes caricati in quel'istante
      * @param fileOnline                    Numero di file caricati in quel momento
      * @param usersLoggedNow                Numero di utenti connessi in questo istante
@@ -105,6 +169,11 @@
      * @param numeroMassimoBytesCaricato    Numero massimo di byte che sono stati caricati
      * @param numeroMemoryMiss              Numero di espulsioni che la cache ha fatto
      * @param numTotLogin                   Numero di login totali nel server
+     * @param numeroCodaPiena               Numero di volte in cui la coda dei task era piena e le richieste
+     *                                      sono rimaste nel socket
+     * @param richiesteCorsia               Numero di richieste servite per corsia del pool [accesso atomico]
+     * @param latenzaTotaleCorsia           Somma delle latenze (attesa in coda ed esecuzione) per corsia in us [accesso atomico]
+     * @param latenzaMassimaCorsia          Latenza massima per corsia in us [accesso atomico]
      */
     typedef struct {
         /** Strutture dati **/
@@ -117,12 +186,17 @@
         serverLogFile *log;
         pthread_mutex_t *LRU_Access;
         pthread_mutex_t *Files_Access;
+        Posto_File *posti;
+        unsigned int *postiLiberi;
+        unsigned int numeroPostiLiberi;
 
         /** Informazioni capacitive **/
         size_t maxBytesOnline;
         unsigned int maxUsersLoggedOnline;
         unsigned int maxFileOnline;
         unsigned int maxUtentiPerFile;
+        size_t sogliaMemfd;
+        Segmento *segmento;
 
         /** Valori attuali **/
         size_t bytesOnline;
@@ -135,6 +209,10 @@
         size_t numeroMassimoBytesCaricato;
         unsigned int numeroMemoryMiss;
         unsigned int numTotLogin;
+        unsigned int numeroCodaPiena;
+        unsigned long richiesteCorsia[NUMERO_CORSIE];
+        unsigned long latenzaTotaleCorsia[NUMERO_CORSIE];
+        unsigned long latenzaMassimaCorsia[NUMERO_CORSIE];
     } LRU_Memory;
 
 
@@ -195,13 +273,22 @@
     int openFileOnCache(LRU_Memory *cache, const char *pathname, int openFD);
 
 
+    /**
+     * @brief                       Da' la maniglia di un file della cache aperto da 'fd': le operazioni che la ricevono
+     *                              trovano il file senza cercarne il pathname nella tabella
+     * @fun                         handleOnCache
+     * @return                      (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int handleOnCache(LRU_Memory *, const char *, int, Maniglia_File *);
+
+
     /**
      * @brief                   Chiude un file aperto da 'closeFD' (e lo unlocka se anche locked)
      * @fun                     closeFileOnCache
      * @return                  In caso di successo ritorna 0 o FD del client che ora detiene la lock
      *                          del file dopo 'closeFD'; -1 altrimenti e setta errno
      */
-    int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD);
+    int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD, const Maniglia_File *maniglia);
 
 
     /**
@@ -218,7 +305,7 @@
      * @fun                     removeFileOnCache
      * @return                  Ritorna il file cancellato; in caso di errore ritorna NULL [setta errno]
      */
-    myFile* removeFileOnCache(LRU_Memory *, const char *, int);
+    myFile* removeFileOnCache(LRU_Memory *, const char *, int, const Maniglia_File *);
 
 
     /**
@@ -226,7 +313,34 @@
     * @fun                         appendFile
     * @return                      Ritorna gli eventuali file espulsi; in caso di errore valutare se si setta errno
     */
-    myFile** appendFile(LRU_Memory *, const char *, int, void *, size_t);
+    myFile** appendFile(LRU_Memory *, const char *, int, void *, size_t, const Maniglia_File *);
+
+
+    /**
+     * @brief                   Sovrascrive il contenuto di un file a partire da un offset, estendendolo se necessario
+     *                          (le espulsioni coprono solo la crescita del file)
+     * @fun                     writeAtOnCache
+     * @return                  Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+     */
+    myFile** writeAtOnCache(LRU_Memory *, const char *, int, size_t, void *, size_t, const Maniglia_File *);
+
+
+    /**
+     * @brief                   Inserisce nella cache un file nuovo gia' completo del suo contenuto, liberando
+     *                          lo spazio una sola volta per la dimensione finale
+     * @fun                     putFileOnCache
+     * @return                  Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+     */
+    myFile** putFileOnCache(LRU_Memory *, const char *, int, void *, size_t, int);
+
+
+    /**
+     * @brief                   Inserisce nella cache un file nuovo leggendone il contenuto dal descrittore di un file
+     *                          regolare passato dal client (con lock il file resta aperto e in lock dal client)
+     * @fun                     putFileFromFdOnCache
+     * @return                  Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+     */
+    myFile** putFileFromFdOnCache(LRU_Memory *, const char *, int, int, int, size_t *);
 
 
     /**
@@ -237,6 +351,32 @@
     size_t readFileOnCache(LRU_Memory *, const char *, int, void **);
 
 
+    /**
+     * @brief                   Consegna il contenuto di un file grande come memfd sigillato in sola lettura
+     * @fun                     shareFileOnCache
+     * @return                  Ritorna un descrittore del memfd da chiudere dopo l'invio; (-1) altrimenti,
+     *                          con errno EMSGSIZE se il file e' sotto la soglia [setta errno]
+     */
+    int shareFileOnCache(LRU_Memory *, const char *, int, size_t *, const Maniglia_File *);
+
+
+    /**
+     * @brief                   Legge una porzione del file (offset e lunghezza, 0 per arrivare alla fine)
+     *                          e riporta la dimensione attuale dell'intero file
+     * @fun                     readRangeOnCache
+     * @return                  Ritorna il numero di bytes letti; (-1) altrimenti [setta errno]
+     */
+    size_t readRangeOnCache(LRU_Memory *, const char *, int, size_t, size_t, void **, size_t *, const Maniglia_File *);
+
+
+    /**
+     * @brief                   Pubblica un file nel segmento condiviso, dove i client lo leggono senza passare dal server
+     * @fun                     publishFileOnCache
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int publishFileOnCache(LRU_Memory *, const char *, int);
+
+
     /**
      * @brief               Legge N file in ordine della LRU non locked
      * @fun                 readRandFiles
@@ -246,13 +386,22 @@
     myFile **readsRandFiles(LRU_Memory *, int, int *);
 
 
+    /**
+     * @brief                   Legge una lista di file indicati per nome risolvendoli tutti con un solo accesso alla tabella
+     * @fun                     readListOnCache
+     * @return                  Ritorna un array con le copie dei file richiesti (NULL dove la lettura non e' riuscita,
+     *                          con il motivo negli esiti); in caso di errore ritorna NULL [setta errno]
+     */
+    myFile** readListOnCache(LRU_Memory *, int, char **, size_t, int *);
+
+
     /**
      * @brief                   Effettua la lock su un file per quel fd
      * @fun                     lockFileOnCache
      * @return                  Ritorna (1) se il file e' locked gia'; (0) se la lock e' riuscita;
      *                          (-1) in caso di errore [setta errno]
      */
-    int lockFileOnCache(LRU_Memory *, const char *, int);
+    int lockFileOnCache(LRU_Memory *, const char *, int, int, const Maniglia_File *);
 
 
     /**
@@ -261,7 +410,7 @@
      * @return                  In caso di successo ritorna Fd del client da sbloccare;
      *                          (-1) in caso di errore [setta errno]
      */
-    int unlockFileOnCache(LRU_Memory *, const char *, int);
+    int unlockFileOnCache(LRU_Memory *, const char *, int, const Maniglia_File *);
 
 
     /**
@@ -269,9 +418,10 @@
      *                      su tutti i file in gestione a lui
      * @fun                 deleteClientFromCache
      * @return              Ritorna un puntatore ad un array di fd che specifica i client che sono in attesa dei file
-     *                      locked da 'fd'; altrimenti, in caso di errore, setta errno
+     *                      locked da 'fd' (e, se richiesto, l'array parallelo dei loro pathname);
+     *                      altrimenti, in caso di errore, setta errno
      */
-    int* deleteClientFromCache(LRU_Memory *, int);
+    int* deleteClientFromCache(LRU_Memory *, int, char ***);
 
 
     /**
@@ -6,6 +6,7 @@
  */
 
 #include "FileStorageServer.h"
+#include <ctype.h>
 
 
 /**
@@ -56,6 +57,8 @@
                 free(copy);                                                                                                                     \
                 return kickedFiles;                                                                                                             \
             }                              \
+            withdrawPublishedFile(kickedFiles[numKick-1]);                                                                                      \
+            liberaPosto(cache, kickedFiles[numKick-1]);                                                                                         \
             if((kickedFiles[numKick-1])->lockAccessFile != toAdd->lockAccessFile) {\
                 if((error = pthread_mutex_unlock((kickedFiles[numKick-1])->lockAccessFile)) != 0) {                                                          \
                     pthread_mutex_unlock(cache->LRU_Access);                               \
@@ -241,6 +244,70 @@ static void LRU_Update(myFile **LRU, unsigned int numElements) {
 }
 
 
+/**
+ * @brief                   Assegna a un file appena entrato nella cache un posto nella tabella delle maniglie.
+ *                          Va chiamata con LRU_Access acquisita
+ * @fun                     occupaPosto
+ * @param cache             Memoria cache
+ * @param file              File entrato nella cache
+ */
+static void occupaPosto(LRU_Memory *cache, myFile *file) {
+    /** Senza posti liberi il file resta senza maniglia **/
+    if(cache->numeroPostiLiberi == 0) { file->posto = -1; return; }
+    file->posto = (int) (cache->postiLiberi)[--(cache->numeroPostiLiberi)];
+    (cache->posti)[file->posto].file = file;
+}
+
+
+/**
+ * @brief                   Libera il posto di un file che lascia la cache: la generazione del posto avanza e le
+ *                          maniglie date fino ad ora non lo trovano piu'. Va chiamata con LRU_Access acquisita
+ * @fun                     liberaPosto
+ * @param cache             Memoria cache
+ * @param file              File che lascia la cache
+ */
+static void liberaPosto(LRU_Memory *cache, myFile *file) {
+    /** Controllo parametri **/
+    if(file->posto == -1) return;
+
+    /** Libero il posto **/
+    (cache->posti)[file->posto].file = NULL;
+    if(++((cache->posti)[file->posto].generazione) == 0) (cache->posti)[file->posto].generazione = 1;
+    (cache->postiLiberi)[(cache->numeroPostiLiberi)++] = (unsigned int) file->posto;
+    file->posto = -1;
+}
+
+
+/**
+ * @brief                   Trova un file della cache dalla sua maniglia o, se non c'e', dal pathname.
+ *                          Va chiamata con LRU_Access acquisita
+ * @fun                     cercaFile
+ * @param cache             Memoria cache
+ * @param pathname          Pathname del file (usato solo senza maniglia)
+ * @param maniglia          Maniglia del file (puo' essere NULL)
+ * @return                  Ritorna il file; NULL se non c'e' [setta errno: ENOENT, o ESTALE se il file della
+ *                          maniglia ha lasciato la cache]
+ */
+static myFile* cercaFile(LRU_Memory *cache, const char *pathname, const Maniglia_File *maniglia) {
+    /** Variabili **/
+    myFile *file = NULL;
+
+    /** Con la maniglia basta controllare la generazione del posto **/
+    if(maniglia != NULL) {
+        if((maniglia->posto >= cache->maxFileOnline) || ((cache->posti)[maniglia->posto].generazione != maniglia->generazione) ||
+           ((file = (cache->posti)[maniglia->posto].file) == NULL)) {
+            errno = ESTALE;
+            return NULL;
+        }
+        return file;
+    }
+
+    /** Senza maniglia cerco il pathname nella tabella **/
+    if((file = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) errno = ENOENT;
+    return file;
+}
+
+
 /**
  * @brief                   Funzione che gestisce le connessioni tra client e file
  * @fun                     linksManage
@@ -345,6 +412,99 @@ static Queue* linksManage(LRU_Memory *cache, int fd, void *cmp, int link, Compar
 }
 
 
+/**
+ * @brief                           Legge una lista di CPU separate da virgola (es. "0,1,2,3")
+ * @fun                             leggiListaCpu
+ * @param lista                     Stringa da leggere
+ * @param set                       Impostazioni in cui salvare la lista
+ * @return                          (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int leggiListaCpu(char *lista, Settings *set) {
+    /** Variabili **/
+    char *token = NULL, *save = NULL;
+    long cpu = -1;
+    unsigned int n = 1;
+
+    /** Conto gli elementi **/
+    for(char *c = lista; *c != '\0'; c++) if(*c == ',') n++;
+    if((set->cpuWorker = (int *) calloc(n, sizeof(int))) == NULL) {
+        return -1;
+    }
+
+    /** Leggo le CPU **/
+    set->numeroCpuWorker = 0;
+    token = strtok_r(lista, ", \t\n", &save);
+    while(token != NULL) {
+        if((cpu = isNumber(token)) < 0) {
+            free(set->cpuWorker);
+            set->cpuWorker = NULL, set->numeroCpuWorker = 0;
+            errno = EINVAL;
+            return -1;
+        }
+        (set->cpuWorker)[(set->numeroCpuWorker)++] = (int) cpu;
+        token = strtok_r(NULL, ", \t\n", &save);
+    }
+    if(set->numeroCpuWorker == 0) {
+        free(set->cpuWorker);
+        set->cpuWorker = NULL;
+    }
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                           Valore di una chiave del config file: la riga deve iniziare (spazi esclusi) proprio
+ *                                  con la chiave seguita da '=', cosi' che una chiave non venga presa per un'altra che
+ *                                  la contiene (es. "socket" e "socketPacchetti")
+ * @fun                             valoreChiave
+ * @param riga                      Riga del config file
+ * @param chiave                    Chiave cercata
+ * @return                          Ritorna il valore (dopo '=' e gli spazi); NULL se la riga non e' della chiave
+ */
+static char* valoreChiave(char *riga, const char *chiave) {
+    /** Variabili **/
+    size_t lunghezza = strlen(chiave);
+
+    /** Confronto la chiave **/
+    while(isspace((unsigned char) *riga)) riga++;
+    if(strncmp(riga, chiave, lunghezza) != 0) return NULL;
+    riga += lunghezza;
+    while((*riga == ' ') || (*riga == '\t')) riga++;
+    if(*riga != '=') return NULL;
+    riga++;
+    while((*riga == ' ') || (*riga == '\t')) riga++;
+
+    return riga;
+}
+
+
+/**
+ * @brief                           Converte il valore numerico di una chiave del config file, che deve essere un intero
+ *                                  (seguito solo da spazi) compreso nell'intervallo indicato
+ * @fun                             numeroChiave
+ * @param valore                    Valore da convertire
+ * @param minimo                    Valore minimo ammesso
+ * @param massimo                   Valore massimo ammesso
+ * @param numero                    Valore convertito
+ * @return                          (0) in caso di successo; (-1) se il valore non e' valido [setta errno]
+ */
+static int numeroChiave(const char *valore, long minimo, long massimo, long *numero) {
+    /** Variabili **/
+    char *fine = NULL;
+
+    /** Converto e controllo l'intervallo **/
+    errno = 0;
+    *numero = strtol(valore, &fine, 0);
+    if((fine == valore) || (errno == ERANGE)) { errno = EINVAL; return -1; }
+    while(isspace((unsigned char) *fine)) fine++;
+    if((*fine != '\0') || (*numero < minimo) || (*numero > massimo)) { errno = EINVAL; return -1; }
+
+    return 0;
+}
+
+
 /**
  * @brief                           Legge il contenuto del configFile del server e lo traduce in una struttura in memoria principale
  * @fun                             readConfigFile
@@ -353,8 +513,8 @@ static Queue* linksManage(LRU_Memory *cache, int fd, void *cmp, int link, Compar
  */
 Settings* readConfigFile(const char *configPathname) {
     /** Variabili **/
-    char *buffer = NULL, *commento = NULL, *opt = NULL;
-    int error = 0;
+    char *buffer = NULL, *commento = NULL, *opt = NULL, *porta = NULL;
+    int error = 0, spinLetto = 0, sogliaLetta = 0, segmentoLetto = 0, valoreErrato = 0;
     long valueOpt = -1;
     FILE *file = NULL;
     Settings *serverMemory = NULL;
@@ -386,11 +546,23 @@ Settings* readConfigFile(const char *configPathname) {
         if((serverMemory->maxMB == 0) && (strstr(buffer, "maxMB") != NULL) && ((opt = strrchr(buffer, '=')) != NULL) && ((valueOpt = isNumber(opt+1)) != -1)) { serverMemory->maxMB = valueOpt; continue; }
         else if(serverMemory->maxMB == 0) serverMemory->maxMB = DEFAULT_MAX_MB;
 
+        // Imposto il socket SOCK_SEQPACKET
+        if((serverMemory->socketPacchetti == NULL) && ((opt = valoreChiave(buffer, "socketPacchetti")) != NULL) && (strstr(opt, ".sk") != NULL)) {
+            if((serverMemory->socketPacchetti = (char *) calloc(MAX_BUFFER_LEN, sizeof(char))) == NULL) { error = errno; free(buffer); fclose(file); free(serverMemory->socket); free(serverMemory); errno = error; return NULL; }
+            strncpy(serverMemory->socketPacchetti, opt, MAX_BUFFER_LEN-1);
+            while((strnlen(serverMemory->socketPacchetti, MAX_BUFFER_LEN) > 0) && isspace((unsigned char) (serverMemory->socketPacchetti)[strnlen(serverMemory->socketPacchetti, MAX_BUFFER_LEN)-1])) {
+                (serverMemory->socketPacchetti)[strnlen(serverMemory->socketPacchetti, MAX_BUFFER_LEN)-1] = '\0';
+            }
+            continue;
+        }
+
         // Imposto il canale di comunicazione socket
         if((serverMemory->socket == NULL) && ((serverMemory->socket = (char *) calloc(MAX_BUFFER_LEN, sizeof(char))) == NULL)) { error = errno; free(buffer); fclose(file); free(serverMemory); errno = error; return NULL; }
-        if(((opt = strstr(buffer, "socket")) != NULL) && ((opt = strrchr(opt, '=')) != NULL) && (strstr(opt+1, ".sk") != NULL)) {
-            strncpy(serverMemory->socket, opt+1, strnlen(opt+1, MAX_BUFFER_LEN)-1);
-            (serverMemory->socket)[strnlen(serverMemory->socket, MAX_BUFFER_LEN)-1] = '\0';
+        if(((opt = valoreChiave(buffer, "socket")) != NULL) && (strstr(opt, ".sk") != NULL)) {
+            strncpy(serverMemory->socket, opt, MAX_BUFFER_LEN-1);
+            while((strnlen(serverMemory->socket, MAX_BUFFER_LEN) > 0) && isspace((unsigned char) (serverMemory->socket)[strnlen(serverMemory->socket, MAX_BUFFER_LEN)-1])) {
+                (serverMemory->socket)[strnlen(serverMemory->socket, MAX_BUFFER_LEN)-1] = '\0';
+            }
             continue;
         }
         else if(serverMemory->socket == NULL) strncpy(serverMemory->socket, DEFAULT_SOCKET, strnlen(DEFAULT_SOCKET, MAX_BUFFER_LEN)+1);
@@ -406,7 +578,89 @@ Settings* readConfigFile(const char *configPathname) {
         // Imposto il numero massimo di utenti che possono aprire un file contemporaneamente
         if((serverMemory->maxUtentiPerFile == 0) && (strstr(buffer, "maxUtentiPerFile") != NULL) && ((opt = strrchr(buffer, '=')) != NULL) && ((valueOpt = isNumber(opt+1)) != -1)) { serverMemory->maxUtentiPerFile = valueOpt; continue; }
         else if(serverMemory->maxUtentiPerFile == 0) serverMemory->maxUtentiPerFile = DEFUALT_MAX_NUMERO_UTENTI;
+
+        // Imposto la capacita' della coda globale dei task del pool
+        if((serverMemory->dimCodaTask == 0) && ((opt = valoreChiave(buffer, "dimCodaTask")) != NULL)) {
+            if(numeroChiave(opt, 1, MASSIMA_CODA_TASK, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->dimCodaTask = (unsigned int) valueOpt;
+            continue;
+        }
+
+        // Imposto il numero massimo di thread del pool (fissi piu' aiutanti)
+        if((serverMemory->maxThreadWorker == 0) && ((opt = valoreChiave(buffer, "maxThreadWorker")) != NULL)) {
+            if(numeroChiave(opt, 1, INT_MAX, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->maxThreadWorker = (unsigned int) valueOpt;
+            continue;
+        }
+
+        // Imposto la modalita' di affinita' delle connessioni ai thread worker
+        if((opt = valoreChiave(buffer, "affinitaConnessioni")) != NULL) {
+            if(numeroChiave(opt, 0, 1, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->affinitaConnessioni = (int) valueOpt;
+            continue;
+        }
+
+        // Imposto la lista delle CPU su cui fissare i thread worker
+        if((serverMemory->cpuWorker == NULL) && ((opt = valoreChiave(buffer, "cpuWorker")) != NULL)) {
+            if(leggiListaCpu(opt, serverMemory) == -1) { valoreErrato = 1; break; }
+            continue;
+        }
+
+        // Imposto il budget di attesa attiva dei thread worker prima di sospendersi
+        if(!spinLetto && ((opt = valoreChiave(buffer, "spinWorker")) != NULL)) {
+            if(numeroChiave(opt, 0, INT_MAX, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->spinWorker = (unsigned int) valueOpt, spinLetto = 1;
+            continue;
+        }
+
+        // Imposto la modalita' busy-poll dei thread worker
+        if((opt = valoreChiave(buffer, "busyPoll")) != NULL) {
+            if(numeroChiave(opt, 0, 1, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->busyPoll = (int) valueOpt;
+            continue;
+        }
+
+        // Imposto la dimensione oltre la quale i file letti vengono consegnati come memfd
+        if(!sogliaLetta && ((opt = valoreChiave(buffer, "sogliaMemfdKB")) != NULL)) {
+            if(numeroChiave(opt, 0, LONG_MAX / 1024, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->sogliaMemfdKB = (size_t) valueOpt, sogliaLetta = 1;
+            continue;
+        }
+
+        // Imposto la dimensione del segmento condiviso con i file pubblicati
+        if(!segmentoLetto && ((opt = valoreChiave(buffer, "segmentoCondivisoKB")) != NULL)) {
+            if(numeroChiave(opt, 0, MASSIMO_SEGMENTO_KB, &valueOpt) == -1) { valoreErrato = 1; break; }
+            serverMemory->segmentoCondivisoKB = (size_t) valueOpt, segmentoLetto = 1;
+            continue;
+        }
+
+        // Imposto il listener TCP aggiuntivo (tcp=indirizzo:porta)
+        if((serverMemory->indirizzoTcp == NULL) && ((opt = valoreChiave(buffer, "tcp")) != NULL)) {
+            if(((porta = strrchr(opt, ':')) == NULL) || (porta == opt) || (numeroChiave(porta+1, 1, 65535, &valueOpt) == -1)) { valoreErrato = 1; break; }
+            if((serverMemory->indirizzoTcp = (char *) calloc(MAX_BUFFER_LEN, sizeof(char))) == NULL) { valoreErrato = 1; break; }
+            memcpy(serverMemory->indirizzoTcp, opt, (size_t) fmin((double) (porta-opt), (double) (MAX_BUFFER_LEN-1)));
+            serverMemory->portaTcp = (unsigned short) valueOpt;
+            continue;
+        }
+    }
+    if(valoreErrato) {
+        /** Valore non valido (o memoria esaurita): le impostazioni vengono scartate **/
+        error = (errno != 0) ? errno : EINVAL;
+        free(buffer);
+        fclose(file);
+        free(serverMemory->socket);
+        free(serverMemory->socketPacchetti);
+        free(serverMemory->indirizzoTcp);
+        free(serverMemory->cpuWorker);
+        free(serverMemory);
+        errno = error;
+        return NULL;
     }
+    if(serverMemory->dimCodaTask == 0) serverMemory->dimCodaTask = DEFAULT_DIM_CODA_TASK;
+    if(!spinLetto) serverMemory->spinWorker = DEFAULT_SPIN_WORKER;
+    if(!sogliaLetta) serverMemory->sogliaMemfdKB = DEFAULT_SOGLIA_MEMFD_KB;
+    if(!segmentoLetto) serverMemory->segmentoCondivisoKB = DEFAULT_SEGMENTO_CONDIVISO_KB;
+    if(serverMemory->maxThreadWorker < serverMemory->numeroThreadWorker) serverMemory->maxThreadWorker = serverMemory->numeroThreadWorker;
     free(buffer);
     fclose(file);
 
@@ -439,21 +693,40 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
     mem->maxBytesOnline = set->maxMB * 1000000;
     mem->maxFileOnline = set->maxNumeroFileCaricabili;
     mem->maxUtentiPerFile = set->maxUtentiPerFile;
+    mem->sogliaMemfd = set->sogliaMemfdKB * 1024;
     mem->maxUsersLoggedOnline = set->maxUtentiConnessi;
     if(log != NULL) mem->log = log;
+    if(((mem->posti = (Posto_File *) calloc(set->maxNumeroFileCaricabili, sizeof(Posto_File))) == NULL) ||
+       ((mem->postiLiberi = (unsigned int *) calloc(set->maxNumeroFileCaricabili, sizeof(unsigned int))) == NULL)) {
+        free(mem->posti);
+        free(mem);
+        return NULL;
+    }
+    while(++index < set->maxNumeroFileCaricabili) {
+        (mem->posti)[index].generazione = 1;
+        (mem->postiLiberi)[index] = set->maxNumeroFileCaricabili - 1 - index;
+    }
+    mem->numeroPostiLiberi = set->maxNumeroFileCaricabili;
+    index = -1;
     if((mem->tabella = icl_hash_create((int) ((set->maxNumeroFileCaricabili)*2), NULL, NULL)) == NULL) {
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         errno = EOPNOTSUPP;
         return NULL;
     }
     if((mem->LRU = (myFile **) calloc(set->maxNumeroFileCaricabili, sizeof(myFile *))) == NULL) {
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
     if((mem->LRU_Access = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t))) == NULL) {
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -461,6 +734,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         errno = error;
         return NULL;
@@ -470,6 +745,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -479,6 +756,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -489,6 +768,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         errno = error;
         return NULL;
@@ -501,6 +782,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -513,6 +796,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -526,6 +811,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         errno = error;
         return NULL;
@@ -542,6 +829,8 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
         free(mem->LRU_Access);
         free(mem->LRU);
         icl_hash_destroy(mem->tabella, free, free_file);
+        free(mem->postiLiberi);
+        free(mem->posti);
         free(mem);
         return NULL;
     }
@@ -561,12 +850,21 @@ LRU_Memory* startLRUMemory(Settings *set, serverLogFile *log) {
             free(mem->LRU_Access);
             free(mem->LRU);
             icl_hash_destroy(mem->tabella, free, free_file);
-            free(mem);
+            free(mem->postiLiberi);
+            free(mem->posti);
+            free(mem->postiLiberi);
+        free(mem->posti);
+        free(mem);
             errno = error;
             return NULL;
         }
     }
 
+    /** Il segmento condiviso e' solo una scorciatoia per le letture: se non si riesce a crearlo i file vengono letti dal socket **/
+    if((set->segmentoCondivisoKB > 0) && ((mem->segmento = creaSegmento(set->segmentoCondivisoKB * 1024)) == NULL) && (log != NULL)) {
+        traceOnLog(log, "[ATTENZIONE]: Segmento condiviso non disponibile (%s)\n", strerror(errno));
+    }
+
     /** Ritorno la memoria cache **/
     errno = 0;
     return mem;
@@ -796,16 +1094,70 @@ int openFileOnCache(LRU_Memory *cache, const char *pathname, int openFD) {
 }
 
 
+/**
+ * @brief                   Da' la maniglia di un file della cache aperto da 'fd': le operazioni che la ricevono
+ *                          trovano il file con un accesso alla tabella delle maniglie, senza cercarne il pathname
+ * @fun                     handleOnCache
+ * @param cache             Memoria cache
+ * @param pathname          Pathname del file
+ * @param fd                Client che ha aperto il file
+ * @param maniglia          Maniglia del file
+ * @return                  (0) in caso di successo; (-1) altrimenti [setta errno: ENOENT anche per i file creati
+ *                          ma non ancora scritti, che non sono nella cache]
+ */
+int handleOnCache(LRU_Memory *cache, const char *pathname, int fd, Maniglia_File *maniglia) {
+    /** Variabili **/
+    int error = 0, esito = 0;
+    myFile *file = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return -1; }
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(maniglia == NULL) { errno = EINVAL; return -1; }
+
+    /** Cerco il file e ne leggo il posto **/
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        errno = error;
+        return -1;
+    }
+    if((file = cercaFile(cache, pathname, NULL)) == NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        return -1;
+    }
+    if((error = pthread_mutex_lock(file->lockAccessFile)) != 0) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        errno = error;
+        return -1;
+    }
+    if(!fileIsOpenedFrom(file, fd)) {
+        esito = EPERM;
+    } else if(file->posto == -1) {
+        esito = ENFILE;
+    } else {
+        maniglia->posto = (unsigned int) file->posto;
+        maniglia->generazione = (cache->posti)[file->posto].generazione;
+    }
+    pthread_mutex_unlock(file->lockAccessFile);
+    pthread_mutex_unlock(cache->LRU_Access);
+
+    errno = esito;
+    return (esito == 0) ? 0 : -1;
+}
+
+
 /**
  * @brief                   Chiude un file aperto da 'closeFD' (e lo unlocka se anche locked)
  * @fun                     closeFileOnCache
  * @param cache             Memoria cache
  * @param pathname          Pathname del file da chiudere
  * @param closeFD           FD che vuole chiudere il file
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname): i file creati e non ancora
+ *                          scritti non hanno maniglia
  * @return                  In caso di successo ritorna 0 o FD del client che ora detiene la lock
  *                          del file dopo 'closeFD'; -1 altrimenti e setta errno
  */
-int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD) {
+int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD, const Maniglia_File *maniglia) {
     /** Variabili **/
     int fdReturn = 0, error = 0, swap = 0;
     myFile *toClose = NULL;
@@ -823,7 +1175,7 @@ int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD) {
         errno = error;
         return -1;
     }
-    if((cl = icl_hash_find(cache->notAdded, (void *) pathname)) != NULL) {
+    if((maniglia == NULL) && ((cl = icl_hash_find(cache->notAdded, (void *) pathname)) != NULL)) {
         if(fileIsOpenedFrom(cl->f, closeFD)) {
             icl_hash_delete(cache->notAdded, (void *) pathname, free, free_ClientFile);
             swap = 1;
@@ -843,9 +1195,8 @@ int closeFileOnCache(LRU_Memory *cache, const char *pathname, int closeFD) {
             errno = error;
             return -1;
         }
-        if((toClose = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) {
+        if((toClose = cercaFile(cache, pathname, maniglia)) == NULL) {
             pthread_mutex_unlock(cache->LRU_Access);
-            errno = ENOENT;
             return -1;
         }
         if((error = pthread_mutex_lock(toClose->lockAccessFile)) != 0) {
@@ -975,6 +1326,7 @@ myFile** addFileOnCache(LRU_Memory *cache, const char *pathname, int fd, int che
         errno = EAGAIN;
         return kickedFiles;
     }
+    occupaPosto(cache, toAdd);
     (cache->LRU)[(cache->fileOnline)++] = toAdd;
     if((cache->massimoNumeroDiFileOnline) < (cache->fileOnline)) (cache->massimoNumeroDiFileOnline) = (cache->fileOnline);
     updateTime(toAdd);
@@ -1006,9 +1358,10 @@ myFile** addFileOnCache(LRU_Memory *cache, const char *pathname, int fd, int che
  * @param cache             Memoria cache da cui estrarre il file
  * @param pathname          Pathname del file da rimuovere
  * @param fd                Client che rimuove il file
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname)
  * @return                  Ritorna il file cancellato, altrimenti ritorna NULL (in caso di errore [setta errno])
  */
-myFile* removeFileOnCache(LRU_Memory *cache, const char *pathname, int fd) {
+myFile* removeFileOnCache(LRU_Memory *cache, const char *pathname, int fd, const Maniglia_File *maniglia) {
     /** Variabili **/
     long index = -1;
     int error = 0;
@@ -1025,13 +1378,19 @@ myFile* removeFileOnCache(LRU_Memory *cache, const char *pathname, int fd) {
         errno = error;
         return NULL;
     }
-    if(cache->fileOnline == 0) {
+    if((maniglia == NULL) && (cache->fileOnline == 0)) {
         pthread_mutex_unlock(cache->LRU_Access);
         errno = ENOENT;
         return NULL;
     }
+    if((maniglia != NULL) && ((del = cercaFile(cache, pathname, maniglia)) == NULL)) {
+        error = errno;
+        pthread_mutex_unlock(cache->LRU_Access);
+        errno = error;
+        return NULL;
+    }
     while(++index < cache->fileOnline) {
-        if(findFileOnLRU(pathname, (cache->LRU)+index) == 0) break;
+        if((del != NULL) ? (cache->LRU[index] == del) : (findFileOnLRU(pathname, (cache->LRU)+index) == 0)) break;
     }
     if(index >= cache->fileOnline) {
         pthread_mutex_unlock(cache->LRU_Access);
@@ -1056,6 +1415,8 @@ myFile* removeFileOnCache(LRU_Memory *cache, const char *pathname, int fd) {
         errno = EAGAIN;
         return NULL;
     }
+    withdrawPublishedFile(del);
+    liberaPosto(cache, del);
     cache->bytesOnline -= del->size;
     cache->LRU[index] = cache->LRU[--(cache->fileOnline)];
     cache->LRU[(cache->fileOnline)] = NULL;
@@ -1092,9 +1453,10 @@ myFile* removeFileOnCache(LRU_Memory *cache, const char *pathname, int fd) {
  * @param fd                    Client che aggiunge il contenuto al file
  * @param buffer                Buffer da aggiungere
  * @param size                  Dimensione del buffer da aggiungere
+ * @param maniglia              Maniglia del file (NULL per cercarlo dal pathname)
  * @return                      Ritorna gli eventuali file espulsi; in caso di errore valutare se si setta errno
  */
-myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffer, size_t size) {
+myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffer, size_t size, const Maniglia_File *maniglia) {
     /** Variabili **/
     myFile **kickedFiles = NULL, *toAdd = NULL;
     int error = 0, numKick = 0;
@@ -1119,10 +1481,9 @@ myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffe
     }
     strncpy(copy, pathname, strnlen(pathname, MAX_PATHNAME)+1);
     LRU_Update(cache->LRU, cache->fileOnline);
-    if((toAdd = icl_hash_find(cache->tabella, copy)) == NULL) {
+    if((toAdd = cercaFile(cache, copy, maniglia)) == NULL) {
         pthread_mutex_unlock(cache->LRU_Access);
         free(copy);
-        errno = ENOENT;
         return NULL;
     }
     if((error = pthread_mutex_lock(toAdd->lockAccessFile)) != 0) {
@@ -1133,6 +1494,7 @@ myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffe
     }
     if(cache->maxBytesOnline < size) {
         icl_hash_delete(cache->tabella, (void *) copy, free, NULL);
+        liberaPosto(cache, toAdd);
         pthread_mutex_unlock(cache->LRU_Access);
         pthread_mutex_unlock(toAdd->lockAccessFile);
         index = -1;
@@ -1200,6 +1562,283 @@ myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffe
 }
 
 
+/**
+ * @brief                       Sovrascrive il contenuto di un file a partire da un offset, estendendolo se necessario.
+ *                              Il client deve avere il file aperto e in lock; le espulsioni coprono solo la crescita
+ * @fun                         writeAtOnCache
+ * @param cache                 Memoria cache
+ * @param pathname              Pathname del file da aggiornare
+ * @param fd                    Client che scrive il file
+ * @param offset                Posizione da cui scrivere
+ * @param buffer                Buffer da scrivere
+ * @param size                  Dimensione del buffer
+ * @param maniglia              Maniglia del file (NULL per cercarlo dal pathname)
+ * @return                      Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+ */
+myFile** writeAtOnCache(LRU_Memory *cache, const char *pathname, int fd, size_t offset, void *buffer, size_t size, const Maniglia_File *maniglia) {
+    /** Variabili **/
+    myFile **kickedFiles = NULL, *toAdd = NULL;
+    int error = 0, numKick = 0, index = -1;
+    size_t crescita = 0;
+    char *copy = NULL;
+    Queue *uL = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return NULL; }
+    if(pathname == NULL) { errno = EINVAL; return NULL; }
+    if((buffer == NULL) || (size == 0)) { errno = EINVAL; return NULL; }
+    if((offset > cache->maxBytesOnline) || (size > cache->maxBytesOnline - offset)) { errno = EFBIG; return NULL; }
+
+    /** Trovo il file e ne verifico i diritti **/
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        errno = error;
+        return NULL;
+    }
+    if((copy = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        return NULL;
+    }
+    strncpy(copy, pathname, strnlen(pathname, MAX_PATHNAME)+1);
+    LRU_Update(cache->LRU, cache->fileOnline);
+    if((toAdd = cercaFile(cache, copy, maniglia)) == NULL) {
+        error = errno;
+        pthread_mutex_unlock(cache->LRU_Access);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+    if((error = pthread_mutex_lock(toAdd->lockAccessFile)) != 0) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+    if(!fileIsOpenedFrom(toAdd, fd) || (toAdd->utenteLock != fd)) {
+        pthread_mutex_unlock(toAdd->lockAccessFile);
+        pthread_mutex_unlock(cache->LRU_Access);
+        free(copy);
+        errno = EPERM;
+        return NULL;
+    }
+
+    /** Libero spazio solo per la crescita del file e scrivo **/
+    crescita = ((offset + size) > toAdd->size) ? (offset + size - toAdd->size) : 0;
+    if(crescita > 0) MEMORY_MISS(0, crescita);
+    if(writeContentAt(toAdd, offset, buffer, size) == -1) {
+        error = errno;
+        pthread_mutex_unlock(toAdd->lockAccessFile);
+        pthread_mutex_unlock(cache->LRU_Access);
+        free(copy);
+        errno = error;
+        return kickedFiles;
+    }
+    cache->bytesOnline += crescita;
+    if((cache->numeroMassimoBytesCaricato) < (cache->bytesOnline)) (cache->numeroMassimoBytesCaricato) = (cache->bytesOnline);
+    if((error = pthread_mutex_unlock(toAdd->lockAccessFile)) != 0) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        free(copy);
+        errno = error;
+        return kickedFiles;
+    }
+    if((error = pthread_mutex_unlock(cache->LRU_Access)) != 0) {
+        free(copy);
+        errno = error;
+        return kickedFiles;
+    }
+    while(--numKick >= 0) {
+        index = -1;
+        while((kickedFiles[numKick]->utentiConnessi)[++index] != -1) {
+            uL = linksManage(cache, (kickedFiles[numKick]->utentiConnessi)[index], (void *) (kickedFiles[numKick])->pathname, 1, findPath);
+            if(uL != NULL) destroyQueue(&uL, free_userLink);
+            if(errno != 0) {
+                free(copy);
+                return kickedFiles;
+            }
+        }
+    }
+
+    free(copy);
+    errno = 0;
+    return kickedFiles;
+}
+
+
+/**
+ * @brief                       Inserisce nella cache un file nuovo gia' completo del suo contenuto, preso da un
+ *                              buffer o letto da un descrittore: lo spazio viene liberato una sola volta per la
+ *                              dimensione finale del file
+ * @fun                         inserisciFileCompleto
+ * @param cache                 Memoria cache
+ * @param pathname              Pathname del file da inserire
+ * @param fd                    Client che inserisce il file
+ * @param buffer                Contenuto del file (se sorgente e' -1)
+ * @param sorgente              Descrittore da cui leggere il contenuto (-1 per usare buffer)
+ * @param size                  Dimensione del contenuto
+ * @param lock                  Se (1) il file resta aperto e in lock da fd; se (0) viene inserito chiuso
+ * @return                      Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+ */
+static myFile** inserisciFileCompleto(LRU_Memory *cache, const char *pathname, int fd, void *buffer, int sorgente, size_t size, int lock) {
+    /** Variabili **/
+    myFile **kickedFiles = NULL, *toAdd = NULL;
+    int error = 0, numKick = 0, index = -1;
+    unsigned int hashPathname = 0;
+    char *copy = NULL;
+    Queue *uL = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return NULL; }
+    if(pathname == NULL) { errno = EINVAL; return NULL; }
+    if(fd <= 0) { errno = EINVAL; return NULL; }
+    if((buffer == NULL) && (sorgente < 0) && (size > 0)) { errno = EINVAL; return NULL; }
+    if((lock < 0) || (lock > 1)) { errno = EINVAL; return NULL; }
+    if(cache->maxBytesOnline < size) { errno = EFBIG; return NULL; }
+
+    /** Creo il file completo fuori dalla sezione critica **/
+    if((copy = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
+        return NULL;
+    }
+    strncpy(copy, pathname, strnlen(pathname, MAX_PATHNAME)+1);
+    hashPathname = hash_pjw(copy), hashPathname %= (2*(cache->maxFileOnline));
+    if((toAdd = createFile(copy, cache->maxUtentiPerFile, NULL)) == NULL) {
+        free(copy);
+        return NULL;
+    }
+    if(((size > 0) && (sorgente >= 0) && (addContentFromFd(toAdd, sorgente, size) == -1)) ||
+       ((size > 0) && (sorgente < 0) && (addContentToFile(toAdd, buffer, size) == -1)) ||
+       ((lock) && ((openFile(toAdd, fd) != 0) || (lockFile(toAdd, fd) != 0)))) {
+        error = errno;
+        destroyFile(&toAdd);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+
+    /** Il file non deve essere gia' stato creato da un altro client **/
+    if((error = pthread_mutex_lock(cache->notAddedAccess)) != 0) {
+        destroyFile(&toAdd);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+    if(icl_hash_find(cache->notAdded, copy) != NULL) {
+        pthread_mutex_unlock(cache->notAddedAccess);
+        destroyFile(&toAdd);
+        free(copy);
+        errno = EPERM;
+        return NULL;
+    }
+    if((error = pthread_mutex_unlock(cache->notAddedAccess)) != 0) {
+        destroyFile(&toAdd);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+
+    /** Libero lo spazio per la dimensione finale e inserisco il file **/
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        destroyFile(&toAdd);
+        free(copy);
+        errno = error;
+        return NULL;
+    }
+    LRU_Update(cache->LRU, cache->fileOnline);
+    if(icl_hash_find(cache->tabella, copy) != NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        destroyFile(&toAdd);
+        free(copy);
+        errno = EPERM;
+        return NULL;
+    }
+    MEMORY_MISS(1, size);
+    toAdd->lockAccessFile = (cache->Files_Access) + hashPathname;
+    if(icl_hash_insert(cache->tabella, copy, toAdd) == NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        destroyFile(&toAdd);
+        free(copy);
+        errno = EAGAIN;
+        return kickedFiles;
+    }
+    occupaPosto(cache, toAdd);
+    (cache->LRU)[(cache->fileOnline)++] = toAdd;
+    cache->bytesOnline += size;
+    if((cache->massimoNumeroDiFileOnline) < (cache->fileOnline)) (cache->massimoNumeroDiFileOnline) = (cache->fileOnline);
+    if((cache->numeroMassimoBytesCaricato) < (cache->bytesOnline)) (cache->numeroMassimoBytesCaricato) = (cache->bytesOnline);
+    updateTime(toAdd);
+    if((error = pthread_mutex_unlock(cache->LRU_Access)) != 0) {
+        errno = error;
+        return kickedFiles;
+    }
+
+    /** Collegamenti del client al file e dei file espulsi **/
+    if(lock) {
+        linksManage(cache, fd, (void *) pathname, 0, NULL);
+        if(errno != 0) {
+            return kickedFiles;
+        }
+    }
+    while(--numKick >= 0) {
+        index = -1;
+        while((kickedFiles[numKick]->utentiConnessi)[++index] != -1) {
+            uL = linksManage(cache, (kickedFiles[numKick]->utentiConnessi)[index], (void *) (kickedFiles[numKick])->pathname, 1, findPath);
+            if(uL != NULL) { destroyQueue(&uL, free_userLink); }
+            if(errno != 0) {
+                return kickedFiles;
+            }
+        }
+    }
+
+    errno = 0;
+    return kickedFiles;
+}
+
+
+/**
+ * @brief                       Inserisce nella cache un file nuovo gia' completo del suo contenuto: lo spazio
+ *                              viene liberato una sola volta per la dimensione finale del file
+ * @fun                         putFileOnCache
+ * @param cache                 Memoria cache
+ * @param pathname              Pathname del file da inserire
+ * @param fd                    Client che inserisce il file
+ * @param buffer                Contenuto del file
+ * @param size                  Dimensione del contenuto
+ * @param lock                  Se (1) il file resta aperto e in lock da fd; se (0) viene inserito chiuso
+ * @return                      Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+ */
+myFile** putFileOnCache(LRU_Memory *cache, const char *pathname, int fd, void *buffer, size_t size, int lock) {
+    return inserisciFileCompleto(cache, pathname, fd, buffer, -1, size, lock);
+}
+
+
+/**
+ * @brief                       Inserisce nella cache un file nuovo leggendone il contenuto dal descrittore passato
+ *                              dal client: i bytes vengono letti direttamente nel buffer del file
+ * @fun                         putFileFromFdOnCache
+ * @param cache                 Memoria cache
+ * @param pathname              Pathname del file da inserire
+ * @param fd                    Client che inserisce il file
+ * @param sorgente              Descrittore di un file regolare con il contenuto
+ * @param lock                  Se (1) il file resta aperto e in lock da fd; se (0) viene inserito chiuso
+ * @param size                  Dimensione del contenuto letto
+ * @return                      Ritorna gli eventuali file espulsi; in caso di errore ritorna NULL [setta errno]
+ */
+myFile** putFileFromFdOnCache(LRU_Memory *cache, const char *pathname, int fd, int sorgente, int lock, size_t *size) {
+    /** Variabili **/
+    struct stat info;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(size == NULL) { errno = EINVAL; return NULL; }
+    if(fstat(sorgente, &info) == -1) { return NULL; }
+    if(!S_ISREG(info.st_mode)) { errno = EINVAL; return NULL; }
+
+    /** Inserisco il file **/
+    *size = (size_t) info.st_size;
+    return inserisciFileCompleto(cache, pathname, fd, NULL, sorgente, *size, lock);
+}
+
+
 /**
  * @brief                   Funzione che legge il contenuto del file e ne restituisce una copia
  * @fun                     readFileOnCache
@@ -1210,6 +1849,25 @@ myFile** appendFile(LRU_Memory *cache, const char *pathname, int fd, void *buffe
  * @return                  Ritorna la dimensione del buffer; (-1) altrimenti [setta errno]
  */
 size_t readFileOnCache(LRU_Memory *cache, const char *pathname, int fd, void **dataContent) {
+    return readRangeOnCache(cache, pathname, fd, 0, 0, dataContent, NULL, NULL);
+}
+
+
+/**
+ * @brief                   Legge una porzione del file e ne restituisce una copia
+ * @fun                     readRangeOnCache
+ * @param cache             Memoria cache
+ * @param pathname          Pathname del file da leggere
+ * @param fd                Client che legge il file dal server
+ * @param offset            Posizione da cui iniziare la lettura
+ * @param length            Numero massimo di bytes da leggere; (0) per leggere fino alla fine del file
+ * @param dataContent       Bytes letti (NULL se la porzione e' vuota)
+ * @param totalSize         Dimensione attuale dell'intero file (puo' essere NULL)
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname)
+ * @return                  Ritorna il numero di bytes letti (0 se offset e' oltre la fine del file);
+ *                          (-1) altrimenti [setta errno]
+ */
+size_t readRangeOnCache(LRU_Memory *cache, const char *pathname, int fd, size_t offset, size_t length, void **dataContent, size_t *totalSize, const Maniglia_File *maniglia) {
     /** Variabili **/
     int error = 0;
     size_t size = -1;
@@ -1219,15 +1877,16 @@ size_t readFileOnCache(LRU_Memory *cache, const char *pathname, int fd, void **d
     errno = 0;
     if(cache == NULL) { errno = EINVAL; return -1; }
     if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(dataContent == NULL) { errno = EINVAL; return -1; }
 
     /** Trovo il file e lo leggo **/
+    *dataContent = NULL;
     if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
         errno = error;
         return -1;
     }
-    if((readF = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) {
+    if((readF = cercaFile(cache, pathname, maniglia)) == NULL) {
         pthread_mutex_unlock(cache->LRU_Access);
-        errno = ENOENT;
         return -1;
     }
     if((error = pthread_mutex_lock(readF->lockAccessFile)) != 0) {
@@ -1250,15 +1909,17 @@ size_t readFileOnCache(LRU_Memory *cache, const char *pathname, int fd, void **d
         errno = EPERM;
         return -1;
     }
-    if((*dataContent = malloc(readF->size)) == NULL) {
+    size = (offset < readF->size) ? (readF->size - offset) : 0;
+    if((length != 0) && (length < size)) size = length;
+    if((size > 0) && ((*dataContent = malloc(size)) == NULL)) {
         pthread_mutex_unlock(readF->lockAccessFile);
         return -1;
     }
-    memcpy(*dataContent, readF->buffer, readF->size);
-    size = readF->size;
+    if(size > 0) memcpy(*dataContent, (char *) readF->buffer + offset, size);
+    if(totalSize != NULL) *totalSize = readF->size;
     updateTime(readF);
     if((error = pthread_mutex_unlock(readF->lockAccessFile)) != 0) {
-        free(*dataContent);
+        if(*dataContent != NULL) free(*dataContent);
         *dataContent = NULL;
         errno = error;
         return -1;
@@ -1269,6 +1930,135 @@ size_t readFileOnCache(LRU_Memory *cache, const char *pathname, int fd, void **d
 }
 
 
+/**
+ * @brief                   Consegna il contenuto di un file grande come memfd sigillato: la copia viene fatta una
+ *                          sola volta e condivisa da tutte le letture finche' il file non viene modificato
+ * @fun                     shareFileOnCache
+ * @param cache             Memoria cache
+ * @param pathname          Pathname del file da leggere
+ * @param fd                Client che legge il file dal server
+ * @param size              Dimensione del contenuto consegnato
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname)
+ * @return                  Ritorna un descrittore del memfd, che il chiamante deve chiudere dopo averlo inviato;
+ *                          (-1) altrimenti, con errno EMSGSIZE se il file e' sotto la soglia [setta errno]
+ */
+int shareFileOnCache(LRU_Memory *cache, const char *pathname, int fd, size_t *size, const Maniglia_File *maniglia) {
+    /** Variabili **/
+    int error = 0, copia = -1;
+    myFile *readF = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return -1; }
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(size == NULL) { errno = EINVAL; return -1; }
+    if(cache->sogliaMemfd == 0) { errno = EMSGSIZE; return -1; }
+
+    /** Trovo il file e ne duplico la copia sigillata **/
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        errno = error;
+        return -1;
+    }
+    if((readF = cercaFile(cache, pathname, maniglia)) == NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        return -1;
+    }
+    if((error = pthread_mutex_lock(readF->lockAccessFile)) != 0) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        errno = error;
+        return -1;
+    }
+    if((error = pthread_mutex_unlock(cache->LRU_Access)) != 0) {
+        pthread_mutex_unlock(readF->lockAccessFile);
+        errno = error;
+        return -1;
+    }
+    if(!fileIsOpenedFrom(readF, fd) || ((readF->utenteLock != fd) && (readF->utenteLock != -1))) {
+        pthread_mutex_unlock(readF->lockAccessFile);
+        errno = EPERM;
+        return -1;
+    }
+    if(readF->size < cache->sogliaMemfd) {
+        pthread_mutex_unlock(readF->lockAccessFile);
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if(((copia = sealedCopyOfFile(readF)) == -1) || ((copia = dup(copia)) == -1)) {
+        error = errno;
+        pthread_mutex_unlock(readF->lockAccessFile);
+        errno = error;
+        return -1;
+    }
+    *size = readF->size;
+    updateTime(readF);
+    if((error = pthread_mutex_unlock(readF->lockAccessFile)) != 0) {
+        close(copia);
+        errno = error;
+        return -1;
+    }
+
+    errno = 0;
+    return copia;
+}
+
+
+/**
+ * @brief                   Pubblica un file nel segmento condiviso: da quel momento i client sulla stessa macchina
+ *                          lo leggono dalla memoria, senza aprirlo e senza passare dal server, finche' resta nella
+ *                          cache. Ogni modifica aggiorna la voce; se il contenuto non ci sta piu' il file viene ritirato
+ * @fun                     publishFileOnCache
+ * @param cache             Memoria cache
+ * @param pathname          Pathname del file da pubblicare
+ * @param fd                Client che pubblica il file (deve averlo aperto e, se e' in lock, esserne il proprietario)
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno: ENOTSUP se il segmento
+ *                          e' disattivato, EFBIG se il file non sta in una voce, ENOSPC se il segmento e' pieno]
+ */
+int publishFileOnCache(LRU_Memory *cache, const char *pathname, int fd) {
+    /** Variabili **/
+    int error = 0, res = 0;
+    myFile *pubF = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return -1; }
+    if(pathname == NULL) { errno = EINVAL; return -1; }
+    if(cache->segmento == NULL) { errno = ENOTSUP; return -1; }
+
+    /** Trovo il file e lo pubblico **/
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        errno = error;
+        return -1;
+    }
+    if((pubF = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        errno = ENOENT;
+        return -1;
+    }
+    if((error = pthread_mutex_lock(pubF->lockAccessFile)) != 0) {
+        pthread_mutex_unlock(cache->LRU_Access);
+        errno = error;
+        return -1;
+    }
+    if((error = pthread_mutex_unlock(cache->LRU_Access)) != 0) {
+        pthread_mutex_unlock(pubF->lockAccessFile);
+        errno = error;
+        return -1;
+    }
+    if(!fileIsOpenedFrom(pubF, fd) || ((pubF->utenteLock != fd) && (pubF->utenteLock != -1))) {
+        pthread_mutex_unlock(pubF->lockAccessFile);
+        errno = EPERM;
+        return -1;
+    }
+    res = publishFileContent(pubF, cache->segmento);
+    error = errno;
+    if(res == 0) updateTime(pubF);
+    pthread_mutex_unlock(pubF->lockAccessFile);
+
+    errno = error;
+    return res;
+}
+
+
 /**
  * @brief               Legge N file in ordine della LRU non locked
  * @fun                 readRandFiles
@@ -1328,6 +2118,8 @@ myFile** readsRandFiles(LRU_Memory *cache, int fd, int *N) {
                 return NULL;
             }
             memcpy(filesRead[nReads-1], (cache->LRU)[index], sizeof(myFile));
+            filesRead[nReads-1]->copiaSigillata = -1;
+            filesRead[nReads-1]->segmento = NULL, filesRead[nReads-1]->voceCondivisa = -1;
             if((filesRead[nReads-1]->pathname = calloc(strnlen((cache->LRU)[index]->pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
                 pthread_mutex_unlock((cache->LRU[index])->lockAccessFile);
                 pthread_mutex_unlock(cache->LRU_Access);
@@ -1389,16 +2181,119 @@ myFile** readsRandFiles(LRU_Memory *cache, int fd, int *N) {
 }
 
 
+/**
+ * @brief               Copia pathname e contenuto di un file della cache (va chiamata con la mutex del file acquisita)
+ * @fun                 copiaFile
+ * @param file          File da copiare
+ * @return              Ritorna la copia; NULL in caso di errore [setta errno]
+ */
+static myFile* copiaFile(const myFile *file) {
+    /** Variabili **/
+    myFile *copia = NULL;
+
+    /** Copio il file **/
+    if((copia = (myFile *) calloc(1, sizeof(myFile))) == NULL) {
+        return NULL;
+    }
+    if((copia->pathname = (char *) calloc(strnlen(file->pathname, MAX_PATHNAME)+1, sizeof(char))) == NULL) {
+        free(copia);
+        return NULL;
+    }
+    strncpy(copia->pathname, file->pathname, strnlen(file->pathname, MAX_PATHNAME)+1);
+    if((file->size > 0) && ((copia->buffer = malloc(file->size)) == NULL)) {
+        free(copia->pathname);
+        free(copia);
+        return NULL;
+    }
+    if(file->size > 0) memcpy(copia->buffer, file->buffer, file->size);
+    copia->size = file->size;
+    copia->utenteLock = -1;
+    copia->copiaSigillata = -1;
+    copia->segmento = NULL, copia->voceCondivisa = -1;
+
+    return copia;
+}
+
+
+/**
+ * @brief               Legge una lista di file indicati per nome risolvendoli tutti con un solo accesso alla tabella
+ * @fun                 readListOnCache
+ * @param cache         Memoria cache
+ * @param fd            Client che richiede la lettura
+ * @param pathnames     Pathname dei file da leggere
+ * @param numero        Numero dei file richiesti
+ * @param esiti         Esito della lettura di ogni file: 0 se letto; ENOENT se assente; EPERM se in lock da un altro client
+ * @return              Ritorna un array di 'numero' copie dei file (NULL dove la lettura non e' riuscita);
+ *                      in caso di errore ritorna NULL [setta errno]
+ */
+myFile** readListOnCache(LRU_Memory *cache, int fd, char **pathnames, size_t numero, int *esiti) {
+    /** Variabili **/
+    myFile **filesRead = NULL, *readF = NULL;
+    int error = 0;
+    size_t i = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(cache == NULL) { errno = EINVAL; return NULL; }
+    if((pathnames == NULL) || (esiti == NULL)) { errno = EINVAL; return NULL; }
+    if(numero == 0) { errno = EINVAL; return NULL; }
+
+    /** Risolvo e copio i file **/
+    if((filesRead = (myFile **) calloc(numero, sizeof(myFile *))) == NULL) {
+        return NULL;
+    }
+    if((error = pthread_mutex_lock(cache->LRU_Access)) != 0) {
+        free(filesRead);
+        errno = error;
+        return NULL;
+    }
+    for(i = 0; i < numero; i++) {
+        if((readF = (myFile *) icl_hash_find(cache->tabella, (void *) pathnames[i])) == NULL) {
+            esiti[i] = ENOENT;
+            continue;
+        }
+        if((error = pthread_mutex_lock(readF->lockAccessFile)) != 0) {
+            break;
+        }
+        if((readF->utenteLock != fd) && (readF->utenteLock != -1)) {
+            esiti[i] = EPERM;
+        } else if((filesRead[i] = copiaFile(readF)) == NULL) {
+            error = errno;
+            pthread_mutex_unlock(readF->lockAccessFile);
+            break;
+        } else {
+            esiti[i] = 0;
+            updateTime(readF);
+        }
+        pthread_mutex_unlock(readF->lockAccessFile);
+    }
+    pthread_mutex_unlock(cache->LRU_Access);
+    if(i < numero) {
+        while(i > 0) {
+            destroyFile(filesRead + (--i));
+        }
+        free(filesRead);
+        errno = error;
+        return NULL;
+    }
+
+    errno = 0;
+    return filesRead;
+}
+
+
 /**
  * @brief                   Effettua la lock su un file per quel fd
  * @fun                     lockFileOnCache
  * @param cache             Memoria cache
  * @param pathname          Pathname del file da bloccare
  * @param lockFD            Fd che effettua la lock
+ * @param attendi           Se (0) la lock di un file gia' di un altro client fallisce con EBUSY invece di mettersi in coda
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname)
  * @return                  Ritorna (1) se il file e' locked gia'; (0) se la lock e' riuscita;
  *                          (-1) in caso di errore [setta errno]
  */
-int lockFileOnCache(LRU_Memory *cache, const char *pathname, int lockFD) {
+int lockFileOnCache(LRU_Memory *cache, const char *pathname, int lockFD, int attendi, const Maniglia_File *maniglia) {
     /** Variabili **/
     int error = 0, lockResult = -1;
     myFile *fileToLock = NULL;
@@ -1414,9 +2309,8 @@ int lockFileOnCache(LRU_Memory *cache, const char *pathname, int lockFD) {
         errno = error;
         return -1;
     }
-    if((fileToLock = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) {
+    if((fileToLock = cercaFile(cache, pathname, maniglia)) == NULL) {
         pthread_mutex_unlock(cache->LRU_Access);
-        errno = ENOENT;
         return -1;
     }
     if((error = pthread_mutex_lock(fileToLock->lockAccessFile)) != 0) {
@@ -1429,6 +2323,11 @@ int lockFileOnCache(LRU_Memory *cache, const char *pathname, int lockFD) {
         errno = error;
         return -1;
     }
+    if(!attendi && (fileToLock->utenteLock != -1) && (fileToLock->utenteLock != lockFD)) {
+        pthread_mutex_unlock(fileToLock->lockAccessFile);
+        errno = EBUSY;
+        return -1;
+    }
     if(((lockResult = lockFile(fileToLock, lockFD)) == -1) && ((errno != EALREADY))) {
         pthread_mutex_unlock(fileToLock->lockAccessFile);
         return -1;
@@ -1450,10 +2349,11 @@ int lockFileOnCache(LRU_Memory *cache, const char *pathname, int lockFD) {
  * @param cache             Memoria cache
  * @param pathname          Pathname del file da sbloccare
  * @param unlockFD          Fd che effettua la unlock
+ * @param maniglia          Maniglia del file (NULL per cercarlo dal pathname)
  * @return                  In caso di successo ritorna Fd del client da sbloccare;
  *                          (-1) in caso di errore [setta errno]
  */
-int unlockFileOnCache(LRU_Memory *cache, const char *pathname, int unlockFD) {
+int unlockFileOnCache(LRU_Memory *cache, const char *pathname, int unlockFD, const Maniglia_File *maniglia) {
     /** Variabili **/
     int error = 0, unlockResult = -1;
     myFile *fileToUnlock = NULL;
@@ -1469,9 +2369,8 @@ int unlockFileOnCache(LRU_Memory *cache, const char *pathname, int unlockFD) {
         errno = error;
         return -1;
     }
-    if((fileToUnlock = (myFile *) icl_hash_find(cache->tabella, (void *) pathname)) == NULL) {
+    if((fileToUnlock = cercaFile(cache, pathname, maniglia)) == NULL) {
         pthread_mutex_unlock(cache->LRU_Access);
-        errno = ENOENT;
         return -1;
     }
     if((error = pthread_mutex_lock(fileToUnlock->lockAccessFile)) != 0) {
@@ -1504,13 +2403,15 @@ int unlockFileOnCache(LRU_Memory *cache, const char *pathname, int unlockFD) {
  * @fun                 deleteClientFromCache
  * @param cache         Memoria cache
  * @param fd            Client che si è disconnesso
+ * @param pathnames     Se diverso da NULL riceve l'array (parallelo al risultato) dei pathname dei file
+ *                      passati ai client in attesa; va liberato dal chiamante
  * @return              Ritorna un puntatore ad un array di fd che specifica i client che sono in attesa dei file
  *                      locked da 'fd'; altrimenti, in caso di errore, setta errno
  */
-int* deleteClientFromCache(LRU_Memory *cache, int fd) {
+int* deleteClientFromCache(LRU_Memory *cache, int fd, char ***pathnames) {
     /** Variabili **/
     int error = 0, *fdToUnlock = NULL, *new = NULL, numToUnlock = 0, app = -1;
-    char *pathname = NULL;
+    char *pathname = NULL, **newPathnames = NULL;
     myFile *file = NULL;
     Queue *list = NULL;
     userLink *del = NULL;
@@ -1518,6 +2419,7 @@ int* deleteClientFromCache(LRU_Memory *cache, int fd) {
     /** Controllo parametri **/
     if(cache == NULL) { errno = EINVAL; return NULL; }
     if(fd <= 0) { errno = EINVAL; return NULL; }
+    if(pathnames != NULL) *pathnames = NULL;
 
 
     errno=0;
@@ -1559,6 +2461,19 @@ int* deleteClientFromCache(LRU_Memory *cache, int fd) {
             }
             fdToUnlock = new;
             fdToUnlock[numToUnlock-1] = app, fdToUnlock[numToUnlock] = -1;
+            if(pathnames != NULL) {
+                if((newPathnames = (char **) realloc(*pathnames, numToUnlock*sizeof(char *))) == NULL) {
+                    pthread_mutex_unlock(file->lockAccessFile);
+                    pthread_mutex_unlock(cache->LRU_Access);
+                    free_userLink(del);
+                    fdToUnlock[numToUnlock-1] = -1;
+                    return fdToUnlock;
+                }
+                *pathnames = newPathnames;
+                if(((*pathnames)[numToUnlock-1] = (char *) calloc(strnlen(pathname, MAX_PATHNAME)+1, sizeof(char))) != NULL) {
+                    strncpy((*pathnames)[numToUnlock-1], pathname, strnlen(pathname, MAX_PATHNAME)+1);
+                }
+            }
         }
         if((error = pthread_mutex_unlock(file->lockAccessFile)) != 0) {
             pthread_mutex_unlock(cache->LRU_Access);
@@ -1592,6 +2507,9 @@ void deleteLRU(Settings **serverMemory, LRU_Memory **cache) {
     /** Dealloco le impostazioni **/
     if(*serverMemory != NULL) {
         free((*serverMemory)->socket);
+        if((*serverMemory)->socketPacchetti != NULL) free((*serverMemory)->socketPacchetti);
+        if((*serverMemory)->indirizzoTcp != NULL) free((*serverMemory)->indirizzoTcp);
+        if((*serverMemory)->cpuWorker != NULL) free((*serverMemory)->cpuWorker);
         free(*serverMemory);
         serverMemory = NULL;
     }
@@ -1608,6 +2526,13 @@ void deleteLRU(Settings **serverMemory, LRU_Memory **cache) {
         printf("Massima capacità raggiunta dal server: %.4lf MB\n", ((float) (*cache)->numeroMassimoBytesCaricato)/1000000);
         printf("Meccanismo di espulsione file attivato %d volte\n", (*cache)->numeroMemoryMiss);
         printf("Verso il server sono state effettuate un numero di connessioni pari a %d\n", (*cache)->numTotLogin);
+        printf("Coda dei task piena (richieste lasciate nel socket) %d volte\n", (*cache)->numeroCodaPiena);
+        for(int k=0; k<NUMERO_CORSIE; k++) {
+            printf("Corsia %s: %lu richieste - latenza media %.3lf ms - latenza massima %.3lf ms\n", (k == CORSIA_PRIORITARIA) ? "metadati" : "trasferimenti",
+                   (*cache)->richiesteCorsia[k],
+                   ((*cache)->richiesteCorsia[k] == 0) ? 0 : ((double) (*cache)->latenzaTotaleCorsia[k] / (*cache)->richiesteCorsia[k]) / 1000,
+                   ((double) (*cache)->latenzaMassimaCorsia[k]) / 1000);
+        }
         printf("Lista dei file presenti al momento dello shutdown:\n");
         while(++i < ((*cache)->fileOnline)) {
             printf("File: %s\n", (*cache)->LRU[i]->pathname);
@@ -1629,6 +2554,9 @@ void deleteLRU(Settings **serverMemory, LRU_Memory **cache) {
         free((*cache)->usersConnectedAccess);
         free((*cache)->usersConnected);
         free((*cache)->LRU);
+        free((*cache)->posti);
+        free((*cache)->postiLiberi);
+        distruggiSegmento(&((*cache)->segmento));
         free(*cache);
         *cache = NULL;
     }
@@ -0,0 +1,679 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Protocollo binario v2: frame con intestazione fissa e corpo a campi
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#define _GNU_SOURCE
+#include "protocol.h"
+#include <sys/socket.h>
+#include <sys/select.h>
+
+
+/** Socket SOCK_SEQPACKET, indicizzati per fd: i frame viaggiano in pacchetti di al piu' PACCHETTO_MASSIMO bytes **/
+static unsigned char pacchetti[FD_SETSIZE];
+
+
+/**
+ * @brief                   Indica se un socket e' SOCK_SEQPACKET, cioe' se i frame vengono spediti e ricevuti a
+ *                          pacchetti. Attivandolo il buffer di invio viene portato ad almeno due pacchetti
+ * @fun                     impostaPacchetti
+ * @param fd                Socket
+ * @param attivi            (1) se il socket e' SOCK_SEQPACKET; (0) se e' SOCK_STREAM
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int impostaPacchetti(int fd, int attivi) {
+    /** Variabili **/
+    int buffer = 0;
+    socklen_t dimensione = sizeof(int);
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((fd < 0) || (fd >= FD_SETSIZE)) {
+        if(!attivi) return 0;
+        errno = EINVAL;
+        return -1;
+    }
+
+    /** Imposto **/
+    pacchetti[fd] = (unsigned char) (attivi != 0);
+    if(attivi && (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, &dimensione) == 0) && (buffer < 2*PACCHETTO_MASSIMO)) {
+        buffer = 2*PACCHETTO_MASSIMO;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(int));
+    }
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief                   Verifica se un socket trasporta i frame a pacchetti
+ * @fun                     aPacchetti
+ * @param fd                Socket
+ * @return                  Ritorna (1) se il socket e' SOCK_SEQPACKET; (0) altrimenti
+ */
+static int aPacchetti(int fd) {
+    return (fd >= 0) && (fd < FD_SETSIZE) && pacchetti[fd];
+}
+
+
+/**
+ * @brief                   Legge le credenziali del processo dall'altra parte di un socket AF_UNIX (SO_PEERCRED)
+ * @fun                     credenzialiPeer
+ * @param fd                Socket
+ * @param uid               Utente del processo
+ * @param gid               Gruppo del processo
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int credenzialiPeer(int fd, uid_t *uid, gid_t *gid) {
+    /** Variabili **/
+    struct ucred credenziali;
+    socklen_t dimensione = sizeof(struct ucred);
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((fd < 0) || (uid == NULL) || (gid == NULL)) { errno = EINVAL; return -1; }
+
+    /** Le leggo **/
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credenziali, &dimensione) == -1) return -1;
+    *uid = credenziali.uid, *gid = credenziali.gid;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Calcola la dimensione del corpo formato dai campi indicati
+ * @fun                     dimensioneCorpo
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna la dimensione del corpo sul canale
+ */
+uint64_t dimensioneCorpo(const Campo *campi, size_t numeroCampi) {
+    /** Variabili **/
+    uint64_t totale = 0;
+
+    /** Calcolo **/
+    for(size_t i=0; i<numeroCampi; i++) {
+        totale += sizeof(uint64_t) + campi[i].dimensione;
+    }
+
+    return totale;
+}
+
+
+/**
+ * @brief                   Invia i bytes di un vettore insieme a un descrittore (SCM_RIGHTS): il descrittore
+ *                          arriva al destinatario con il primo di questi bytes
+ * @fun                     inviaDescrittore
+ * @param fd                Socket su cui inviare
+ * @param vettore           Bytes da inviare
+ * @param descrittore       Descrittore da passare
+ * @return                  Ritorna il numero di bytes inviati (almeno uno); -1 in caso di errore [setta errno]
+ */
+static ssize_t inviaDescrittore(int fd, struct iovec *vettore, int descrittore) {
+    /** Variabili **/
+    union {
+        struct cmsghdr allineamento;
+        char spazio[CMSG_SPACE(sizeof(int))];
+    } controllo;
+    struct msghdr messaggio;
+    struct cmsghdr *c = NULL;
+    ssize_t inviati = -1;
+
+    /** Preparo il messaggio **/
+    memset(&messaggio, 0, sizeof(struct msghdr));
+    memset(&controllo, 0, sizeof(controllo));
+    messaggio.msg_iov = vettore, messaggio.msg_iovlen = 1;
+    messaggio.msg_control = controllo.spazio, messaggio.msg_controllen = sizeof(controllo.spazio);
+    c = CMSG_FIRSTHDR(&messaggio);
+    c->cmsg_level = SOL_SOCKET, c->cmsg_type = SCM_RIGHTS, c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &descrittore, sizeof(int));
+
+    /** Invio **/
+    while(((inviati = sendmsg(fd, &messaggio, 0)) == -1) && (errno == EINTR));
+    if(inviati == 0) { errno = ECOMM; return -1; }
+
+    return inviati;
+}
+
+
+/**
+ * @brief                   Invia i bytes dei vettori su un socket SOCK_SEQPACKET in pacchetti di al piu'
+ *                          PACCHETTO_MASSIMO bytes (e IOV_MAX vettori): il destinatario riceve ogni pacchetto con
+ *                          una sola lettura. L'eventuale descrittore accompagna il primo pacchetto
+ * @fun                     inviaPacchetti
+ * @param fd                Socket su cui inviare
+ * @param vettori           Bytes da inviare (vengono modificati)
+ * @param numeroVettori     Numero dei vettori
+ * @param descrittore       Descrittore da passare (-1 se nessuno)
+ * @return                  Ritorna il numero di bytes inviati; -1 in caso di errore [setta errno]
+ */
+static ssize_t inviaPacchetti(int fd, struct iovec *vettori, int numeroVettori, int descrittore) {
+    /** Variabili **/
+    union {
+        struct cmsghdr allineamento;
+        char spazio[CMSG_SPACE(sizeof(int))];
+    } controllo;
+    struct msghdr messaggio;
+    struct cmsghdr *c = NULL;
+    struct iovec tagliato;
+    size_t dimensione = 0, totale = 0;
+    ssize_t inviati = -1;
+    int numero = 0, taglio = 0;
+
+    /** Un pacchetto alla volta **/
+    while(numeroVettori > 0) {
+        /** Prendo i vettori che entrano nel pacchetto, spezzando l'ultimo se serve **/
+        dimensione = 0, numero = 0, taglio = 0;
+        while((numero < numeroVettori) && (numero < IOV_MAX) && (dimensione + vettori[numero].iov_len <= PACCHETTO_MASSIMO)) {
+            dimensione += vettori[numero++].iov_len;
+        }
+        if((numero < numeroVettori) && (numero < IOV_MAX) && (dimensione < PACCHETTO_MASSIMO)) {
+            tagliato = vettori[numero];
+            vettori[numero++].iov_len = PACCHETTO_MASSIMO - dimensione;
+            dimensione = PACCHETTO_MASSIMO, taglio = 1;
+        }
+
+        /** Invio il pacchetto **/
+        memset(&messaggio, 0, sizeof(struct msghdr));
+        messaggio.msg_iov = vettori, messaggio.msg_iovlen = numero;
+        if(descrittore >= 0) {
+            memset(&controllo, 0, sizeof(controllo));
+            messaggio.msg_control = controllo.spazio, messaggio.msg_controllen = sizeof(controllo.spazio);
+            c = CMSG_FIRSTHDR(&messaggio);
+            c->cmsg_level = SOL_SOCKET, c->cmsg_type = SCM_RIGHTS, c->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(c), &descrittore, sizeof(int));
+            descrittore = -1;
+        }
+        while(((inviati = sendmsg(fd, &messaggio, 0)) == -1) && (errno == EINTR));
+        if(inviati != (ssize_t) dimensione) {
+            if(inviati != -1) errno = ECOMM;
+            return -1;
+        }
+        totale += dimensione;
+
+        /** Il resto del vettore spezzato apre il prossimo pacchetto **/
+        if(taglio) {
+            numero--;
+            vettori[numero].iov_base = (char *) tagliato.iov_base + vettori[numero].iov_len;
+            vettori[numero].iov_len = tagliato.iov_len - vettori[numero].iov_len;
+        }
+        vettori += numero, numeroVettori -= numero;
+    }
+
+    return (ssize_t) totale;
+}
+
+
+/**
+ * @brief                   Invia un frame con un'unica writev: intestazione seguita dai campi del corpo
+ * @fun                     inviaFrame
+ * @param fd                FD su cui inviare il frame
+ * @param intestazione      Intestazione del frame (gia' completa della lunghezza del corpo)
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare insieme all'intestazione (-1 se nessuno)
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+static ssize_t inviaFrame(int fd, void *intestazione, size_t dimIntestazione, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Variabili **/
+    struct iovec vettoriLocali[1 + 2*CAMPI_LOCALI], *vettori = vettoriLocali;
+    uint64_t dimLocali[CAMPI_LOCALI], *dimCampi = dimLocali;
+    size_t totale = dimIntestazione;
+    ssize_t scritti = -1, inviati = 0;
+    int numeroVettori = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(fd <= 0) { errno = EINVAL; return -1; }
+    if((numeroCampi > 0) && (campi == NULL)) { errno = EINVAL; return -1; }
+
+    /** Costruisco i vettori: intestazione, poi dimensione e contenuto di ogni campo **/
+    if(numeroCampi > CAMPI_LOCALI) {
+        vettori = (struct iovec *) malloc((1 + 2*numeroCampi)*sizeof(struct iovec));
+        dimCampi = (uint64_t *) malloc(numeroCampi*sizeof(uint64_t));
+        if((vettori == NULL) || (dimCampi == NULL)) {
+            if(vettori != NULL) free(vettori);
+            if(dimCampi != NULL) free(dimCampi);
+            return -1;
+        }
+    }
+    vettori[numeroVettori].iov_base = intestazione;
+    vettori[numeroVettori++].iov_len = dimIntestazione;
+    for(size_t i=0; i<numeroCampi; i++) {
+        dimCampi[i] = campi[i].dimensione;
+        vettori[numeroVettori].iov_base = dimCampi + i;
+        vettori[numeroVettori++].iov_len = sizeof(uint64_t);
+        totale += sizeof(uint64_t) + campi[i].dimensione;
+        if(campi[i].dimensione == 0) continue;
+        vettori[numeroVettori].iov_base = (void *) campi[i].dati;
+        vettori[numeroVettori++].iov_len = campi[i].dimensione;
+    }
+
+    /** Socket SOCK_SEQPACKET: il frame parte a pacchetti **/
+    if(aPacchetti(fd)) {
+        scritti = inviaPacchetti(fd, vettori, numeroVettori, descrittore);
+        if(vettori != vettoriLocali) free(vettori);
+        if(dimCampi != dimLocali) free(dimCampi);
+        if(scritti != (ssize_t) totale) { errno = ECOMM; return -1; }
+        errno = 0;
+        return (ssize_t) totale;
+    }
+
+    /** Invio: l'eventuale descrittore accompagna i primi bytes dell'intestazione **/
+    if((descrittore >= 0) && ((inviati = inviaDescrittore(fd, vettori, descrittore)) != -1)) {
+        vettori[0].iov_base = (char *) vettori[0].iov_base + inviati;
+        vettori[0].iov_len -= inviati;
+    }
+    scritti = (inviati != -1) ? writevn(fd, vettori, numeroVettori) : -1;
+    if(vettori != vettoriLocali) free(vettori);
+    if(dimCampi != dimLocali) free(dimCampi);
+    if((scritti == -1) || (inviati + scritti != totale)) { errno = ECOMM; return -1; }
+
+    errno = 0;
+    return (ssize_t) totale;
+}
+
+
+/**
+ * @brief                   Riceve n bytes dal lettore se presente, altrimenti direttamente da fd
+ * @fun                     leggiFrame
+ * @param fd                FD da cui leggere
+ * @param lettore           Lettore bufferizzato (NULL per leggere direttamente da fd)
+ * @param ptr               Buffer su cui salvare i dati
+ * @param n                 Bytes da leggere
+ * @return                  Ritorna i bytes letti (meno di n in caso di EOF); -1 in caso di errore
+ */
+static ssize_t leggiFrame(int fd, Lettore *lettore, void *ptr, size_t n) {
+    return (lettore != NULL) ? readnLettore(lettore, ptr, n) : readn(fd, ptr, n);
+}
+
+
+/**
+ * @brief                   Riceve un pacchetto da un socket SOCK_SEQPACKET con un'unica recvmsg, insieme
+ *                          all'eventuale descrittore che lo accompagna (gli altri vengono chiusi)
+ * @fun                     riceviPacchetto
+ * @param fd                Socket da cui ricevere
+ * @param vettori           Destinazione del pacchetto
+ * @param numeroVettori     Numero dei vettori
+ * @param descrittore       Descrittore ricevuto (NULL per chiuderlo)
+ * @return                  Ritorna i bytes ricevuti; 0 se il canale e' stato chiuso; -1 in caso di errore o se il
+ *                          pacchetto non entra nei vettori [setta errno]
+ */
+static ssize_t riceviPacchetto(int fd, struct iovec *vettori, int numeroVettori, int *descrittore) {
+    /** Variabili **/
+    union {
+        struct cmsghdr allineamento;
+        char spazio[CMSG_SPACE(DESCRITTORI_LETTORE*sizeof(int))];
+    } controllo;
+    struct msghdr messaggio;
+    struct cmsghdr *c = NULL;
+    ssize_t letti = -1;
+    size_t arrivati = 0;
+    int d = -1;
+
+    /** Ricevo il pacchetto **/
+    memset(&messaggio, 0, sizeof(struct msghdr));
+    messaggio.msg_iov = vettori, messaggio.msg_iovlen = numeroVettori;
+    messaggio.msg_control = controllo.spazio, messaggio.msg_controllen = sizeof(controllo.spazio);
+    while(((letti = recvmsg(fd, &messaggio, 0)) == -1) && (errno == EINTR));
+    if(letti <= 0) return letti;
+    for(c = CMSG_FIRSTHDR(&messaggio); c != NULL; c = CMSG_NXTHDR(&messaggio, c)) {
+        if((c->cmsg_level != SOL_SOCKET) || (c->cmsg_type != SCM_RIGHTS)) continue;
+        arrivati = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i=0; i<arrivati; i++) {
+            memcpy(&d, CMSG_DATA(c) + i*sizeof(int), sizeof(int));
+            if((descrittore != NULL) && (*descrittore < 0)) *descrittore = d;
+            else close(d);
+        }
+    }
+    if(messaggio.msg_flags & MSG_TRUNC) { errno = EMSGSIZE; return -1; }
+
+    return letti;
+}
+
+
+/**
+ * @brief                   Riceve un frame da un socket SOCK_SEQPACKET senza lettore: il primo pacchetto arriva con
+ *                          una sola recvmsg che riempie intestazione e inizio del corpo, senza leggere prima la
+ *                          lunghezza; gli eventuali pacchetti successivi vengono ricevuti direttamente nel corpo
+ * @fun                     riceviFramePacchetti
+ * @param fd                Socket da cui ricevere il frame
+ * @param arena             Arena in cui ricevere il corpo (NULL per allocarlo con malloc)
+ * @param intestazione      Intestazione da riempire
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @param lunghezza         Campo dell'intestazione con la dimensione del corpo
+ * @param corpo             Corpo da riempire (gia' vuoto)
+ * @param descrittore       Descrittore arrivato con il frame, -1 se nessuno (NULL per scartarlo)
+ * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+ *                          -1 in caso di errore [setta errno]
+ */
+static ssize_t riceviFramePacchetti(int fd, Arena *arena, void *intestazione, size_t dimIntestazione, const uint64_t *lunghezza, Corpo *corpo, int *descrittore) {
+    /** Variabili **/
+    struct iovec vettori[2];
+    char *inizio = NULL;
+    size_t nelPrimo = 0, ricevuti = 0;
+    ssize_t letti = -1;
+    int error = 0;
+
+    /** Primo pacchetto: intestazione e inizio del corpo **/
+    if(descrittore != NULL) *descrittore = -1;
+    inizio = (arena != NULL) ? (char *) allocaArena(arena, PACCHETTO_MASSIMO - dimIntestazione) : (char *) malloc(PACCHETTO_MASSIMO - dimIntestazione);
+    if(inizio == NULL) return -1;
+    vettori[0].iov_base = intestazione, vettori[0].iov_len = dimIntestazione;
+    vettori[1].iov_base = inizio, vettori[1].iov_len = PACCHETTO_MASSIMO - dimIntestazione;
+    if(((letti = riceviPacchetto(fd, vettori, 2, descrittore)) < (ssize_t) dimIntestazione) || ((nelPrimo = letti - dimIntestazione) > *lunghezza)) {
+        error = (letti > 0) ? EBADMSG : ECOMM;
+        if(arena == NULL) free(inizio);
+        if((descrittore != NULL) && (*descrittore >= 0)) close(*descrittore), *descrittore = -1;
+        errno = error;
+        return (letti == 0) ? 0 : -1;
+    }
+
+    /** Frame in un solo pacchetto: il corpo e' gia' al suo posto **/
+    if(nelPrimo == *lunghezza) {
+        if(*lunghezza == 0) {
+            if(arena == NULL) free(inizio);
+        } else corpo->buffer = inizio, corpo->dimensione = *lunghezza, corpo->arena = arena;
+        errno = 0;
+        return letti;
+    }
+
+    /** Frame piu' grande di un pacchetto: il resto arriva direttamente nel corpo **/
+    corpo->buffer = (arena != NULL) ? (char *) allocaArena(arena, *lunghezza) : (char *) malloc(*lunghezza);
+    if(corpo->buffer != NULL) {
+        corpo->arena = arena;
+        memcpy(corpo->buffer, inizio, nelPrimo);
+    }
+    if(arena == NULL) free(inizio);
+    for(ricevuti = nelPrimo; (corpo->buffer != NULL) && (ricevuti < *lunghezza); ricevuti += letti) {
+        vettori[0].iov_base = corpo->buffer + ricevuti, vettori[0].iov_len = *lunghezza - ricevuti;
+        if((letti = riceviPacchetto(fd, vettori, 1, NULL)) <= 0) break;
+    }
+    if((corpo->buffer == NULL) || (ricevuti < *lunghezza)) {
+        error = (corpo->buffer == NULL) ? errno : ECOMM;
+        if((descrittore != NULL) && (*descrittore >= 0)) close(*descrittore), *descrittore = -1;
+        liberaCorpo(corpo);
+        errno = error;
+        return -1;
+    }
+    corpo->dimensione = *lunghezza;
+
+    errno = 0;
+    return (ssize_t) (dimIntestazione + *lunghezza);
+}
+
+
+/**
+ * @brief                   Riceve un frame: intestazione e corpo
+ * @fun                     riceviFrame
+ * @param fd                FD da cui ricevere il frame
+ * @param lettore           Lettore bufferizzato (NULL per leggere direttamente da fd)
+ * @param arena             Arena in cui ricevere il corpo (NULL per allocarlo con malloc)
+ * @param intestazione      Intestazione da riempire
+ * @param dimIntestazione   Dimensione dell'intestazione
+ * @param lunghezza         Campo dell'intestazione con la dimensione del corpo
+ * @param corpo             Corpo da riempire (il contenuto precedente viene liberato)
+ * @param descrittore       Descrittore arrivato con l'intestazione, -1 se nessuno (NULL per scartarlo; usato
+ *                          solo senza lettore)
+ * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+ *                          -1 in caso di errore [setta errno]
+ */
+static ssize_t riceviFrame(int fd, Lettore *lettore, Arena *arena, void *intestazione, size_t dimIntestazione, const uint64_t *lunghezza, Corpo *corpo, int *descrittore) {
+    /** Variabili **/
+    ssize_t letti = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(fd <= 0) { errno = EINVAL; return -1; }
+    if(corpo == NULL) { errno = EINVAL; return -1; }
+
+    /** Ricevo l'intestazione (con l'eventuale descrittore che la accompagna); senza lettore un socket
+        SOCK_SEQPACKET va letto a pacchetti interi, mentre il buffer del lettore ne contiene sempre uno **/
+    liberaCorpo(corpo);
+    if((lettore == NULL) && aPacchetti(fd)) return riceviFramePacchetti(fd, arena, intestazione, dimIntestazione, lunghezza, corpo, descrittore);
+    letti = ((lettore == NULL) && (descrittore != NULL)) ? readnDescrittore(fd, intestazione, dimIntestazione, descrittore) : leggiFrame(fd, lettore, intestazione, dimIntestazione);
+    if(letti != dimIntestazione) {
+        if((descrittore != NULL) && (*descrittore >= 0)) close(*descrittore), *descrittore = -1;
+        errno = ECOMM;
+        return (letti == 0) ? 0 : -1;
+    }
+
+    /** Ricevo il corpo direttamente nella sua destinazione **/
+    if(*lunghezza != 0) {
+        corpo->buffer = (arena != NULL) ? (char *) allocaArena(arena, *lunghezza) : (char *) malloc(*lunghezza);
+        if(corpo->buffer == NULL) {
+            if((descrittore != NULL) && (*descrittore >= 0)) close(*descrittore), *descrittore = -1;
+            return -1;
+        }
+        corpo->arena = arena;
+        if(leggiFrame(fd, lettore, corpo->buffer, *lunghezza) != *lunghezza) {
+            if((descrittore != NULL) && (*descrittore >= 0)) close(*descrittore), *descrittore = -1;
+            liberaCorpo(corpo);
+            errno = ECOMM;
+            return -1;
+        }
+        corpo->dimensione = *lunghezza;
+    }
+
+    errno = 0;
+    return (ssize_t) (dimIntestazione + *lunghezza);
+}
+
+
+/**
+ * @brief                   Invia una richiesta v2 con i campi indicati come corpo
+ * @fun                     inviaRichiesta
+ * @param fd                FD su cui inviare la richiesta
+ * @param intestazione      Intestazione della richiesta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+ssize_t inviaRichiesta(int fd, Intestazione_Richiesta *intestazione, const Campo *campi, size_t numeroCampi) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+
+    /** Invio **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return inviaFrame(fd, intestazione, sizeof(Intestazione_Richiesta), campi, numeroCampi, -1);
+}
+
+
+/**
+ * @brief                   Invia una richiesta v2 passando al server anche un descrittore (SCM_RIGHTS)
+ * @fun                     inviaRichiestaConDescrittore
+ * @param fd                Socket su cui inviare la richiesta
+ * @param intestazione      Intestazione della richiesta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare (resta aperto anche nel mittente)
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+ssize_t inviaRichiestaConDescrittore(int fd, Intestazione_Richiesta *intestazione, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+    if(descrittore < 0) { errno = EINVAL; return -1; }
+
+    /** Invio **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return inviaFrame(fd, intestazione, sizeof(Intestazione_Richiesta), campi, numeroCampi, descrittore);
+}
+
+
+/**
+ * @brief                   Invia una risposta v2 con i campi indicati come corpo
+ * @fun                     inviaRisposta
+ * @param fd                FD su cui inviare la risposta
+ * @param intestazione      Intestazione della risposta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+ssize_t inviaRisposta(int fd, Intestazione_Risposta *intestazione, const Campo *campi, size_t numeroCampi) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+
+    /** Invio **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return inviaFrame(fd, intestazione, sizeof(Intestazione_Risposta), campi, numeroCampi, -1);
+}
+
+
+/**
+ * @brief                   Invia una risposta v2 passando al client anche un descrittore (SCM_RIGHTS)
+ * @fun                     inviaRispostaConDescrittore
+ * @param fd                Socket su cui inviare la risposta
+ * @param intestazione      Intestazione della risposta (la lunghezza viene calcolata)
+ * @param campi             Campi del corpo
+ * @param numeroCampi       Numero dei campi
+ * @param descrittore       Descrittore da passare (resta aperto anche nel mittente)
+ * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+ */
+ssize_t inviaRispostaConDescrittore(int fd, Intestazione_Risposta *intestazione, const Campo *campi, size_t numeroCampi, int descrittore) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+    if(descrittore < 0) { errno = EINVAL; return -1; }
+
+    /** Invio **/
+    intestazione->lunghezza = dimensioneCorpo(campi, numeroCampi);
+    return inviaFrame(fd, intestazione, sizeof(Intestazione_Risposta), campi, numeroCampi, descrittore);
+}
+
+
+/**
+ * @brief                   Riceve una richiesta v2 (intestazione e corpo)
+ * @fun                     riceviRichiesta
+ * @param fd                FD da cui ricevere la richiesta
+ * @param intestazione      Intestazione della richiesta
+ * @param corpo             Corpo della richiesta
+ * @param arena             Arena della connessione in cui ricevere il corpo (NULL per allocarlo con malloc)
+ * @param descrittore       Descrittore passato dal client con l'intestazione, -1 se nessuno (NULL per scartarlo)
+ * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+ *                          -1 in caso di errore [setta errno]
+ */
+ssize_t riceviRichiesta(int fd, Intestazione_Richiesta *intestazione, Corpo *corpo, Arena *arena, int *descrittore) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+
+    /** Ricevo **/
+    return riceviFrame(fd, NULL, arena, intestazione, sizeof(Intestazione_Richiesta), &(intestazione->lunghezza), corpo, descrittore);
+}
+
+
+/**
+ * @brief                   Riceve una risposta v2 (intestazione e corpo) tramite il lettore bufferizzato del client
+ * @fun                     riceviRisposta
+ * @param lettore           Lettore da cui ricevere la risposta
+ * @param intestazione      Intestazione della risposta
+ * @param corpo             Corpo della risposta
+ * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+ *                          -1 in caso di errore [setta errno]
+ */
+ssize_t riceviRisposta(Lettore *lettore, Intestazione_Risposta *intestazione, Corpo *corpo) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(lettore == NULL) { errno = EINVAL; return -1; }
+    if(intestazione == NULL) { errno = EINVAL; return -1; }
+
+    /** Ricevo **/
+    return riceviFrame(lettore->fd, lettore, NULL, intestazione, sizeof(Intestazione_Risposta), &(intestazione->lunghezza), corpo, NULL);
+}
+
+
+/**
+ * @brief                   Legge il prossimo campo del corpo senza copiarlo
+ * @fun                     leggiCampo
+ * @param corpo             Corpo da cui leggere
+ * @param dati              Puntatore al contenuto del campo (interno al corpo)
+ * @param dimensione        Dimensione del campo
+ * @return                  Ritorna (0) in caso di successo; (-1) se il corpo e' finito o malformato [setta errno]
+ */
+int leggiCampo(Corpo *corpo, void **dati, size_t *dimensione) {
+    /** Variabili **/
+    uint64_t dimCampo = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((corpo == NULL) || (dati == NULL) || (dimensione == NULL)) { errno = EINVAL; return -1; }
+    if((corpo->dimensione - corpo->letti) < sizeof(uint64_t)) { errno = EBADMSG; return -1; }
+
+    /** Leggo dimensione e contenuto del campo **/
+    memcpy(&dimCampo, corpo->buffer + corpo->letti, sizeof(uint64_t));
+    if(dimCampo > (corpo->dimensione - corpo->letti - sizeof(uint64_t))) { errno = EBADMSG; return -1; }
+    *dati = corpo->buffer + corpo->letti + sizeof(uint64_t);
+    *dimensione = (size_t) dimCampo;
+    corpo->letti += sizeof(uint64_t) + dimCampo;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Libera il contenuto del corpo
+ * @fun                     liberaCorpo
+ * @param corpo             Corpo da liberare
+ */
+void liberaCorpo(Corpo *corpo) {
+    /** Controllo parametri **/
+    if(corpo == NULL) return;
+
+    /** Libero (la memoria di un'arena viene riusata da chi la possiede) **/
+    if((corpo->buffer != NULL) && (corpo->arena == NULL)) free(corpo->buffer);
+    corpo->buffer = NULL;
+    corpo->arena = NULL;
+    corpo->dimensione = 0;
+    corpo->letti = 0;
+}
+
+
+/**
+ * @brief                   Scrive in memoria i campi indicati nel formato del corpo di un frame, per i corpi annidati
+ *                          nel campo di un altro corpo (le operazioni di OP_COMPOSTA)
+ * @fun                     scriviCampi
+ * @param destinazione      Memoria in cui scrivere (almeno dimensioneCorpo dei campi)
+ * @param campi             Campi da scrivere
+ * @param numeroCampi       Numero dei campi
+ * @return                  Ritorna il numero di bytes scritti
+ */
+uint64_t scriviCampi(void *destinazione, const Campo *campi, size_t numeroCampi) {
+    /** Variabili **/
+    char *posizione = (char *) destinazione;
+    uint64_t dimCampo = 0;
+
+    /** Scrivo dimensione e contenuto di ogni campo **/
+    for(size_t i=0; i<numeroCampi; i++) {
+        dimCampo = (uint64_t) campi[i].dimensione;
+        memcpy(posizione, &dimCampo, sizeof(uint64_t));
+        if(dimCampo > 0) memcpy(posizione + sizeof(uint64_t), campi[i].dati, campi[i].dimensione);
+        posizione += sizeof(uint64_t) + dimCampo;
+    }
+
+    return (uint64_t) (posizione - (char *) destinazione);
+}
+
+
+/**
+ * @brief                   Prepara la lettura di un corpo annidato nel campo di un altro corpo: la memoria resta
+ *                          di quest'ultimo, quindi il corpo annidato non va liberato
+ * @fun                     corpoAnnidato
+ * @param corpo             Corpo da preparare
+ * @param dati              Inizio del corpo annidato
+ * @param dimensione        Dimensione del corpo annidato
+ */
+void corpoAnnidato(Corpo *corpo, void *dati, size_t dimensione) {
+    corpo->buffer = (char *) dati;
+    corpo->dimensione = dimensione;
+    corpo->letti = 0;
+    corpo->arena = NULL;
+}
@@ -0,0 +1,329 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Segmento di memoria condivisa in sola lettura con i file pubblicati dal server
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#define _GNU_SOURCE
+#include "segmento.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**
+ * @brief                   Hash FNV-1a del pathname: il server e i client devono calcolarlo allo stesso modo
+ * @fun                     hashPathname
+ * @param pathname          Pathname del file
+ * @return                  Ritorna l'hash
+ */
+static uint32_t hashPathname(const char *pathname) {
+    /** Variabili **/
+    uint32_t hash = 2166136261u;
+
+    /** Calcolo **/
+    for(size_t i=0; (i<VOCE_PATHNAME) && (pathname[i] != '\0'); i++) {
+        hash ^= (unsigned char) pathname[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+/**
+ * @brief                   Scrive una voce con il seqlock: i lettori che la attraversano scartano la loro copia
+ * @fun                     scriviVoce
+ * @param voce              Voce da scrivere (l'unico scrittore e' chi ha acquisito l'accesso al segmento)
+ * @param stato             Nuovo stato della voce
+ * @param pathname          Pathname del file (NULL per lasciarlo invariato)
+ * @param dati              Contenuto del file
+ * @param dimensione        Dimensione del contenuto
+ */
+static void scriviVoce(Voce_Condivisa *voce, uint32_t stato, const char *pathname, const void *dati, size_t dimensione) {
+    /** Variabili **/
+    uint32_t sequenza = __atomic_load_n(&(voce->sequenza), __ATOMIC_RELAXED);
+
+    /** Sequenza dispari durante la scrittura **/
+    __atomic_store_n(&(voce->sequenza), sequenza + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    voce->stato = stato;
+    voce->dimensione = dimensione;
+    if(pathname != NULL) {
+        memset(voce->pathname, 0, VOCE_PATHNAME);
+        memcpy(voce->pathname, pathname, strnlen(pathname, VOCE_PATHNAME-1));
+    }
+    if(dimensione > 0) memcpy(voce->dati, dati, dimensione);
+    __atomic_store_n(&(voce->sequenza), sequenza + 2, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief                   Crea il segmento condiviso: il memfd viene sigillato contro scritture future, cosi'
+ *                          i client possono solo mapparlo in lettura mentre il server continua a scriverlo
+ * @fun                     creaSegmento
+ * @param dimensione        Dimensione in bytes del segmento
+ * @return                  Ritorna il segmento; NULL in caso di errore [setta errno]
+ */
+Segmento* creaSegmento(size_t dimensione) {
+    /** Variabili **/
+    Segmento *segmento = NULL;
+    size_t numeroVoci = 0;
+    int error = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(dimensione < sizeof(Segmento_Condiviso) + sizeof(Voce_Condivisa)) { errno = EINVAL; return NULL; }
+    numeroVoci = (dimensione - sizeof(Segmento_Condiviso)) / sizeof(Voce_Condivisa);
+    dimensione = sizeof(Segmento_Condiviso) + numeroVoci*sizeof(Voce_Condivisa);
+
+    /** Creo la struttura **/
+    if((segmento = (Segmento *) calloc(1, sizeof(Segmento))) == NULL) {
+        return NULL;
+    }
+    segmento->descrittore = -1, segmento->memoria = MAP_FAILED, segmento->dimensione = dimensione;
+    if(((segmento->accesso = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t))) == NULL) ||
+       ((segmento->proprietari = (const void **) calloc(numeroVoci, sizeof(void *))) == NULL)) {
+        distruggiSegmento(&segmento);
+        return NULL;
+    }
+    if((error = pthread_mutex_init(segmento->accesso, NULL)) != 0) {
+        free(segmento->accesso), segmento->accesso = NULL;
+        distruggiSegmento(&segmento);
+        errno = error;
+        return NULL;
+    }
+
+    /** Creo e mappo il memfd, poi lo sigillo **/
+    if(((segmento->descrittore = memfd_create("segmento", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) ||
+       (ftruncate(segmento->descrittore, dimensione) == -1) ||
+       ((segmento->memoria = (Segmento_Condiviso *) mmap(NULL, dimensione, PROT_READ | PROT_WRITE, MAP_SHARED, segmento->descrittore, 0)) == MAP_FAILED) ||
+       (fcntl(segmento->descrittore, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) == -1)) {
+        error = errno;
+        distruggiSegmento(&segmento);
+        errno = error;
+        return NULL;
+    }
+    (segmento->memoria)->magia = SEGMENTO_MAGIA;
+    (segmento->memoria)->numeroVoci = (uint32_t) numeroVoci;
+
+    errno = 0;
+    return segmento;
+}
+
+
+/**
+ * @brief                   Distrugge il segmento condiviso (i client che l'hanno mappato continuano a vederlo)
+ * @fun                     distruggiSegmento
+ * @param segmento          Segmento da distruggere (viene messo a NULL)
+ */
+void distruggiSegmento(Segmento **segmento) {
+    /** Controllo parametri **/
+    if((segmento == NULL) || (*segmento == NULL)) return;
+
+    /** Distruggo **/
+    if((*segmento)->memoria != MAP_FAILED) munmap((*segmento)->memoria, (*segmento)->dimensione);
+    if((*segmento)->descrittore != -1) close((*segmento)->descrittore);
+    if((*segmento)->accesso != NULL) {
+        pthread_mutex_destroy((*segmento)->accesso);
+        free((*segmento)->accesso);
+    }
+    if((*segmento)->proprietari != NULL) free((*segmento)->proprietari);
+    free(*segmento);
+    *segmento = NULL;
+}
+
+
+/**
+ * @brief                   Pubblica (o aggiorna) il contenuto di un file nel segmento: la voce viene cercata
+ *                          lungo la scansione del suo hash e, se il file non c'e', presa dalla prima libera o rimossa
+ * @fun                     pubblicaVoce
+ * @param segmento          Segmento in cui pubblicare
+ * @param proprietario      File a cui appartiene la voce (solo lui potra' ritirarla)
+ * @param pathname          Pathname del file
+ * @param dati              Contenuto del file
+ * @param dimensione        Dimensione del contenuto
+ * @return                  Ritorna l'indice della voce; -1 in caso di errore [setta errno: ENAMETOOLONG, EFBIG
+ *                          oppure ENOSPC se il segmento e' pieno]
+ */
+int pubblicaVoce(Segmento *segmento, const void *proprietario, const char *pathname, const void *dati, size_t dimensione) {
+    /** Variabili **/
+    Voce_Condivisa *voci = NULL;
+    uint32_t numeroVoci = 0, inizio = 0, indice = 0;
+    int scelta = -1, error = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((segmento == NULL) || (proprietario == NULL) || (pathname == NULL)) { errno = EINVAL; return -1; }
+    if((dimensione > 0) && (dati == NULL)) { errno = EINVAL; return -1; }
+    if(strnlen(pathname, VOCE_PATHNAME) >= VOCE_PATHNAME) { errno = ENAMETOOLONG; return -1; }
+    if(dimensione > VOCE_DATI) { errno = EFBIG; return -1; }
+
+    /** Cerco la voce del file o la prima disponibile **/
+    voci = (segmento->memoria)->voci, numeroVoci = (segmento->memoria)->numeroVoci;
+    inizio = hashPathname(pathname) % numeroVoci;
+    if((error = pthread_mutex_lock(segmento->accesso)) != 0) {
+        errno = error;
+        return -1;
+    }
+    for(uint32_t i=0; i<numeroVoci; i++) {
+        indice = (inizio + i) % numeroVoci;
+        if(voci[indice].stato == VOCE_OCCUPATA) {
+            if(strncmp(voci[indice].pathname, pathname, VOCE_PATHNAME) != 0) continue;
+            scelta = (int) indice;
+            break;
+        }
+        if(scelta == -1) scelta = (int) indice;
+        if(voci[indice].stato == VOCE_LIBERA) break;
+    }
+    if(scelta == -1) {
+        pthread_mutex_unlock(segmento->accesso);
+        errno = ENOSPC;
+        return -1;
+    }
+
+    /** Scrivo la voce **/
+    scriviVoce(voci + scelta, VOCE_OCCUPATA, pathname, dati, dimensione);
+    (segmento->proprietari)[scelta] = proprietario;
+    pthread_mutex_unlock(segmento->accesso);
+
+    errno = 0;
+    return scelta;
+}
+
+
+/**
+ * @brief                   Ritira la voce di un file dal segmento: resta come rimossa per non interrompere la
+ *                          scansione delle altre voci. Se nel frattempo la voce e' passata a un altro file non
+ *                          viene toccata
+ * @fun                     ritiraVoce
+ * @param segmento          Segmento
+ * @param indice            Indice della voce
+ * @param proprietario      File che ritira la voce
+ */
+void ritiraVoce(Segmento *segmento, int indice, const void *proprietario) {
+    /** Controllo parametri **/
+    if((segmento == NULL) || (indice < 0) || ((uint32_t) indice >= (segmento->memoria)->numeroVoci)) return;
+
+    /** Ritiro **/
+    if(pthread_mutex_lock(segmento->accesso) != 0) return;
+    if((segmento->proprietari)[indice] == proprietario) {
+        scriviVoce((segmento->memoria)->voci + indice, VOCE_RIMOSSA, NULL, NULL, 0);
+        (segmento->proprietari)[indice] = NULL;
+    }
+    pthread_mutex_unlock(segmento->accesso);
+}
+
+
+/**
+ * @brief                   Mappa in sola lettura il segmento ricevuto dal server, verificandone il formato
+ * @fun                     mappaSegmento
+ * @param descrittore       Memfd del segmento (puo' essere chiuso dopo la mappatura)
+ * @param dimensione        Dimensione della mappatura
+ * @return                  Ritorna il segmento; NULL in caso di errore [setta errno]
+ */
+const Segmento_Condiviso* mappaSegmento(int descrittore, size_t *dimensione) {
+    /** Variabili **/
+    Segmento_Condiviso *segmento = NULL;
+    struct stat info;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((descrittore < 0) || (dimensione == NULL)) { errno = EINVAL; return NULL; }
+
+    /** Mappo e controllo che la tabella stia nel segmento **/
+    if(fstat(descrittore, &info) == -1) return NULL;
+    if(info.st_size < (off_t) (sizeof(Segmento_Condiviso) + sizeof(Voce_Condivisa))) { errno = EINVAL; return NULL; }
+    if((segmento = (Segmento_Condiviso *) mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, descrittore, 0)) == MAP_FAILED) {
+        return NULL;
+    }
+    if((segmento->magia != SEGMENTO_MAGIA) || (segmento->numeroVoci == 0) ||
+       (sizeof(Segmento_Condiviso) + (size_t) segmento->numeroVoci*sizeof(Voce_Condivisa) > (size_t) info.st_size)) {
+        munmap(segmento, (size_t) info.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    *dimensione = (size_t) info.st_size;
+
+    errno = 0;
+    return segmento;
+}
+
+
+/**
+ * @brief                   Rilascia la mappatura del segmento
+ * @fun                     smappaSegmento
+ * @param segmento          Segmento da rilasciare (viene messo a NULL)
+ * @param dimensione        Dimensione della mappatura
+ */
+void smappaSegmento(const Segmento_Condiviso **segmento, size_t dimensione) {
+    /** Controllo parametri **/
+    if((segmento == NULL) || (*segmento == NULL)) return;
+
+    /** Rilascio **/
+    munmap((void *) *segmento, dimensione);
+    *segmento = NULL;
+}
+
+
+/**
+ * @brief                   Legge un file dal segmento senza chiamate di sistema: ogni voce attraversata viene
+ *                          letta con il seqlock e, se il server la sta aggiornando, la lettura viene ripetuta
+ *                          al piu' TENTATIVI_VOCE volte
+ * @fun                     leggiSegmento
+ * @param segmento          Segmento mappato
+ * @param pathname          Pathname del file
+ * @param buf               Copia del contenuto (allocata con malloc; NULL se il file e' vuoto)
+ * @param size              Dimensione del contenuto
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno: ENOENT se il file non
+ *                          e' pubblicato, EAGAIN se il server lo sta aggiornando]
+ */
+int leggiSegmento(const Segmento_Condiviso *segmento, const char *pathname, void **buf, size_t *size) {
+    /** Variabili **/
+    const Voce_Condivisa *voce = NULL;
+    uint32_t numeroVoci = 0, inizio = 0, prima = 0, stato = 0;
+    uint64_t dimensione = 0;
+    void *copia = NULL;
+    int uguale = 0, tentativi = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if((segmento == NULL) || (pathname == NULL) || (buf == NULL) || (size == NULL)) { errno = EINVAL; return -1; }
+    if(strnlen(pathname, VOCE_PATHNAME) >= VOCE_PATHNAME) { errno = ENOENT; return -1; }
+
+    /** Scansione delle voci a partire dall'hash del pathname **/
+    numeroVoci = segmento->numeroVoci;
+    inizio = hashPathname(pathname) % numeroVoci;
+    for(uint32_t i=0; i<numeroVoci; i++) {
+        voce = segmento->voci + ((inizio + i) % numeroVoci);
+        for(tentativi = 0; tentativi < TENTATIVI_VOCE; tentativi++) {
+            /** Copia della voce tra due letture della stessa sequenza pari **/
+            if((prima = __atomic_load_n(&(voce->sequenza), __ATOMIC_ACQUIRE)) & 1) continue;
+            stato = voce->stato, dimensione = voce->dimensione;
+            uguale = (stato == VOCE_OCCUPATA) && (strncmp(voce->pathname, pathname, VOCE_PATHNAME) == 0);
+            if(uguale && (dimensione <= VOCE_DATI) && (dimensione > 0)) {
+                if((copia = malloc((size_t) dimensione)) == NULL) return -1;
+                memcpy(copia, voce->dati, (size_t) dimensione);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(__atomic_load_n(&(voce->sequenza), __ATOMIC_RELAXED) == prima) break;
+            if(copia != NULL) free(copia), copia = NULL;
+        }
+        if(tentativi == TENTATIVI_VOCE) { errno = EAGAIN; return -1; }
+        if(stato == VOCE_LIBERA) break;
+        if(!uguale) continue;
+        if(dimensione > VOCE_DATI) { errno = EAGAIN; return -1; }
+
+        /** Voce del file **/
+        *buf = copia;
+        *size = (size_t) dimensione;
+        errno = 0;
+        return 0;
+    }
+
+    errno = ENOENT;
+    return -1;
+}
@@ -26,22 +26,109 @@
     #include <stdio.h>
     #include <utils.h>
     #include <math.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <protocol.h>
+    #include <anello.h>
     #include <FileStorageServer.h>
 
 
+    /** Richieste v2 servite da un task finche' il client ne ha altre gia' in coda sul socket **/
+    #define RICHIESTE_PER_TASK 16
+
+    /** Socket da cui e' arrivato un client **/
+    #define TRASPORTO_STREAM 0
+    #define TRASPORTO_PACCHETTI 1
+    #define TRASPORTO_TCP 2
+
+
+    /**
+     * @brief                   Richiesta v2 sospesa in attesa di una lock
+     * @struct                  Attesa_Lock
+     * @param id                Identificativo della richiesta
+     * @param opcode            Opcode della richiesta
+     * @param pathname          File su cui si attende la lock
+     */
+    typedef struct {
+        uint32_t id;
+        uint16_t opcode;
+        char *pathname;
+    } Attesa_Lock;
+
+
     /**
-     * @brief       Argomenti per ogni thread del pool
-     * @struct      Task_Package
-     * @param fd    FD del client con cui comunica
-     * @param pfd   Pipe per scrivere FD da riabilitare
-     * @param cache Memoria cache da gestire per le richieste
-     * @param log   File di log per il tracciamento delle operazioni
+     * @brief                   Maniglia data a un client con openFile (FLAG_MANIGLIA): le richieste che la usano
+     *                          portano il suo numero (posizione nella tabella della sessione + 1) al posto del pathname
+     * @struct                  Maniglia_Sessione
+     * @param pathname          File della maniglia (NULL se la posizione e' libera)
+     * @param file              Maniglia del file nella cache
+     */
+    typedef struct {
+        char *pathname;
+        Maniglia_File file;
+    } Maniglia_Sessione;
+
+
+    /**
+     * @brief                   Stato di una connessione con un client
+     * @struct                  Sessione
+     * @param protocollo        Versione del protocollo negoziata (PROTOCOLLO_V1 o PROTOCOLLO_V2)
+     * @param ricezione         Arena in cui vengono ricevute le richieste, riusata tra una richiesta e l'altra
+     * @param accesso           Serializza le risposte sul socket e l'accesso alle attese (il client puo'
+     *                          essere risvegliato da un altro thread mentre le sue richieste vengono servite)
+     * @param attese            Richieste v2 sospese in attesa di una lock (al piu' FINESTRA_MASSIMA)
+     * @param numeroAttese      Numero delle richieste sospese
+     * @param cartellaEspulsi   Cartella registrata dal client (descrittore passato con SCM_RIGHTS) in cui il server
+     *                          salva direttamente i file espulsi dalle sue scritture; -1 se non registrata
+     * @param anelli            Anelli in memoria condivisa da cui arrivano le richieste e su cui partono le
+     *                          risposte (OP_ANELLI); NULL se il client usa solo il socket
+     * @param campanello        Eventfd con cui il client segnala nuove richieste negli anelli; -1 se non ci sono
+     * @param remota            (1) se il client e' connesso via TCP: niente descrittori ne' memoria condivisa, e le
+     *                          risposte a piu' richieste servite di fila vengono raccolte con TCP_CORK
+     * @param pacchetti         (1) se il client e' connesso al socket SOCK_SEQPACKET: niente anelli, i frame viaggiano
+     *                          sempre a pacchetti
+     * @param espulsioni        Consegna dei file espulsi dalle scritture del client (ESPULSI_*, OP_ESPULSIONI)
+     * @param maniglie          Maniglie date al client, usate solo dal task che ne serve le richieste
+     * @param numeroManiglie    Dimensione della tabella delle maniglie
+     * @param corsia            Corsia della prossima richiesta, scelta dal task che serve il client con l'intestazione
+     *                          gia' letta o sbirciata (se non c'e' ancora, quella dell'ultima richiesta servita)
+     */
+    typedef struct {
+        int protocollo;
+        Arena ricezione;
+        pthread_mutex_t *accesso;
+        Attesa_Lock *attese;
+        unsigned int numeroAttese;
+        int cartellaEspulsi;
+        Anelli *anelli;
+        int campanello;
+        int remota;
+        int pacchetti;
+        int espulsioni;
+        Maniglia_Sessione *maniglie;
+        unsigned int numeroManiglie;
+        int corsia;
+    } Sessione;
+
+
+    /**
+     * @brief           Argomenti per ogni thread del pool
+     * @struct          Task_Package
+     * @param fd        FD del client con cui comunica
+     * @param pfd       Pipe per scrivere FD da riabilitare
+     * @param cache     Memoria cache da gestire per le richieste
+     * @param log       File di log per il tracciamento delle operazioni
+     * @param sessioni  Tabella delle sessioni dei client, indicizzata per FD
      */
     typedef struct {
         int fd;
         int pfd;
         LRU_Memory *cache;
         serverLogFile *log;
+        Sessione *sessioni;
     } Task_Package;
 
 
@@ -53,4 +140,44 @@
     void* ServerTasks(unsigned int, void *);
 
 
+    /**
+     * @brief                       Crea la tabella delle sessioni, indicizzata per FD
+     * @fun                         creaSessioni
+     * @return                      Ritorna la tabella; NULL in caso di errore [setta errno]
+     */
+    Sessione* creaSessioni(size_t);
+
+
+    /**
+     * @brief                       Distrugge la tabella delle sessioni
+     * @fun                         distruggiSessioni
+     */
+    void distruggiSessioni(Sessione **, size_t);
+
+
+    /**
+     * @brief                       Inizializza la sessione di un client appena connesso, indicando il socket da cui e'
+     *                              arrivato (TRASPORTO_STREAM, TRASPORTO_PACCHETTI o TRASPORTO_TCP)
+     * @fun                         apriSessione
+     * @return                      Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int apriSessione(Sessione *, int, int);
+
+
+    /**
+     * @brief                       Rilascia le risorse della sessione di un client
+     * @fun                         chiudiSessione
+     */
+    void chiudiSessione(Sessione *);
+
+
+    /**
+     * @brief                       Classifica la prossima richiesta del client senza chiamate di sistema
+     * @fun                         classificaRichiesta
+     * @return                      CORSIA_PRIORITARIA per le operazioni sui metadati; CORSIA_NORMALE per i trasferimenti
+     *                              di dati
+     */
+    int classificaRichiesta(const Sessione *);
+
+
 #endif //FILE_STORAGE_SERVER_LRU_SERVER_API_H
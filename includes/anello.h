@@ -0,0 +1,175 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Anelli in memoria condivisa tra client e server sulla stessa macchina: le richieste e le
+ *                      risposte piccole passano dalla memoria invece che dal socket
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#ifndef FILE_STORAGE_SERVER_LRU_ANELLO_H
+
+
+    #define FILE_STORAGE_SERVER_LRU_ANELLO_H
+
+
+    /** Capacita' di ogni anello (potenza di due) **/
+    #define ANELLO_CAPACITA (512*1024)
+
+    /**
+     * Frame che l'anello delle risposte deve poter contenere: ognuna delle FINESTRA_MASSIMA richieste in volo produce la
+     * sua risposta e al piu' una notifica fuori finestra (OP_ESPULSIONI, anche rinviata dopo una richiesta composta)
+     */
+    #define ANELLO_FRAME_RISERVATI (2*FINESTRA_MASSIMA)
+
+    /** Frame piu' grande scritto nell'anello: con ANELLO_FRAME_RISERVATI frame in sospeso l'anello non si riempie **/
+    #define ANELLO_MASSIMO_FRAME (ANELLO_CAPACITA / ANELLO_FRAME_RISERVATI)
+
+    /** Attesa massima di una risposta nell'anello prima di controllare che il server sia ancora connesso **/
+    #define ATTESA_ANELLO_MS 100
+
+    #define LINEA_CACHE 64
+
+
+    #include <stdlib.h>
+    #include <stdint.h>
+    #include <utils.h>
+    #include <protocol.h>
+
+
+    /**
+     * @brief                   Anello di bytes con un solo produttore e un solo consumatore: i frame vengono scritti
+     *                          con lo stesso formato del socket (intestazione e campi)
+     * @struct                  Anello
+     * @param scritti           Bytes scritti dal produttore (contatore che si riavvolge)
+     * @param inAttesa          Il consumatore dorme sul futex di scritti
+     * @param letti             Bytes consumati dal consumatore, su una linea di cache separata
+     * @param dati              Contenuto dell'anello
+     */
+    typedef struct {
+        uint32_t scritti;
+        uint32_t inAttesa;
+        char separazioneScritti[LINEA_CACHE - 2*sizeof(uint32_t)];
+        uint32_t letti;
+        char separazioneLetti[LINEA_CACHE - sizeof(uint32_t)];
+        char dati[ANELLO_CAPACITA];
+    } Anello;
+
+
+    /**
+     * @brief                   Coppia di anelli di una connessione, nel memfd condiviso tra client e server
+     * @struct                  Anelli
+     * @param richieste         Anello delle richieste (il client produce, il server consuma)
+     * @param risposte          Anello delle risposte (il server produce, il client consuma)
+     */
+    typedef struct {
+        Anello richieste;
+        Anello risposte;
+    } Anelli;
+
+
+    /**
+     * @brief                   Crea gli anelli in un memfd sigillato contro ridimensionamenti e li mappa
+     * @fun                     creaAnelli
+     * @return                  Ritorna gli anelli e il memfd da passare al server; NULL in caso di errore [setta errno]
+     */
+    Anelli* creaAnelli(int *);
+
+
+    /**
+     * @brief                   Mappa gli anelli ricevuti dal client, verificando dimensione e sigilli del memfd
+     * @fun                     mappaAnelli
+     * @return                  Ritorna gli anelli; NULL in caso di errore [setta errno]
+     */
+    Anelli* mappaAnelli(int);
+
+
+    /**
+     * @brief                   Rilascia la mappatura degli anelli
+     * @fun                     smappaAnelli
+     */
+    void smappaAnelli(Anelli **);
+
+
+    /**
+     * @brief                   Scrive una richiesta v2 nell'anello
+     * @fun                     scriviRichiestaAnello
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno: EMSGSIZE se
+     *                          il frame supera ANELLO_MASSIMO_FRAME, ENOBUFS se l'anello e' pieno]
+     */
+    ssize_t scriviRichiestaAnello(Anello *, Intestazione_Richiesta *, const Campo *, size_t);
+
+
+    /**
+     * @brief                   Scrive una risposta v2 nell'anello e sveglia il client se dorme
+     * @fun                     scriviRispostaAnello
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno: EMSGSIZE se
+     *                          il frame supera ANELLO_MASSIMO_FRAME, ENOBUFS se l'anello e' pieno]
+     */
+    ssize_t scriviRispostaAnello(Anello *, Intestazione_Risposta *, const Campo *, size_t);
+
+
+    /**
+     * @brief                   Preleva una richiesta v2 dall'anello, con il corpo nell'arena se indicata
+     * @fun                     leggiRichiestaAnello
+     * @return                  Ritorna il numero di bytes letti; 0 se l'anello e' vuoto; -1 in caso di errore [setta errno]
+     */
+    ssize_t leggiRichiestaAnello(Anello *, Intestazione_Richiesta *, Corpo *, Arena *);
+
+
+    /**
+     * @brief                   Preleva una risposta v2 dall'anello
+     * @fun                     leggiRispostaAnello
+     * @return                  Ritorna il numero di bytes letti; 0 se l'anello e' vuoto; -1 in caso di errore [setta errno]
+     */
+    ssize_t leggiRispostaAnello(Anello *, Intestazione_Risposta *, Corpo *);
+
+
+    /**
+     * @brief                   Copia l'intestazione del prossimo frame senza consumarlo
+     * @fun                     sbirciaAnello
+     * @return                  Ritorna (0) se c'e' un frame; (-1) altrimenti
+     */
+    int sbirciaAnello(const Anello *, void *, size_t);
+
+
+    /**
+     * @brief                   Verifica se l'anello e' vuoto
+     * @fun                     anelloVuoto
+     * @return                  Ritorna (1) se non ci sono frame da prelevare; (0) altrimenti
+     */
+    int anelloVuoto(const Anello *);
+
+
+    /**
+     * @brief                   Attende sul futex dell'anello che arrivi un frame
+     * @fun                     attendiAnello
+     * @return                  Ritorna (0) se l'anello non e' vuoto; (-1) allo scadere dell'attesa [setta errno]
+     */
+    int attendiAnello(Anello *, int);
+
+
+    /**
+     * @brief                   Crea il campanello (eventfd) con cui il client segnala al server nuove richieste
+     * @fun                     creaCampanello
+     * @return                  Ritorna il campanello; -1 in caso di errore [setta errno]
+     */
+    int creaCampanello(void);
+
+
+    /**
+     * @brief                   Suona il campanello
+     * @fun                     suonaCampanello
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int suonaCampanello(int);
+
+
+    /**
+     * @brief                   Azzera il campanello senza bloccarsi
+     * @fun                     azzeraCampanello
+     */
+    void azzeraCampanello(int);
+
+
+#endif //FILE_STORAGE_SERVER_LRU_ANELLO_H
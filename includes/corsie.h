@@ -0,0 +1,20 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Corsie della coda globale dei task, condivise dal pool di thread e dalle statistiche del server
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#ifndef FILE_STORAGE_SERVER_LRU_CORSIE_H
+
+
+    #define FILE_STORAGE_SERVER_LRU_CORSIE_H
+
+
+    #define NUMERO_CORSIE 2
+    #define CORSIA_NORMALE 0
+    #define CORSIA_PRIORITARIA 1
+
+
+#endif //FILE_STORAGE_SERVER_LRU_CORSIE_H
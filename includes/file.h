@@ -23,6 +23,7 @@
     #include <sys/time.h>
     #include <queue.h>
     #include <utils.h>
+    #include <segmento.h>
 
 
     /**
@@ -38,6 +39,11 @@
      * @param maxUtentiConnessiAlFile   Numero massimo di utenti che possono aprire al file
      * @param numeroUtentiConnessi      Numero di utenti hanno il file aperto
      * @param time                      Tempo di ultimo utilizzo
+     * @param copiaSigillata            Memfd sigillato con il contenuto del file, consegnato ai client per
+     *                                  le letture grandi (-1 se non ancora creato o non piu' valido)
+     * @param segmento                  Segmento condiviso in cui il file e' pubblicato (NULL se non pubblicato)
+     * @param voceCondivisa             Voce del file nel segmento (-1 se non pubblicato)
+     * @param posto                     Posto del file nella tabella delle maniglie della cache (-1 se non e' nella cache)
      */
     typedef struct {
         char *pathname;
@@ -52,6 +58,10 @@
         unsigned int numeroUtentiConnessi;
 
         struct timeval time;
+        int copiaSigillata;
+        Segmento *segmento;
+        int voceCondivisa;
+        int posto;
     } myFile;
 
 
@@ -83,6 +93,62 @@
     size_t addContentToFile(myFile *, void *, size_t);
 
 
+    /**
+     * @brief                       Aggiorna il contenuto di 'file' aggiungendo in append i bytes letti da un descrittore
+     * @fun                         addContentFromFd
+     * @return                      Ritorna la dimensione finale del file; in caso di errore ritorna (-1) e setta errno
+     */
+    size_t addContentFromFd(myFile *, int, size_t);
+
+
+    /**
+     * @brief                       Sovrascrive il contenuto di 'file' a partire da un offset, estendendolo se necessario
+     * @fun                         writeContentAt
+     * @return                      Ritorna la dimensione finale del file; in caso di errore ritorna (-1) e setta errno
+     */
+    size_t writeContentAt(myFile *, size_t, void *, size_t);
+
+
+    /**
+     * @brief                       Restituisce la copia sigillata (memfd in sola lettura) del contenuto di 'file',
+     *                              creandola se non esiste
+     * @fun                         sealedCopyOfFile
+     * @return                      Ritorna il descrittore della copia (appartiene al file); in caso di errore
+     *                              ritorna (-1) e setta errno
+     */
+    int sealedCopyOfFile(myFile *);
+
+
+    /**
+     * @brief                       Chiude la copia sigillata di 'file'
+     * @fun                         dropSealedCopy
+     */
+    void dropSealedCopy(myFile *);
+
+
+    /**
+     * @brief                       Pubblica il contenuto di 'file' nel segmento condiviso, che da quel momento
+     *                              viene aggiornato a ogni modifica del file
+     * @fun                         publishFileContent
+     * @return                      Ritorna (0) in caso di successo; in caso di errore ritorna (-1) e setta errno
+     */
+    int publishFileContent(myFile *, Segmento *);
+
+
+    /**
+     * @brief                       Aggiorna la voce di 'file' nel segmento condiviso dopo una modifica
+     * @fun                         refreshPublishedFile
+     */
+    void refreshPublishedFile(myFile *);
+
+
+    /**
+     * @brief                       Ritira 'file' dal segmento condiviso
+     * @fun                         withdrawPublishedFile
+     */
+    void withdrawPublishedFile(myFile *);
+
+
     /**
      * @brief                   Controlla che 'fd' abbia aperto 'file'
      * @fun                     fileIsOpenedFrom
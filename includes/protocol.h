@@ -0,0 +1,282 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Protocollo binario v2: frame con intestazione fissa e corpo a campi
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#ifndef FILE_STORAGE_SERVER_LRU_PROTOCOL_H
+
+
+    #define FILE_STORAGE_SERVER_LRU_PROTOCOL_H
+
+
+    /** Versioni del protocollo **/
+    #define PROTOCOLLO_V1 1
+    #define PROTOCOLLO_V2 2
+    #define COMANDO_PROTOCOLLO "protocollo"
+
+
+    /** Negoziazione senza attese: il client spedisce COMANDO_PROTOCOLLO con la proposta
+        { PROTOCOLLO_V2, NEGOZIAZIONE_CON_SONDA } seguito dalla sonda, un openFile v1 sul pathname vuoto.
+        Un server v2 consuma la sonda e risponde con { versione accettata, NEGOZIAZIONE_CON_SONDA }; un server
+        che non conosce la negoziazione ignora la proposta e risponde alla sonda con un solo int **/
+    #define NEGOZIAZIONE_CON_SONDA 1
+    #define COMANDO_SONDA "openFile"
+    #define PATHNAME_SONDA ""
+
+
+    /** Opcode delle richieste v2 **/
+    #define OP_OPENFILE 1
+    #define OP_READFILE 2
+    #define OP_READNFILES 3
+    #define OP_WRITEFILE 4
+    #define OP_APPENDTOFILE 5
+    #define OP_LOCKFILE 6
+    #define OP_UNLOCKFILE 7
+    #define OP_CLOSEFILE 8
+    #define OP_REMOVEFILE 9
+    #define OP_PUTFILE 10
+    #define OP_READFILES 11
+    #define OP_READFILERANGE 12
+    #define OP_WRITEAT 13
+    #define OP_REGISTERDIR 14
+    #define OP_ANELLI 15
+    #define OP_PUBLISHFILE 16
+    #define OP_SEGMENTO 17
+    #define OP_ESPULSIONI 18
+    #define OP_COMPOSTA 19
+    #define NUMERO_OPCODE 20
+
+
+    /** Flag di readFile: nella richiesta il client accetta il contenuto come memfd; nella risposta il corpo
+        contiene solo la dimensione e il memfd sigillato arriva con l'intestazione (SCM_RIGHTS).
+        Flag di putFile: il corpo contiene solo il pathname e il contenuto e' il file regolare il cui
+        descrittore arriva con l'intestazione della richiesta **/
+    #define FLAG_DESCRITTORE 0x8000
+
+    /** Flag delle risposte con file espulsi: il server li ha gia' salvati nella cartella registrata dal client
+        (OP_REGISTERDIR) e il corpo contiene solo i loro pathname **/
+    #define FLAG_SALVATI 0x4000
+
+    /** Flag delle notifiche di file espulsi in modalita' ESPULSI_NOMI, e delle risposte di scrittura per cui il server
+        non aveva memoria per spedirne i contenuti: il corpo contiene solo i loro pathname **/
+    #define FLAG_NOMI 0x1000
+
+    /** Flag delle richieste sui file: al posto del pathname il corpo contiene la maniglia (uint32_t) data dalla
+        risposta a un openFile con lo stesso flag (readFile, appendToFile, lockFile, unlockFile, closeFile) **/
+    #define FLAG_MANIGLIA 0x0800
+
+
+    /** Flag dei frame di una connessione con anelli in memoria condivisa (OP_ANELLI): nell'anello c'e' solo
+        l'intestazione e il frame completo viaggia sul socket (frame troppo grande o con un descrittore) **/
+    #define FLAG_SUL_SOCKET 0x2000
+
+
+    /** Pacchetto piu' grande spedito su un socket SOCK_SEQPACKET: i frame piu' grandi vengono spezzati in piu'
+        pacchetti. Il buffer del lettore del client contiene sempre un pacchetto intero **/
+    #define PACCHETTO_MASSIMO BUFFER_LETTORE
+
+
+    /** Consegna dei file espulsi dalle scritture di una sessione, scelta con OP_ESPULSIONI (nei flag della richiesta).
+        Tranne che in ESPULSI_IN_RISPOSTA la risposta alla scrittura parte subito senza file, e quelli espulsi
+        arrivano dopo in una notifica (id ID_NOTIFICA, opcode OP_ESPULSIONI) o vengono scartati **/
+    #define ESPULSI_IN_RISPOSTA 0
+    #define ESPULSI_CONTENUTO 1
+    #define ESPULSI_NOMI 2
+    #define ESPULSI_SCARTA 3
+    #define ID_NOTIFICA 0
+
+
+    /** Richiesta composta (OP_COMPOSTA): ogni campo del corpo e' un'operazione, cioe' un'Intestazione_Richiesta seguita
+        dal suo corpo. Il server le esegue in ordine nello stesso task e si ferma alla prima che fallisce; la risposta
+        ha un solo campo, che contiene un campo per ogni operazione eseguita (Intestazione_Risposta seguita dal suo
+        corpo). Il numero della risposta e' quello delle operazioni eseguite, l'esito quello dell'ultima **/
+    #define OPERAZIONI_COMPOSTE_MASSIME 64
+
+
+    /** Finestra delle richieste v2 in volo su una connessione **/
+    #define FINESTRA_PREDEFINITA 16
+    #define FINESTRA_MASSIMA 64
+
+
+    /** Campi di un frame i cui vettori di invio stanno sullo stack **/
+    #define CAMPI_LOCALI 16
+
+
+    #include <stdlib.h>
+    #include <stdint.h>
+    #include <utils.h>
+
+
+    /**
+     * @brief                   Intestazione di una richiesta v2 (il corpo segue subito dopo)
+     * @struct                  Intestazione_Richiesta
+     * @param opcode            Operazione richiesta (OP_*)
+     * @param flags             Flag dell'operazione (es. O_CREATE | O_LOCK per openFile)
+     * @param id                Identificativo della richiesta, ripetuto nella risposta
+     * @param lunghezza         Dimensione in bytes del corpo
+     */
+    typedef struct {
+        uint16_t opcode;
+        uint16_t flags;
+        uint32_t id;
+        uint64_t lunghezza;
+    } Intestazione_Richiesta;
+
+
+    /**
+     * @brief                   Intestazione di una risposta v2 (il corpo segue subito dopo)
+     * @struct                  Intestazione_Risposta
+     * @param opcode            Operazione a cui si risponde
+     * @param flags             Flag della risposta
+     * @param id                Identificativo della richiesta a cui si risponde
+     * @param esito             Esito dell'operazione: 0 in caso di successo; altrimenti il codice di errore
+     * @param numero            Numero di file (coppie pathname-contenuto) presenti nel corpo
+     * @param lunghezza         Dimensione in bytes del corpo
+     */
+    typedef struct {
+        uint16_t opcode;
+        uint16_t flags;
+        uint32_t id;
+        int32_t esito;
+        uint32_t numero;
+        uint64_t lunghezza;
+    } Intestazione_Risposta;
+
+
+    /**
+     * @brief                   Campo del corpo di un frame: sul canale viene preceduto dalla sua dimensione (uint64_t)
+     * @struct                  Campo
+     * @param dati              Contenuto del campo
+     * @param dimensione        Dimensione del contenuto
+     */
+    typedef struct {
+        const void *dati;
+        size_t dimensione;
+    } Campo;
+
+
+    /**
+     * @brief                   Corpo ricevuto di un frame, letto campo per campo
+     * @struct                  Corpo
+     * @param buffer            Contenuto del corpo
+     * @param dimensione        Dimensione del corpo
+     * @param letti             Bytes del corpo gia' consumati
+     * @param arena             Arena che contiene il buffer (NULL se il buffer e' allocato con malloc)
+     */
+    typedef struct {
+        char *buffer;
+        size_t dimensione;
+        size_t letti;
+        Arena *arena;
+    } Corpo;
+
+
+    /**
+     * @brief                   Indica se un socket e' SOCK_SEQPACKET (i frame viaggiano a pacchetti) o SOCK_STREAM
+     * @fun                     impostaPacchetti
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int impostaPacchetti(int, int);
+
+
+    /**
+     * @brief                   Legge le credenziali del processo dall'altra parte di un socket AF_UNIX (SO_PEERCRED)
+     * @fun                     credenzialiPeer
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int credenzialiPeer(int, uid_t *, gid_t *);
+
+
+    /**
+     * @brief                   Calcola la dimensione del corpo formato dai campi indicati
+     * @fun                     dimensioneCorpo
+     * @return                  Ritorna la dimensione del corpo sul canale
+     */
+    uint64_t dimensioneCorpo(const Campo *, size_t);
+
+
+    /**
+     * @brief                   Invia una richiesta v2 con i campi indicati come corpo
+     * @fun                     inviaRichiesta
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+     */
+    ssize_t inviaRichiesta(int, Intestazione_Richiesta *, const Campo *, size_t);
+
+
+    /**
+     * @brief                   Invia una richiesta v2 passando al server anche un descrittore (SCM_RIGHTS)
+     * @fun                     inviaRichiestaConDescrittore
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+     */
+    ssize_t inviaRichiestaConDescrittore(int, Intestazione_Richiesta *, const Campo *, size_t, int);
+
+
+    /**
+     * @brief                   Invia una risposta v2 con i campi indicati come corpo
+     * @fun                     inviaRisposta
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+     */
+    ssize_t inviaRisposta(int, Intestazione_Risposta *, const Campo *, size_t);
+
+
+    /**
+     * @brief                   Invia una risposta v2 passando al client anche un descrittore (SCM_RIGHTS)
+     * @fun                     inviaRispostaConDescrittore
+     * @return                  Ritorna il numero di bytes scritti; -1 in caso di errore [setta errno]
+     */
+    ssize_t inviaRispostaConDescrittore(int, Intestazione_Risposta *, const Campo *, size_t, int);
+
+
+    /**
+     * @brief                   Riceve una richiesta v2 (intestazione e corpo), con il corpo nell'arena se indicata,
+     *                          e l'eventuale descrittore passato dal client con l'intestazione
+     * @fun                     riceviRichiesta
+     * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+     *                          -1 in caso di errore [setta errno]
+     */
+    ssize_t riceviRichiesta(int, Intestazione_Richiesta *, Corpo *, Arena *, int *);
+
+
+    /**
+     * @brief                   Riceve una risposta v2 (intestazione e corpo) tramite il lettore bufferizzato del client
+     * @fun                     riceviRisposta
+     * @return                  Ritorna il numero di bytes letti; 0 se il canale e' stato chiuso;
+     *                          -1 in caso di errore [setta errno]
+     */
+    ssize_t riceviRisposta(Lettore *, Intestazione_Risposta *, Corpo *);
+
+
+    /**
+     * @brief                   Legge il prossimo campo del corpo senza copiarlo
+     * @fun                     leggiCampo
+     * @return                  Ritorna (0) in caso di successo; (-1) se il corpo e' finito o malformato [setta errno]
+     */
+    int leggiCampo(Corpo *, void **, size_t *);
+
+
+    /**
+     * @brief                   Libera il contenuto del corpo
+     * @fun                     liberaCorpo
+     */
+    void liberaCorpo(Corpo *);
+
+
+    /**
+     * @brief                   Scrive in memoria i campi indicati nel formato del corpo di un frame (corpi annidati)
+     * @fun                     scriviCampi
+     * @return                  Ritorna il numero di bytes scritti
+     */
+    uint64_t scriviCampi(void *, const Campo *, size_t);
+
+
+    /**
+     * @brief                   Prepara la lettura di un corpo annidato nel campo di un altro corpo (non va liberato)
+     * @fun                     corpoAnnidato
+     */
+    void corpoAnnidato(Corpo *, void *, size_t);
+
+
+#endif //FILE_STORAGE_SERVER_LRU_PROTOCOL_H
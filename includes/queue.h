@@ -30,6 +30,32 @@
     } Queue;
 
 
+    /**
+     * @brief               Nodo di una coda intrusiva: va messo come primo campo della struttura da accodare,
+     *                      cosi' che la memoria del nodo sia del chiamante e non della coda
+     * @struct              QueueNode
+     * @param next          Puntatore al nodo successivo
+     */
+    typedef struct queue_node {
+        struct queue_node *next;
+    } QueueNode;
+
+
+    /**
+     * @brief               Coda intrusiva FIFO con puntatore alla coda: inserimento ed estrazione in O(1)
+     *                      e senza allocazioni
+     * @struct              IntrusiveQueue
+     * @param head          Primo nodo della coda
+     * @param tail          Ultimo nodo della coda
+     * @param len           Numero di nodi in coda
+     */
+    typedef struct {
+        QueueNode *head;
+        QueueNode *tail;
+        size_t len;
+    } IntrusiveQueue;
+
+
     /**
      * @brief               Struttura che rappresenta il prototipo di funzione di comparazione tra elementi
      * @struct              Compare_Fun
@@ -84,4 +110,27 @@
     void destroyQueue(Queue **q, Free_Data);
 
 
+    /**
+     * @brief               Inizializza una coda intrusiva vuota
+     * @fun                 initIntrusiveQueue
+     */
+    void initIntrusiveQueue(IntrusiveQueue *);
+
+
+    /**
+     * @brief               Inserisce in fondo alla coda intrusiva un nodo del chiamante
+     * @fun                 enqueueNode
+     * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int enqueueNode(IntrusiveQueue *, QueueNode *);
+
+
+    /**
+     * @brief               Estrae il primo nodo della coda intrusiva
+     * @fun                 dequeueNode
+     * @return              Ritorna il nodo estratto; NULL se la coda e' vuota
+     */
+    QueueNode* dequeueNode(IntrusiveQueue *);
+
+
 #endif //FILE_STORAGE_SERVER_LRU_QUEUE_H
@@ -173,4 +173,66 @@ void destroyQueue(Queue **q, Free_Data destroy) {
     }
 
     *q = NULL;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief               Inizializza una coda intrusiva vuota
+ * @fun                 initIntrusiveQueue
+ * @param q             Coda da inizializzare
+ */
+void initIntrusiveQueue(IntrusiveQueue *q) {
+    /** Controllo parametri **/
+    if(q == NULL) return;
+
+    /** Inizializzo **/
+    q->head = NULL, q->tail = NULL, q->len = 0;
+}
+
+
+/**
+ * @brief               Inserisce in fondo alla coda intrusiva un nodo del chiamante
+ * @fun                 enqueueNode
+ * @param q             Coda
+ * @param node          Nodo da inserire (la memoria resta del chiamante)
+ * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int enqueueNode(IntrusiveQueue *q, QueueNode *node) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(q == NULL) { errno = EINVAL; return -1; }
+    if(node == NULL) { errno = EINVAL; return -1; }
+
+    /** Aggancio il nodo in coda **/
+    node->next = NULL;
+    if(q->tail == NULL) q->head = node;
+    else (q->tail)->next = node;
+    q->tail = node;
+    (q->len)++;
+
+    return 0;
+}
+
+
+/**
+ * @brief               Estrae il primo nodo della coda intrusiva
+ * @fun                 dequeueNode
+ * @param q             Coda
+ * @return              Ritorna il nodo estratto; NULL se la coda e' vuota
+ */
+QueueNode* dequeueNode(IntrusiveQueue *q) {
+    /** Variabili **/
+    QueueNode *node = NULL;
+
+    /** Controllo parametri **/
+    if((q == NULL) || (q->head == NULL)) return NULL;
+
+    /** Sgancio il primo nodo **/
+    node = q->head;
+    q->head = node->next;
+    if(q->head == NULL) q->tail = NULL;
+    (q->len)--;
+    node->next = NULL;
+
+    return node;
+}
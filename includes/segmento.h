@@ -0,0 +1,139 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Segmento di memoria condivisa in sola lettura con i file pubblicati dal server: i client
+ *                      sulla stessa macchina li leggono senza chiamate di sistema
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#ifndef FILE_STORAGE_SERVER_LRU_SEGMENTO_H
+
+
+    #define FILE_STORAGE_SERVER_LRU_SEGMENTO_H
+
+
+    #define SEGMENTO_MAGIA 0x46535347
+    #define VOCE_PATHNAME 256
+    #define VOCE_DATI 4096
+
+    /** Tentativi di lettura di una voce che il server sta aggiornando prima di passare al socket **/
+    #define TENTATIVI_VOCE 4
+
+    /** Stato di una voce **/
+    #define VOCE_LIBERA 0
+    #define VOCE_OCCUPATA 1
+    #define VOCE_RIMOSSA 2
+
+
+    #include <stdlib.h>
+    #include <stdint.h>
+    #include <pthread.h>
+    #include <utils.h>
+
+
+    /**
+     * @brief                   Voce del segmento, protetta da un seqlock: il server incrementa la sequenza prima
+     *                          e dopo ogni scrittura, il lettore la rilegge e scarta la copia se e' cambiata o dispari
+     * @struct                  Voce_Condivisa
+     * @param sequenza          Sequenza del seqlock (dispari durante una scrittura)
+     * @param stato             VOCE_LIBERA, VOCE_OCCUPATA o VOCE_RIMOSSA
+     * @param dimensione        Dimensione del contenuto
+     * @param pathname          Pathname del file
+     * @param dati              Contenuto del file
+     */
+    typedef struct {
+        uint32_t sequenza;
+        uint32_t stato;
+        uint64_t dimensione;
+        char pathname[VOCE_PATHNAME];
+        char dati[VOCE_DATI];
+    } Voce_Condivisa;
+
+
+    /**
+     * @brief                   Contenuto del segmento: tabella hash a indirizzamento aperto (scansione lineare)
+     * @struct                  Segmento_Condiviso
+     * @param magia             SEGMENTO_MAGIA
+     * @param numeroVoci        Numero delle voci della tabella
+     * @param voci              Voci della tabella
+     */
+    typedef struct {
+        uint32_t magia;
+        uint32_t numeroVoci;
+        Voce_Condivisa voci[];
+    } Segmento_Condiviso;
+
+
+    /**
+     * @brief                   Segmento dal lato del server, che e' l'unico a scriverlo
+     * @struct                  Segmento
+     * @param memoria           Mappatura in scrittura del segmento
+     * @param dimensione        Dimensione della mappatura
+     * @param descrittore       Memfd del segmento, sigillato: i client possono mapparlo solo in lettura
+     * @param accesso           Serializza le scritture delle voci
+     * @param proprietari       File a cui appartiene ogni voce (NULL se nessuno)
+     */
+    typedef struct {
+        Segmento_Condiviso *memoria;
+        size_t dimensione;
+        int descrittore;
+        pthread_mutex_t *accesso;
+        const void **proprietari;
+    } Segmento;
+
+
+    /**
+     * @brief                   Crea il segmento condiviso della dimensione indicata
+     * @fun                     creaSegmento
+     * @return                  Ritorna il segmento; NULL in caso di errore [setta errno]
+     */
+    Segmento* creaSegmento(size_t);
+
+
+    /**
+     * @brief                   Distrugge il segmento condiviso (i client che l'hanno mappato continuano a vederlo)
+     * @fun                     distruggiSegmento
+     */
+    void distruggiSegmento(Segmento **);
+
+
+    /**
+     * @brief                   Pubblica (o aggiorna) il contenuto di un file nel segmento
+     * @fun                     pubblicaVoce
+     * @return                  Ritorna l'indice della voce; -1 in caso di errore [setta errno]
+     */
+    int pubblicaVoce(Segmento *, const void *, const char *, const void *, size_t);
+
+
+    /**
+     * @brief                   Ritira la voce di un file dal segmento
+     * @fun                     ritiraVoce
+     */
+    void ritiraVoce(Segmento *, int, const void *);
+
+
+    /**
+     * @brief                   Mappa in sola lettura il segmento ricevuto dal server
+     * @fun                     mappaSegmento
+     * @return                  Ritorna il segmento; NULL in caso di errore [setta errno]
+     */
+    const Segmento_Condiviso* mappaSegmento(int, size_t *);
+
+
+    /**
+     * @brief                   Rilascia la mappatura del segmento
+     * @fun                     smappaSegmento
+     */
+    void smappaSegmento(const Segmento_Condiviso **, size_t);
+
+
+    /**
+     * @brief                   Legge un file dal segmento senza chiamate di sistema
+     * @fun                     leggiSegmento
+     * @return                  Ritorna (0) in caso di successo; (-1) se il file non c'e' o viene aggiornato [setta errno]
+     */
+    int leggiSegmento(const Segmento_Condiviso *, const char *, void **, size_t *);
+
+
+#endif //FILE_STORAGE_SERVER_LRU_SEGMENTO_H
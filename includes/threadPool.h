@@ -20,6 +20,88 @@
     #include <logFile.h>
     #include <pthread.h>
     #include <string.h>
+    #include <time.h>
+    #include <corsie.h>
+
+
+    #define DIM_CODA_THREAD 256
+    #define DIM_BATCH_TASK 4
+    #define SOGLIA_CODA_AIUTANTI 4
+    #define SOGLIA_ATTESA_AIUTANTI_MS 20
+    #define TIMEOUT_AIUTANTI_MS 5000
+    #define PESO_CORSIA_PRIORITARIA 4
+    #define SOGLIA_FURTO_AFFINITA 2
+    #define SPIN_MINIMO 16
+
+
+    /**
+     * @brief                           Coda di lavoro di un singolo thread (deque di Chase-Lev): il proprietario
+     *                                  inserisce ed estrae dal fondo, gli altri thread rubano dalla cima
+     * @struct                          WorkDeque
+     * @param top                       Indice della cima (da cui rubano gli altri thread)
+     * @param bottom                    Indice del fondo (usato solo dal thread proprietario)
+     * @param mask                      Maschera per indicizzare il buffer circolare (capacita' - 1)
+     * @param buffer                    Buffer circolare dei task
+     */
+    typedef struct {
+        long top;
+        long bottom;
+        long mask;
+        void **buffer;
+    } WorkDeque;
+
+
+    /**
+     * @brief                           Cella della coda globale dei task
+     * @struct                          RingSlot
+     * @param sequenza                  Numero di sequenza che indica se la cella e' libera o occupata
+     * @param task                      Task contenuto nella cella
+     */
+    typedef struct {
+        long sequenza;
+        void *task;
+    } RingSlot;
+
+
+    /**
+     * @brief                           Coda globale limitata e lock-free a piu' produttori e piu' consumatori
+     *                                  (buffer circolare con numero di sequenza per cella)
+     * @struct                          TaskRing
+     * @param testa                     Prossima posizione da cui estrarre
+     * @param coda                      Prossima posizione in cui inserire
+     * @param mask                      Maschera per indicizzare il buffer circolare (capacita' - 1)
+     * @param slot                      Celle del buffer circolare
+     */
+    typedef struct {
+        long testa;
+        long coda;
+        long mask;
+        RingSlot *slot;
+    } TaskRing;
+
+
+    /**
+     * @brief                           Impostazioni di avvio del pool di thread
+     * @struct                          Pool_Settings
+     * @param numeroThread              Numero di thread fissi da creare
+     * @param maxThread                 Numero massimo di thread (fissi piu' aiutanti); se uguale a numeroThread il pool non cresce
+     * @param dimCoda                   Capacita' della coda globale dei task di ciascuna corsia
+     * @param affinita                  Se i task con affinita' vanno al loro thread "di casa"
+     * @param cpu                       Lista delle CPU su cui fissare i thread fissi (NULL per non fissarli)
+     * @param numeroCpu                 Lunghezza della lista delle CPU
+     * @param maxSpin                   Numero massimo di giri di attesa attiva prima di sospendersi (0 la disattiva)
+     * @param busyPoll                  Se i thread fissi non si sospendono mai ma interrogano le code di continuo
+     */
+    typedef struct {
+        unsigned int numeroThread;
+        unsigned int maxThread;
+        unsigned int dimCoda;
+        int affinita;
+        int *cpu;
+        unsigned int numeroCpu;
+        unsigned int maxSpin;
+        int busyPoll;
+    } Pool_Settings;
 
 
     /**
@@ -28,31 +110,58 @@
      * @param shutdown                  Variabile che indica al pool il momento di arrestarsi
      * @param hardST                    Se si vuole spegnere il server immediatamente
      * @param numeroThread              Numero dei thread fissi del pool di thread
-     * @param numeroDiThreadAttivi      Numero di thread attivi in quel istante
-     * @param numeroThreadAiutanti      Numero di thread in supporto al pool
+     * @param maxThread                 Numero massimo di thread, fissi ed aiutanti, del pool
+     * @param numeroDiThreadAttivi      Numero di thread attivi in quel istante [accesso atomico]
+     * @param numeroThreadAiutanti      Numero di thread in supporto al pool, creati sotto carico e terminati
+     *                                  dopo TIMEOUT_AIUTANTI_MS di inattivita' [accesso atomico]
+     * @param numeroThreadDormienti     Numero di thread in attesa sulla variabile condizione [accesso atomico]
+     * @param aiutantiCreati            Numero di thread aiutanti creati dall'avvio, da cui l'id di ogni nuovo aiutante
+     *                                  (non viene mai riusato) [protetto da taskQueueMutex]
      * @param thread                    ID dei thread del pool fissi
-     * @param taskQueue                 Coda dei task da far eseguire ai thread
-     * @param numeroTaskInCoda          Numero dei task in coda
-     * @param taskQueueMutex            Variabile Mutex per l'accesso concorrente alla coda dei task
-     * @param emptyCondVar              Variabile condizione per segnalare se la coda dei task e' vuota o no
-     * @param isEmpty                   Variabile per gestire il controllo di riempimento della coda
+     * @param codeThread                Code di lavoro locali, una per ogni thread
+     * @param taskQueue                 Code globali limitate di iniezione dei task inviati dal thread manager, una per
+     *                                  corsia: i thread servono PESO_CORSIA_PRIORITARIA task prioritari per ogni task
+     *                                  normale, cosi' che nessuna delle due corsie resti senza servizio
+     * @param affinita                  Se attiva la modalita' di affinita' delle connessioni
+     * @param codeAffinita              Code dei task destinati ad un thread fisso "di casa", una per thread: gli altri
+     *                                  thread ne rubano solo se contengono almeno SOGLIA_FURTO_AFFINITA task
+     * @param numeroTaskInCoda          Numero dei task in coda, globale e locali [accesso atomico]
+     * @param taskQueueMutex            Variabile Mutex per l'attesa dei thread senza lavoro
+     * @param emptyCondVar              Variabile condizione su cui attendono i thread aiutanti
+     * @param condThread                Variabili condizione su cui attendono i thread fissi, una per thread
+     * @param dormiente                 Per ogni thread fisso indica se e' in attesa e non ancora svegliato
+     * @param maxSpin                   Budget massimo di giri di attesa attiva prima di sospendersi; ogni thread
+     *                                  lo adatta raddoppiandolo quando l'attesa attiva trova lavoro e dimezzandolo
+     *                                  (fino a SPIN_MINIMO) quando non lo trova
+     * @param busyPoll                  Se i thread fissi non si sospendono mai
+     * @param aiutantiCondVar           Variabile condizione per segnalare la terminazione dei thread aiutanti
      * @param log                       File di log in caso tracciamento
      */
-    typedef struct{
+    typedef struct {
         int shutdown;
         int hardST;
 
         unsigned int numeroThread;
+        unsigned int maxThread;
         unsigned int numeroDiThreadAttivi;
         unsigned int numeroThreadAiutanti;
+        unsigned int numeroThreadDormienti;
+        unsigned int aiutantiCreati;
 
         pthread_t *threads;
-        Queue *taskQueue;
+        WorkDeque *codeThread;
+        TaskRing taskQueue[NUMERO_CORSIE];
+        int affinita;
+        TaskRing *codeAffinita;
         void (*free_task)(void *);
         int numeroTaskInCoda;
         pthread_mutex_t *taskQueueMutex;
         pthread_cond_t *emptyCondVar;
-        int isEmpty;
+        pthread_cond_t *condThread;
+        int *dormiente;
+        unsigned int maxSpin;
+        int busyPoll;
+        pthread_cond_t *aiutantiCondVar;
 
         serverLogFile *log;
     } threadPool;
@@ -66,12 +175,23 @@
 
 
     /**
-     * @brief                   Struttura che rappresenta il Task che aggiungo alla coda
+     * @brief                   Struttura che rappresenta il Task che aggiungo alla coda; la memoria e' del chiamante
+     *                          e viene restituita tramite free_task una volta eseguito il task
      * @struct                  Task
+     * @param node              Nodo per le code intrusive del chiamante (deve restare il primo campo)
+     * @param to_do             Funzione da eseguire
+     * @param argv              Argomenti della funzione
+     * @param corsia            Corsia della coda globale in cui inserire il task (CORSIA_NORMALE o CORSIA_PRIORITARIA)
+     * @param affinita          Chiave di affinita' (es. fd della connessione) che sceglie il thread di casa; -1 se nessuna
+     * @param arrivo            Istante di inserimento nel pool (usato per misurare l'attesa in coda)
      */
     typedef struct {
+        QueueNode node;
         Task_Fun to_do;
         void *argv;
+        int corsia;
+        int affinita;
+        struct timespec arrivo;
     } Task;
 
 
@@ -80,13 +200,16 @@
      * @fun                     startThreadPool
      * @return                  Ritorna la struttura che rappresenta il pool; in caso di errore ritorna NULL [setta errno]
      */
-    threadPool* startThreadPool(unsigned int, void (*free_task)(void *), serverLogFile *);
+    threadPool* startThreadPool(Pool_Settings *, void (*free_task)(void *), serverLogFile *);
 
 
     /**
-     * @brief                   Funzione che manda un task da eseguire al pool
+     * @brief                   Funzione che manda un task da eseguire al pool; se chiamata da un thread del pool
+     *                          il task finisce nella sua coda locale, altrimenti nella coda globale
      * @fun                     pushTask
-     * @return                  (0) in caso di successo; (-1) altrimenti [setta errno]
+     * @return                  (0) se il task e' in coda, anche se non e' stato possibile svegliare un thread; (-1)
+     *                          altrimenti [setta errno: EAGAIN se la coda globale e' piena, in tal caso il task resta
+     *                          al chiamante]
      */
     int pushTask(threadPool *, Task *);
 
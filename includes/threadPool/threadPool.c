@@ -7,7 +7,22 @@
  */
 
 
+#define _GNU_SOURCE
 #include "threadPool.h"
+#include <sched.h>
+
+
+/**
+ * @brief               Pausa della CPU durante l'attesa attiva
+ * @macro               CPU_RELAX
+ */
+#if defined(__x86_64__) || defined(__i386__)
+    #define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+    #define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+    #define CPU_RELAX() do { } while(0)
+#endif
 
 
 /**
@@ -16,14 +31,27 @@
  * @param idThread      Id del thread
  * @param log           File di log
  * @param pool          Pool che gestisce il thread
+ * @param aiutante      Se il thread e' un aiutante (senza coda locale, termina dopo un periodo di inattivita')
  */
 typedef struct {
     unsigned int idThread;
     serverLogFile *log;
     threadPool *pool;
+    int aiutante;
 } Threads_Arg;
 
 
+/**
+ * @brief               Pool e indice della coda locale del thread corrente (-1 se non e' un thread del pool)
+ */
+static __thread threadPool *poolCorrente = NULL;
+static __thread int codaCorrente = -1;
+static __thread unsigned int turnoCorsia = 0;
+
+
+static void* start_routine(void *);
+
+
 /**
  * @brief               Dealloca l'intero pool di thread
  * @macro               FREE_POOL_THREAD
@@ -39,8 +67,33 @@ typedef struct {
             pthread_cond_destroy(pool->emptyCondVar);                                       \
             free(pool->emptyCondVar);                                                       \
         }                                                                                   \
+        if(pool->aiutantiCondVar != NULL) {                                                 \
+            pthread_cond_destroy(pool->aiutantiCondVar);                                    \
+            free(pool->aiutantiCondVar);                                                    \
+        }                                                                                   \
+        if(pool->condThread != NULL) {                                                      \
+            for(int k=0; k<pool->numeroThread; k++) {                                       \
+                pthread_cond_destroy((pool->condThread)+k);                                 \
+            }                                                                               \
+            free(pool->condThread);                                                         \
+        }                                                                                   \
+        if(pool->dormiente != NULL) { free(pool->dormiente); }                              \
+        if(pool->codeAffinita != NULL) {                                                    \
+            for(int k=0; k<pool->numeroThread; k++) {                                       \
+                destroyRing((pool->codeAffinita)+k, pool->free_task);                       \
+            }                                                                               \
+            free(pool->codeAffinita);                                                       \
+        }                                                                                   \
+        if(pool->codeThread != NULL) {                                                      \
+            for(int k=0; k<pool->numeroThread; k++) {                                       \
+                destroyDeque((pool->codeThread)+k, pool->free_task);                        \
+            }                                                                               \
+            free(pool->codeThread);                                                         \
+        }                                                                                   \
         if(pool->threads != NULL) { free(pool->threads); }                                  \
-        if(pool->taskQueue != NULL) { destroyQueue(&(pool->taskQueue), pool->free_task); }  \
+        for(int k=0; k<NUMERO_CORSIE; k++) {                                                \
+            destroyRing((pool->taskQueue)+k, pool->free_task);                              \
+        }                                                                                   \
         if(pool != NULL) { free(pool); }                                                    \
         errno = error;                                                                      \
     } while(0);
@@ -84,69 +137,580 @@ typedef struct {
         }                                                           \
     }
 
+
+/**
+ * @brief               Inizializza la coda locale di un thread
+ * @fun                 initDeque
+ * @param d             Coda da inizializzare
+ * @param capacita      Capacita' della coda (potenza di 2)
+ * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int initDeque(WorkDeque *d, long capacita) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(d == NULL) { errno = EINVAL; return -1; }
+    if((capacita <= 0) || ((capacita & (capacita - 1)) != 0)) { errno = EINVAL; return -1; }
+
+    /** Alloco il buffer circolare **/
+    if((d->buffer = (void **) calloc(capacita, sizeof(void *))) == NULL) {
+        return -1;
+    }
+    d->top = 0, d->bottom = 0, d->mask = capacita - 1;
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief               Dealloca la coda locale di un thread ed i task rimasti al suo interno
+ * @fun                 destroyDeque
+ * @param d             Coda da deallocare
+ * @param free_task     Funzione per deallocare i task rimasti
+ */
+static void destroyDeque(WorkDeque *d, void (*free_task)(void *)) {
+    /** Controllo parametri **/
+    if((d == NULL) || (d->buffer == NULL)) return;
+
+    /** Dealloco **/
+    while(d->top < d->bottom) {
+        free_task((d->buffer)[(d->top) & (d->mask)]);
+        (d->top)++;
+    }
+    free(d->buffer);
+    d->buffer = NULL;
+}
+
+
+/**
+ * @brief               Inserisce un task in fondo alla coda locale (solo thread proprietario)
+ * @fun                 pushDeque
+ * @param d             Coda locale
+ * @param task          Task da inserire
+ * @return              (0) in caso di successo; (-1) se la coda e' piena
+ */
+static int pushDeque(WorkDeque *d, void *task) {
+    /** Variabili **/
+    long b = -1, t = -1;
+
+    /** Inserimento **/
+    b = __atomic_load_n(&(d->bottom), __ATOMIC_RELAXED);
+    t = __atomic_load_n(&(d->top), __ATOMIC_ACQUIRE);
+    if((b - t) > (d->mask)) return -1;
+    __atomic_store_n(&((d->buffer)[b & (d->mask)]), task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&(d->bottom), b + 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+
+/**
+ * @brief               Estrae un task dal fondo della coda locale (solo thread proprietario)
+ * @fun                 popDeque
+ * @param d             Coda locale
+ * @return              Ritorna il task estratto; NULL se la coda e' vuota
+ */
+static void* popDeque(WorkDeque *d) {
+    /** Variabili **/
+    long b = -1, t = -1;
+    void *task = NULL;
+
+    /** Estrazione **/
+    b = __atomic_load_n(&(d->bottom), __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&(d->bottom), b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&(d->top), __ATOMIC_RELAXED);
+    if(t <= b) {
+        task = __atomic_load_n(&((d->buffer)[b & (d->mask)]), __ATOMIC_RELAXED);
+        if(t == b) {
+            /** Ultimo elemento: competo con eventuali ladri **/
+            if(!__atomic_compare_exchange_n(&(d->top), &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                task = NULL;
+            }
+            __atomic_store_n(&(d->bottom), b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&(d->bottom), b + 1, __ATOMIC_RELAXED);
+    }
+
+    return task;
+}
+
+
+/**
+ * @brief               Ruba un task dalla cima della coda locale di un altro thread
+ * @fun                 stealDeque
+ * @param d             Coda locale da cui rubare
+ * @return              Ritorna il task rubato; NULL se la coda e' vuota o se si e' perso il confronto
+ */
+static void* stealDeque(WorkDeque *d) {
+    /** Variabili **/
+    long b = -1, t = -1;
+    void *task = NULL;
+
+    /** Furto **/
+    t = __atomic_load_n(&(d->top), __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&(d->bottom), __ATOMIC_ACQUIRE);
+    if(t < b) {
+        task = __atomic_load_n(&((d->buffer)[t & (d->mask)]), __ATOMIC_RELAXED);
+        if(!__atomic_compare_exchange_n(&(d->top), &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return NULL;
+        }
+    }
+
+    return task;
+}
+
+
+/**
+ * @brief               Numero di task presenti nella coda locale (stima del thread proprietario)
+ * @fun                 dimDeque
+ * @param d             Coda locale
+ * @return              Ritorna il numero di task in coda
+ */
+static long dimDeque(WorkDeque *d) {
+    return __atomic_load_n(&(d->bottom), __ATOMIC_RELAXED) - __atomic_load_n(&(d->top), __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * @brief               Inizializza la coda globale limitata
+ * @fun                 initRing
+ * @param r             Coda da inizializzare
+ * @param capacita      Capacita' richiesta (arrotondata alla potenza di 2 successiva, minimo 2)
+ * @return              (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+static int initRing(TaskRing *r, unsigned int capacita) {
+    /** Variabili **/
+    long dim = 2;   // con una sola cella i numeri di sequenza di "piena" e "libera" coinciderebbero
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(r == NULL) { errno = EINVAL; return -1; }
+    if(capacita == 0) { errno = EINVAL; return -1; }
+
+    /** Alloco il buffer circolare **/
+    while(dim < capacita) dim <<= 1;
+    if((r->slot = (RingSlot *) calloc(dim, sizeof(RingSlot))) == NULL) {
+        return -1;
+    }
+    for(long i=0; i<dim; i++) (r->slot)[i].sequenza = i;
+    r->testa = 0, r->coda = 0, r->mask = dim - 1;
+
+    errno = 0;
+    return 0;
+}
+
+
+/**
+ * @brief               Inserisce un task nella coda globale limitata
+ * @fun                 pushRing
+ * @param r             Coda globale
+ * @param task          Task da inserire
+ * @return              (0) in caso di successo; (-1) se la coda e' piena
+ */
+static int pushRing(TaskRing *r, void *task) {
+    /** Variabili **/
+    long pos = -1, seq = -1;
+    RingSlot *cella = NULL;
+
+    /** Prenoto una cella libera **/
+    pos = __atomic_load_n(&(r->coda), __ATOMIC_RELAXED);
+    while(1) {
+        cella = (r->slot)+(pos & (r->mask));
+        seq = __atomic_load_n(&(cella->sequenza), __ATOMIC_ACQUIRE);
+        if(seq == pos) {
+            if(__atomic_compare_exchange_n(&(r->coda), &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if(seq < pos) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&(r->coda), __ATOMIC_RELAXED);
+        }
+    }
+
+    /** Pubblico il task **/
+    cella->task = task;
+    __atomic_store_n(&(cella->sequenza), pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+
+/**
+ * @brief               Estrae un task dalla coda globale limitata
+ * @fun                 popRing
+ * @param r             Coda globale
+ * @return              Ritorna il task estratto; NULL se la coda e' vuota
+ */
+static void* popRing(TaskRing *r) {
+    /** Variabili **/
+    long pos = -1, seq = -1;
+    void *task = NULL;
+    RingSlot *cella = NULL;
+
+    /** Prenoto una cella occupata **/
+    pos = __atomic_load_n(&(r->testa), __ATOMIC_RELAXED);
+    while(1) {
+        cella = (r->slot)+(pos & (r->mask));
+        seq = __atomic_load_n(&(cella->sequenza), __ATOMIC_ACQUIRE);
+        if(seq == pos + 1) {
+            if(__atomic_compare_exchange_n(&(r->testa), &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if(seq < pos + 1) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&(r->testa), __ATOMIC_RELAXED);
+        }
+    }
+
+    /** Libero la cella per il giro successivo **/
+    task = cella->task;
+    __atomic_store_n(&(cella->sequenza), pos + (r->mask) + 1, __ATOMIC_RELEASE);
+
+    return task;
+}
+
+
+/**
+ * @brief               Numero di task presenti in una coda limitata (stima)
+ * @fun                 dimRing
+ * @param r             Coda
+ * @return              Ritorna il numero di task in coda
+ */
+static long dimRing(TaskRing *r) {
+    return __atomic_load_n(&(r->coda), __ATOMIC_ACQUIRE) - __atomic_load_n(&(r->testa), __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * @brief               Dealloca la coda globale ed i task rimasti al suo interno
+ * @fun                 destroyRing
+ * @param r             Coda da deallocare
+ * @param free_task     Funzione per deallocare i task rimasti
+ */
+static void destroyRing(TaskRing *r, void (*free_task)(void *)) {
+    /** Variabili **/
+    void *task = NULL;
+
+    /** Controllo parametri **/
+    if((r == NULL) || (r->slot == NULL)) return;
+
+    /** Dealloco **/
+    while((task = popRing(r)) != NULL) free_task(task);
+    free(r->slot);
+    r->slot = NULL;
+}
+
+
+/**
+ * @brief               Sveglia un thread in attesa se ce ne sono: preferisce il thread di casa indicato, poi un
+ *                      qualsiasi thread fisso ed infine gli aiutanti
+ * @fun                 wakeUpWorker
+ * @param pool          Pool di thread
+ * @param casa          Thread fisso da svegliare di preferenza; -1 se indifferente
+ * @return              (0) in caso di successo; altrimenti il codice di errore
+ */
+static int wakeUpWorker(threadPool *pool, int casa) {
+    /** Variabili **/
+    int error = 0, scelto = -1;
+
+    /** Sveglio un thread dormiente **/
+    if(__atomic_load_n(&(pool->numeroThreadDormienti), __ATOMIC_SEQ_CST) == 0) return 0;
+    if((error = pthread_mutex_lock(pool->taskQueueMutex)) != 0) return error;
+    if((casa >= 0) && (pool->dormiente)[casa]) scelto = casa;
+    else if(casa >= 0) {
+        /** Il thread di casa e' sveglio: gli altri vanno svegliati solo se la sua coda e' arretrata **/
+        if(dimRing((pool->codeAffinita)+casa) < SOGLIA_FURTO_AFFINITA) return pthread_mutex_unlock(pool->taskQueueMutex);
+    }
+    for(int i=0; (scelto == -1) && (i<pool->numeroThread); i++) {
+        if((pool->dormiente)[i]) scelto = i;
+    }
+    if(scelto != -1) {
+        (pool->dormiente)[scelto] = 0;
+        error = pthread_cond_signal((pool->condThread)+scelto);
+    } else {
+        error = pthread_cond_signal(pool->emptyCondVar);
+    }
+    if(error != 0) {
+        pthread_mutex_unlock(pool->taskQueueMutex);
+        return error;
+    }
+    return pthread_mutex_unlock(pool->taskQueueMutex);
+}
+
+
+/**
+ * @brief               Stima dei task che un thread puo' eseguire: i task nelle code di affinita' degli altri
+ *                      thread non contano finche' quelle code non sono arretrate
+ * @fun                 lavoroVisibile
+ * @param pool          Pool di thread
+ * @param id            Indice del thread fisso (-1 per gli aiutanti)
+ * @return              Ritorna il numero stimato di task eseguibili
+ */
+static long lavoroVisibile(threadPool *pool, int id) {
+    /** Variabili **/
+    long visibile = __atomic_load_n(&(pool->numeroTaskInCoda), __ATOMIC_SEQ_CST), altri = 0;
+
+    /** Sottraggo le code di affinita' non arretrate degli altri thread **/
+    if(!(pool->affinita) || pool->shutdown) return visibile;
+    for(int i=0; i<pool->numeroThread; i++) {
+        if((i != id) && ((altri = dimRing((pool->codeAffinita)+i)) < SOGLIA_FURTO_AFFINITA)) visibile -= altri;
+    }
+
+    return visibile;
+}
+
+
 /**
- * @brief               Funzione per l'arresto dei thread worker del pool
- * @fun                 stopTasking
- * @param a, b          Argomenti non utilizzati nella funzione
- * @return              NULL sempre
+ * @brief               Cerca un task da eseguire: prima nella propria coda, poi nella coda globale
+ *                      (spostandone un piccolo lotto nella coda locale) ed infine rubandolo agli altri thread
+ * @fun                 findTask
+ * @param pool          Pool di thread
+ * @param id            Indice della coda locale del thread (-1 per i thread aiutanti, che non ne hanno una)
+ * @return              Ritorna il task trovato; NULL se non ci sono task
  */
-static void* stopTasking(unsigned int a, void *b) {
+static void* findTask(threadPool *pool, int id) {
+    /** Variabili **/
+    int i = 0, k = 0, preso = 0, corsia = CORSIA_PRIORITARIA;
+    void *task = NULL, *altro = NULL;
+    WorkDeque *mia = (id >= 0) ? (pool->codeThread)+id : NULL;
+
+    /** Coda locale e coda di affinita' **/
+    if((mia != NULL) && ((task = popDeque(mia)) != NULL)) return task;
+    if((pool->affinita) && (id >= 0) && ((task = popRing((pool->codeAffinita)+id)) != NULL)) return task;
+
+    /** Code globali: PESO_CORSIA_PRIORITARIA turni alla corsia prioritaria, uno a quella normale **/
+    corsia = ((++turnoCorsia) % (PESO_CORSIA_PRIORITARIA + 1) != 0) ? CORSIA_PRIORITARIA : CORSIA_NORMALE;
+    if((task = popRing((pool->taskQueue)+corsia)) == NULL) {
+        corsia = (corsia == CORSIA_PRIORITARIA) ? CORSIA_NORMALE : CORSIA_PRIORITARIA;
+        task = popRing((pool->taskQueue)+corsia);
+    }
+    if(task != NULL) {
+        /** I trasferimenti della corsia normale non vengono accumulati in coda locale davanti ad altri task **/
+        if((mia == NULL) || (corsia == CORSIA_NORMALE)) return task;
+        /** Solo il proprietario inserisce nella coda locale: se c'e' spazio ora, ci sara' anche al pushDeque **/
+        while((++preso < DIM_BATCH_TASK) && (dimDeque(mia) <= (mia->mask)) && ((altro = popRing((pool->taskQueue)+corsia)) != NULL)) {
+            pushDeque(mia, altro);
+        }
+        if(preso > 1) wakeUpWorker(pool, -1);
+        return task;
+    }
+
+    /** Furto dalle code di affinita' arretrate degli altri thread **/
+    for(i=1; (pool->affinita) && (i<=pool->numeroThread); i++) {
+        if((k = (id+i) % (int) (pool->numeroThread)) == id) continue;
+        if((dimRing((pool->codeAffinita)+k) >= SOGLIA_FURTO_AFFINITA) || pool->shutdown) {
+            if((task = popRing((pool->codeAffinita)+k)) != NULL) return task;
+        }
+    }
+
+    /** Furto dalle code degli altri thread **/
+    for(i=1; i<=pool->numeroThread; i++) {
+        if((k = (id+i) % (int) (pool->numeroThread)) == id) continue;
+        if((task = stealDeque((pool->codeThread)+k)) != NULL) return task;
+    }
+
     return NULL;
 }
 
 
 /**
- * @brief               Routine base che deve eseguire il thread worker del pool
- * @fun                 start_routine
- * @param argv          Argomenti passati al thread worker
+ * @brief               Attesa attiva adattiva: interroga le code per al piu' *budget giri (senza limite in busy-poll)
+ *                      prima che il thread si sospenda; il budget raddoppia se l'attesa trova lavoro e si dimezza
+ *                      altrimenti
+ * @fun                 spinTask
+ * @param pool          Pool di thread
+ * @param id            Indice del thread fisso (-1 per gli aiutanti)
+ * @param budget        Budget di giri del thread (aggiornato)
+ * @return              Ritorna il task trovato; NULL se non ce ne sono
+ */
+static void* spinTask(threadPool *pool, int id, unsigned int *budget) {
+    /** Variabili **/
+    void *task = NULL;
+    unsigned int giri = 0;
+    int busyPoll = (pool->busyPoll) && (id >= 0);
+
+    /** Controllo parametri **/
+    if((pool->maxSpin == 0) && !busyPoll) return NULL;
+
+    /** Attesa attiva **/
+    while((busyPoll || (giri < *budget)) && !__atomic_load_n(&(pool->shutdown), __ATOMIC_ACQUIRE) && !__atomic_load_n(&(pool->hardST), __ATOMIC_ACQUIRE)) {
+        if((task = findTask(pool, id)) != NULL) break;
+        CPU_RELAX();
+        if((++giri % 1024) == 0) sched_yield();
+    }
+
+    /** Adatto il budget **/
+    if(task != NULL) *budget = ((*budget) * 2 > pool->maxSpin) ? pool->maxSpin : (*budget) * 2;
+    else *budget = ((*budget) / 2 < SPIN_MINIMO) ? SPIN_MINIMO : (*budget) / 2;
+    if(*budget > pool->maxSpin) *budget = pool->maxSpin;
+
+    return task;
+}
+
+
+/**
+ * @brief               Millisecondi trascorsi da un istante
+ * @fun                 msTrascorsi
+ * @param da            Istante di partenza (CLOCK_MONOTONIC)
+ * @return              Ritorna i millisecondi trascorsi
+ */
+static long msTrascorsi(struct timespec *da) {
+    /** Variabili **/
+    struct timespec ora;
+
+    /** Calcolo **/
+    clock_gettime(CLOCK_MONOTONIC, &ora);
+    return ((ora.tv_sec - da->tv_sec) * 1000) + ((ora.tv_nsec - da->tv_nsec) / 1000000);
+}
+
+
+/**
+ * @brief               Crea un thread aiutante se il pool non ha raggiunto il numero massimo di thread
+ * @fun                 spawnAiutante
+ * @param pool          Pool di thread
+ * @return              (0) in caso di successo o se non serve un aiutante; altrimenti il codice di errore
+ */
+static int spawnAiutante(threadPool *pool) {
+    /** Variabili **/
+    int error = 0;
+    pthread_t aiutante;
+    Threads_Arg *arg = NULL;
+
+    /** Controllo senza lock: la crescita e' un'ottimizzazione, non serve precisione **/
+    if((pool->numeroThread + __atomic_load_n(&(pool->numeroThreadAiutanti), __ATOMIC_RELAXED)) >= pool->maxThread) return 0;
+
+    /** Creo l'aiutante **/
+    if((error = pthread_mutex_lock(pool->taskQueueMutex)) != 0) return error;
+    if(pool->shutdown || ((pool->numeroThread + pool->numeroThreadAiutanti) >= pool->maxThread)) {
+        return pthread_mutex_unlock(pool->taskQueueMutex);
+    }
+    if((arg = (Threads_Arg *) malloc(sizeof(Threads_Arg))) == NULL) {
+        error = errno;
+        pthread_mutex_unlock(pool->taskQueueMutex);
+        return error;
+    }
+    arg->idThread = pool->numeroThread + pool->aiutantiCreati + 1, arg->pool = pool, arg->log = pool->log, arg->aiutante = 1;
+    if((error = pthread_create(&aiutante, NULL, start_routine, arg)) != 0) {
+        free(arg);
+        pthread_mutex_unlock(pool->taskQueueMutex);
+        return error;
+    }
+    pthread_detach(aiutante);
+    (pool->aiutantiCreati)++;
+    __atomic_add_fetch(&(pool->numeroThreadAiutanti), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
+
+    return pthread_mutex_unlock(pool->taskQueueMutex);
+}
+
+
+/**
+ * @brief               Annulla la sospensione di un thread che esce per errore dall'attesa di un task: torna attivo e
+ *                      non dormiente, e rilascia la mutex della coda (che deve possedere)
+ * @fun                 abbandonaAttesa
+ * @param pool          Pool di thread
+ * @param coda          Deque del thread (-1 per gli aiutanti)
+ */
+static void abbandonaAttesa(threadPool *pool, int coda) {
+    __atomic_add_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
+    if(coda != -1) (pool->dormiente)[coda] = 0;
+    __atomic_sub_fetch(&(pool->numeroThreadDormienti), 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(pool->taskQueueMutex);
+}
+
+
+/**
+ * @brief               Ciclo di lavoro del thread worker: estrae ed esegue i task finche' il pool non viene fermato
+ *                      (o, per gli aiutanti, finche' resta inattivo troppo a lungo)
+ * @fun                 cicloThread
+ * @param pool          Pool di thread
+ * @param numeroDelThread Numero del thread
+ * @param aiutante      Se il thread e' un aiutante creato sotto carico
+ * @param log           File di log
  * @return              Ritorna NULL in caso di successo; altrimenti ritorna un valore contenente l'errore che ha
- *                      generato l'arresto
+ *                      generato l'arresto (senza possedere la mutex della coda)
  */
-static void* start_routine(void *argv) {
+static void* cicloThread(threadPool *pool, unsigned int numeroDelThread, int aiutante, serverLogFile *log) {
     /** Variabili **/
-    int error = 0, *status = NULL;
+    int error = 0, scaduto = 0;
+    unsigned int budgetSpin = pool->maxSpin;
     char errorMSG[MAX_BUFFER_LEN];
-    Threads_Arg *castedArg = NULL;
-    threadPool *pool = NULL;
-    serverLogFile *log = NULL;
-    unsigned int numeroDelThread = -1;
+    struct timespec scadenza;
     void *uncastedTask = NULL;
     Task *t = NULL;
     Task_Fun work = NULL;
 
-    /** Cast degli argomenti **/
-    castedArg = (Threads_Arg *) argv;
-    pool = castedArg->pool;
-    numeroDelThread = castedArg->idThread;
-    log = castedArg->log;
-    free(argv);
-
     /** Lavoro iterativo del thread **/
     TRACE_ON_LOG(0, &errno, "[THREAD %d]: thread avviato correttamente\n", numeroDelThread)
-    LOCK_POOL(NULL)
-    do {
-        /** Se la lista e' vuota mi metto in attesa */
-        while(pool->isEmpty && (!pool->hardST)) {
-            (pool->numeroDiThreadAttivi)--;
-            TRACE_ON_LOG(0, &errno, "[THREAD %d]: Nessun task trovato, mi metto in attesa\n", numeroDelThread)
-            if((error = pthread_cond_wait((pool->emptyCondVar), (pool->taskQueueMutex))) != 0) {
+    while(!__atomic_load_n(&(pool->hardST), __ATOMIC_ACQUIRE)) {
+        /** Cerco un task; se non ne trovo attendo attivamente e poi mi sospendo **/
+        if((uncastedTask = findTask(pool, codaCorrente)) == NULL) uncastedTask = spinTask(pool, codaCorrente, &budgetSpin);
+        if(uncastedTask == NULL) {
+            if((error = pthread_mutex_lock(pool->taskQueueMutex)) != 0) {
+                errno = error;
+                return (void *) &errno;
+            }
+            __atomic_add_fetch(&(pool->numeroThreadDormienti), 1, __ATOMIC_SEQ_CST);
+            if(aiutante) {
+                clock_gettime(CLOCK_REALTIME, &scadenza);
+                scadenza.tv_sec += TIMEOUT_AIUTANTI_MS / 1000;
+                scadenza.tv_nsec += (TIMEOUT_AIUTANTI_MS % 1000) * 1000000;
+                if(scadenza.tv_nsec >= 1000000000) scadenza.tv_sec++, scadenza.tv_nsec -= 1000000000;
+            }
+            while((lavoroVisibile(pool, codaCorrente) <= 0) && (!pool->shutdown) && (!pool->hardST) && (!scaduto)) {
+                __atomic_sub_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
+                if(traceOnLog(log, "[THREAD %d]: Nessun task trovato, mi metto in attesa\n", numeroDelThread) == -1) {
+                    error = errno;
+                    abbandonaAttesa(pool, codaCorrente);
+                    errno = error;
+                    return (void *) &errno;
+                }
+                if(aiutante) error = pthread_cond_timedwait((pool->emptyCondVar), (pool->taskQueueMutex), &scadenza);
+                else {
+                    (pool->dormiente)[codaCorrente] = 1;
+                    error = pthread_cond_wait((pool->condThread)+codaCorrente, (pool->taskQueueMutex));
+                }
+                if(error == ETIMEDOUT) scaduto = 1;
+                else if(error != 0) {
+                    abbandonaAttesa(pool, codaCorrente);
+                    errno = error;
+                    return (void *) &errno;
+                }
+                __atomic_add_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
+            }
+            if(!aiutante) (pool->dormiente)[codaCorrente] = 0;
+            __atomic_sub_fetch(&(pool->numeroThreadDormienti), 1, __ATOMIC_SEQ_CST);
+            if(pool->hardST || (pool->shutdown && (__atomic_load_n(&(pool->numeroTaskInCoda), __ATOMIC_SEQ_CST) == 0))) {
+                pthread_mutex_unlock(pool->taskQueueMutex);
+                break;
+            }
+            if(scaduto && (lavoroVisibile(pool, -1) <= 0)) {
+                /** Aiutante inattivo da troppo tempo: termina **/
+                pthread_mutex_unlock(pool->taskQueueMutex);
+                TRACE_ON_LOG(0, &errno, "[THREAD %d]: Aiutante inattivo, terminazione\n", numeroDelThread)
+                break;
+            }
+            scaduto = 0;
+            if((error = pthread_mutex_unlock(pool->taskQueueMutex)) != 0) {
+                errno = error;
                 return (void *) &errno;
             }
-            TRACE_ON_LOG(0, &errno, "[THREAD %d]: Segnalato nuovo task in queue\n", numeroDelThread)
-            (pool->numeroDiThreadAttivi)++;
+            continue;
         }
 
-        /** Estraggo il task dalla coda e lo eseguo **/
-        if((uncastedTask = deleteFirstElement(&(pool->taskQueue))) == NULL) {
-            UNLOCK_POOL(NULL)
-            break;
-        }
-        (pool->numeroTaskInCoda)--;
-        if((pool->taskQueue == NULL) && (!pool->shutdown)) pool->isEmpty = 1;
-        UNLOCK_POOL(NULL)
+        /** Eseguo il task estratto **/
+        __atomic_sub_fetch(&(pool->numeroTaskInCoda), 1, __ATOMIC_SEQ_CST);
         TRACE_ON_LOG(0, &errno, "[THREAD %d]: Estratto dalla queue nuovo task da eseguire\n", numeroDelThread)
         t = (Task *) uncastedTask;
         work = t->to_do;
+        if((pool->maxThread > pool->numeroThread) && (msTrascorsi(&(t->arrivo)) >= SOGLIA_ATTESA_AIUTANTI_MS) && (__atomic_load_n(&(pool->numeroThreadDormienti), __ATOMIC_SEQ_CST) == 0)) {
+            /** Il task ha atteso troppo in coda: chiedo un aiutante **/
+            if((error = spawnAiutante(pool)) != 0) {
+                TRACE_ON_LOG(0, &errno, "[THREAD %d]: Impossibile creare un thread aiutante\n", numeroDelThread)
+            }
+        }
         TRACE_ON_LOG(0, &errno, "[THREAD %d]: Avvio del task da eseguire in corso...\n", numeroDelThread)
         if(work(numeroDelThread, t->argv) != NULL) {
             if(errno == ECOMM || errno == EPIPE || errno == EBADF) {
@@ -160,38 +724,81 @@ static void* start_routine(void *argv) {
         }
         pool->free_task(uncastedTask);
         TRACE_ON_LOG(0, &errno, "[THREAD %d]: Task terminato con successo\n", numeroDelThread)
-        LOCK_POOL(NULL)
-    } while((!(pool->shutdown)) || ((pool->taskQueue != NULL) && (!pool->hardST)));
-    UNLOCK_POOL(NULL)
-
+    }
 
-    /** Arresto del thread **/
     TRACE_ON_LOG(0, &errno, "[THREAD %d]: arresto in corso\n", numeroDelThread)
-    free(status);
     return NULL;
 }
 
 
+/**
+ * @brief               Routine base che deve eseguire il thread worker del pool
+ * @fun                 start_routine
+ * @param argv          Argomenti passati al thread worker
+ * @return              Ritorna NULL in caso di successo; altrimenti ritorna un valore contenente l'errore che ha
+ *                      generato l'arresto
+ */
+static void* start_routine(void *argv) {
+    /** Variabili **/
+    int aiutante = 0, lock = 0;
+    Threads_Arg *castedArg = NULL;
+    threadPool *pool = NULL;
+    serverLogFile *log = NULL;
+    unsigned int numeroDelThread = -1;
+    void *esito = NULL;
+
+    /** Cast degli argomenti **/
+    castedArg = (Threads_Arg *) argv;
+    pool = castedArg->pool;
+    numeroDelThread = castedArg->idThread;
+    log = castedArg->log;
+    aiutante = castedArg->aiutante;
+    free(argv);
+    poolCorrente = pool, codaCorrente = (aiutante) ? -1 : (int) numeroDelThread - 1;
+
+    /** Lavoro iterativo del thread **/
+    esito = cicloThread(pool, numeroDelThread, aiutante, log);
+
+    /** Arresto del thread: qualunque sia l'esito l'aiutante esce dal conteggio, o stopThreadPool lo attenderebbe per sempre **/
+    if(aiutante) {
+        /** Dopo l'unlock l'aiutante non deve piu' toccare il pool, che potrebbe essere deallocato **/
+        lock = pthread_mutex_lock(pool->taskQueueMutex);
+        __atomic_sub_fetch(&(pool->numeroThreadAiutanti), 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(pool->aiutantiCondVar);
+        if(lock == 0) pthread_mutex_unlock(pool->taskQueueMutex);
+    }
+    return esito;
+}
+
+
 /**
  * @brief                   Crea un pool di thread
  * @fun                     startThreadPool
- * @param numeroThread      Numero di thread da creare nel pool
+ * @param set               Impostazioni del pool
  * @param free_task         Funzione per pulire i task una volta eseguiti
  * @param log               File di log
  * @return                  Ritorna la struttura che rappresenta il pool; in caso di errore ritorna NULL [setta errno]
  */
-threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *), serverLogFile *log) {
+threadPool* startThreadPool(Pool_Settings *set, void (*free_task)(void *), serverLogFile *log) {
     /** Variabili **/
     int error;
+    unsigned int numeroThread = 0;
+    cpu_set_t cpuThread;
     Threads_Arg **arg = NULL;
     threadPool *pool = NULL;
 
     /** Controllo parametri **/
     errno = 0;
+    if(set == NULL) { errno = EINVAL; return NULL; }
     if(free_task == NULL) { errno = EINVAL; return NULL; }
+    if((numeroThread = set->numeroThread) == 0) { errno = EINVAL; return NULL; }
+    if(set->dimCoda == 0) { errno = EINVAL; return NULL; }
+    if(set->maxThread < numeroThread) { errno = EINVAL; return NULL; }
+    if((set->cpu != NULL) && (set->numeroCpu == 0)) { errno = EINVAL; return NULL; }
 
     /** Alloco la struttura **/
-    TRACE_ON_LOG(1, NULL, "[THREAD MANAGER]: Avvio del pool di %d thread\n")
+    TRACE_ON_LOG(0, NULL, "[THREAD MANAGER]: Avvio del pool di %d thread\n", numeroThread)
     if((pool = (threadPool *) malloc(sizeof(threadPool))) == NULL) {
         return NULL;
     }
@@ -206,12 +813,61 @@ threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *)
         FREE_POOL_THREAD()
         return NULL;
     }
+    if((pool->aiutantiCondVar = (pthread_cond_t *) malloc(sizeof(pthread_cond_t))) == NULL) {
+        FREE_POOL_THREAD()
+        return NULL;
+    }
     if((pool->threads = (pthread_t *) calloc(numeroThread, sizeof(pthread_t))) == NULL) {
         FREE_POOL_THREAD()
         return NULL;
     }
+    if((pool->codeThread = (WorkDeque *) calloc(numeroThread, sizeof(WorkDeque))) == NULL) {
+        FREE_POOL_THREAD()
+        return NULL;
+    }
     pool->numeroThread = numeroThread;
-    pool->isEmpty = 1;
+    pool->maxThread = set->maxThread;
+    pool->affinita = set->affinita;
+    pool->maxSpin = set->maxSpin;
+    pool->busyPoll = set->busyPoll;
+    if((pool->condThread = (pthread_cond_t *) calloc(numeroThread, sizeof(pthread_cond_t))) == NULL) {
+        FREE_POOL_THREAD()
+        return NULL;
+    }
+    if((pool->dormiente = (int *) calloc(numeroThread, sizeof(int))) == NULL) {
+        FREE_POOL_THREAD()
+        return NULL;
+    }
+    for(int i=0; i<numeroThread; i++) {
+        if((error = pthread_cond_init((pool->condThread)+i, NULL)) != 0) {
+            FREE_POOL_THREAD()
+            return NULL;
+        }
+    }
+    if(pool->affinita) {
+        if((pool->codeAffinita = (TaskRing *) calloc(numeroThread, sizeof(TaskRing))) == NULL) {
+            FREE_POOL_THREAD()
+            return NULL;
+        }
+        for(int i=0; i<numeroThread; i++) {
+            if(initRing((pool->codeAffinita)+i, set->dimCoda) == -1) {
+                FREE_POOL_THREAD()
+                return NULL;
+            }
+        }
+    }
+    for(int i=0; i<numeroThread; i++) {
+        if(initDeque((pool->codeThread)+i, DIM_CODA_THREAD) == -1) {
+            FREE_POOL_THREAD()
+            return NULL;
+        }
+    }
+    for(int i=0; i<NUMERO_CORSIE; i++) {
+        if(initRing((pool->taskQueue)+i, set->dimCoda) == -1) {
+            FREE_POOL_THREAD()
+            return NULL;
+        }
+    }
     if((error = pthread_mutex_init(pool->taskQueueMutex, NULL)) != 0) {
         FREE_POOL_THREAD()
         return NULL;
@@ -220,6 +876,10 @@ threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *)
         FREE_POOL_THREAD()
         return NULL;
     }
+    if((error = pthread_cond_init(pool->aiutantiCondVar, NULL)) != 0) {
+        FREE_POOL_THREAD()
+        return NULL;
+    }
 
     /** Avvio i thread **/
     LOCK_POOL(NULL)
@@ -234,13 +894,21 @@ threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *)
             FREE_POOL_THREAD()
             return NULL;
         }
-        arg[i]->idThread = i+1, arg[i]->pool = pool, arg[i]->log = log;
+        arg[i]->idThread = i+1, arg[i]->pool = pool, arg[i]->log = log, arg[i]->aiutante = 0;
         if((error = pthread_create(&((pool->threads)[i]), NULL, start_routine, arg[i])) != 0) {
             UNLOCK_POOL(NULL)
             FREE_POOL_THREAD()
             return NULL;
         }
-        (pool->numeroDiThreadAttivi)++;
+        if(set->cpu != NULL) {
+            /** Fisso il thread sulla CPU indicata; se non e' possibile il thread resta libero **/
+            CPU_ZERO(&cpuThread);
+            CPU_SET((set->cpu)[i % (set->numeroCpu)], &cpuThread);
+            if((error = pthread_setaffinity_np((pool->threads)[i], sizeof(cpu_set_t), &cpuThread)) != 0) {
+                TRACE_ON_LOG(0, NULL, "[THREAD MANAGER]: Impossibile fissare il thread %d sulla CPU %d\n", i+1, (set->cpu)[i % (set->numeroCpu)])
+            }
+        }
+        __atomic_add_fetch(&(pool->numeroDiThreadAttivi), 1, __ATOMIC_RELAXED);
     }
     free(arg);
     arg = NULL;
@@ -254,7 +922,8 @@ threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *)
 
 
 /**
- * @brief                   Funzione che manda un task da eseguire al pool
+ * @brief                   Funzione che manda un task da eseguire al pool; se chiamata da un thread del pool
+ *                          il task finisce nella sua coda locale, altrimenti nella coda globale
  * @fun                     pushTask
  * @param pool              Pool di thread
  * @param task              Task da eseguire e mandare al pool
@@ -262,34 +931,65 @@ threadPool* startThreadPool(unsigned int numeroThread, void (*free_task)(void *)
  */
 int pushTask(threadPool *pool, Task *task) {
     /** Variabili **/
-    int error = 0;
+    int error = 0, casa = -1;
     serverLogFile *log = NULL;
 
     /** Controllo parametri **/
     errno = 0;
     if(pool == NULL) { errno = EINVAL; return -1; }
     if(task == NULL) { errno = EINVAL; return -1; }
+    if((task->corsia < 0) || (task->corsia >= NUMERO_CORSIE)) { errno = EINVAL; return -1; }
 
-    /** Prendo il controllo della coda e ci aggiungo il task da eseguire **/
+    /** Se sono un thread del pool provo ad usare la mia coda locale **/
     log = pool->log;
+    clock_gettime(CLOCK_MONOTONIC, &(task->arrivo));
     TRACE_ON_LOG(0, errno, "[THREAD MANAGER]: Richiesta di inserimento nuovo task\n")
-    LOCK_POOL(-1)
-    if(pool->hardST) {
-        UNLOCK_POOL(-1)
+    if(__atomic_load_n(&(pool->hardST), __ATOMIC_ACQUIRE)) {
+        pool->free_task(task);
         errno = 0;
         return 0;
     }
-    if((pool->taskQueue = insertIntoQueue((pool->taskQueue), task, sizeof(Task))) == NULL) {
-        return errno;
+    if((poolCorrente == pool) && (codaCorrente != -1)) {
+        if(pushDeque((pool->codeThread)+codaCorrente, task) == 0) {
+            __atomic_add_fetch(&(pool->numeroTaskInCoda), 1, __ATOMIC_SEQ_CST);
+            if((error = wakeUpWorker(pool, -1)) != 0) {
+                TRACE_ON_LOG(0, 0, "[THREAD MANAGER]: Impossibile svegliare un thread (errore %d), il task resta in coda\n", error)
+            }
+            errno = 0;
+            return 0;
+        }
+    }
+
+    /** Modalita' affinita': il task va al suo thread di casa; se la sua coda e' piena passa alla coda globale **/
+    if((pool->affinita) && (task->affinita >= 0)) {
+        casa = (task->affinita) % (int) (pool->numeroThread);
+        if(pushRing((pool->codeAffinita)+casa, task) == 0) {
+            __atomic_add_fetch(&(pool->numeroTaskInCoda), 1, __ATOMIC_SEQ_CST);
+            if((error = wakeUpWorker(pool, casa)) != 0) {
+                TRACE_ON_LOG(0, 0, "[THREAD MANAGER]: Impossibile svegliare il thread %d (errore %d), il task resta in coda\n", casa+1, error)
+            }
+            TRACE_ON_LOG(0, errno, "[THREAD MANAGER]: Task inviato al thread %d\n", casa+1)
+            errno = 0;
+            return 0;
+        }
+    }
+
+    /** Altrimenti lo aggiungo alla coda globale; se e' piena il task resta al chiamante, altrimenti da qui in poi e'
+        del pool e un errore nel creare un aiutante o nello svegliare un thread non deve restituirlo **/
+    if(pushRing((pool->taskQueue)+(task->corsia), task) == -1) {
+        TRACE_ON_LOG(0, -1, "[THREAD MANAGER]: Coda dei task piena\n")
+        errno = EAGAIN;
+        return -1;
     }
-    (pool->numeroTaskInCoda)++;
-    if(pool->isEmpty) {
-        pool->isEmpty = 0;
-        if((error = pthread_cond_signal(pool->emptyCondVar)) != 0) {
-            return errno;
+    if((__atomic_add_fetch(&(pool->numeroTaskInCoda), 1, __ATOMIC_SEQ_CST) >= SOGLIA_CODA_AIUTANTI) && (__atomic_load_n(&(pool->numeroThreadDormienti), __ATOMIC_SEQ_CST) == 0)) {
+        /** Coda troppo lunga e nessun thread libero: chiedo un aiutante **/
+        if((error = spawnAiutante(pool)) != 0) {
+            TRACE_ON_LOG(0, 0, "[THREAD MANAGER]: Impossibile creare un thread aiutante (errore %d)\n", error)
         }
     }
-    UNLOCK_POOL(-1)
+    if((error = wakeUpWorker(pool, -1)) != 0) {
+        TRACE_ON_LOG(0, 0, "[THREAD MANAGER]: Impossibile svegliare un thread (errore %d), il task resta in coda\n", error)
+    }
     TRACE_ON_LOG(0, errno, "[THREAD MANAGER]: Task inviato correttamente\n")
 
     errno = 0;
@@ -306,50 +1006,51 @@ int pushTask(threadPool *pool, Task *task) {
  */
 int stopThreadPool(threadPool *pool, int hardShutdown) {
     /** Variabili **/
-    Task *endTask = NULL;
-    int index = -1, *status = NULL;
+    int index = -1;
     int error = 0;
+    void *status = NULL;
     serverLogFile *log = NULL;
 
     /** Controllo parametri **/
     errno = 0;
+    if(pool == NULL) { errno = EINVAL; return -1; }
     if((hardShutdown < 0) || (hardShutdown > 1)) { errno = EINVAL; return -1; }
 
     /** Avvio fase di spegnimento **/
     log = pool->log;
     LOCK_POOL(-1)
     if(hardShutdown) {
-        pool->hardST = 1;
-        destroyQueue(&(pool->taskQueue), pool->free_task);
-        pool->taskQueue = NULL;
+        __atomic_store_n(&(pool->hardST), 1, __ATOMIC_RELEASE);
         TRACE_ON_LOG(0, -1, "[THREAD MANAGER]:Arresto forzato; inizio procedura di hard-shutdown del pool\n")
     } else {
-        TRACE_ON_LOG(0, -1, "[THREAD MANAGER]: Arresto soft del pool di thread; invio messaggio di arresto\n")
+        TRACE_ON_LOG(0, -1, "[THREAD MANAGER]: Arresto soft del pool di thread; attesa dello svuotamento delle code\n")
+    }
+    __atomic_store_n(&(pool->shutdown), 1, __ATOMIC_RELEASE);
+    for(int i=0; i<pool->numeroThread; i++) {
+        pthread_cond_broadcast((pool->condThread)+i);
     }
     if((error = pthread_cond_broadcast(pool->emptyCondVar)) != 0) {
+        pthread_mutex_unlock(pool->taskQueueMutex);
+        errno = error;
         return -1;
     }
-    if((endTask = (Task *) malloc(sizeof(Task))) == NULL) return -1;
+    UNLOCK_POOL(-1)
+    index = -1;
     while(++index < (pool->numeroThread)) {
-        (endTask)->argv = NULL;
-        (endTask)->to_do = stopTasking;
-        if((pool->taskQueue = insertIntoQueue(pool->taskQueue, endTask, sizeof(Task))) == NULL) {
+        if((error = pthread_join((pool->threads)[index], &status)) != 0) {
+            errno = error;
             return -1;
         }
-        (pool->numeroTaskInCoda)++;
     }
-    free(endTask);
-    pool->isEmpty = 0;
-    pool->shutdown = 1;
-    UNLOCK_POOL(-1)
-    index = -1;
-    while(++index < (pool->numeroThread)) {
-        if((error = pthread_join((pool->threads)[index], (void **) &status)) != 0) {
+    LOCK_POOL(-1)
+    while(pool->numeroThreadAiutanti > 0) {
+        if((error = pthread_cond_wait(pool->aiutantiCondVar, pool->taskQueueMutex)) != 0) {
+            pthread_mutex_unlock(pool->taskQueueMutex);
             errno = error;
             return -1;
         }
-        free(status);
     }
+    UNLOCK_POOL(-1)
     TRACE_ON_LOG(0, -1, "[THREAD MANAGER]: Pool di thread fermato correttamente\n")
     FREE_POOL_THREAD()
 
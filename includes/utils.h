@@ -12,6 +12,13 @@
 
     #define MAX_PATHNAME 2048
     #define MAX_BUFFER_LEN 10000
+    #define SEGMENTI_INIZIALI 8
+    #define IOVEC_LOCALI 32
+    #define ARENA_BLOCCO 4096
+    #define ARENA_MASSIMA (1024*1024)
+    #define ARENA_ALLINEAMENTO sizeof(long double)
+    #define DESCRITTORI_LETTORE 8
+    #define BUFFER_LETTORE (64*1024)
 
 
     #include <stdlib.h>
@@ -19,6 +26,90 @@
     #include <string.h>
     #include <unistd.h>
     #include <errno.h>
+    #include <limits.h>
+    #include <sys/uio.h>
+
+
+    #ifndef IOV_MAX
+        #define IOV_MAX 1024
+    #endif
+
+
+    /**
+     * @brief                   Messaggio (dimensione e contenuto) accodato per un invio vettoriale
+     * @struct                  Segmento_MSG
+     * @param dimensione        Dimensione del contenuto, spedita davanti al messaggio
+     * @param valore            Copia del contenuto per i messaggi interi
+     * @param msg               Contenuto del messaggio (deve restare valido fino all'invio)
+     */
+    typedef struct {
+        size_t dimensione;
+        int valore;
+        const void *msg;
+    } Segmento_MSG;
+
+
+    /**
+     * @brief                   Insieme di messaggi spediti con un'unica writev
+     * @struct                  Messaggi
+     * @param segmenti          Messaggi accodati
+     * @param numero            Numero di messaggi accodati
+     * @param capacita          Capacita' dell'array dei segmenti
+     */
+    typedef struct {
+        Segmento_MSG *segmenti;
+        size_t numero;
+        size_t capacita;
+    } Messaggi;
+
+
+    /**
+     * @brief                   Blocco di memoria di un'arena
+     * @struct                  Blocco_Arena
+     * @param precedente        Blocco allocato prima di questo
+     * @param capacita          Bytes disponibili nel blocco
+     * @param usati             Bytes gia' assegnati
+     * @param dati              Memoria del blocco (long double per l'allineamento massimo)
+     */
+    typedef struct Blocco_Arena {
+        struct Blocco_Arena *precedente;
+        size_t capacita;
+        size_t usati;
+        long double dati[];
+    } Blocco_Arena;
+
+
+    /**
+     * @brief                   Arena di ricezione: le allocazioni di una richiesta restano valide fino
+     *                          al successivo azzeramento e la memoria viene riusata tra le richieste
+     * @struct                  Arena
+     * @param corrente          Blocco da cui vengono servite le allocazioni
+     * @param totale            Capacita' complessiva dei blocchi
+     */
+    typedef struct {
+        Blocco_Arena *corrente;
+        size_t totale;
+    } Arena;
+
+
+    /**
+     * @brief                   Lettore bufferizzato: piu' messaggi piccoli costano una sola read
+     * @struct                  Lettore
+     * @param fd                FD da cui legge
+     * @param inizio            Primo byte del buffer non ancora consumato
+     * @param fine              Fine dei dati validi nel buffer
+     * @param buffer            Dati letti in anticipo (contiene sempre un pacchetto intero di un socket SOCK_SEQPACKET)
+     * @param descrittori       Descrittori ricevuti insieme ai dati (SCM_RIGHTS), in ordine di arrivo
+     * @param numeroDescrittori Numero dei descrittori non ancora prelevati
+     */
+    typedef struct {
+        int fd;
+        size_t inizio;
+        size_t fine;
+        char buffer[BUFFER_LETTORE];
+        int descrittori[DESCRITTORI_LETTORE];
+        unsigned int numeroDescrittori;
+    } Lettore;
 
 
     /**
@@ -29,6 +120,31 @@
     long isNumber(const char*);
 
 
+    /**
+     * @brief                   Riceve n bytes da fd in modo completo
+     * @fun                     readn
+     * @return                  Ritorna i bytes letti (meno di n in caso di EOF); -1 in caso di errore
+     */
+    ssize_t readn(int, void *, size_t);
+
+
+    /**
+     * @brief                   Scrive n bytes su fd in modo completo
+     * @fun                     writen
+     * @return                  Ritorna i bytes scritti; -1 in caso di errore
+     */
+    ssize_t writen(int, void *, size_t);
+
+
+    /**
+     * @brief                   Riceve n bytes da un socket in modo completo insieme all'eventuale descrittore
+     *                          che li accompagna (SCM_RIGHTS)
+     * @fun                     readnDescrittore
+     * @return                  Ritorna i bytes letti (meno di n in caso di EOF); -1 in caso di errore
+     */
+    ssize_t readnDescrittore(int, void *, size_t, int *);
+
+
     /**
      * brief                Manda un messaggio alla server sulla socket indicata
      * @fun                 sendMSG
@@ -46,5 +162,107 @@
     ssize_t receiveMSG(int, void **, size_t *);
 
 
+    /**
+     * @brief                   Scrive tutti i vettori su fd con il minor numero di writev
+     * @fun                     writevn
+     * @return                  Ritorna i bytes scritti; -1 in caso di errore
+     */
+    ssize_t writevn(int, struct iovec *, int);
+
+
+    /**
+     * @brief                   Accoda un messaggio per il prossimo invio vettoriale
+     * @fun                     aggiungiMSG
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int aggiungiMSG(Messaggi *, const void *, size_t);
+
+
+    /**
+     * @brief                   Accoda un messaggio intero (copiato) per il prossimo invio vettoriale
+     * @fun                     aggiungiIntMSG
+     * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+     */
+    int aggiungiIntMSG(Messaggi *, int);
+
+
+    /**
+     * @brief                   Spedisce con un'unica writev tutti i messaggi accodati e svuota la coda
+     * @fun                     sendMSGv
+     * @return                  Ritorna il numero di byte scritti o -1 in caso di errore [setta errno]
+     */
+    ssize_t sendMSGv(int, Messaggi *);
+
+
+    /**
+     * @brief                   Libera la memoria dei messaggi accodati
+     * @fun                     liberaMessaggi
+     */
+    void liberaMessaggi(Messaggi *);
+
+
+    /**
+     * @brief                   Associa il lettore all'fd e svuota il suo buffer
+     * @fun                     inizializzaLettore
+     */
+    void inizializzaLettore(Lettore *, int);
+
+
+    /**
+     * @brief                   Riceve n bytes in modo completo passando dal buffer del lettore
+     * @fun                     readnLettore
+     * @return                  Ritorna i bytes letti (meno di n in caso di EOF); -1 in caso di errore
+     */
+    ssize_t readnLettore(Lettore *, void *, size_t);
+
+
+    /**
+     * @brief                   Preleva il primo descrittore ricevuto dal lettore
+     * @fun                     prelevaDescrittore
+     * @return                  Ritorna il descrittore; -1 se non ne sono arrivati [setta errno]
+     */
+    int prelevaDescrittore(Lettore *);
+
+
+    /**
+     * @brief               Riceve un messaggio passando dal buffer del lettore
+     * @fun                 receiveBufferedMSG
+     * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
+     *                      -1 [setta errno]
+     */
+    ssize_t receiveBufferedMSG(Lettore *, void **, size_t *);
+
+
+    /**
+     * @brief                   Assegna memoria dall'arena, allocando un nuovo blocco solo se serve
+     * @fun                     allocaArena
+     * @return                  Ritorna la memoria assegnata; NULL in caso di errore [setta errno]
+     */
+    void* allocaArena(Arena *, size_t);
+
+
+    /**
+     * @brief                   Rende di nuovo disponibile tutta la memoria dell'arena
+     * @fun                     azzeraArena
+     */
+    void azzeraArena(Arena *);
+
+
+    /**
+     * @brief                   Libera tutti i blocchi dell'arena
+     * @fun                     liberaArena
+     */
+    void liberaArena(Arena *);
+
+
+    /**
+     * @brief               Riceve un messaggio nella memoria dell'arena (da non liberare)
+     * @fun                 receiveMSGArena
+     * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
+     *                      -1 [setta errno]
+     */
+    ssize_t receiveMSGArena(int, Arena *, void **, size_t *);
+
+
 
 #endif //FILE_STORAGE_SERVER_LRU_UTILS_H
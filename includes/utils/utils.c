@@ -7,6 +7,7 @@
  */
 
 #include "utils.h"
+#include <sys/socket.h>
 
 
 /**
@@ -33,7 +34,7 @@ long isNumber(const char* s) {
  * @return                  Ritorna la dimensione dei dati letti; altrimenti ritorna i
  *                          byte che è riuscita a leggere, 0 in caso di EOF o -1
  */
-static ssize_t readn(int fd, void *ptr, size_t n) {
+ssize_t readn(int fd, void *ptr, size_t n) {
     size_t   nleft;
     ssize_t  nread;
 
@@ -60,7 +61,7 @@ static ssize_t readn(int fd, void *ptr, size_t n) {
  * @return                  Ritorna la dimensione dei dati scritti; altrimenti ritorna i
  *                          byte che è riuscita a scrivere o -1
  */
-static ssize_t writen(int fd, void *ptr, size_t n) {
+ssize_t writen(int fd, void *ptr, size_t n) {
     size_t   nleft;
     ssize_t  nwritten;
 
@@ -77,6 +78,41 @@ static ssize_t writen(int fd, void *ptr, size_t n) {
 }
 
 
+/**
+ * @brief                   Funzione che scrive tutti i vettori su fd in modo completo,
+ *                          con una writev per ogni gruppo di al piu' IOV_MAX vettori
+ * @fun                     writevn
+ * @param fd                Fd su cui scrivere i dati
+ * @param iov               Vettori da scrivere (vengono consumati durante la scrittura)
+ * @param iovcnt            Numero dei vettori
+ * @return                  Ritorna la dimensione dei dati scritti; altrimenti ritorna i
+ *                          byte che è riuscita a scrivere o -1
+ */
+ssize_t writevn(int fd, struct iovec *iov, int iovcnt) {
+    size_t   nwrittenTot = 0;
+    ssize_t  nwritten;
+
+    while (iovcnt > 0) {
+        if((nwritten = writev(fd, iov, (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt)) < 0) {
+            if (errno == EINTR) continue;
+            if (nwrittenTot == 0) return -1; /* error, return -1 */
+            else break; /* error, return amount written so far */
+        } else if (nwritten == 0) break;
+        nwrittenTot += nwritten;
+        while ((iovcnt > 0) && ((size_t) nwritten >= iov->iov_len)) { /* vettori completati */
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) { /* vettore scritto in parte */
+            iov->iov_base = (char *) iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+    return nwrittenTot; /* return >= 0 */
+}
+
+
 /**
  * brief                Manda un messaggio dalla server sulla socket indicata
  * @fun                 sendMSG
@@ -87,41 +123,37 @@ static ssize_t writen(int fd, void *ptr, size_t n) {
  */
 ssize_t sendMSG(int fd, void *msg, size_t msgSize) {
     /** Variabili **/
-    ssize_t bytesSendIt = -1, nWrites = -1;
+    ssize_t nWrites = -1;
+    struct iovec vettori[2];
 
     /** Controllo parametri **/
     errno = 0;
     if(fd <= 0) { errno = EINVAL; return -1; }
 
-    /** Invio richiesta al server **/
-    if((nWrites = writen(fd, &msgSize, sizeof(size_t))) != sizeof(size_t)) { // 1° Step: mando la dimensione del messaggio
+    /** Dimensione e contenuto in un'unica scrittura (il server puo' classificare la richiesta sbirciando il socket) **/
+    vettori[0].iov_base = &msgSize, vettori[0].iov_len = sizeof(size_t);
+    vettori[1].iov_base = msg, vettori[1].iov_len = msgSize;
+    if((nWrites = writevn(fd, vettori, (msgSize != 0) ? 2 : 1)) != (sizeof(size_t) + msgSize)) {
         errno = ECOMM;
         return -1;
     }
-    bytesSendIt += nWrites;
-    if(msgSize != 0) {
-        if((nWrites = writen(fd, msg, msgSize)) != msgSize) { // 2° Step: Invio del messaggio
-            errno = ECOMM;
-            return -1;
-        }
-        bytesSendIt += nWrites;
-    }
 
     errno = 0;
-    return bytesSendIt;
+    return nWrites - 1;
 }
 
 
 /**
- * @brief               Riceve un messaggio dalla socket indicata
- * @fun                 receiveMSG
+ * @brief               Riceve un messaggio dalla socket indicata, direttamente o tramite un lettore
+ * @fun                 riceviMessaggio
  * @param fd            FD da cui riceve il messaggio
+ * @param lettore       Lettore bufferizzato da usare (NULL per leggere direttamente da fd)
  * @param msg           Buffer che conterrà il messaggio ricevuto
  * @param msgSize       Dimensione del messaggio che ricevo
  * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
  *                      -1 [setta errno]
  */
-ssize_t receiveMSG(int fd, void **msg, size_t *msgSize) {
+static ssize_t riceviMessaggio(int fd, Lettore *lettore, void **msg, size_t *msgSize) {
     /** Variabili **/
     int isNull = 0;
     ssize_t bytesReceiveIt = -1, nReads = -1;
@@ -134,7 +166,8 @@ ssize_t receiveMSG(int fd, void **msg, size_t *msgSize) {
     if((msgSize == NULL) && ((isNull = 1, msgSize = (size_t *) malloc(sizeof(size_t))) == NULL)) {
         return -1;
     }
-    if((nReads = readn(fd, msgSize, sizeof(size_t))) != sizeof(size_t)) {
+    nReads = (lettore != NULL) ? readnLettore(lettore, msgSize, sizeof(size_t)) : readn(fd, msgSize, sizeof(size_t));
+    if(nReads != sizeof(size_t)) {
         if(isNull) free(msgSize), msgSize = NULL;
         errno = ECOMM;
         if(nReads == 0) return 0;
@@ -147,7 +180,8 @@ ssize_t receiveMSG(int fd, void **msg, size_t *msgSize) {
         return -1;
     }
     if(*msgSize != 0) {
-        if((nReads = readn(fd, *msg, *msgSize)) != *msgSize) {
+        nReads = (lettore != NULL) ? readnLettore(lettore, *msg, *msgSize) : readn(fd, *msg, *msgSize);
+        if(nReads != *msgSize) {
             errno = ECOMM;
             if(isNull) free(msgSize), msgSize = NULL;
             free(*msg);
@@ -162,4 +196,474 @@ ssize_t receiveMSG(int fd, void **msg, size_t *msgSize) {
     if(isNull) free(msgSize);
     errno = 0;
     return bytesReceiveIt;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief               Riceve un messaggio dalla socket indicata
+ * @fun                 receiveMSG
+ * @param fd            FD da cui riceve il messaggio
+ * @param msg           Buffer che conterrà il messaggio ricevuto
+ * @param msgSize       Dimensione del messaggio che ricevo
+ * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
+ *                      -1 [setta errno]
+ */
+ssize_t receiveMSG(int fd, void **msg, size_t *msgSize) {
+    return riceviMessaggio(fd, NULL, msg, msgSize);
+}
+
+
+/**
+ * @brief                   Accoda un messaggio per il prossimo invio vettoriale
+ * @fun                     aggiungiMSG
+ * @param messaggi          Coda dei messaggi
+ * @param msg               Contenuto del messaggio (non viene copiato: deve restare valido fino a sendMSGv)
+ * @param msgSize           Dimensione del messaggio
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int aggiungiMSG(Messaggi *messaggi, const void *msg, size_t msgSize) {
+    /** Variabili **/
+    Segmento_MSG *nuovi = NULL;
+    size_t capacita = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(messaggi == NULL) { errno = EINVAL; return -1; }
+    if((msg == NULL) && (msgSize != 0)) { errno = EINVAL; return -1; }
+
+    /** Faccio spazio al nuovo segmento **/
+    if(messaggi->numero == messaggi->capacita) {
+        capacita = (messaggi->capacita == 0) ? SEGMENTI_INIZIALI : 2*messaggi->capacita;
+        if((nuovi = (Segmento_MSG *) realloc(messaggi->segmenti, capacita*sizeof(Segmento_MSG))) == NULL) {
+            return -1;
+        }
+        messaggi->segmenti = nuovi;
+        messaggi->capacita = capacita;
+    }
+
+    /** Accodo **/
+    messaggi->segmenti[messaggi->numero].dimensione = msgSize;
+    messaggi->segmenti[messaggi->numero].valore = 0;
+    messaggi->segmenti[messaggi->numero].msg = msg;
+    messaggi->numero++;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Accoda un messaggio intero (copiato) per il prossimo invio vettoriale
+ * @fun                     aggiungiIntMSG
+ * @param messaggi          Coda dei messaggi
+ * @param valore            Valore da spedire
+ * @return                  Ritorna (0) in caso di successo; (-1) altrimenti [setta errno]
+ */
+int aggiungiIntMSG(Messaggi *messaggi, int valore) {
+    /** Accodo un segmento che punta alla propria copia del valore (fissata all'invio) **/
+    if(aggiungiMSG(messaggi, NULL, 0) == -1) {
+        return -1;
+    }
+    messaggi->segmenti[messaggi->numero-1].dimensione = sizeof(int);
+    messaggi->segmenti[messaggi->numero-1].valore = valore;
+
+    return 0;
+}
+
+
+/**
+ * @brief                   Spedisce con un'unica writev tutti i messaggi accodati (ognuno preceduto
+ *                          dalla sua dimensione, come sendMSG) e svuota la coda
+ * @fun                     sendMSGv
+ * @param fd                FD su cui mandare i messaggi
+ * @param messaggi          Coda dei messaggi
+ * @return                  Ritorna il numero di byte scritti o -1 in caso di errore [setta errno]
+ */
+ssize_t sendMSGv(int fd, Messaggi *messaggi) {
+    /** Variabili **/
+    struct iovec locali[IOVEC_LOCALI], *vettori = locali;
+    Segmento_MSG *segmento = NULL;
+    size_t totale = 0;
+    ssize_t nWrites = -1;
+    int numeroVettori = 0;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(fd <= 0) { errno = EINVAL; return -1; }
+    if(messaggi == NULL) { errno = EINVAL; return -1; }
+    if(messaggi->numero == 0) return 0;
+
+    /** Costruisco i vettori: dimensione e contenuto di ogni messaggio **/
+    if((2*messaggi->numero > IOVEC_LOCALI) && ((vettori = (struct iovec *) malloc(2*messaggi->numero*sizeof(struct iovec))) == NULL)) {
+        return -1;
+    }
+    for(size_t i=0; i<messaggi->numero; i++) {
+        segmento = messaggi->segmenti + i;
+        vettori[numeroVettori].iov_base = &(segmento->dimensione);
+        vettori[numeroVettori++].iov_len = sizeof(size_t);
+        if(segmento->dimensione == 0) continue;
+        vettori[numeroVettori].iov_base = (segmento->msg != NULL) ? (void *) segmento->msg : (void *) &(segmento->valore);
+        vettori[numeroVettori++].iov_len = segmento->dimensione;
+        totale += segmento->dimensione;
+    }
+    totale += messaggi->numero*sizeof(size_t);
+
+    /** Invio **/
+    nWrites = writevn(fd, vettori, numeroVettori);
+    if(vettori != locali) free(vettori);
+    messaggi->numero = 0;
+    if(nWrites != totale) {
+        errno = ECOMM;
+        return -1;
+    }
+
+    errno = 0;
+    return nWrites;
+}
+
+
+/**
+ * @brief                   Libera la memoria dei messaggi accodati
+ * @fun                     liberaMessaggi
+ * @param messaggi          Coda dei messaggi
+ */
+void liberaMessaggi(Messaggi *messaggi) {
+    /** Controllo parametri **/
+    if(messaggi == NULL) return;
+
+    /** Libero **/
+    if(messaggi->segmenti != NULL) free(messaggi->segmenti);
+    messaggi->segmenti = NULL;
+    messaggi->numero = 0;
+    messaggi->capacita = 0;
+}
+
+
+/**
+ * @brief                   Associa il lettore all'fd e svuota il suo buffer
+ * @fun                     inizializzaLettore
+ * @param lettore           Lettore da inizializzare
+ * @param fd                FD da cui leggere
+ */
+void inizializzaLettore(Lettore *lettore, int fd) {
+    /** Controllo parametri **/
+    if(lettore == NULL) return;
+
+    /** Inizializzo **/
+    lettore->fd = fd;
+    lettore->inizio = 0;
+    lettore->fine = 0;
+    lettore->numeroDescrittori = 0;
+}
+
+
+/**
+ * @brief                   Legge da un socket conservando gli eventuali descrittori che accompagnano i dati
+ *                          (SCM_RIGHTS); quelli in eccesso rispetto allo spazio disponibile vengono chiusi
+ * @fun                     riceviConDescrittori
+ * @param fd                Socket da cui leggere
+ * @param ptr               Buffer su cui salvare i dati
+ * @param n                 Dimensione del buffer
+ * @param descrittori       Descrittori ricevuti, accodati a quelli gia' presenti
+ * @param numero            Numero dei descrittori presenti
+ * @param massimo           Spazio per i descrittori
+ * @return                  Ritorna i bytes letti; 0 in caso di EOF; -1 in caso di errore
+ */
+static ssize_t riceviConDescrittori(int fd, void *ptr, size_t n, int *descrittori, unsigned int *numero, unsigned int massimo) {
+    /** Variabili **/
+    union {
+        struct cmsghdr allineamento;
+        char spazio[CMSG_SPACE(DESCRITTORI_LETTORE*sizeof(int))];
+    } controllo;
+    struct iovec vettore = { ptr, n };
+    struct msghdr messaggio;
+    struct cmsghdr *c = NULL;
+    ssize_t letti = -1;
+    size_t arrivati = 0;
+    int d = -1;
+
+    /** Ricevo i dati e gli eventuali descrittori **/
+    memset(&messaggio, 0, sizeof(struct msghdr));
+    messaggio.msg_iov = &vettore, messaggio.msg_iovlen = 1;
+    messaggio.msg_control = controllo.spazio, messaggio.msg_controllen = sizeof(controllo.spazio);
+    if((letti = recvmsg(fd, &messaggio, 0)) <= 0) {
+        return letti;
+    }
+    for(c = CMSG_FIRSTHDR(&messaggio); c != NULL; c = CMSG_NXTHDR(&messaggio, c)) {
+        if((c->cmsg_level != SOL_SOCKET) || (c->cmsg_type != SCM_RIGHTS)) continue;
+        arrivati = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i=0; i<arrivati; i++) {
+            memcpy(&d, CMSG_DATA(c) + i*sizeof(int), sizeof(int));
+            if(*numero < massimo) descrittori[(*numero)++] = d;
+            else close(d);
+        }
+    }
+
+    return letti;
+}
+
+
+/**
+ * @brief                   Legge dal socket del lettore conservando gli eventuali descrittori che accompagnano i dati
+ * @fun                     leggiSocket
+ * @param lettore           Lettore da cui leggere
+ * @param ptr               Buffer su cui salvare i dati
+ * @param n                 Dimensione del buffer
+ * @return                  Ritorna i bytes letti; 0 in caso di EOF; -1 in caso di errore
+ */
+static ssize_t leggiSocket(Lettore *lettore, void *ptr, size_t n) {
+    return riceviConDescrittori(lettore->fd, ptr, n, lettore->descrittori, &(lettore->numeroDescrittori), DESCRITTORI_LETTORE);
+}
+
+
+/**
+ * @brief                   Riceve n bytes da un socket in modo completo insieme all'eventuale descrittore che li
+ *                          accompagna (SCM_RIGHTS); altri descrittori arrivati vengono chiusi
+ * @fun                     readnDescrittore
+ * @param fd                Socket da cui leggere
+ * @param ptr               Buffer su cui salvare i dati
+ * @param n                 Dimensione del buffer
+ * @param descrittore       Descrittore ricevuto (-1 se non ne e' arrivato nessuno)
+ * @return                  Ritorna la dimensione dei dati letti; altrimenti ritorna i
+ *                          byte che è riuscita a leggere, 0 in caso di EOF o -1
+ */
+ssize_t readnDescrittore(int fd, void *ptr, size_t n, int *descrittore) {
+    size_t   nleft;
+    ssize_t  nread;
+    unsigned int arrivati = 0;
+    char     *dest = (char *) ptr;
+
+    *descrittore = -1;
+    nleft = n;
+    while (nleft > 0) {
+        if((nread = riceviConDescrittori(fd, dest, nleft, descrittore, &arrivati, 1)) < 0) {
+            if (errno == EINTR) continue;
+            if (nleft == n) return -1; /* error, return -1 */
+            else break; /* error, return amount read so far */
+        } else if (nread == 0) break; /* EOF */
+        nleft -= nread;
+        dest  += nread;
+    }
+    return(n - nleft); /* return >= 0 */
+}
+
+
+/**
+ * @brief                   Riceve n bytes in modo completo passando dal buffer del lettore: le richieste
+ *                          piccole vengono servite dal buffer (riempito con una sola read), quelle grandi
+ *                          vengono lette direttamente nella destinazione
+ * @fun                     readnLettore
+ * @param lettore           Lettore da cui leggere
+ * @param ptr               Buffer su cui salvare i dati
+ * @param n                 Dimensione del buffer
+ * @return                  Ritorna la dimensione dei dati letti; altrimenti ritorna i
+ *                          byte che è riuscita a leggere, 0 in caso di EOF o -1
+ */
+ssize_t readnLettore(Lettore *lettore, void *ptr, size_t n) {
+    size_t   nleft, disponibili;
+    ssize_t  nread;
+    char     *dest = (char *) ptr;
+
+    nleft = n;
+    while (nleft > 0) {
+        disponibili = lettore->fine - lettore->inizio;
+        if (disponibili > 0) { /* consumo prima quanto gia' letto */
+            if (disponibili > nleft) disponibili = nleft;
+            memcpy(dest, lettore->buffer + lettore->inizio, disponibili);
+            lettore->inizio += disponibili;
+            nleft -= disponibili;
+            dest  += disponibili;
+            continue;
+        }
+        if (nleft >= sizeof(lettore->buffer)) { /* richiesta grande: nessuna copia intermedia */
+            if((nread = leggiSocket(lettore, dest, nleft)) < 0) {
+                if (nleft == n) return -1; /* error, return -1 */
+                else break; /* error, return amount read so far */
+            } else if (nread == 0) break; /* EOF */
+            nleft -= nread;
+            dest  += nread;
+            continue;
+        }
+        if((nread = leggiSocket(lettore, lettore->buffer, sizeof(lettore->buffer))) < 0) {
+            if (nleft == n) return -1; /* error, return -1 */
+            else break; /* error, return amount read so far */
+        } else if (nread == 0) break; /* EOF */
+        lettore->inizio = 0;
+        lettore->fine = nread;
+    }
+    return(n - nleft); /* return >= 0 */
+}
+
+
+/**
+ * @brief                   Preleva il primo descrittore ricevuto dal lettore: i descrittori vengono consegnati
+ *                          nell'ordine in cui sono arrivati sul socket
+ * @fun                     prelevaDescrittore
+ * @param lettore           Lettore da cui prelevare
+ * @return                  Ritorna il descrittore; -1 se non ne sono arrivati [setta errno]
+ */
+int prelevaDescrittore(Lettore *lettore) {
+    /** Variabili **/
+    int d = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(lettore == NULL) { errno = EINVAL; return -1; }
+    if(lettore->numeroDescrittori == 0) { errno = ENOENT; return -1; }
+
+    /** Prelevo il descrittore piu' vecchio **/
+    d = (lettore->descrittori)[0];
+    (lettore->numeroDescrittori)--;
+    memmove(lettore->descrittori, lettore->descrittori + 1, (lettore->numeroDescrittori)*sizeof(int));
+
+    return d;
+}
+
+
+/**
+ * @brief               Riceve un messaggio passando dal buffer del lettore
+ * @fun                 receiveBufferedMSG
+ * @param lettore       Lettore da cui riceve il messaggio
+ * @param msg           Buffer che conterrà il messaggio ricevuto
+ * @param msgSize       Dimensione del messaggio che ricevo
+ * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
+ *                      -1 [setta errno]
+ */
+ssize_t receiveBufferedMSG(Lettore *lettore, void **msg, size_t *msgSize) {
+    /** Controllo parametri **/
+    errno = 0;
+    if(lettore == NULL) { errno = EINVAL; return -1; }
+
+    return riceviMessaggio(lettore->fd, lettore, msg, msgSize);
+}
+
+
+/**
+ * @brief                   Assegna memoria dall'arena, allocando un nuovo blocco solo se quello
+ *                          corrente non basta (i blocchi precedenti restano validi fino all'azzeramento)
+ * @fun                     allocaArena
+ * @param arena             Arena da cui allocare
+ * @param dimensione        Bytes richiesti
+ * @return                  Ritorna la memoria assegnata; NULL in caso di errore [setta errno]
+ */
+void* allocaArena(Arena *arena, size_t dimensione) {
+    /** Variabili **/
+    Blocco_Arena *blocco = NULL;
+    size_t capacita = ARENA_BLOCCO;
+    void *assegnata = NULL;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(arena == NULL) { errno = EINVAL; return NULL; }
+
+    /** Allineo la richiesta e cerco spazio nel blocco corrente **/
+    dimensione = (dimensione + ARENA_ALLINEAMENTO - 1) & ~(ARENA_ALLINEAMENTO - 1);
+    blocco = arena->corrente;
+    if((blocco == NULL) || ((blocco->capacita - blocco->usati) < dimensione)) {
+        if((blocco != NULL) && (2*blocco->capacita > capacita)) capacita = 2*blocco->capacita;
+        if(dimensione > capacita) capacita = dimensione;
+        if((blocco = (Blocco_Arena *) malloc(sizeof(Blocco_Arena) + capacita)) == NULL) {
+            return NULL;
+        }
+        blocco->precedente = arena->corrente;
+        blocco->capacita = capacita;
+        blocco->usati = 0;
+        arena->corrente = blocco;
+        arena->totale += capacita;
+    }
+
+    /** Assegno **/
+    assegnata = (char *) blocco->dati + blocco->usati;
+    blocco->usati += dimensione;
+    return assegnata;
+}
+
+
+/**
+ * @brief                   Rende di nuovo disponibile tutta la memoria dell'arena. Se durante la richiesta
+ *                          sono serviti piu' blocchi vengono sostituiti da uno solo che li contiene tutti;
+ *                          oltre ARENA_MASSIMA la memoria viene restituita al sistema
+ * @fun                     azzeraArena
+ * @param arena             Arena da azzerare
+ */
+void azzeraArena(Arena *arena) {
+    /** Variabili **/
+    size_t totale = 0;
+
+    /** Controllo parametri **/
+    if((arena == NULL) || (arena->corrente == NULL)) return;
+
+    /** Un solo blocco di dimensione accettabile: lo riuso **/
+    if((arena->corrente->precedente == NULL) && (arena->totale <= ARENA_MASSIMA)) {
+        arena->corrente->usati = 0;
+        return;
+    }
+
+    /** Compatto i blocchi in uno solo (se non supera il limite) **/
+    totale = arena->totale;
+    liberaArena(arena);
+    if(totale <= ARENA_MASSIMA) {
+        if(allocaArena(arena, totale) != NULL) arena->corrente->usati = 0;
+    }
+}
+
+
+/**
+ * @brief                   Libera tutti i blocchi dell'arena
+ * @fun                     liberaArena
+ * @param arena             Arena da liberare
+ */
+void liberaArena(Arena *arena) {
+    /** Variabili **/
+    Blocco_Arena *blocco = NULL;
+
+    /** Controllo parametri **/
+    if(arena == NULL) return;
+
+    /** Libero **/
+    while((blocco = arena->corrente) != NULL) {
+        arena->corrente = blocco->precedente;
+        free(blocco);
+    }
+    arena->totale = 0;
+}
+
+
+/**
+ * @brief               Riceve un messaggio nella memoria dell'arena: nessuna allocazione se l'arena
+ *                      ha gia' spazio e nessuna free da parte del chiamante
+ * @fun                 receiveMSGArena
+ * @param fd            FD da cui riceve il messaggio
+ * @param arena         Arena in cui salvare il messaggio
+ * @param msg           Conterrà il puntatore al messaggio ricevuto
+ * @param msgSize       Dimensione del messaggio che ricevo (puo' essere NULL)
+ * @return              In caso di successo ritorna il numero di bytes letti; altrimenti
+ *                      -1 [setta errno]
+ */
+ssize_t receiveMSGArena(int fd, Arena *arena, void **msg, size_t *msgSize) {
+    /** Variabili **/
+    size_t dimensione = 0;
+    ssize_t nReads = -1;
+
+    /** Controllo parametri **/
+    errno = 0;
+    if(fd <= 0) { errno = EINVAL; return -1; }
+    if((arena == NULL) || (msg == NULL)) { errno = EINVAL; return -1; }
+
+    /** Ricevo dimensione e contenuto direttamente nell'arena **/
+    if((nReads = readn(fd, &dimensione, sizeof(size_t))) != sizeof(size_t)) {
+        errno = ECOMM;
+        return (nReads == 0) ? 0 : -1;
+    }
+    if((*msg = allocaArena(arena, (dimensione != 0) ? dimensione : 1)) == NULL) {
+        return -1;
+    }
+    if((dimensione != 0) && ((nReads = readn(fd, *msg, dimensione)) != dimensione)) {
+        *msg = NULL;
+        errno = ECOMM;
+        return (nReads == 0) ? 0 : -1;
+    }
+    if(msgSize != NULL) *msgSize = dimensione;
+
+    errno = 0;
+    return (ssize_t) (sizeof(size_t) + dimensione - 1);
+}
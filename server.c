@@ -21,6 +21,8 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <errno.h>
 #include <logFile.h>
 #include <FileStorageServer.h>
@@ -37,14 +39,17 @@
     do {                                                                                                                        \
         error = errno;                                                                                                          \
         if(status != NULL) { free(status); }                                                                                    \
-        if(commitToPool != NULL) { free(commitToPool); }                                                                        \
         if(pool != NULL) { stopThreadPool(pool, (HARDSHOT)); }                                                                  \
+        if(deposito != NULL) { destroyTaskDeposit(&deposito); }                                                                 \
+        if(sessioni != NULL) { distruggiSessioni(&sessioni, FD_SETSIZE); }                                                      \
         if(fd_sk != -1) { close(fd_sk); }                                                                                       \
+        if(fd_pacchetti != -1) { close(fd_pacchetti); unlink(setServer->socketPacchetti); }                                     \
+        if(fd_tcp != -1) { close(fd_tcp); }                                                                                     \
         for(fd = 0; fd <= max; fd++) {                                                                                          \
             if(FD_ISSET(fd, &allFd))                                                                                            \
                 close(fd);                                                                                                      \
         }                                                                                                                       \
-        unlink(setServer->socket);                                                                                              \
+        if(setServer != NULL) { unlink(setServer->socket); }                                                                    \
         index = -1;                                                                                                             \
         while((cacheLRU != NULL) && (cacheLRU->usersConnected != NULL) && ((cacheLRU->usersConnected)[++index] != NULL)) {      \
             fd = ((userLink *) (cacheLRU->usersConnected)[index]->data)->fd;                                                    \
@@ -78,12 +83,16 @@
  *                      delle connessioni
  * @param pfd           Puntatore alla pipe di ritorno degli fd riabilitati
  * @param fd            Fd principale di accettazione delle connessioni alla socket
+ * @param fdPacchetti   Fd di accettazione delle connessioni al socket SOCK_SEQPACKET (-1 se non aperto)
+ * @param fdTcp         Fd di accettazione delle connessioni TCP (-1 se non aperto)
  * @param set           Maschera degli fd attivi in lettura
  */
 typedef struct {
     int *runnable;
     int *pfd;
     int fd;
+    int fdPacchetti;
+    int fdTcp;
     fd_set *set;
 } argToHandler;
 
@@ -109,25 +118,205 @@ static int update(int fd_num, fd_set *set) {
 
 
 /**
- * @brief           Funzione che dealloca i task del pool di thread
+ * @brief                   Riabilita in lettura i client sospesi perche' la coda dei task era piena
+ * @fun                     riabilitaSospesi
+ * @param sospesi           Maschera dei client sospesi (viene svuotata)
+ * @param set               Maschera degli fd attivi in lettura
+ * @param max               Valore del fd piu' grande mai usato
+ * @param fd_num            Valore del fd piu' grande attivo in lettura (aggiornato)
+ */
+static void riabilitaSospesi(fd_set *sospesi, fd_set *set, int max, int *fd_num) {
+    /** Riabilitazione **/
+    for(int fd=0; fd<=max; fd++) {
+        if(FD_ISSET(fd, sospesi)) {
+            FD_SET(fd, set);
+            if(fd > *fd_num) *fd_num = fd;
+        }
+    }
+    FD_ZERO(sospesi);
+}
+
+
+/**
+ * @brief               Deposito dei task gia' eseguiti, pronti per essere riutilizzati dal thread manager
+ * @struct              taskDeposit
+ * @param liberi        Coda intrusiva dei task liberi
+ * @param access        Mutex per l'accesso concorrente al deposito
+ */
+typedef struct {
+    IntrusiveQueue liberi;
+    pthread_mutex_t *access;
+} taskDeposit;
+
+
+/**
+ * @brief               Task riciclabile: contiene sia il task mandato al pool che i suoi argomenti
+ * @struct              taskObject
+ * @param task          Task da mandare al pool (deve restare il primo campo)
+ * @param package       Argomenti del task
+ * @param deposito      Deposito a cui restituire il task una volta eseguito
+ */
+typedef struct {
+    Task task;
+    Task_Package package;
+    taskDeposit *deposito;
+} taskObject;
+
+
+/**
+ * @brief                   Crea il deposito dei task e lo riempie con i task iniziali
+ * @fun                     startTaskDeposit
+ * @param numeroTask        Numero di task da preallocare
+ * @return                  Ritorna il deposito; NULL in caso di errore [setta errno]
+ */
+static taskDeposit* startTaskDeposit(size_t numeroTask) {
+    /** Variabili **/
+    int error = 0;
+    taskDeposit *d = NULL;
+    taskObject *obj = NULL;
+    QueueNode *nodo = NULL;
+
+    /** Creo il deposito **/
+    if((d = (taskDeposit *) malloc(sizeof(taskDeposit))) == NULL) {
+        return NULL;
+    }
+    initIntrusiveQueue(&(d->liberi));
+    if((d->access = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t))) == NULL) {
+        error = errno;
+        free(d);
+        errno = error;
+        return NULL;
+    }
+    if((error = pthread_mutex_init(d->access, NULL)) != 0) {
+        free(d->access);
+        free(d);
+        errno = error;
+        return NULL;
+    }
+
+    /** Prealloco i task **/
+    for(size_t i=0; i<numeroTask; i++) {
+        if((obj = (taskObject *) malloc(sizeof(taskObject))) == NULL) {
+            error = errno;
+            while((nodo = dequeueNode(&(d->liberi))) != NULL) free(nodo);
+            pthread_mutex_destroy(d->access);
+            free(d->access);
+            free(d);
+            errno = error;
+            return NULL;
+        }
+        obj->deposito = d;
+        enqueueNode(&(d->liberi), &((obj->task).node));
+    }
+
+    errno = 0;
+    return d;
+}
+
+
+/**
+ * @brief                   Preleva un task libero dal deposito; se non ce ne sono ne alloca uno nuovo
+ * @fun                     getTaskObject
+ * @param d                 Deposito dei task
+ * @return                  Ritorna il task; NULL in caso di errore [setta errno]
+ */
+static taskObject* getTaskObject(taskDeposit *d) {
+    /** Variabili **/
+    int error = 0;
+    taskObject *obj = NULL;
+
+    /** Controllo parametri **/
+    if(d == NULL) { errno = EINVAL; return NULL; }
+
+    /** Prelevo il task **/
+    if((error = pthread_mutex_lock(d->access)) != 0) {
+        errno = error;
+        return NULL;
+    }
+    obj = (taskObject *) dequeueNode(&(d->liberi));
+    if((error = pthread_mutex_unlock(d->access)) != 0) {
+        errno = error;
+        return NULL;
+    }
+    if((obj == NULL) && ((obj = (taskObject *) malloc(sizeof(taskObject))) == NULL)) {
+        return NULL;
+    }
+    obj->deposito = d;
+    (obj->task).argv = &(obj->package);
+
+    errno = 0;
+    return obj;
+}
+
+
+/**
+ * @brief                   Dealloca il deposito dei task e tutti i task liberi
+ * @fun                     destroyTaskDeposit
+ * @param d                 Deposito dei task
+ */
+static void destroyTaskDeposit(taskDeposit **d) {
+    /** Variabili **/
+    QueueNode *nodo = NULL;
+
+    /** Controllo parametri **/
+    if((d == NULL) || (*d == NULL)) return;
+
+    /** Dealloco **/
+    while((nodo = dequeueNode(&((*d)->liberi))) != NULL) free(nodo);
+    pthread_mutex_destroy((*d)->access);
+    free((*d)->access);
+    free(*d);
+    *d = NULL;
+}
+
+
+/**
+ * @brief           Restituisce un task al suo deposito
+ * @fun             restituisciTask
+ * @param obj       Task da restituire
+ */
+static void restituisciTask(taskObject *obj) {
+    /** Controllo parametri **/
+    if(obj == NULL) return;
+
+    /** Restituisco il task al deposito **/
+    if(pthread_mutex_lock((obj->deposito)->access) != 0) {
+        free(obj);
+        return;
+    }
+    enqueueNode(&((obj->deposito)->liberi), &((obj->task).node));
+    pthread_mutex_unlock((obj->deposito)->access);
+}
+
+
+/**
+ * @brief           Funzione che registra la latenza dei task eseguiti dal pool di thread e li restituisce al deposito
  * @fun             free_task
- * @param uTask     Task da deallocare
+ * @param uTask     Task da restituire
  */
 static void free_task(void *uTask) {
     /** Variabili **/
-    Task *t = NULL;
-    Task_Package *tp = NULL;
+    taskObject *obj = NULL;
+    LRU_Memory *cache = NULL;
+    struct timespec ora;
+    unsigned long latenza = 0, massima = 0;
+    int corsia = -1;
 
     /** Controllo parametri **/
     if(uTask == NULL) return;
 
-    /** Dealloco il task **/
-    t = (Task *) uTask;
-    tp = (Task_Package *) t->argv;
-    if(tp != NULL) {
-        free(tp);
-    }
-    free(t);
+    /** Latenza per corsia: attesa in coda piu' esecuzione **/
+    obj = (taskObject *) uTask;
+    cache = (obj->package).cache;
+    corsia = (obj->task).corsia;
+    clock_gettime(CLOCK_MONOTONIC, &ora);
+    latenza = ((ora.tv_sec - (obj->task).arrivo.tv_sec) * 1000000) + ((ora.tv_nsec - (obj->task).arrivo.tv_nsec) / 1000);
+    __atomic_add_fetch(&(cache->richiesteCorsia[corsia]), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(cache->latenzaTotaleCorsia[corsia]), latenza, __ATOMIC_RELAXED);
+    massima = __atomic_load_n(&(cache->latenzaMassimaCorsia[corsia]), __ATOMIC_RELAXED);
+    while((latenza > massima) && !__atomic_compare_exchange_n(&(cache->latenzaMassimaCorsia[corsia]), &massima, latenza, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    restituisciTask(obj);
 }
 
 
@@ -141,7 +330,7 @@ static void* signalHandler(void *argv) {
     /** Variabili **/
     int *status = NULL;
     int error = 0, sig = -1, *runnable = NULL;
-    int *pfd = NULL, fd = -1;
+    int *pfd = NULL, fd = -1, fdPacchetti = -1, fdTcp = -1;
     fd_set *set = NULL;
     argToHandler *converted = NULL;
     sigset_t setSignal;
@@ -151,6 +340,8 @@ static void* signalHandler(void *argv) {
     converted = (argToHandler *) argv;
     pfd = converted->pfd;
     fd = converted->fd;
+    fdPacchetti = converted->fdPacchetti;
+    fdTcp = converted->fdTcp;
     set = converted->set;
     runnable = converted->runnable;
     free(argv);
@@ -166,6 +357,8 @@ static void* signalHandler(void *argv) {
 
     /** Arrivo del segnale da gestire **/
     FD_CLR(fd, set);
+    if(fdPacchetti != -1) FD_CLR(fdPacchetti, set);
+    if(fdTcp != -1) FD_CLR(fdTcp, set);
     *runnable = 0;
     switch (sig) {
         case SIGINT:
@@ -188,24 +381,30 @@ int main(int argc, char **argv) {
     /** Variabili **/
     int *status = NULL;
     int index = -1;
-    int fd = 0, fd_sk = -1, fd_cl = -1, fd_num = 0, max = 0, selectRes = -1;
+    int fd = 0, fd_sk = -1, fd_pacchetti = -1, fd_tcp = -1, fd_cl = -1, riuso = 1, fd_num = 0, max = 0, selectRes = -1;
+    int cliente = -1, campanello = -1, proprietari[FD_SETSIZE];
     int error = 0, pfd[2] = {-1, -1};
     int runnable = 1;
     ssize_t pipeBytes = -1;
     sigset_t set, oldset;
-    fd_set setInit, setRead, allFd;
+    fd_set setInit, setRead, allFd, sospesi;
     struct sockaddr_un sock_addr;
+    struct sockaddr_in indirizzo;
     serverLogFile *log = NULL;
     threadPool *pool = NULL;
+    Pool_Settings setPool;
     pthread_t *handler = NULL;
     argToHandler *sigHand = NULL;
     Settings *setServer = NULL;
     LRU_Memory *cacheLRU = NULL;
-    Task *commitToPool = NULL;
-    Task_Package *taskPackage = NULL;
+    taskDeposit *deposito = NULL;
+    taskObject *commitToPool = NULL;
+    Sessione *sessioni = NULL;
     struct timeval selectRefreshig, saveSelectRefreshig;
     FD_ZERO(&setInit);
     FD_ZERO(&allFd);
+    FD_ZERO(&sospesi);
+    for(fd = 0; fd < FD_SETSIZE; fd++) proprietari[fd] = -1;
 
     /** Controllo parametri **/
     if(argc != 2) {
@@ -289,18 +488,79 @@ int main(int argc, char **argv) {
     }
     TRACE_ON_LOG("[THREAD MANAGER]: Apertura della socket \"%s\"\n", setServer->socket)
 
+    /** Apertura del socket SOCK_SEQPACKET: i confini dei frame li conserva il kernel **/
+    if(setServer->socketPacchetti != NULL) {
+        if((fd_pacchetti = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        memset(&sock_addr, 0, sizeof(sock_addr));
+        sock_addr.sun_family = AF_UNIX;
+        strncpy(sock_addr.sun_path, setServer->socketPacchetti, sizeof(sock_addr.sun_path)-1);
+        if(bind(fd_pacchetti, (struct sockaddr *) &sock_addr, sizeof(sock_addr)) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        if(listen(fd_pacchetti, (int) setServer->maxUtentiConnessi) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        TRACE_ON_LOG("[THREAD MANAGER]: Apertura della socket SOCK_SEQPACKET \"%s\"\n", setServer->socketPacchetti)
+    }
+
+    /** Apertura del listener TCP per i client che non vedono il filesystem del server **/
+    if(setServer->indirizzoTcp != NULL) {
+        memset(&indirizzo, 0, sizeof(indirizzo));
+        indirizzo.sin_family = AF_INET;
+        indirizzo.sin_port = htons(setServer->portaTcp);
+        if(inet_pton(AF_INET, setServer->indirizzoTcp, &(indirizzo.sin_addr)) != 1) {
+            errno = EINVAL;
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        if((fd_tcp = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        if(setsockopt(fd_tcp, SOL_SOCKET, SO_REUSEADDR, &riuso, sizeof(int)) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        if(bind(fd_tcp, (struct sockaddr *) &indirizzo, sizeof(indirizzo)) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        if(listen(fd_tcp, (int) setServer->maxUtentiConnessi) == -1) {
+            FREE_SERVER(1)
+            exit(errno);
+        }
+        TRACE_ON_LOG("[THREAD MANAGER]: Apertura del listener TCP \"%s:%hu\"\n", setServer->indirizzoTcp, setServer->portaTcp)
+    }
+
     /** Preparazione degli fd da ascoltare in lettura **/
     if(fd_sk > fd_num) fd_num = fd_sk;
     FD_SET(fd_sk, &setInit), FD_SET(fd_sk, &allFd);            //Abilito il listen socket
     FD_SET(pfd[0], &setInit), FD_SET(fd_sk, &allFd);           //Abilito la pipe in lettura sulla select
+    if(fd_pacchetti != -1) {                                    //Abilito il socket SOCK_SEQPACKET
+        if(fd_pacchetti > fd_num) fd_num = fd_pacchetti;
+        FD_SET(fd_pacchetti, &setInit);
+    }
+    if(fd_tcp != -1) {                                          //Abilito il listener TCP
+        if(fd_tcp > fd_num) fd_num = fd_tcp;
+        FD_SET(fd_tcp, &setInit);
+    }
 
     /** Avvio del thread pool **/
-    if((pool = startThreadPool(setServer->numeroThreadWorker, free_task, log)) == NULL) {
+    setPool.numeroThread = setServer->numeroThreadWorker, setPool.maxThread = setServer->maxThreadWorker;
+    setPool.dimCoda = setServer->dimCodaTask, setPool.affinita = setServer->affinitaConnessioni;
+    setPool.cpu = setServer->cpuWorker, setPool.numeroCpu = setServer->numeroCpuWorker;
+    setPool.maxSpin = setServer->spinWorker, setPool.busyPoll = setServer->busyPoll;
+    if((pool = startThreadPool(&setPool, free_task, log)) == NULL) {
         FREE_SERVER(1)
         perror("Errore");
         exit(errno);
     }
-    TRACE_ON_LOG("[THREAD MANAGER]: Avvio del threadpool effettuato correttamente: avviati \"%d\" thread\n", setServer->numeroThreadWorker)
+    TRACE_ON_LOG("[THREAD MANAGER]: Avvio del threadpool effettuato correttamente: avviati \"%d\" thread (massimo \"%d\")\n", setServer->numeroThreadWorker, setServer->maxThreadWorker)
 
     /** Avvio memoria cache LRU **/
     if((cacheLRU = startLRUMemory(setServer, log)) == NULL) {
@@ -320,6 +580,8 @@ int main(int argc, char **argv) {
     sigHand->set = &setInit;
     sigHand->pfd = pfd;
     sigHand->fd = fd_sk;
+    sigHand->fdPacchetti = fd_pacchetti;
+    sigHand->fdTcp = fd_tcp;
     sigHand->runnable = &runnable;
     if((error = pthread_create(handler, NULL, signalHandler, sigHand)) != 0) {
         FREE_SERVER(1)
@@ -327,10 +589,16 @@ int main(int argc, char **argv) {
     }
     TRACE_ON_LOG("[THREAD MANAGER]: Gestione dei segnali affidata a thread specializzato\n")
 
+    /** Tabella delle sessioni dei client, indicizzata per fd **/
+    if((sessioni = creaSessioni(FD_SETSIZE)) == NULL) {
+        FREE_SERVER(1)
+        exit(errno);
+    }
+
     /** Inizio del lavoro per il server **/
     selectRefreshig.tv_sec = 2;
     selectRefreshig.tv_usec = 0;
-    if((commitToPool = (Task *) malloc(sizeof(Task))) == NULL) {
+    if((deposito = startTaskDeposit(setServer->maxUtentiConnessi)) == NULL) {
         FREE_SERVER(1)
         exit(errno);
     }
@@ -342,24 +610,32 @@ int main(int argc, char **argv) {
         if(((selectRes = select(fd_num+1, &setRead, NULL, NULL, &saveSelectRefreshig)) == -1) && (errno != EINTR)) {
             FREE_SERVER(1)
             exit(errno);
-        } else if (selectRes <= 0 && runnable) continue;
+        } else if (selectRes <= 0 && runnable) {
+            riabilitaSospesi(&sospesi, &setInit, max, &fd_num);
+            continue;
+        }
 
         TRACE_ON_LOG("[THREAD MANAGER]: Select: nuovi fd pronti in lettura...\n")
         for(fd = 0; fd <= fd_num; fd++) {
             if(FD_ISSET(fd, &setRead)) {
                 TRACE_ON_LOG("[THREAD MANAGER]: fd:\"%d\" pronto in lettura\n", fd)
-                if(fd == fd_sk) { /** Richiesta di connessione di un nuovo client **/
+                if((fd == fd_sk) || (fd == fd_pacchetti) || (fd == fd_tcp)) { /** Richiesta di connessione di un nuovo client **/
                     /** Abilito in lettura il nuovo client **/
                     TRACE_ON_LOG("[THREAD MANAGER]: Accept(): richiesta di accettazione di un client\n")
                     if(loginClient(cacheLRU) == -1) {
                         TRACE_ON_LOG("[THREAD MANAGE]: Troppi utenti connessi, il client deve attendere...\n")
                         continue;
                     }
-                    if(((fd_cl = accept(fd_sk, NULL, 0)) == -1) && (errno != EINTR)) {
+                    if(((fd_cl = accept(fd, NULL, 0)) == -1) && (errno != EINTR)) {
                         FREE_SERVER(1)
                         exit(errno);
                     }
                     (cacheLRU->numTotLogin)++;
+                    if(apriSessione(sessioni, fd_cl, (fd == fd_tcp) ? TRASPORTO_TCP : ((fd == fd_pacchetti) ? TRASPORTO_PACCHETTI : TRASPORTO_STREAM)) == -1) {
+                        FREE_SERVER(1)
+                        exit(errno);
+                    }
+                    proprietari[fd_cl] = -1;
                     FD_SET(fd_cl, &setInit), FD_SET(fd_cl, &allFd);
                     if(fd_cl > fd_num) fd_num = fd_cl;
                     if(max < fd_num) max = fd_num;
@@ -373,9 +649,17 @@ int main(int argc, char **argv) {
                             TRACE_ON_LOG("[THREAD MANAGER]: Client con fd:\"%d\" riabilitato\n", fd_cl)
                             FD_SET(fd_cl, &setInit);
                             if (fd_cl > fd_num) fd_num = fd_cl;
+                            /** Il campanello degli anelli del client torna in ascolto insieme al socket **/
+                            if ((campanello = sessioni[fd_cl].campanello) >= 0) {
+                                proprietari[campanello] = fd_cl;
+                                FD_SET(campanello, &setInit);
+                                if (campanello > fd_num) fd_num = campanello;
+                                if (max < fd_num) max = fd_num;
+                            }
                         }
                         pipeBytes = read(pfd[0], &fd_cl, sizeof(int));
                     }
+                    riabilitaSospesi(&sospesi, &setInit, max, &fd_num);
                     if(errno == EAGAIN) continue;
                     if(errno == EPIPE) break;
                     if((pipeBytes == -1) && (errno != 0) && (errno != EPIPE) && (errno != EAGAIN) && (errno != EINTR) && (errno != EBADF)) {
@@ -384,24 +668,43 @@ int main(int argc, char **argv) {
                     }
                     errno = 0;
                 } else {
-                    if((taskPackage = (Task_Package *) malloc(sizeof(Task_Package))) == NULL) {
+                    /** Socket o campanello degli anelli: la task serve comunque il client, una sola alla volta **/
+                    cliente = (proprietari[fd] != -1) ? proprietari[fd] : fd;
+                    campanello = sessioni[cliente].campanello;
+                    FD_CLR(cliente, &setRead);
+                    if(campanello >= 0) FD_CLR(campanello, &setRead);
+                    if((commitToPool = getTaskObject(deposito)) == NULL) {
                         FREE_SERVER(1)
                         exit(errno);
                     }
-                    TRACE_ON_LOG("[THREAD MANAGER]: Client con fd:\"%d\", invio task al pool di thread\n", fd)
-                    taskPackage->fd = fd;
-                    taskPackage->cache = cacheLRU;
-                    taskPackage->pfd = pfd[1];
-                    taskPackage->log = log;
-                    commitToPool->argv = taskPackage;
-                    commitToPool->to_do = ServerTasks;
-                    if(pushTask(pool, commitToPool) == -1) {
+                    TRACE_ON_LOG("[THREAD MANAGER]: Client con fd:\"%d\", invio task al pool di thread\n", cliente)
+                    (commitToPool->package).fd = cliente;
+                    (commitToPool->package).cache = cacheLRU;
+                    (commitToPool->package).pfd = pfd[1];
+                    (commitToPool->package).log = log;
+                    (commitToPool->package).sessioni = sessioni;
+                    (commitToPool->task).to_do = ServerTasks;
+                    (commitToPool->task).corsia = classificaRichiesta(sessioni + cliente);
+                    (commitToPool->task).affinita = cliente;
+                    if(pushTask(pool, &(commitToPool->task)) == -1) {
+                        error = errno;
+                        restituisciTask(commitToPool);
+                        errno = error;
+                        if(errno == EAGAIN) {
+                            /** Coda piena: la richiesta resta nel socket finche' un worker non si libera **/
+                            (cacheLRU->numeroCodaPiena)++;
+                            FD_CLR(cliente, &setInit), FD_SET(cliente, &sospesi);
+                            if(campanello >= 0) FD_CLR(campanello, &setInit), FD_SET(campanello, &sospesi);
+                            TRACE_ON_LOG("[THREAD MANAGER]: Coda dei task piena, client con fd:\"%d\" sospeso\n", cliente)
+                            continue;
+                        }
                         FREE_SERVER(1)
                         exit(errno);
                     }
-                    FD_CLR(fd, &setInit);
+                    FD_CLR(cliente, &setInit);
+                    if(campanello >= 0) FD_CLR(campanello, &setInit);
                     fd_num = update(fd_num, &setInit);
-                    TRACE_ON_LOG("[THREAD MANAGER]: Client con fd:\"%d\", richiesta al pool di thread inviata correttamente\n", fd)
+                    TRACE_ON_LOG("[THREAD MANAGER]: Client con fd:\"%d\", richiesta al pool di thread inviata correttamente\n", cliente)
                 }
             }
         }
@@ -0,0 +1,207 @@
+/**
+ * @project             FILE_STORAGE_SERVER
+ * @brief               Scenari del protocollo v2 con due client: il proprietario tiene in lock un file mentre l'altro
+ *                      client gli accoda una lockFileAsync e altre letture, le cui risposte devono arrivare prima di
+ *                      quella della lock e ognuna con il proprio id; poi maniglia di un file rimosso (ESTALE, e EBADF
+ *                      dopo la closeHandle)
+ *                      e richiesta composta che si ferma al primo errore.
+ *                      Uso: ./test4/scenari socket
+ * @author              Simone Tassotti
+ * @date                19/10/2026
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <Client_API.h>
+#include <protocol.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+
+#define NUMERO_LETTURE 3
+#define FILE_LOCK "/test4/lock"
+#define FILE_RIMOSSO "/test4/rimosso"
+#define FILE_ASSENTE "/test4/assente"
+#define TIMEOUT_SCENARI_S 20
+
+
+/** File letti in pipeline mentre la lock e' in attesa: il contenuto di ognuno e' diverso **/
+static const char *letture[NUMERO_LETTURE] = { "/test4/a", "/test4/b", "/test4/c" };
+static const char *contenuti[NUMERO_LETTURE] = { "primo file", "secondo file, piu' lungo", "terzo" };
+
+/** Scenari falliti **/
+static int falliti = 0;
+
+
+/**
+ * @brief                   Riporta l'esito di un controllo
+ * @fun                     controlla
+ * @param riuscito          Se il controllo e' riuscito
+ * @param descrizione       Descrizione del controllo
+ */
+static void controlla(int riuscito, const char *descrizione) {
+    printf("[%s] %s\n", (riuscito) ? "OK" : "ERRORE", descrizione);
+    fflush(stdout);
+    if(!riuscito) falliti++;
+}
+
+
+/**
+ * @brief                   Attende un segnale dall'altro processo
+ * @fun                     attendi
+ * @param fd                Lato di lettura della pipe
+ * @return                  (0) in caso di successo; (-1) altrimenti
+ */
+static int attendi(int fd) {
+    char segnale = 0;
+
+    return (read(fd, &segnale, 1) == 1) ? 0 : -1;
+}
+
+
+/**
+ * @brief                   Manda un segnale all'altro processo
+ * @fun                     avvisa
+ * @param fd                Lato di scrittura della pipe
+ */
+static void avvisa(int fd) {
+    char segnale = 1;
+
+    if(write(fd, &segnale, 1) != 1) perror("avvisa");
+}
+
+
+/**
+ * @brief                   Proprietario della lock: crea i file, tiene FILE_LOCK in lock finche' l'altro client non ha
+ *                          ricevuto le letture accodate dopo la sua lockFileAsync, poi rimuove FILE_RIMOSSO
+ * @fun                     proprietario
+ * @param socket            Socket del server
+ * @param verso             Pipe verso l'altro client
+ * @param da                Pipe dall'altro client
+ * @return                  (0) in caso di successo; (-1) altrimenti
+ */
+static int proprietario(const char *socket, int verso, int da) {
+    /** Variabili **/
+    struct timespec attesa = { 2, 0 };
+
+    /** Creo i file, FILE_LOCK resta aperto e in lock **/
+    if(openConnection(socket, 100, attesa) == -1) { perror("openConnection"); return -1; }
+    for(int i=0; i<NUMERO_LETTURE; i++) {
+        if(putFile(letture[i], (void *) contenuti[i], strlen(contenuti[i]), 0, NULL) == -1) { perror("putFile"); return -1; }
+    }
+    if(putFile(FILE_RIMOSSO, "rimosso", 7, 0, NULL) == -1) { perror("putFile"); return -1; }
+    if(putFile(FILE_LOCK, "lock", 4, O_LOCK, NULL) == -1) { perror("putFile"); return -1; }
+    avvisa(verso);
+
+    /** Rilascio la lock solo dopo che l'altro client ha ricevuto le letture **/
+    if(attendi(da) == -1) return -1;
+    if(unlockFile(FILE_LOCK) == -1) { perror("unlockFile"); return -1; }
+
+    /** Rimuovo il file di cui l'altro client ha la maniglia **/
+    if(attendi(da) == -1) return -1;
+    if((openFile(FILE_RIMOSSO, 0) == -1) || (lockFile(FILE_RIMOSSO) == -1) || (removeFile(FILE_RIMOSSO) == -1)) { perror("removeFile"); return -1; }
+    avvisa(verso);
+
+    if(attendi(da) == -1) return -1;
+    closeConnection(socket);
+    return 0;
+}
+
+
+/**
+ * @brief                   Client che accoda le richieste: lockFileAsync su FILE_LOCK seguita da letture, maniglia di
+ *                          FILE_RIMOSSO e richiesta composta su un file assente
+ * @fun                     accodante
+ * @param socket            Socket del server
+ * @param verso             Pipe verso il proprietario
+ * @param da                Pipe dal proprietario
+ */
+static void accodante(const char *socket, int verso, int da) {
+    /** Variabili **/
+    struct timespec attesa = { 2, 0 };
+    int id[NUMERO_LETTURE], idLock = -1, maniglia = -1, esito = 0, corretti = 0;
+    void *buf = NULL;
+    size_t size = 0;
+    Operazione_Composta ops[] = {
+        { OP_OPENFILE, 0, FILE_ASSENTE, 0, NULL, 0, 0 },
+        { OP_READFILE, 0, FILE_ASSENTE, 0, NULL, 0, 0 },
+        { OP_CLOSEFILE, 0, FILE_ASSENTE, 0, NULL, 0, 0 }
+    };
+
+    /** Apro i file quando il proprietario li ha creati **/
+    if((openConnection(socket, 100, attesa) == -1) || (attendi(da) == -1)) { perror("openConnection"); exit(EXIT_FAILURE); }
+    for(int i=0; i<NUMERO_LETTURE; i++) {
+        if(openFile(letture[i], 0) == -1) { perror("openFile"); exit(EXIT_FAILURE); }
+    }
+    if(openFile(FILE_LOCK, 0) == -1) { perror("openFile"); exit(EXIT_FAILURE); }
+    if((maniglia = openHandle(FILE_RIMOSSO)) == -1) { perror("openHandle"); exit(EXIT_FAILURE); }
+
+    /** Pipeline: la lock resta in attesa, le letture accodate dopo di lei ricevono risposta prima **/
+    id[0] = readFileAsync(letture[0]);
+    idLock = lockFileAsync(FILE_LOCK);
+    for(int i=1; i<NUMERO_LETTURE; i++) id[i] = readFileAsync(letture[i]);
+    for(int i=NUMERO_LETTURE-1; i>=0; i--) {
+        if((waitResponse(id[i], &buf, &size) == 0) && (size == strlen(contenuti[i])) && (memcmp(buf, contenuti[i], size) == 0)) corretti++;
+        free(buf), buf = NULL;
+    }
+    controlla((idLock != -1) && (corretti == NUMERO_LETTURE), "letture accodate dopo una lock in attesa: risposte ricevute prima della lock, ognuna con il proprio contenuto");
+    avvisa(verso);
+    esito = waitResponse(idLock, NULL, NULL);
+    controlla(esito == 0, "lockFileAsync completata dopo l'unlock del proprietario");
+    controlla(unlockFile(FILE_LOCK) == 0, "unlockFile della lock ottenuta in pipeline");
+
+    /** Maniglia di un file rimosso da un altro client **/
+    avvisa(verso);
+    if(attendi(da) == -1) exit(EXIT_FAILURE);
+    esito = readHandle(maniglia, &buf, &size);
+    controlla((esito == -1) && (errno == ESTALE), "readHandle di un file rimosso: ESTALE");
+    free(buf), buf = NULL;
+    closeHandle(maniglia);
+    esito = readHandle(maniglia, &buf, &size);
+    controlla((esito == -1) && (errno == EBADF), "readHandle dopo closeHandle: EBADF");
+    free(buf), buf = NULL;
+
+    /** Richiesta composta che si ferma alla prima operazione fallita **/
+    esito = compoundRequest(ops, 3, NULL);
+    controlla((esito == -1) && (errno == ENOENT) && (ops[0].esito == ENOENT) && (ops[1].esito == ECANCELED) && (ops[2].esito == ECANCELED), "compoundRequest su un file assente: ENOENT e operazioni successive annullate");
+    free(ops[1].buf);
+
+    avvisa(verso);
+    closeConnection(socket);
+    exit((falliti == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[]) {
+    /** Variabili **/
+    int versoFiglio[2], versoPadre[2], stato = 0, esito = 0;
+    pid_t figlio = -1;
+
+    /** Controllo parametri **/
+    if(argc != 2) {
+        fprintf(stderr, "Uso: %s socket\n", argv[0]);
+        return EINVAL;
+    }
+
+    /** Un client per processo: la libreria ha una sola connessione **/
+    if((pipe(versoFiglio) == -1) || (pipe(versoPadre) == -1)) {
+        perror("pipe");
+        return errno;
+    }
+    if((figlio = fork()) == -1) {
+        perror("fork");
+        return errno;
+    }
+    alarm(TIMEOUT_SCENARI_S);                                   //Un server che serializza le risposte blocca gli scenari
+    if(figlio == 0) {
+        close(versoFiglio[1]), close(versoPadre[0]);
+        accodante(argv[1], versoPadre[1], versoFiglio[0]);
+    }
+    close(versoFiglio[0]), close(versoPadre[1]);
+    esito = proprietario(argv[1], versoFiglio[1], versoPadre[0]);
+    close(versoFiglio[1]);
+    if((waitpid(figlio, &stato, 0) == -1) || !WIFEXITED(stato) || (WEXITSTATUS(stato) != EXIT_SUCCESS)) esito = -1;
+
+    printf("%s\n", (esito == 0) ? "Scenari superati" : "Scenari falliti");
+    return (esito == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
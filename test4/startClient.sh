@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Test n°4: scenari del protocollo v2 con due client (lock in pipeline, maniglie, richieste composte)
+
+# Controllo gli argomenti
+if [ ! $# = 1 ]; then
+  echo "Devi specificare il PID del server"
+  exit 22;
+fi
+
+./test4/scenari ./socket.sk
+ESITO=$?
+
+# Mando il segnale di arresto al server
+kill -1 $1
+wait $1 2>/dev/null
+
+exit $ESITO